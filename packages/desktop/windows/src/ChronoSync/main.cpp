@@ -3,6 +3,7 @@
 #endif // _DEBUG
 
 #include <windows.h>
+#include <cstdio>
 #include <string>
 #include <unordered_map>
 
@@ -10,10 +11,14 @@
 #include "app.h"
 #include "admin.h"
 #include "startup.h"
+#include "queryServer.h"
+#include "usageSketch.h"
 
 #include "ChronoSync.h"
 
 #define _DEBUG_MESSAGE 1
+#define SHUTDOWN_DEADLINE 500
+#define SHUTDOWN_LOOP_WAIT 300 // Of the deadline, what the loops get to return
 
 std::unordered_map<std::string, HANDLE> Threads;
 
@@ -27,6 +32,8 @@ std::unordered_map<std::string, HANDLE> Threads;
 #define ID_CAFFEINE 104
 #define ID_INFO 105
 #define ID_AFK_MONITORING 106
+#define ID_VISIBLE_WINDOWS 107
+#define ID_INPUT_COUNTING 108
 
 
 void CreateTrayMenu() 
@@ -38,6 +45,8 @@ void CreateTrayMenu()
         {MF_SEPARATOR, 0, "", {}},
         {MF_STRING | (IsCaffeine() ? MF_CHECKED : 0U), ID_CAFFEINE, "Caffeine", {}},
         {MF_STRING | (IsAFKMonitoringActive() ? MF_CHECKED : 0U), ID_AFK_MONITORING, "Monitoring AFK", {}, !IsRunningAsAdmin()},
+        {MF_STRING | (IsVisibleTrackingActive() ? MF_CHECKED : 0U), ID_VISIBLE_WINDOWS, "Track visible windows", {}},
+        {MF_STRING | (IsInputCountingActive() ? MF_CHECKED : 0U), ID_INPUT_COUNTING, "Count input activity", {}},
         {MF_STRING | (IsAutoStart(APP_NAME) ? MF_CHECKED : 0U), ID_AUTOSTART, "AutoStart", {}},
 #ifdef _DEBUG
         {MF_SEPARATOR, 0, "", {}},
@@ -107,12 +116,31 @@ int TrayCommandCallback(HWND hwnd, WPARAM wParam) {
             }
             CreateTrayMenu();
             break;
+        case ID_VISIBLE_WINDOWS:
+            if (IsVisibleTrackingActive()) {
+                EndVisibleTracking();
+            } else {
+                BeginVisibleTracking();
+            }
+            SetSetting(SETTING_VISIBLE_WINDOWS, IsVisibleTrackingActive());
+            CreateTrayMenu();
+            break;
+        case ID_INPUT_COUNTING:
+            if (IsInputCountingActive()) {
+                EndInputCounting();
+            } else if (!BeginInputCounting()) {
+                MessageBoxA(hwnd, "Fail to start input counting.", "Input activity", MB_OK);
+            }
+            SetSetting(SETTING_INPUT_COUNTING, IsInputCountingActive());
+            CreateTrayMenu();
+            break;
 
 #ifdef _DEBUG
         case ID_DEBUG:
             MessageBoxA(hwnd, "Debug mode active. This version is not intended for distribution.", "Debug", MB_OK);
             break;
         case 1000:
+            PrintTrackerState();
             PrintToConsole();
             PrintToFile();
             break;
@@ -141,6 +169,78 @@ int TrayUserCallback(HWND hwnd, LPARAM lParam) {
 #pragma endregion TRAY_CALLBACK
 
 
+// Runs on the tracker thread as a limit from limits.txt is crossed
+void OnLimitReached(const LimitRule& rule, long long used)
+{
+    char text[256];
+    snprintf(text, sizeof(text), "%s: %lld min used, the limit is %u min.",
+             rule.name.c_str(), used / 60, rule.seconds / 60);
+    ShowTrayNotification("Usage limit reached", text);
+}
+
+
+// Stop every loop, give the threads a bounded time to finish, then drain the
+// logger and the stores. The whole of it stays within SHUTDOWN_DEADLINE.
+void Shutdown()
+{
+    static bool done = false;
+    if (done) {
+        return;
+    }
+    done = true;
+
+    ULONGLONG deadline = GetTickCount64() + SHUTDOWN_DEADLINE;
+    auto remaining = [deadline]() {
+        ULONGLONG now = GetTickCount64();
+        return now < deadline ? (DWORD)(deadline - now) : 0;
+    };
+
+    Stop();
+    StopQueryServer();
+    std::vector<HANDLE> handles;
+    for (auto it = Threads.begin(); it != Threads.end(); ++it) {
+        if (it->second != NULL) {
+            handles.push_back(it->second);
+        }
+    }
+    bool stopped = true;
+    if (!handles.empty()) {
+        DWORD waited = WaitForMultipleObjects((DWORD)handles.size(), handles.data(), TRUE, SHUTDOWN_LOOP_WAIT);
+        stopped = waited < WAIT_OBJECT_0 + handles.size();
+    }
+
+    // The logger lock orders the final flush after a tracker tick still in
+    // flight, entries added after it are dropped
+    [[maybe_unused]] bool closed = CloseLogger(remaining());
+    EndVisibleTracking();
+    EndInputCounting();
+    if (stopped) {
+        // Stores that cannot be rebuilt first: rollups, the title index and
+        // activity catch up from the text log on the next start
+        void (*saves[])() = {SaveVisibleWindows, SaveResources, SaveInput, SaveUsageSketches,
+                             SealRollups, SaveTitleIndex, SaveActivity};
+        for (auto save : saves) {
+            if (remaining() == 0) {
+                break;
+            }
+            save();
+        }
+    }
+#ifdef _DEBUG
+    // A loop that is still running may be inside one of the saves, they are skipped then
+    if (!stopped || !closed) {
+        std::cout << "Shutdown: " << (stopped ? "" : "loops still running, stores not saved ")
+                  << (closed ? "" : "logger busy, buffered sessions dropped") << "\n";
+    }
+#endif // _DEBUG
+
+    for (HANDLE handle : handles) {
+        CloseHandle(handle);
+    }
+    Threads.clear();
+}
+
+
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow)
 {
 #ifdef _RELEASE
@@ -154,6 +254,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 #pragma region TRAY_ICON
     SetTrayCommandCallback(TrayCommandCallback);
     SetTrayUserCallback(TrayUserCallback);
+    SetTrayEndSessionCallback(Shutdown);
     HWND hwnd = CreateTrayWindow(hInstance, APP_NAME);
     if (hwnd == NULL) {
         return -1;
@@ -164,6 +265,24 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 #pragma endregion TRAY_ICON
 
     CreateLogFile();
+    StartUsageSketches();
+    StartRollups();
+    StartTitleIndex();
+    StartActivity();
+    StartResources();
+    // Opt-in modes come back as they were left in the tray
+    if (GetSetting(SETTING_VISIBLE_WINDOWS)) {
+        BeginVisibleTracking();
+    }
+    if (GetSetting(SETTING_INPUT_COUNTING)) {
+        BeginInputCounting();
+    }
+    StartLimits(OnLimitReached);
+    // The menu was built before the modes above started
+    CreateTrayMenu();
+    // After the stores above have read the last line: a resumed session
+    // reaches them again marked resumed, and they add only what came after
+    ResumeSession(GetActiveWindowExecutableName(), GetActiveWindowTitle());
 
 #pragma region CREATE_THREAD
     Threads["Tracker"] = CreateThread( NULL, 0,
@@ -182,6 +301,22 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         return 0;
     }
 
+    Threads["QueryServer"] = CreateThread( NULL, 0,
+        (LPTHREAD_START_ROUTINE)(void*)QueryServerLoop,
+        NULL, 0, NULL
+    );
+    if (Threads["QueryServer"] == NULL) {
+        return 0;
+    }
+
+    Threads["Scrub"] = CreateThread( NULL, 0,
+        (LPTHREAD_START_ROUTINE)(void*)ScrubLoop,
+        NULL, 0, NULL
+    );
+    if (Threads["Scrub"] == NULL) {
+        return 0;
+    }
+
 
 #if defined(_DEBUG) && (_DEBUG_MESSAGE == 1)
     Threads["DebugMessage"] = CreateThread( NULL, 0,
@@ -200,20 +335,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         DispatchMessage(&msg);
     }
 
-    CloseHandle(Threads["Tracker"]);
-    CloseHandle(Threads["SaveToFile"]);
-#ifdef _DEBUG
-    CloseHandle(Threads["DebugMessage"]);
-    PrintToConsole();
-#endif // _DEBUG
-    PrintToFile();
-
-    for (auto it = Threads.begin(); it != Threads.end(); ++it) {
-        if (it->second != NULL) {
-            CloseHandle(it->second);
-        }
-    }
-    Threads.clear();
+    Shutdown();
 
     RemoveTrayIcon(hwnd);
     return 0;
@@ -0,0 +1,109 @@
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "collector.h"
+#include "trackerImport.h"
+
+
+static void OnSignal(int)
+{
+    StopCollector();
+}
+
+static void Usage(const char* exe)
+{
+    fprintf(stderr,
+        "usage: %s [--socket path] [--root dir] [--upstream path] [--workers n] [--io n]\n"
+        "       %s --upstream path --user name --reconcile log [--reconcile log ...]\n"
+        "  --socket    listen here (default $XDG_RUNTIME_DIR or /tmp + /" COLLECTOR_SOCKET_NAME ")\n"
+        "  --root      partition directory (default ./collector)\n"
+        "  --upstream  forward consolidated batches to another collector\n"
+        "  --workers   shard workers (default one per core)\n"
+        "  --io        socket reader threads (default one per four cores)\n"
+        "  --reconcile upload only the sessions of these logs the upstream collector lacks\n",
+        exe, exe);
+}
+
+static int RunReconcile(const CollectorConfig& config, const std::string& user, const std::vector<std::string>& logs)
+{
+    std::vector<AppLogger> sessions;
+    for (const auto& log : logs) {
+        ImportLogFile(log, sessions);
+    }
+    DigestTree tree;
+    tree.Build(sessions);
+    std::vector<std::string> lines;
+    tree.Lines("", lines);
+    size_t fullBytes = 0;
+    for (const auto& line : lines) {
+        fullBytes += line.size();
+    }
+
+    CollectorReconcileStats stats;
+    if (!ReconcileWithCollector(config.upstream, user, tree, stats)) {
+        fprintf(stderr, "reconcile with %s failed\n", config.upstream.c_str());
+        return 1;
+    }
+    fprintf(stderr, "sessions %zu, sent %zu in %zu round trips (%zu nodes compared), %zu bytes out, %zu bytes in, full upload %zu bytes\n",
+            tree.Sessions(), stats.reconcile.sessionsSent, stats.reconcile.roundTrips, stats.reconcile.nodesCompared,
+            stats.bytesSent, stats.bytesReceived, fullBytes);
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    CollectorConfig config = {};
+    std::string user;
+    std::vector<std::string> reconcile;
+    const char* runtime = getenv("XDG_RUNTIME_DIR");
+    config.socket = std::filesystem::path(runtime != NULL ? runtime : "/tmp") / COLLECTOR_SOCKET_NAME;
+    config.root = "collector";
+
+    for (int i = 1; i < argc; i++) {
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (value != NULL && strcmp(argv[i], "--socket") == 0) {
+            config.socket = value;
+        } else if (value != NULL && strcmp(argv[i], "--root") == 0) {
+            config.root = value;
+        } else if (value != NULL && strcmp(argv[i], "--upstream") == 0) {
+            config.upstream = value;
+        } else if (value != NULL && strcmp(argv[i], "--workers") == 0) {
+            config.workers = (unsigned)atoi(value);
+        } else if (value != NULL && strcmp(argv[i], "--io") == 0) {
+            config.ioThreads = (unsigned)atoi(value);
+        } else if (value != NULL && strcmp(argv[i], "--user") == 0) {
+            user = value;
+        } else if (value != NULL && strcmp(argv[i], "--reconcile") == 0) {
+            reconcile.push_back(value);
+        } else {
+            Usage(argv[0]);
+            return 2;
+        }
+        i++;
+    }
+
+    if (!reconcile.empty()) {
+        if (user.empty() || config.upstream.empty()) {
+            Usage(argv[0]);
+            return 2;
+        }
+        return RunReconcile(config, user, reconcile);
+    }
+
+    struct sigaction action = {};
+    action.sa_handler = OnSignal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    int result = RunCollector(config);
+
+    CollectorStats stats = GetCollectorStats();
+    fprintf(stderr, "batches %zu, records %zu, malformed %zu, forwarded %zu, spooled %zu, steals %zu\n",
+            stats.batches, stats.records, stats.malformed, stats.forwarded, stats.spooled, stats.steals);
+    return result;
+}
@@ -0,0 +1,73 @@
+#include "allocCounter.h"
+
+#include <cstdlib>
+#include <new>
+
+
+static thread_local size_t _thread_allocations = 0;
+
+
+size_t ThreadAllocations()
+{
+    return _thread_allocations;
+}
+
+static void* CountedAlloc(size_t size)
+{
+    _thread_allocations++;
+    return malloc(size != 0 ? size : 1);
+}
+
+void* operator new(size_t size)
+{
+    void* p = CountedAlloc(size);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return CountedAlloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return CountedAlloc(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+    free(p);
+}
@@ -0,0 +1,11 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <cstddef>
+
+// Linked into the allocation test only: replaces the global operator new to
+// count heap allocations per thread, so the test can read the count around
+// each tracker tick and each flush
+size_t ThreadAllocations();
+
+#endif // ALLOC_COUNTER_H
@@ -0,0 +1,80 @@
+#include "test.h"
+#include "trackerActivity.h"
+
+#include <fstream>
+
+
+// A year of sessions in the text log: marking them into the minute bitmaps on
+// start, and the queries behind the heatmaps, against walking the sessions
+// for the same weekday totals
+template<typename F>
+static void Time(const char* name, F query)
+{
+    int runs = 200;
+    unsigned long long result = query();
+    Stopwatch watch;
+    for (int i = 0; i < runs; i++) {
+        result += query();
+    }
+    printf("%-30s %8.1f us (%llu)\n", name, watch.Seconds() / runs * 1e6, result / (runs + 1));
+}
+
+int main()
+{
+    std::filesystem::path store = UseTestStore("bench-activity");
+    std::vector<AppLogger> logs = SyntheticSessions(100000, TimeSeconds({2025, 1, 0, 1, 0, 0, 0, 0}), 3);
+    {
+        std::ofstream file(GetLogFilePath(), std::ios::app);
+        for (const auto& log : logs) {
+            file << GetLineStr(log);
+        }
+    }
+    long from = DayNumber(logs.front().start);
+    long to = DayNumber(logs.back().end);
+
+    Stopwatch watch;
+    StartActivity();
+    printf("start over %zu sessions: %.0f ns each\n", logs.size(), watch.Seconds() / logs.size() * 1e9);
+    SaveActivity();
+    printf("saved series: %.1f KB\n", std::filesystem::file_size(store / ACTIVITY_FILE) / 1e3);
+
+    Time("minutes by day", [&]() {
+        std::vector<unsigned> days = ActivityByDay("Code.exe", from, to);
+        unsigned long long total = 0;
+        for (unsigned minutes : days) {
+            total += minutes;
+        }
+        return total;
+    });
+    Time("minutes by weekday", [&]() {
+        unsigned long long weekdays[7];
+        ActivityByWeekday("Code.exe", from, to, weekdays);
+        return weekdays[1];
+    });
+    Time("minutes by weekday and hour", [&]() {
+        unsigned long long hours[7][24];
+        ActivityByHour("Code.exe", from, to, hours);
+        return hours[1][10];
+    });
+    Time("overlap", [&]() { return ActivityOverlap("Code.exe", "chrome.exe", from, to); });
+    Time("union", [&]() { return ActivityUnion("Code.exe", "chrome.exe", from, to); });
+
+    // What the bitmaps replace: the minutes each session touches, with the
+    // same end convention, without merging minutes two sessions share
+    Time("session scan by weekday", [&]() {
+        unsigned long long weekdays[7] = {};
+        for (const auto& log : logs) {
+            if (log.executable != "Code.exe") {
+                continue;
+            }
+            long long start = TimeSeconds(log.start), end = TimeSeconds(log.end);
+            long long last = end > start ? end - 1 : start;
+            for (long long minute = start / 60; minute <= last / 60; minute++) {
+                weekdays[((minute / 1440 + 4) % 7 + 7) % 7]++;
+            }
+        }
+        return weekdays[1];
+    });
+    RemoveTestStore();
+    return 0;
+}
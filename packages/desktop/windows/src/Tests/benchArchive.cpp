@@ -0,0 +1,99 @@
+#include "test.h"
+#include "trackerArchive.h"
+#include "trackerImport.h"
+
+#include <fstream>
+
+
+// Compaction of a year of sessions, the block reads every export and query
+// pays, and what a query costs against the same history left uncompressed
+int main()
+{
+    UseTestStore("bench-archive");
+    std::filesystem::path logPath = GetLogFilePath();
+    std::vector<AppLogger> logs = SyntheticSessions(100000, Now() - 366 * 86400);
+    std::string text;
+    for (const auto& log : logs) {
+        AppendLogLine(text, log);
+    }
+    std::ofstream(logPath, std::ios::binary) << text;
+
+    Stopwatch compaction;
+    CompactLogFile();
+    printf("compact %zu sessions (%.1f MB): %.0f ms\n", logs.size(), text.size() / 1e6, compaction.Seconds() * 1e3);
+
+    size_t raw = 0, compressed = 0, blocks = 0, sessions = 0;
+    std::vector<ArchiveReader> readers;
+    for (const auto& entry : std::filesystem::directory_iterator(logPath.parent_path() / "Archive")) {
+        ArchiveReader reader;
+        if (entry.path().extension() == ".csa" && OpenArchive(entry.path(), reader)) {
+            for (const auto& block : reader.blocks) {
+                raw += block.rawSize;
+                compressed += block.compressedSize;
+            }
+            blocks += reader.blocks.size();
+            readers.push_back(std::move(reader));
+        }
+    }
+    printf("archives: %zu months, %zu blocks, %.1f MB -> %.1f MB (%.2fx)\n", readers.size(), blocks, raw / 1e6,
+           compressed / 1e6, (double)raw / compressed);
+
+    double best = 1e9;
+    std::vector<AppLogger> out;
+    for (int run = 0; run < 5; run++) {
+        Stopwatch watch;
+        out.clear();
+        for (const auto& reader : readers) {
+            for (size_t i = 0; i < reader.blocks.size(); i++) {
+                ReadArchiveBlock(reader, i, out);
+            }
+        }
+        best = std::min(best, watch.Seconds());
+        sessions = out.size();
+    }
+    printf("read every block: %zu sessions, %.1f ms, %.0f MB/s decoded\n", sessions, best * 1e3, raw / best / 1e6);
+
+    best = 1e9;
+    for (int run = 0; run < 5; run++) {
+        Stopwatch watch;
+        bool intact = true;
+        for (const auto& reader : readers) {
+            for (size_t i = 0; i < reader.blocks.size(); i++) {
+                VerifyArchiveBlock(reader, i, intact);
+            }
+        }
+        best = std::min(best, watch.Seconds());
+    }
+    printf("verify every block: %.1f ms, %.0f MB/s\n", best * 1e3, compressed / best / 1e6);
+
+    // Queries of a day, a week and a month half a year back, through the
+    // archives and then with the whole history in the text log
+    std::filesystem::path archiveDir = logPath.parent_path() / "Archive";
+    long long middle = TimeSeconds(logs[logs.size() / 2].start);
+    double latency[2][3];
+    for (int compressedStore = 1; compressedStore >= 0; compressedStore--) {
+        if (!compressedStore) {
+            std::filesystem::rename(archiveDir, logPath.parent_path() / "Archive.off");
+            std::ofstream(logPath, std::ios::binary) << text;
+        }
+        int i = 0;
+        for (long long days : {1, 7, 30}) {
+            ULONGLONG from = TimeKey(TimeFromSeconds(middle));
+            ULONGLONG to = TimeKey(TimeFromSeconds(middle + days * 86400));
+            latency[compressedStore][i] = 1e9;
+            for (int run = 0; run < 5; run++) {
+                Stopwatch watch;
+                ForEachStoredSession(from, to, [](const AppLogger&) { return true; });
+                latency[compressedStore][i] = std::min(latency[compressedStore][i], watch.Seconds());
+            }
+            i++;
+        }
+    }
+    const char* ranges[] = {"a day", "a week", "a month"};
+    for (int i = 0; i < 3; i++) {
+        printf("query %s: %.2f ms archived, %.2f ms from the text log\n", ranges[i], latency[1][i] * 1e3,
+               latency[0][i] * 1e3);
+    }
+    RemoveTestStore();
+    return 0;
+}
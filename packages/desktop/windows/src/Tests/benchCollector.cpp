@@ -0,0 +1,148 @@
+#include "test.h"
+#include "collector.h"
+
+#include <algorithm>
+#include <csignal>
+#include <thread>
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+// Closed loop: every client sends its next batch as soon as the last one is
+// acked, numbered so no line repeats one the collector already holds.
+// Throughput per worker core and ack latency, for 1 to all cores and a few
+// client counts and batch sizes.
+typedef struct {
+    int fd;
+    std::string header;
+    std::vector<std::string> lines; // Without the newline, the batch number follows
+    size_t sequence;
+    std::string batch;
+    std::chrono::steady_clock::time_point sent;
+    std::string in;
+} Client;
+
+static int Connect(const std::filesystem::path& path)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path.c_str());
+    for (int i = 0; i < 200 && connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return fd;
+}
+
+static bool SendAll(int fd, const std::string& data)
+{
+    for (size_t at = 0; at < data.size();) {
+        ssize_t n = send(fd, data.data() + at, data.size() - at, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        at += (size_t)n;
+    }
+    return true;
+}
+
+static void SendNext(Client& client)
+{
+    std::string number = std::to_string(client.sequence++) + '\n';
+    client.batch = client.header;
+    for (const auto& line : client.lines) {
+        client.batch += line;
+        client.batch += number;
+    }
+    SendAll(client.fd, client.batch);
+}
+
+static void Run(const std::filesystem::path& store, unsigned workers, int clients, size_t batch, double seconds)
+{
+    CollectorConfig config = {};
+    config.socket = store / COLLECTOR_SOCKET_NAME;
+    config.root = store / "Collector";
+    config.workers = workers;
+    config.ioThreads = 1;
+    std::filesystem::remove_all(config.root);
+    std::thread server([&]() { RunCollector(config); });
+
+    std::vector<AppLogger> logs = SyntheticSessions(batch, TimeSeconds({2026, 10, 0, 19, 8, 0, 0, 0}), 7);
+    std::vector<Client> all(clients);
+    int epoll = epoll_create1(0);
+    for (int i = 0; i < clients; i++) {
+        Client& client = all[i];
+        client.fd = Connect(config.socket);
+        client.header = "BATCH user" + std::to_string(i) + ' ' + std::to_string(batch) + '\n';
+        for (const auto& log : logs) {
+            client.lines.push_back(GetLineStr(log));
+            client.lines.back().back() = ' ';
+        }
+        client.sequence = 0;
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.ptr = &client;
+        epoll_ctl(epoll, EPOLL_CTL_ADD, client.fd, &event);
+    }
+
+    std::vector<double> latencies;
+    Stopwatch watch;
+    for (auto& client : all) {
+        client.sent = std::chrono::steady_clock::now();
+        SendNext(client);
+    }
+    epoll_event events[64];
+    char buffer[256];
+    while (watch.Seconds() < seconds) {
+        int n = epoll_wait(epoll, events, 64, 100);
+        for (int i = 0; i < n; i++) {
+            Client& client = *(Client*)events[i].data.ptr;
+            ssize_t r = recv(client.fd, buffer, sizeof(buffer), 0);
+            if (r <= 0) {
+                continue;
+            }
+            client.in.append(buffer, r);
+            size_t eol;
+            while ((eol = client.in.find('\n')) != std::string::npos) {
+                client.in.erase(0, eol + 1);
+                auto now = std::chrono::steady_clock::now();
+                latencies.push_back(std::chrono::duration<double, std::micro>(now - client.sent).count());
+                client.sent = now;
+                SendNext(client);
+            }
+        }
+    }
+    double elapsed = watch.Seconds();
+    for (auto& client : all) {
+        close(client.fd);
+    }
+    close(epoll);
+    StopCollector();
+    server.join();
+
+    std::sort(latencies.begin(), latencies.end());
+    auto at = [&](double q) { return latencies.empty() ? 0.0 : latencies[(size_t)(q * (latencies.size() - 1))]; };
+    double records = latencies.size() * (double)batch / elapsed;
+    unsigned cores = std::min(workers, std::max(1u, std::thread::hardware_concurrency()));
+    printf("%u workers, %3d clients, batches of %4zu: %6.0f k records/s, %6.0f k per core, ack p50 %7.0f us, p99 %7.0f us\n",
+           workers, clients, batch, records / 1000, records / cores / 1000, at(0.5), at(0.99));
+}
+
+int main()
+{
+    signal(SIGPIPE, SIG_IGN);
+    std::filesystem::path store = UseTestStore("bench-collector");
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned workers = 1; workers <= cores; workers *= 2) {
+        for (int clients : {1, 16, 128}) {
+            for (size_t batch : {10, 100, 1000}) {
+                Run(store, workers, clients, batch, 2.0);
+            }
+        }
+    }
+    RemoveTestStore();
+    return 0;
+}
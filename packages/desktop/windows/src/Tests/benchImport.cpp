@@ -0,0 +1,84 @@
+#include "test.h"
+#include "trackerImport.h"
+
+#include <fstream>
+#include <thread>
+
+
+// A year and a half of sessions, imported whole by one thread and then by all
+// of them, then logs grown to a few GB
+int main()
+{
+    UseTestStore("bench-import");
+    std::vector<AppLogger> logs = SyntheticSessions(400000, TimeSeconds({2023, 1, 0, 1, 0, 0, 0, 0}));
+    std::string text;
+    for (const auto& log : logs) {
+        AppendLogLine(text, log);
+    }
+    std::ofstream(GetLogFilePath(), std::ios::binary) << text;
+
+    std::vector<unsigned> counts = {1, 4};
+    if (std::thread::hardware_concurrency() > 4) {
+        counts.push_back(std::thread::hardware_concurrency());
+    }
+    for (unsigned threads : counts) {
+        double best = 1e9;
+        std::vector<AppLogger> out;
+        for (int run = 0; run < 5; run++) {
+            out.clear();
+            Stopwatch watch;
+            ImportLogFile(GetLogFilePath(), out, threads);
+            best = std::min(best, watch.Seconds());
+        }
+        printf("import %zu sessions, %.1f MB, %u threads: %.1f ms, %.0f MB/s\n", out.size(), text.size() / 1e6,
+               threads, best * 1e3, text.size() / best / 1e6);
+    }
+
+    // getline and ParseLogLine, what a plain reader of the log costs
+    Stopwatch watch;
+    std::ifstream file(GetLogFilePath(), std::ios::binary);
+    std::string line;
+    AppLogger log;
+    size_t parsed = 0;
+    while (std::getline(file, line)) {
+        parsed += ParseLogLine(line.data(), line.size(), log);
+    }
+    printf("getline reader: %zu sessions, %.0f MB/s\n", parsed, text.size() / watch.Seconds() / 1e6);
+    file.close();
+
+    // Up to years of heavy browsing: logs of a few GB with long titles, so the
+    // imported sessions still fit in memory beside the mapped file
+    std::vector<AppLogger> day = SyntheticSessions(2000, TimeSeconds({2020, 1, 0, 1, 0, 0, 0, 0}), 26);
+    for (auto& log : day) {
+        log.title += " - https://example.com/" + std::string(400 + log.title.size() % 200, 'q');
+    }
+    uintmax_t written = 0;
+    for (uintmax_t size : {256ULL << 20, 1ULL << 30, 2ULL << 30}) {
+        std::ofstream log(GetLogFilePath(), std::ios::binary | std::ios::app);
+        for (long long shift = 0; written < size; shift += 86400) {
+            text.clear();
+            for (AppLogger session : day) {
+                session.start = TimeFromSeconds(TimeSeconds(session.start) + shift);
+                session.end = TimeFromSeconds(TimeSeconds(session.end) + shift);
+                AppendLogLine(text, session);
+            }
+            log << text;
+            written += text.size();
+        }
+        log.close();
+        for (unsigned threads : counts) {
+            double best = 1e9;
+            std::vector<AppLogger> out;
+            for (int run = 0; run < 2; run++) {
+                out.clear();
+                Stopwatch watch;
+                ImportLogFile(GetLogFilePath(), out, threads);
+                best = std::min(best, watch.Seconds());
+            }
+            printf("import %zu sessions, %.2f GB, %u threads: %.2f s, %.0f MB/s\n", out.size(), written / 1e9,
+                   threads, best, written / best / 1e6);
+        }
+    }
+    RemoveTestStore();
+    return 0;
+}
@@ -0,0 +1,112 @@
+#include "test.h"
+#include "trackerIndex.h"
+
+
+// A month of sessions: building the segment, its file, and the queries SEARCH
+// serves. Then a year in the text log: the index against the log's size, and
+// searches over time ranges spanning one to twelve monthly segments.
+static void BenchYear()
+{
+    std::vector<AppLogger> logs = SyntheticSessions(100000, TimeSeconds({2024, 1, 0, 1, 0, 0, 0, 0}), 8);
+    {
+        std::ofstream file(GetLogFilePath(), std::ios::binary | std::ios::trunc);
+        for (const auto& log : logs) {
+            file << GetLineStr(log);
+        }
+    }
+    Stopwatch watch;
+    StartTitleIndex();
+    SaveTitleIndex();
+    double build = watch.Seconds();
+    uintmax_t indexBytes = 0;
+    size_t segments = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(GetLogFilePath().parent_path() / "Index")) {
+        indexBytes += entry.file_size();
+        segments++;
+    }
+    uintmax_t logBytes = std::filesystem::file_size(GetLogFilePath());
+    printf("year: %zu sessions, log %.1f MB, %zu segments %.1f MB (%.0f%% of the log), built and saved in %.2f s\n",
+           logs.size(), logBytes / 1e6, segments, indexBytes / 1e6, 100.0 * indexBytes / logBytes, build);
+
+    const char* queries[] = {"report", "\"design review\" exe:slack.exe", "rel*", "missing"};
+    const struct {
+        const char* name;
+        ULONGLONG from;
+        ULONGLONG to;
+    } ranges[] = {
+        {"a day", 20240612000000ULL, 20240612235959ULL},
+        {"a week", 20240610000000ULL, 20240616235959ULL},
+        {"a month", 20240601000000ULL, 20240630235959ULL},
+        {"a quarter", 20240401000000ULL, 20240630235959ULL},
+        {"the year", 20240101000000ULL, 20241231235959ULL},
+        {"open", 0, 0},
+    };
+    for (const char* text : queries) {
+        for (const auto& range : ranges) {
+            std::vector<AppLogger> out;
+            int runs = 20;
+            watch = Stopwatch();
+            for (int i = 0; i < runs; i++) {
+                out = SearchTitles(text, range.from, range.to);
+            }
+            double limited = watch.Seconds() / runs;
+            watch = Stopwatch();
+            for (int i = 0; i < runs; i++) {
+                out = SearchTitles(text, range.from, range.to, 1000000);
+            }
+            printf("%-32s %-9s %6zu matches: first %d in %7.1f us, all in %8.1f us\n", text, range.name, out.size(),
+                   INDEX_DEFAULT_LIMIT, limited * 1e6, watch.Seconds() / runs * 1e6);
+        }
+    }
+}
+
+int main()
+{
+    std::filesystem::path store = UseTestStore("bench-index");
+    std::vector<AppLogger> logs = SyntheticSessions(30000, TimeSeconds({2024, 3, 0, 1, 0, 0, 0, 0}), 5);
+    while (!logs.empty() && logs.back().start.wMonth != 3) {
+        logs.pop_back();
+    }
+
+    IndexSegment segment(202403);
+    Stopwatch watch;
+    for (const auto& log : logs) {
+        segment.Add(log);
+    }
+    double build = watch.Seconds();
+    // Everything again, as the catch-up on start hands it over
+    watch = Stopwatch();
+    for (const auto& log : logs) {
+        segment.Add(log);
+    }
+    double again = watch.Seconds();
+    printf("index %zu sessions, %zu terms: %.0f ns per session, %.0f ns per duplicate\n", segment.Sessions(),
+           segment.Terms(), build / logs.size() * 1e9, again / logs.size() * 1e9);
+
+    watch = Stopwatch();
+    segment.Save(store / "2024-03.idx");
+    double save = watch.Seconds();
+    IndexSegment loaded;
+    watch = Stopwatch();
+    loaded.Load(store / "2024-03.idx");
+    printf("file %.0f KB: save %.2f ms, load %.2f ms\n", std::filesystem::file_size(store / "2024-03.idx") / 1e3,
+           save * 1e3, watch.Seconds() * 1e3);
+
+    const char* queries[] = {"report", "quarterly report", "rel*", "\"design review\" exe:slack.exe", "exe:chrome*",
+                             "日本語", "missing"};
+    for (const char* text : queries) {
+        IndexQuery query;
+        ParseIndexQuery(text, query);
+        std::vector<AppLogger> out;
+        int runs = 200;
+        watch = Stopwatch();
+        for (int i = 0; i < runs; i++) {
+            out.clear();
+            loaded.Search(query, 0, 1LL << 62, INDEX_DEFAULT_LIMIT, out);
+        }
+        printf("%-32s %3zu matches: %.1f us\n", text, out.size(), watch.Seconds() / runs * 1e6);
+    }
+    BenchYear();
+    RemoveTestStore();
+    return 0;
+}
@@ -0,0 +1,41 @@
+#include "test.h"
+#include "syntheticInput.h"
+
+#include <thread>
+
+
+// What the hooks pay per event, RecordInput alone, and the evdev path end to
+// end: synthetic devices written, read, classified and counted
+int main()
+{
+    const long calls = 200000000;
+    Stopwatch watch;
+    for (long i = 0; i < calls; i++) {
+        RecordInput((InputKind)(i % INPUT_KINDS));
+    }
+    printf("RecordInput: %.2f ns per call\n", watch.Seconds() * 1e9 / calls);
+
+    std::filesystem::path store = UseTestStore("bench-input");
+    SyntheticInput devices(store / "devices", 4);
+    BeginInputCounting((store / "devices").c_str());
+    ReduceInput();
+    InputSummary taken;
+    TakeSessionInput(taken);
+    const size_t events = 2000000;
+    watch = Stopwatch();
+    InputSummary expected = devices.Generate(events, 47);
+    uint32_t total = expected.keys + expected.clicks + expected.scrolls;
+    uint32_t counted = 0;
+    while (counted < total && watch.Seconds() < 10) {
+        ReduceInput();
+        TakeSessionInput(taken);
+        counted += taken.keys + taken.clicks + taken.scrolls;
+        std::this_thread::yield();
+    }
+    double seconds = watch.Seconds();
+    printf("evdev: %zu events over 4 devices, %u of %u counted, %.0f ns per event written and read\n", events, counted,
+           total, seconds * 1e9 / events);
+    EndInputCounting();
+    RemoveTestStore();
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include "test.h"
+#include "allocCounter.h"
+#include "trackerImport.h"
+#include "trackerJson.h"
+
+#include <algorithm>
+#include <fstream>
+
+
+// Encoding throughput and heap allocations of upload-sized payloads, of long
+// titles with nothing to escape and with escapes throughout, and of a store
+// exported to a sink
+static double Best(int runs, const std::function<void()>& work)
+{
+    double best = 1e9;
+    for (int run = 0; run < runs; run++) {
+        Stopwatch watch;
+        work();
+        best = std::min(best, watch.Seconds());
+    }
+    return best;
+}
+
+int main()
+{
+    std::vector<AppLogger> logs = SyntheticSessions(100000, Now() - 366 * 86400);
+    JsonWriter json;
+    size_t bytes = 0;
+    size_t allocations = 0;
+    double seconds = Best(5, [&]() {
+        bytes = 0;
+        allocations = ThreadAllocations();
+        for (size_t from = 0; from < logs.size(); from += JSON_BATCH_SESSIONS) {
+            json.Clear();
+            json.BeginObject();
+            json.Key("deviceId");
+            json.Int(42);
+            json.Key("sessions");
+            json.BeginArray();
+            for (size_t i = from; i < std::min(logs.size(), from + JSON_BATCH_SESSIONS); i++) {
+                WriteSessionJson(json, logs[i]);
+            }
+            json.EndArray();
+            json.EndObject();
+            bytes += json.Size();
+        }
+        allocations = ThreadAllocations() - allocations;
+    });
+    size_t batches = (logs.size() + JSON_BATCH_SESSIONS - 1) / JSON_BATCH_SESSIONS;
+    printf("%zu sessions in payloads of %d: %.1f MB, %.0f MB/s, %.0f ns per session, %.1f allocations per payload\n",
+           logs.size(), JSON_BATCH_SESSIONS, bytes / 1e6, bytes / 1e6 / seconds, seconds * 1e9 / logs.size(),
+           (double)allocations / batches);
+
+    std::string clean(1 << 20, 'x');
+    std::string escaped;
+    while (escaped.size() < clean.size()) {
+        escaped += "C:\\Users\\me\\\"notes\"\t\xc3\xa9t\xc3\xa9.txt ";
+    }
+    for (const std::string* title : {&clean, &escaped}) {
+        seconds = Best(5, [&]() {
+            for (int i = 0; i < 50; i++) {
+                json.Clear();
+                json.String(*title);
+            }
+        });
+        printf("%s 1 MB title: %.0f MB/s\n", title == &clean ? "clean" : "escaped", 50 * title->size() / 1e6 / seconds);
+    }
+
+    UseTestStore("bench-json");
+    {
+        std::ofstream file(GetLogFilePath(), std::ios::binary);
+        for (const auto& log : logs) {
+            file << GetLineStr(log);
+        }
+    }
+    JsonExportStats stats = {};
+    seconds = Best(3, [&]() {
+        allocations = ThreadAllocations();
+        stats = ExportJson(0, ~0ULL, 42, [](const char*, size_t) { return true; });
+        allocations = ThreadAllocations() - allocations;
+    });
+    printf("export of %zu stored sessions, %zu payloads: %.1f MB in %.0f ms, %.0f MB/s, %.1f allocations per payload\n",
+           stats.sessions, stats.payloads, stats.bytes / 1e6, seconds * 1e3, stats.bytes / 1e6 / seconds,
+           (double)allocations / stats.payloads);
+    RemoveTestStore();
+    return 0;
+}
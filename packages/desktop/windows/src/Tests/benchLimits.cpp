@@ -0,0 +1,68 @@
+#include "test.h"
+#include "trackerLimits.h"
+
+#include <fstream>
+
+
+// Thousands of rules on the sampled executable: the cost of one sample per
+// matching rule and of a sample no rule matches, then the restart that
+// replays a week of text log into them
+static void Rules(size_t matching, std::string& text)
+{
+    char line[128];
+    for (size_t i = 0; i < matching; i++) {
+        static const char* formats[] = {"daily %zu ; r%zu ; Code.exe,x%zu.exe\n", "streak %zu ; r%zu ; Code.exe,x%zu.exe\n",
+                                        "window %zu 86400 ; r%zu ; Code.exe,x%zu.exe\n"};
+        snprintf(line, sizeof(line), formats[i % 3], 600 + i, i, i);
+        text += line;
+    }
+    for (size_t i = 0; i < 1000; i++) {
+        snprintf(line, sizeof(line), "daily 60 ; o%zu ; other%zu.exe\n", i, i);
+        text += line;
+    }
+}
+
+int main()
+{
+    const int samples = 20000;
+    long long start = TimeSeconds({2024, 5, 0, 6, 9, 0, 0, 0});
+    for (size_t matching : {1000, 5000, 20000}) {
+        LimitEngine engine;
+        std::string text;
+        Rules(matching, text);
+        size_t at = 0;
+        for (size_t end; (end = text.find('\n', at)) != std::string::npos; at = end + 1) {
+            engine.AddRule(text.substr(at, end - at));
+        }
+        std::string code = "Code.exe";
+        Stopwatch watch;
+        for (int s = 0; s < samples; s++) {
+            engine.Add(code, start + s, start + s + 1, false);
+        }
+        double us = watch.Seconds() * 1e6 / samples;
+        std::string other = "notepad.exe";
+        watch = Stopwatch();
+        for (int s = 0; s < samples; s++) {
+            engine.Add(other, start + samples + s, start + samples + s + 1, false);
+        }
+        printf("%zu matching rules, 1000 others: %.1f us per sample, %.1f ns per rule; unmatched sample %.0f ns\n",
+               matching, us, us * 1e3 / matching, watch.Seconds() * 1e9 / samples);
+    }
+
+    // A restart: rules read, then the log replayed back to the longest window
+    std::filesystem::path store = UseTestStore("bench-limits");
+    std::string text;
+    Rules(3000, text);
+    std::ofstream(store / LIMITS_FILE) << text;
+    std::vector<AppLogger> week = SyntheticSessions(3500, Now() - 7 * 86400, 48);
+    std::ofstream log(GetLogFilePath());
+    for (const auto& session : week) {
+        log << GetLineStr(session);
+    }
+    log.close();
+    Stopwatch watch;
+    StartLimits(nullptr);
+    printf("restart with 4000 rules over %zu sessions: %.1f ms\n", week.size(), watch.Seconds() * 1e3);
+    RemoveTestStore();
+    return 0;
+}
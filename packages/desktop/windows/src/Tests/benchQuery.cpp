@@ -0,0 +1,146 @@
+#include "test.h"
+#include "queryServer.h"
+#include "trackerRollup.h"
+#include "trackerState.h"
+
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <fstream>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+
+// Round trips of the small requests on one open connection, and how long a
+// session change takes to reach every subscriber
+static int Connect(const std::string& path)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    for (int i = 0; i < 200 && connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return fd;
+}
+
+// Reads up to the empty line that ends every response
+static void Response(int fd, std::string& out)
+{
+    out.clear();
+    char buffer[4096];
+    ssize_t n;
+    while (out != "\n" && (out.size() < 2 || out.compare(out.size() - 2, 2, "\n\n") != 0)) {
+        if ((n = read(fd, buffer, sizeof(buffer))) <= 0) {
+            return;
+        }
+        out.append(buffer, n);
+    }
+}
+
+static void Percentiles(std::vector<double>& us, double& p50, double& p99)
+{
+    std::sort(us.begin(), us.end());
+    p50 = us[us.size() / 2];
+    p99 = us[us.size() * 99 / 100];
+}
+
+int main()
+{
+    signal(SIGPIPE, SIG_IGN);
+    std::filesystem::path store = UseTestStore("bench-query");
+    setenv("XDG_RUNTIME_DIR", store.c_str(), 1);
+    std::vector<AppLogger> week = SyntheticSessions(3500, Now() - 7 * 86400, 30);
+    {
+        std::ofstream file(GetLogFilePath(), std::ios::binary);
+        for (const auto& log : week) {
+            if (TimeSeconds(log.end) < Now()) {
+                file << GetLineStr(log);
+            }
+        }
+    }
+    StartRollups();
+    AddEntry("Code.exe", "main.cpp - query");
+    TrackerState state = {};
+    state.hasSession = GetCurrentSession(state.current);
+    PublishTrackerState(state);
+    std::thread server(QueryServerLoop);
+    std::string path = QuerySocketPath();
+
+    int fd = Connect(path);
+    std::string range = "RANGE " + std::to_string(TimeKey(TimeFromSeconds(Now() - 7 * 86400))) + " " +
+                        std::to_string(TimeKey(GetTime()));
+    std::string out;
+    for (const std::string& request : {std::string("CURRENT"), std::string("TOP 10"), range}) {
+        std::vector<double> us;
+        std::string line = request + "\n";
+        for (int i = 0; i < 2000; i++) {
+            Stopwatch watch;
+            write(fd, line.data(), line.size());
+            Response(fd, out);
+            us.push_back(watch.Seconds() * 1e6);
+        }
+        double p50, p99;
+        Percentiles(us, p50, p99);
+        printf("%-6s p50 %.1f us, p99 %.1f us, %zu bytes\n", request.substr(0, request.find(' ')).c_str(), p50, p99,
+               out.size());
+    }
+    close(fd);
+
+    // Each subscriber notes the last change it read, the clock stops once all have it
+    for (int subscribers : {1, 4, 15}) {
+        std::vector<std::atomic<int>> seen(subscribers);
+        std::vector<std::thread> readers;
+        std::vector<int> fds;
+        for (int s = 0; s < subscribers; s++) {
+            seen[s] = -1;
+            fds.push_back(Connect(path));
+            write(fds[s], "SUBSCRIBE\n", 10);
+            readers.emplace_back([&, s]() {
+                char buffer[4096];
+                std::string text;
+                ssize_t n;
+                while ((n = read(fds[s], buffer, sizeof(buffer))) > 0) {
+                    text.append(buffer, n);
+                    size_t at = text.rfind("change ");
+                    if (at != std::string::npos) {
+                        seen[s] = atoi(text.c_str() + at + 7);
+                    }
+                    text.erase(0, text.rfind('\n') + 1);
+                }
+            });
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        std::vector<double> us;
+        for (int change = 0; change < 500; change++) {
+            std::string title = "change " + std::to_string(change);
+            Stopwatch watch;
+            AddEntry("Code.exe", title.c_str());
+            for (int s = 0; s < subscribers; s++) {
+                while (seen[s] != change) {
+                    std::this_thread::yield();
+                }
+            }
+            us.push_back(watch.Seconds() * 1e6);
+        }
+        for (int s = 0; s < subscribers; s++) {
+            shutdown(fds[s], SHUT_RDWR);
+            readers[s].join();
+            close(fds[s]);
+        }
+        // The next change finds them gone and frees their slots
+        AddEntry("Code.exe", "between rounds");
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        double p50, p99;
+        Percentiles(us, p50, p99);
+        printf("session change to %2d subscribers: p50 %.1f us, p99 %.1f us\n", subscribers, p50, p99);
+    }
+
+    StopQueryServer();
+    server.join();
+    RemoveTestStore();
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include "test.h"
+#include "trackerResources.h"
+
+#include <csignal>
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+// The sampler tracking 100 processes, one of them busy in the foreground: what
+// it adds to each one-second tick, against the budget it has to stay under
+#define TICK_BUDGET_US 1000 // A tenth of a percent of the tick
+
+int main()
+{
+    std::vector<pid_t> children;
+    for (int i = 0; i < 99; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            pause();
+            _exit(0);
+        }
+        children.push_back(pid);
+    }
+    pid_t busy = fork();
+    if (busy == 0) {
+        volatile unsigned long spin = 0;
+        for (;;) {
+            spin = spin + 1;
+        }
+    }
+    children.push_back(busy);
+
+    ResourceSampler sampler;
+    for (pid_t pid : children) {
+        sampler.Sample(pid);
+    }
+    ResourceSummary summary;
+    sampler.Take(summary);
+
+    // Steady state: the busy child in the foreground, the others read in turn
+    const int samples = 2000;
+    Stopwatch watch;
+    for (int i = 0; i < samples; i++) {
+        sampler.Sample(busy);
+    }
+    double us = watch.Seconds() * 1e6 / samples;
+    printf("%zu tracked, 1 + %d read per sample: %.1f us per tick, budget %d us%s\n", sampler.Tracked(),
+           RESOURCE_BATCH, us, TICK_BUDGET_US, us < TICK_BUDGET_US ? "" : " EXCEEDED");
+
+    sampler.Take(summary);
+    usleep(500000);
+    sampler.Sample(busy);
+    sampler.Take(summary);
+    printf("busy child over 0.5 s: cpu %u ms, background cpu %u ms, peak rss %u KB\n", summary.cpuMs,
+           summary.backgroundCpuMs, summary.peakRssKb);
+
+    // A process that exits is dropped on its next read
+    kill(children[0], SIGKILL);
+    waitpid(children[0], nullptr, 0);
+    for (int i = 0; i < 100 / RESOURCE_BATCH + 1; i++) {
+        sampler.Sample(busy);
+    }
+    printf("after one exit: %zu tracked\n", sampler.Tracked());
+
+    for (pid_t pid : children) {
+        kill(pid, SIGKILL);
+    }
+    while (wait(nullptr) > 0) {
+    }
+    return us < TICK_BUDGET_US ? 0 : 1;
+}
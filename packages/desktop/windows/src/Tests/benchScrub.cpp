@@ -0,0 +1,153 @@
+#include "test.h"
+#include "fakes.h"
+#include "checksum.h"
+#include "trackerArchive.h"
+#include "trackerImport.h"
+#include "trackerScrub.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <thread>
+
+
+// CRC32C throughput of the instructions and the table at block and file
+// sizes, a scrub pass over a year of archives against decoding them, then
+// how late tracker ticks on a 10 ms cadence run while a pass goes on
+static double MBps(uint32_t (*crc)(const void*, size_t, uint32_t), const std::string& data, size_t size, uint32_t& out)
+{
+    double best = 1e9;
+    size_t rounds = std::max<size_t>(1, (64 << 20) / size);
+    for (int run = 0; run < 3; run++) {
+        Stopwatch watch;
+        for (size_t i = 0; i < rounds; i++) {
+            out = crc(data.data(), size, out);
+        }
+        best = std::min(best, watch.Seconds());
+    }
+    return size * rounds / 1e6 / best;
+}
+
+static bool Unpaced(size_t)
+{
+    return false;
+}
+
+static std::atomic<bool> _stop;
+
+// As the scrub thread paces itself, stopping when the ticks are done
+static bool Paced(size_t bytes)
+{
+    std::this_thread::sleep_for(std::chrono::microseconds(bytes * 1000000 / SCRUB_BYTES_PER_SECOND));
+    return _stop;
+}
+
+static bool Stopped(size_t)
+{
+    return _stop;
+}
+
+// Lateness of each wake-up plus the tick it runs, microseconds, sorted
+static std::vector<double> TickLateness(ScrubPace pace)
+{
+    long long seconds = Now();
+    std::string executable = "chrome.exe";
+    std::string title = "Inbox - Mail - Google Chrome";
+    bool afk = false;
+    int wakes = 0;
+    int ended = 0;
+    std::vector<AppLogger> log;
+    Sessionizer<FakeClock> sessionizer(log, FakeClock{&seconds});
+    FakeFingerprintWindow window;
+    window.executable = &executable;
+    window.title = &title;
+    Tracker<FakeClock, FakeFingerprintWindow, FakeIdle, FakeExtendSink> tracker(
+        FakeClock{&seconds}, window, FakeIdle{&afk, &wakes}, FakeExtendSink{{&sessionizer, &ended}, &log, FakeClock{&seconds}});
+
+    _stop = false;
+    std::thread scrub;
+    if (pace != nullptr) {
+        scrub = std::thread([pace]() {
+            while (!_stop) {
+                ScrubStats stats = {};
+                ScrubArchives(stats, pace);
+            }
+        });
+    }
+    std::vector<double> late;
+    auto next = std::chrono::steady_clock::now();
+    for (int i = 0; i < 500; i++) {
+        next += std::chrono::milliseconds(10);
+        std::this_thread::sleep_until(next);
+        seconds += tracker.Tick() / 1000;
+        late.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - next).count());
+    }
+    _stop = true;
+    if (scrub.joinable()) {
+        scrub.join();
+    }
+    std::sort(late.begin(), late.end());
+    return late;
+}
+
+int main()
+{
+    std::string data(4 << 20, '\0');
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = (char)(i * 2654435761u >> 13);
+    }
+    uint32_t hardware = 0, table = 0;
+    printf("crc32c, %s:\n", Crc32cImplementation());
+    for (size_t size : {64, 4096, 65536, 4 << 20}) {
+        double fast = MBps(Crc32c, data, size, hardware);
+        double slow = MBps(Crc32cTable, data, size, table);
+        printf("  %8zu bytes: %8.0f MB/s, table %6.0f MB/s\n", size, fast, slow);
+    }
+    if (hardware != table) {
+        printf("crc32c mismatch: %08x against the table's %08x\n", hardware, table);
+        return 1;
+    }
+
+    UseTestStore("bench-scrub");
+    std::vector<AppLogger> logs = SyntheticSessions(100000, Now() - 366 * 86400);
+    std::string text;
+    for (const auto& log : logs) {
+        AppendLogLine(text, log);
+    }
+    std::ofstream(GetLogFilePath(), std::ios::binary) << text;
+    CompactLogFile();
+
+    // Decoding every block, which checks the CRC on the way
+    std::vector<AppLogger> out;
+    Stopwatch watch;
+    for (const auto& entry : std::filesystem::directory_iterator(GetLogFilePath().parent_path() / "Archive")) {
+        ArchiveReader reader;
+        if (entry.path().extension() == ".csa" && OpenArchive(entry.path(), reader)) {
+            for (size_t i = 0; i < reader.blocks.size(); i++) {
+                ReadArchiveBlock(reader, i, out);
+            }
+        }
+    }
+    double decode = watch.Seconds();
+
+    ScrubStats stats = {};
+    watch = Stopwatch();
+    ScrubArchives(stats, Unpaced);
+    double scrub = watch.Seconds();
+    printf("%zu archives, %zu blocks, %.1f MB: decode %.1f ms, scrub %.1f ms (%.0f MB/s), %zu damaged\n",
+           stats.archives, stats.blocks, stats.bytes / 1e6, decode * 1e3, scrub * 1e3, stats.bytes / 1e6 / scrub,
+           stats.damaged);
+    printf("paced at %d KB/s a pass takes %.0f s\n", SCRUB_BYTES_PER_SECOND / 1024,
+           (double)stats.bytes / SCRUB_BYTES_PER_SECOND);
+
+    printf("tick lateness on a 10 ms cadence, %u cores:\n", std::thread::hardware_concurrency());
+    const char* names[] = {"no scrub", "paced scrub", "unpaced scrub"};
+    ScrubPace paces[] = {nullptr, Paced, Stopped};
+    for (int i = 0; i < 3; i++) {
+        std::vector<double> late = TickLateness(paces[i]);
+        printf("  %-14s p50 %6.0f us, p99 %6.0f us, max %6.0f us\n", names[i], late[late.size() / 2],
+               late[late.size() * 99 / 100], late.back());
+    }
+    RemoveTestStore();
+    return stats.damaged == 0 ? 0 : 1;
+}
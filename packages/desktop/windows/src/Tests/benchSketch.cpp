@@ -0,0 +1,99 @@
+#include "test.h"
+#include "usageSketch.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+
+// A month of sessions over many titles with a long tail: the sketches against
+// exact totals, and what feeding and keeping them costs
+int main()
+{
+    std::vector<AppLogger> logs = SyntheticSessions(200000, TimeSeconds({2024, 1, 0, 1, 0, 0, 0, 0}), 7);
+    // Zipf titles: a few are most of the time, most are seen once or twice
+    std::mt19937 rng(11);
+    std::vector<double> weights;
+    for (int rank = 1; rank <= 100000; rank++) {
+        weights.push_back(1.0 / rank);
+    }
+    std::discrete_distribution<int> zipf(weights.begin(), weights.end());
+    for (auto& log : logs) {
+        log.title = "title " + std::to_string(zipf(rng));
+    }
+
+    UsageSketch sketch;
+    Stopwatch watch;
+    for (const auto& log : logs) {
+        AddToUsageSketch(sketch, log);
+    }
+    double seconds = watch.Seconds();
+
+    std::unordered_map<std::string, uint64_t> titles, apps;
+    uint64_t total = 0;
+    for (const auto& log : logs) {
+        uint64_t length = TimeSeconds(log.end) - TimeSeconds(log.start);
+        titles[log.title] += length;
+        apps[log.executable] += length;
+        total += length;
+    }
+
+    // Count-Min: overcount of every title, against the epsilon * total bound
+    uint64_t worst = 0;
+    double mean = 0;
+    size_t beyond = 0;
+    for (const auto& item : titles) {
+        uint64_t over = sketch.titleSeconds.Estimate(item.first) - item.second;
+        worst = std::max(worst, over);
+        mean += over;
+        beyond += over > SKETCH_EPSILON * total;
+    }
+    printf("count-min: %zu titles, mean overcount %.1f s, worst %llu s, bound %.0f s, %.2f%% beyond it\n",
+           titles.size(), mean / titles.size(), (unsigned long long)worst, SKETCH_EPSILON * total,
+           100.0 * beyond / titles.size());
+
+    // Space-Saving: the true top titles found, and their reported errors
+    std::vector<std::pair<uint64_t, std::string>> exact;
+    for (const auto& item : titles) {
+        exact.push_back({item.second, item.first});
+    }
+    std::sort(exact.rbegin(), exact.rend());
+    for (size_t n : {10, 50}) {
+        std::vector<SpaceSaving::Counter> top = sketch.titles.Top(n);
+        size_t found = 0;
+        uint64_t error = 0;
+        for (size_t i = 0; i < n && i < exact.size(); i++) {
+            found += std::any_of(top.begin(), top.end(), [&](const auto& c) { return c.key == exact[i].second; });
+        }
+        for (const auto& c : top) {
+            error = std::max(error, c.count - titles[c.key]);
+        }
+        printf("space-saving top %zu: %zu of the true top found, worst overcount %llu s\n", n, found,
+               (unsigned long long)error);
+    }
+    std::vector<SpaceSaving::Counter> topApps = sketch.apps.Top(apps.size());
+    size_t exactApps = 0;
+    for (const auto& c : topApps) {
+        exactApps += c.count == apps[c.key] && c.error == 0;
+    }
+    printf("apps: %zu of %zu exact\n", exactApps, apps.size());
+
+    std::string data;
+    watch = Stopwatch();
+    SerializeUsageSketch(sketch, data);
+    double serialize = watch.Seconds();
+    printf("feed: %.0f ns per session; one day file: %.1f KB, serialized in %.2f ms\n", seconds / logs.size() * 1e9,
+           data.size() / 1e3, serialize * 1e3);
+
+    // The month merged, as APPS and TITLES do per request
+    std::vector<UsageSketch> days(SKETCH_DAYS);
+    for (size_t i = 0; i < logs.size(); i++) {
+        AddToUsageSketch(days[i * SKETCH_DAYS / logs.size()], logs[i]);
+    }
+    watch = Stopwatch();
+    UsageSketch merged;
+    for (const auto& day : days) {
+        MergeUsageSketch(merged, day);
+    }
+    printf("merge %d days: %.2f ms\n", SKETCH_DAYS, watch.Seconds() * 1e3);
+    return 0;
+}
@@ -0,0 +1,58 @@
+#include "test.h"
+#include "trackerActivity.h"
+#include "trackerIndex.h"
+#include "trackerRollup.h"
+#include "usageSketch.h"
+
+#include <fstream>
+#include <thread>
+
+
+// What a restart costs before the first tick: every store starting on a
+// month of text log, resuming the last session, and the first flush that
+// replaces its line.
+static void Start(const char* name, void (*start)())
+{
+    Stopwatch watch;
+    start();
+    printf("  %-22s %8.2f ms\n", name, watch.Seconds() * 1e3);
+}
+
+int main()
+{
+    UseTestStore("bench-startup");
+    long long now = Now();
+    std::vector<AppLogger> logs = SyntheticSessions(9000, now - 30 * 86400LL, 12);
+    while (!logs.empty() && TimeSeconds(logs.back().end) > now - 30) {
+        logs.pop_back();
+    }
+    logs.back().end = TimeFromSeconds(now - 30);
+    std::string text;
+    for (const auto& log : logs) {
+        text += GetLineStr(log);
+    }
+    std::ofstream(GetLogFilePath()) << text;
+    printf("%zu sessions, %.1f MB of log\n", logs.size(), text.size() / 1e6);
+
+    Stopwatch total;
+    Start("usage sketches", StartUsageSketches);
+    Start("rollups", StartRollups);
+    Start("title index", StartTitleIndex);
+    Start("activity", StartActivity);
+    Stopwatch watch;
+    bool resumed = ResumeSession(logs.back().executable.c_str(), logs.back().title.c_str());
+    printf("  %-22s %8.2f ms%s\n", "resume", watch.Seconds() * 1e3, resumed ? "" : " (not resumed)");
+    printf("ready after %.2f ms\n", total.Seconds() * 1e3);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    ExtendEntry();
+    watch = Stopwatch();
+    PrintToFile();
+    printf("first flush, replacing the resumed line: %.2f ms\n", watch.Seconds() * 1e3);
+    AddEntry("chrome.exe", "Inbox");
+    watch = Stopwatch();
+    PrintToFile();
+    printf("next flush, appending: %.2f ms\n", watch.Seconds() * 1e3);
+    RemoveTestStore();
+    return 0;
+}
@@ -0,0 +1,70 @@
+#include "test.h"
+#include "trackerState.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+
+// The cost of a view and of a publish with 0 to 8 readers pinning snapshots
+// in a loop, next to a mutex-guarded copy of the same state
+int main()
+{
+    TrackerState state = {};
+    state.hasSession = true;
+    state.current.executable = "Code.exe";
+    state.current.title = "main.cpp - ChronoSync - Visual Studio Code";
+    PublishTrackerState(state);
+
+    std::mutex mutex;
+    TrackerState locked = state;
+    for (int readers : {0, 1, 2, 4, 8}) {
+        for (int guarded = 0; guarded < 2; guarded++) {
+            std::atomic<bool> running(true);
+            std::atomic<size_t> reads(0);
+            std::vector<std::thread> threads;
+            Stopwatch readWatch;
+            for (int i = 0; i < readers; i++) {
+                threads.emplace_back([&]() {
+                    size_t count = 0;
+                    unsigned long long sum = 0;
+                    while (running) {
+                        if (guarded) {
+                            std::lock_guard<std::mutex> lock(mutex);
+                            sum += locked.ticks + locked.current.title.size();
+                        } else {
+                            TrackerStateView view;
+                            sum += view->ticks + view->current.title.size();
+                        }
+                        count++;
+                    }
+                    reads += count + (sum == 0);
+                });
+            }
+            const int publishes = 200000;
+            Stopwatch watch;
+            for (int i = 0; i < publishes; i++) {
+                state.ticks = i;
+                if (guarded) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    locked = state;
+                } else {
+                    PublishTrackerState(state);
+                }
+            }
+            double publish = watch.Seconds() * 1e9 / publishes;
+            running = false;
+            for (auto& thread : threads) {
+                thread.join();
+            }
+            double seconds = readWatch.Seconds();
+            printf("%d readers, %s: publish %.0f ns", readers, guarded ? "mutex" : "epochs", publish);
+            if (readers > 0) {
+                printf(", %.1f M reads/s, %.0f ns per read per reader", reads / seconds / 1e6,
+                       seconds * readers * 1e9 / std::max<size_t>(1, reads));
+            }
+            printf("\n");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,42 @@
+#include "test.h"
+#include "trackerTasks.h"
+
+
+// A year of sessions streamed through thousands of planned blocks, in both
+// attribution modes: building the tree, the join, and the results
+int main()
+{
+    long long start = TimeSeconds({2024, 1, 0, 1, 0, 0, 0, 0});
+    std::vector<AppLogger> logs = SyntheticSessions(105000, start, 45);
+    long long span = TimeSeconds(logs.back().end) - start;
+    printf("%zu sessions over %lld days\n", logs.size(), span / 86400);
+    std::mt19937 rng(45);
+    for (size_t blocks : {1000, 10000}) {
+        for (AttributionMode mode : {ATTRIBUTE_SHARED, ATTRIBUTE_EACH}) {
+            TaskAttribution attribution(mode);
+            rng.seed(45);
+            for (size_t i = 0; i < blocks; i++) {
+                long long from = start + rng() % span;
+                unsigned task = rng() % (blocks / 3 + 1);
+                attribution.AddBlock("task " + std::to_string(task), "type " + std::to_string(task % 7), from,
+                                     from + 900 + rng() % (4 * 3600));
+            }
+            attribution.AddRule("type 3", "Code.exe");
+            attribution.AddRule("type 3", "Slack.exe");
+
+            Stopwatch watch;
+            for (const auto& log : logs) {
+                attribution.Add(log);
+            }
+            std::vector<TaskTime> results = attribution.Results();
+            double seconds = watch.Seconds();
+            double attributed = 0;
+            for (const auto& result : results) {
+                attributed += result.seconds;
+            }
+            printf("%zu blocks, %s: %.1f ms, %zu tasks, %.0f h attributed\n", blocks,
+                   mode == ATTRIBUTE_SHARED ? "shared" : "each", seconds * 1e3, results.size(), attributed / 3600);
+        }
+    }
+    return 0;
+}
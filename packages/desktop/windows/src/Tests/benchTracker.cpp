@@ -0,0 +1,194 @@
+#include "test.h"
+#include "fakes.h"
+#include "utfConvert.h"
+
+#include <algorithm>
+#include <cstring>
+
+
+template<typename T>
+static double NanosPerTick(T& tracker, long long& seconds, std::string* title = nullptr)
+{
+    const int ticks = 2000000;
+    Stopwatch watch;
+    for (int i = 0; i < ticks; i++) {
+        if (title != nullptr && i % 64 == 0) {
+            (*title)[0] = (char)('a' + i / 64 % 26);
+        }
+        seconds += tracker.Tick() / 1000;
+    }
+    return watch.Seconds() * 1e9 / ticks;
+}
+
+// The same tick written out by hand over the same state, as the loop was
+// before the policies: the figure the template has to match
+struct HandWrittenTracker {
+    DWORD Tick()
+    {
+        const char* exec = executable->c_str();
+        if (strcmp(exec, "LockApp.exe") == 0) {
+            locked = true;
+            Add("AFK", "Lock");
+        } else if (!locked && *afk) {
+            away = true;
+            Add("AFK", "AFK");
+        } else if (away || locked) {
+            (*wakes)++;
+            away = false;
+            locked = false;
+        } else {
+            Add(exec, title->c_str());
+        }
+        return (away || locked) ? 10000 : 1000;
+    }
+    void Add(const char* exec, const char* text)
+    {
+        sessionizer->Add(exec, text, [this]() { (*closed)++; });
+    }
+
+    std::string* executable;
+    std::string* title;
+    bool* afk;
+    int* wakes;
+    Sessionizer<FakeClock>* sessionizer;
+    int* closed;
+    bool away = false;
+    bool locked = true;
+};
+
+// The window as the Win32 source reads it: the title comes as UTF-16 and is
+// transcoded on every full tick. The process path lookup has no stand-in, the
+// fast path skips it too.
+struct WideWindow {
+    const char* Executable() { return executable->c_str(); }
+    const char* Title()
+    {
+        size_t len = Utf16ToUtf8((const uint16_t*)wide->data(), wide->size(), buffer);
+        buffer[len] = '\0';
+        return buffer;
+    }
+
+    std::string* executable;
+    std::u16string* wide;
+    char buffer[UTF8_CAPACITY(512) + 1];
+};
+
+// With the fingerprint GetActiveWindowFingerprint takes: the UTF-16 title
+// hashed eight bytes at a time
+struct WideFingerprintWindow : WideWindow {
+    bool Unchanged()
+    {
+        const uint64_t m = 0xc6a4a7935bd1e995ULL;
+        const char* p = (const char*)wide->data();
+        size_t size = wide->size() * sizeof(char16_t);
+        uint64_t h = size * m;
+        for (; size >= 8; p += 8, size -= 8) {
+            uint64_t k;
+            memcpy(&k, p, 8);
+            h = (h ^ k) * m;
+        }
+        uint64_t tail = 0;
+        memcpy(&tail, p, size);
+        h = (h ^ tail) * m;
+        h ^= h >> 47;
+        bool same = h == last && *executable == lastExecutable;
+        if (!same) {
+            last = h;
+            lastExecutable = *executable;
+        }
+        return same;
+    }
+
+    uint64_t last = 0;
+    std::string lastExecutable;
+};
+
+template<typename T>
+static double NanosPerWideTick(T& tracker, long long& seconds, std::u16string* title = nullptr)
+{
+    const int ticks = 2000000;
+    Stopwatch watch;
+    for (int i = 0; i < ticks; i++) {
+        if (title != nullptr && i % 64 == 0) {
+            (*title)[0] = (char16_t)(u'a' + i / 64 % 26);
+        }
+        seconds += tracker.Tick() / 1000;
+    }
+    return watch.Seconds() * 1e9 / ticks;
+}
+
+// An unchanged window with and without the fingerprint fast path, over the
+// UTF-16 title and over the plain fakes
+static void BenchFingerprint()
+{
+    long long seconds = TimeSeconds({2024, 5, 0, 6, 9, 0, 0, 0});
+    std::string executable = "chrome.exe";
+    std::string title = "Inbox (3) - someone@example.com - Mail - Google Chrome";
+    std::u16string wide = u"Inbox (3) - someone@example.com - Mail - Google Chrome";
+    bool afk = false;
+    int wakes = 0;
+    int closed = 0;
+    std::vector<AppLogger> log;
+    std::vector<AppLogger> spare;
+    Sessionizer<FakeClock> sessionizer(log, spare, FakeClock{&seconds});
+    FakeExtendSink sink = {FakeSink{&sessionizer, &closed}, &log, FakeClock{&seconds}};
+
+    Tracker<FakeClock, WideWindow, FakeIdle, FakeExtendSink> full(FakeClock{&seconds}, WideWindow{&executable, &wide, {}},
+                                                                  FakeIdle{&afk, &wakes}, sink);
+    Tracker<FakeClock, WideFingerprintWindow, FakeIdle, FakeExtendSink> fast(
+        FakeClock{&seconds}, WideFingerprintWindow{{&executable, &wide, {}}, 0, ""}, FakeIdle{&afk, &wakes}, sink);
+    Tracker<FakeClock, FakeWindow, FakeIdle, FakeExtendSink> plain(FakeClock{&seconds}, FakeWindow{&executable, &title},
+                                                                   FakeIdle{&afk, &wakes}, sink);
+    Tracker<FakeClock, FakeFingerprintWindow, FakeIdle, FakeExtendSink> plainFast(
+        FakeClock{&seconds}, FakeFingerprintWindow{{&executable, &title}, "", ""}, FakeIdle{&afk, &wakes}, sink);
+
+    double wideFull = 1e9, wideFast = 1e9, plainFull = 1e9, plainFastest = 1e9, wideFullChanging = 1e9,
+           wideFastChanging = 1e9;
+    for (int run = 0; run < 3; run++) {
+        wideFull = std::min(wideFull, NanosPerWideTick(full, seconds));
+        wideFast = std::min(wideFast, NanosPerWideTick(fast, seconds));
+        plainFull = std::min(plainFull, NanosPerTick(plain, seconds));
+        plainFastest = std::min(plainFastest, NanosPerTick(plainFast, seconds));
+        wideFullChanging = std::min(wideFullChanging, NanosPerWideTick(full, seconds, &wide));
+        wideFastChanging = std::min(wideFastChanging, NanosPerWideTick(fast, seconds, &wide));
+    }
+    printf("unchanged UTF-16 window: %.1f ns per tick transcoded, %.1f ns with the fingerprint\n", wideFull, wideFast);
+    printf("unchanged plain window: %.1f ns per tick, %.1f ns with the fingerprint\n", plainFull, plainFastest);
+    printf("UTF-16 title changing every 64 ticks: %.1f ns per tick transcoded, %.1f ns with the fingerprint\n",
+           wideFullChanging, wideFastChanging);
+}
+
+// One tick of the tracker loop with everything but the policies inlined away,
+// against the hand-written loop; then the fingerprint fast path
+int main()
+{
+    long long seconds = TimeSeconds({2024, 5, 0, 6, 9, 0, 0, 0});
+    std::string executable = "chrome.exe";
+    std::string title = "Inbox (3) - someone@example.com - Mail - Google Chrome";
+    bool afk = false;
+    int wakes = 0;
+    int closed = 0;
+    std::vector<AppLogger> log;
+    std::vector<AppLogger> spare;
+    Sessionizer<FakeClock> sessionizer(log, spare, FakeClock{&seconds});
+
+    Tracker<FakeClock, FakeWindow, FakeIdle, FakeSink> tracker(
+        FakeClock{&seconds}, FakeWindow{&executable, &title}, FakeIdle{&afk, &wakes}, FakeSink{&sessionizer, &closed});
+    std::vector<AppLogger> handLog;
+    Sessionizer<FakeClock> handSessionizer(handLog, spare, FakeClock{&seconds});
+    int handClosed = 0;
+    HandWrittenTracker hand = {&executable, &title, &afk, &wakes, &handSessionizer, &handClosed};
+    // Alternated and the best of three kept, so neither gets a warmer machine
+    double steady = 1e9, changing = 1e9, handSteady = 1e9, handChanging = 1e9;
+    for (int run = 0; run < 3; run++) {
+        steady = std::min(steady, NanosPerTick(tracker, seconds));
+        handSteady = std::min(handSteady, NanosPerTick(hand, seconds));
+        changing = std::min(changing, NanosPerTick(tracker, seconds, &title));
+        handChanging = std::min(handChanging, NanosPerTick(hand, seconds, &title));
+    }
+    printf("steady window: %.1f ns per tick, hand-written %.1f ns\n", steady, handSteady);
+    printf("title changing every 64 ticks: %.1f ns per tick, hand-written %.1f ns, %d and %d sessions\n", changing,
+           handChanging, closed, handClosed);
+    BenchFingerprint();
+    return 0;
+}
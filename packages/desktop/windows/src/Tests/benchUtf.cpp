@@ -0,0 +1,59 @@
+#include "test.h"
+#include "utfConvert.h"
+
+#include <iconv.h>
+
+
+// Window titles mixing scripts and emoji, transcoded as the window probe does
+// on every title change
+int main()
+{
+    const char* words[] = {"Inbox", "Google", "Chrome", "Visual", "Studio", "Code", "README.md", "—", "-", "|",
+                           "Résumé", "Café", "Überprüfung", "Документ", "без", "названия", "Привет", "会議の議事録",
+                           "プロジェクト", "计划书", "腾讯会议", "微信", "한국어", "문서", "🚀", "😀", "🔥", "Spotify",
+                           "Word", "Excel", "العربية", "עברית", "Ελληνικά", "123", "(3)", "•"};
+    std::mt19937 rng(7);
+    std::vector<std::vector<uint16_t>> titles;
+    size_t units = 0;
+    for (int t = 0; t < 4096; t++) {
+        std::string text;
+        for (unsigned k = 3 + rng() % 10; k > 0; k--) {
+            text += words[rng() % (sizeof(words) / sizeof(*words))];
+            text += ' ';
+        }
+        iconv_t cd = iconv_open("UTF-16LE", "UTF-8");
+        char* src = text.data();
+        size_t srcLeft = text.size();
+        std::vector<uint16_t> title(text.size());
+        char* dst = (char*)title.data();
+        size_t dstLeft = title.size() * 2;
+        iconv(cd, &src, &srcLeft, &dst, &dstLeft);
+        iconv_close(cd);
+        title.resize(title.size() - dstLeft / 2);
+        units += title.size();
+        titles.push_back(std::move(title));
+    }
+
+    std::vector<char> out(4096);
+    size_t bytes = 0;
+    int runs = 200;
+    Stopwatch watch;
+    for (int run = 0; run < runs; run++) {
+        for (const auto& title : titles) {
+            bytes += Utf16ToUtf8(title.data(), title.size(), out.data());
+        }
+    }
+    double ns = watch.Seconds() * 1e9 / runs / titles.size();
+    printf("%zu titles, %.1f units each: %.1f ns per title, %.0f MB/s out\n", titles.size(),
+           (double)units / titles.size(), ns, bytes / (watch.Seconds() * 1e6));
+
+    watch = Stopwatch();
+    size_t valid = 0;
+    for (int run = 0; run < runs; run++) {
+        for (const auto& title : titles) {
+            valid += IsValidUtf16(title.data(), title.size());
+        }
+    }
+    printf("validate: %.1f ns per title (%zu valid)\n", watch.Seconds() * 1e9 / runs / titles.size(), valid / runs);
+    return 0;
+}
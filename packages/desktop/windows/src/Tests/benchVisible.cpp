@@ -0,0 +1,97 @@
+#include "test.h"
+#include "fakes.h"
+
+#include <algorithm>
+#include <set>
+
+
+// The visible-window set over 250 windows, against one foreground-only tick.
+// The enumeration itself is the desktop's and not measured here: each sample
+// is a fresh copy of the fake screen in Z order, as EnumVisibleWindows gives.
+static std::mt19937 _rng(42);
+static std::vector<VisibleSample> _screen;
+static std::set<HWND> _used;
+
+static HWND NewHandle()
+{
+    HWND hwnd;
+    do {
+        hwnd = (HWND)(uintptr_t)(0x10000 + (_rng() % 0xFFFFF) * 4);
+    } while (!_used.insert(hwnd).second);
+    return hwnd;
+}
+
+template<typename Change>
+static double NanosPerSample(VisibleSet<FakeClock, FakeWindowNames>& set, size_t& transitions, Change change)
+{
+    const int samples = 20000;
+    std::vector<VisibleSample> sample;
+    transitions = 0;
+    Stopwatch watch;
+    for (int i = 0; i < samples; i++) {
+        change();
+        sample = _screen;
+        transitions += set.Update(sample);
+    }
+    return watch.Seconds() * 1e9 / samples;
+}
+
+int main()
+{
+    long long seconds = TimeSeconds({2024, 5, 0, 6, 9, 0, 0, 0});
+    while (_screen.size() < 250) {
+        _screen.push_back({NewHandle(), _rng() % 5 == 0});
+    }
+    std::vector<AppLogger> closed;
+    VisibleSet<FakeClock, FakeWindowNames> set(closed, FakeClock{&seconds});
+    std::vector<VisibleSample> first = _screen;
+    printf("%zu windows, first sample: %zu transitions\n", _screen.size(), set.Update(first));
+
+    size_t transitions;
+    double steady = NanosPerSample(set, transitions, []() {});
+    printf("unchanged: %.0f ns per sample, %zu transitions\n", steady, transitions);
+    double raised = NanosPerSample(set, transitions, []() {
+        std::swap(_screen[_rng() % _screen.size()], _screen[_rng() % _screen.size()]);
+    });
+    printf("Z order change only: %.0f ns per sample, %zu transitions\n", raised, transitions);
+    // One minimize toggle, one close and one open per sample
+    size_t toggled = 0;
+    double changing = NanosPerSample(set, transitions, [&]() {
+        VisibleSample& window = _screen[_rng() % _screen.size()];
+        window.minimized = !window.minimized;
+        size_t gone = _rng() % _screen.size();
+        toggled += &_screen[gone] == &window;
+        _used.erase(_screen[gone].hwnd);
+        _screen.erase(_screen.begin() + gone);
+        _screen.insert(_screen.begin() + _rng() % _screen.size(), {NewHandle(), false});
+    });
+    printf("3 changes: %.0f ns per sample, %zu transitions, %zu sessions closed\n", changing, transitions,
+           closed.size());
+    if (transitions != 3 * 20000 - toggled) {
+        printf("expected %zu transitions\n", 3 * 20000 - toggled);
+        return 1;
+    }
+
+    // Foreground-only: a steady tick on the fingerprint fast path
+    std::string executable = "chrome.exe";
+    std::string title = "Inbox (3) - someone@example.com - Mail - Google Chrome";
+    bool afk = false;
+    int wakes = 0;
+    int ended = 0;
+    std::vector<AppLogger> log;
+    Sessionizer<FakeClock> sessionizer(log, FakeClock{&seconds});
+    FakeFingerprintWindow window;
+    window.executable = &executable;
+    window.title = &title;
+    Tracker<FakeClock, FakeFingerprintWindow, FakeIdle, FakeExtendSink> tracker(
+        FakeClock{&seconds}, window, FakeIdle{&afk, &wakes}, FakeExtendSink{{&sessionizer, &ended}, &log, FakeClock{&seconds}});
+    const int ticks = 200000;
+    Stopwatch watch;
+    for (int i = 0; i < ticks; i++) {
+        seconds += tracker.Tick() / 1000;
+    }
+    double foreground = watch.Seconds() * 1e9 / ticks;
+    printf("foreground-only tick: %.0f ns; an unchanged visible sample costs %.1fx that\n", foreground,
+           steady / foreground);
+    return 0;
+}
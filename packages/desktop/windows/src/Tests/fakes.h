@@ -0,0 +1,84 @@
+#ifndef FAKES_H
+#define FAKES_H
+
+#include <string>
+#include <vector>
+
+#include "trackerPipeline.hpp"
+#include "trackerTime.h"
+
+// Policies for driving Tracker and Sessionizer without a desktop. They
+// share state through plain pointers so a test can steer them between ticks.
+
+struct FakeClock {
+    SYSTEMTIME Now() { return TimeFromSeconds(*seconds); }
+    void Sleep(DWORD ms) { *seconds += ms / 1000; }
+
+    long long* seconds;
+};
+
+struct FakeWindow {
+    const char* Executable() { return executable->c_str(); }
+    const char* Title() { return title->c_str(); }
+
+    std::string* executable;
+    std::string* title;
+};
+
+// With the fingerprint fast path: unchanged while neither string changed
+struct FakeFingerprintWindow : FakeWindow {
+    bool Unchanged()
+    {
+        bool same = *executable == lastExecutable && *title == lastTitle;
+        if (!same) {
+            lastExecutable = *executable;
+            lastTitle = *title;
+        }
+        return same;
+    }
+
+    std::string lastExecutable;
+    std::string lastTitle;
+};
+
+// Every window in the visible set has the same names
+struct FakeWindowNames {
+    const char* Executable(HWND) { return "editor.exe"; }
+    const char* Title(HWND) { return "Some document - Editor"; }
+};
+
+struct FakeIdle {
+    bool IsAFK() { return *afk; }
+    void Wake() { (*wakes)++; }
+
+    bool* afk;
+    int* wakes;
+};
+
+// Sessions go through a Sessionizer over a local buffer, as the logger's do
+struct FakeSink {
+    void Add(const char* executable, const char* title)
+    {
+        sessionizer->Add(executable, title, [this]() { (*closed)++; });
+    }
+
+    Sessionizer<FakeClock>* sessionizer;
+    int* closed;
+};
+
+struct FakeExtendSink : FakeSink {
+    bool Extend()
+    {
+        if (log->empty()) {
+            return false;
+        }
+        log->back().end = clock.Now();
+        return true;
+    }
+
+    std::vector<AppLogger>* log;
+    FakeClock clock;
+};
+
+
+#endif // FAKES_H
@@ -0,0 +1,113 @@
+#ifndef SYNTHETIC_INPUT_H
+#define SYNTHETIC_INPUT_H
+
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/input.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "trackerInput.h"
+
+// Input devices without a desktop: FIFOs named like evdev event nodes, for
+// BeginInputCounting to read as it reads /dev/input. Each is held open for
+// writing until unplugged, so the reader sees a hang-up just as on removal.
+class SyntheticInput {
+public:
+    SyntheticInput(const std::filesystem::path& dir, int devices)
+    {
+        std::filesystem::create_directories(dir);
+        for (int i = 0; i < devices; i++) {
+            std::string path = (dir / ("event" + std::to_string(i))).string();
+            mkfifo(path.c_str(), 0600);
+            // Read-write, so opening does not wait for the reader
+            _fds.push_back(open(path.c_str(), O_RDWR | O_CLOEXEC));
+        }
+    }
+
+    ~SyntheticInput()
+    {
+        for (size_t i = 0; i < _fds.size(); i++) {
+            Unplug(i);
+        }
+    }
+
+    // A mix of presses, auto-repeat, releases, clicks, moves and wheel turns,
+    // spread over the devices still plugged. Returns what should be counted.
+    InputSummary Generate(size_t count, unsigned seed)
+    {
+        std::mt19937 rng(seed);
+        InputSummary counted = {};
+        std::vector<std::vector<struct input_event>> events(_fds.size());
+        for (size_t i = 0; i < count; i++) {
+            struct input_event event = {};
+            switch (rng() % 6) {
+            case 0:
+                event = {{}, EV_KEY, (uint16_t)(KEY_A + rng() % 20), 1};
+                counted.keys++;
+                break;
+            case 1:
+                event = {{}, EV_KEY, KEY_A, 2};
+                break;
+            case 2:
+                event = {{}, EV_KEY, (uint16_t)(BTN_LEFT + rng() % 3), 1};
+                counted.clicks++;
+                break;
+            case 3:
+                event = {{}, EV_REL, (uint16_t)(rng() % 2 ? REL_WHEEL : REL_HWHEEL), 1};
+                counted.scrolls++;
+                break;
+            case 4:
+                event = {{}, EV_REL, REL_X, 3};
+                break;
+            default:
+                event = {{}, EV_KEY, KEY_A, 0};
+                break;
+            }
+            events[Plugged(rng())].push_back(event);
+        }
+        // Up to PIPE_BUF a write is atomic, so the reader only ever gets
+        // whole events, as from a device
+        const size_t chunk = PIPE_BUF / sizeof(struct input_event);
+        for (size_t i = 0; i < _fds.size(); i++) {
+            for (size_t at = 0; at < events[i].size(); at += chunk) {
+                size_t size = std::min(chunk, events[i].size() - at) * sizeof(struct input_event);
+                if (write(_fds[i], &events[i][at], size) != (ssize_t)size) {
+                    break;
+                }
+            }
+        }
+        return counted;
+    }
+
+    void Unplug(size_t device)
+    {
+        if (_fds[device] >= 0) {
+            close(_fds[device]);
+            _fds[device] = -1;
+        }
+    }
+
+private:
+    size_t Plugged(unsigned pick)
+    {
+        for (size_t i = 0; i < _fds.size(); i++) {
+            size_t device = (pick + i) % _fds.size();
+            if (_fds[device] >= 0) {
+                return device;
+            }
+        }
+        return 0;
+    }
+
+    std::vector<int> _fds;
+};
+
+
+#endif // SYNTHETIC_INPUT_H
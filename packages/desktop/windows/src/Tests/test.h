@@ -0,0 +1,93 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "trackerLogger.h"
+#include "trackerTime.h"
+
+// Checks keep going after a failure so one run reports every broken case
+inline int _test_failures = 0;
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            _test_failures++;                                                        \
+        }                                                                            \
+    } while (0)
+
+// Exit code of a test: 0 when every check passed
+inline int TestResult(const char* name)
+{
+    printf("%s: %s\n", name, _test_failures == 0 ? "ok" : "FAILED");
+    return _test_failures == 0 ? 0 : 1;
+}
+
+// A fresh store in the temp directory: the logger and every store beside it
+// write there, as they would under %APPDATA%\ChronoSync\Cache
+inline std::filesystem::path UseTestStore(const std::string& name)
+{
+    std::filesystem::path root = std::filesystem::temp_directory_path() /
+                                 ("chronosync-" + name + "-" + std::to_string(getpid()));
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root);
+    setenv("APPDATA", root.c_str(), 1);
+    CreateLogFile();
+    return GetLogFilePath().parent_path();
+}
+
+inline void RemoveTestStore()
+{
+    std::error_code ec;
+    std::filesystem::remove_all(GetLogFilePath().parent_path().parent_path().parent_path(), ec);
+}
+
+// Back to back sessions from start (TimeSeconds) over a few apps and titles,
+// the same sequence for the same seed
+inline std::vector<AppLogger> SyntheticSessions(size_t count, long long start, unsigned seed = 1)
+{
+    static const char* apps[] = {"Code.exe", "chrome.exe", "explorer.exe", "Slack.exe", "WINWORD.EXE", "Teams.exe"};
+    static const char* words[] = {"main.cpp", "Inbox", "report", "quarterly", "Visual Studio Code", "Google Chrome",
+                                  "Downloads", "général", "design review", "budget.xlsx", "日本語", "release notes"};
+    std::mt19937 rng(seed);
+    std::vector<AppLogger> logs(count);
+    for (auto& log : logs) {
+        long long length = 1 + rng() % 600;
+        log.start = TimeFromSeconds(start);
+        log.end = TimeFromSeconds(start + length);
+        start += length + rng() % 5;
+        log.executable = apps[rng() % (sizeof(apps) / sizeof(*apps))];
+        for (unsigned left = 1 + rng() % 4; left > 0; left--) {
+            log.title += words[rng() % (sizeof(words) / sizeof(*words))];
+            log.title += left > 1 ? " - " : "";
+        }
+        log.title += " #" + std::to_string(rng() % 50);
+    }
+    return logs;
+}
+
+inline long long Now()
+{
+    return TimeSeconds(GetTime());
+}
+
+class Stopwatch {
+public:
+    Stopwatch() : _start(std::chrono::steady_clock::now()) {}
+    double Seconds() const { return std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count(); }
+
+private:
+    std::chrono::steady_clock::time_point _start;
+};
+
+
+#endif // TEST_H
@@ -0,0 +1,148 @@
+#include "test.h"
+#include "trackerActivity.h"
+
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <set>
+
+
+// The bitmap queries over two weeks of sessions in the text log, against the
+// minutes of the sessions themselves: states and executables, days, weekdays
+// and hours, overlaps and unions with days only one side has. Saving goes
+// through a temporary file and keeps only the most active executables.
+
+typedef std::map<long, std::set<unsigned>> Minutes; // DayNumber -> minutes of the day
+
+// The minutes a session touches, one ending on a minute boundary stops before it
+static void Mark(Minutes& minutes, const AppLogger& log)
+{
+    long long start = TimeSeconds(log.start);
+    long long end = std::max(start, TimeSeconds(log.end));
+    long long last = end > start ? end - 1 : start;
+    for (long long minute = start / 60; minute <= last / 60; minute++) {
+        minutes[(long)(minute / 1440)].insert((unsigned)(minute % 1440));
+    }
+}
+
+static unsigned Weekday(long day)
+{
+    return (unsigned)(((day + 4) % 7 + 7) % 7);
+}
+
+// Minutes of [from, to] both or either series have
+static unsigned long long Combine(const Minutes& a, const Minutes& b, long from, long to, bool either)
+{
+    unsigned long long total = 0;
+    for (long day = from; day <= to; day++) {
+        auto ia = a.find(day);
+        auto ib = b.find(day);
+        std::set<unsigned> none;
+        const std::set<unsigned>& sa = ia != a.end() ? ia->second : none;
+        const std::set<unsigned>& sb = ib != b.end() ? ib->second : none;
+        unsigned both = 0;
+        for (unsigned m : sa) {
+            both += sb.count(m);
+        }
+        total += either ? sa.size() + sb.size() - both : both;
+    }
+    return total;
+}
+
+static void CheckSeries(const std::string& key, const Minutes& minutes, long from, long to)
+{
+    std::vector<unsigned> days = ActivityByDay(key, from, to);
+    unsigned long long weekdays[7], hours[7][24];
+    ActivityByWeekday(key, from, to, weekdays);
+    ActivityByHour(key, from, to, hours);
+    unsigned long long expectedWeekdays[7] = {}, expectedHours[7][24] = {};
+    bool same = days.size() == (size_t)(to - from + 1);
+    for (long day = from; day <= to && same; day++) {
+        auto it = minutes.find(day);
+        size_t count = it != minutes.end() ? it->second.size() : 0;
+        same = days[day - from] == count;
+        expectedWeekdays[Weekday(day)] += count;
+        for (unsigned m : it != minutes.end() ? it->second : std::set<unsigned>()) {
+            expectedHours[Weekday(day)][m / 60]++;
+        }
+    }
+    if (!same || memcmp(weekdays, expectedWeekdays, sizeof(weekdays)) != 0 ||
+        memcmp(hours, expectedHours, sizeof(hours)) != 0) {
+        printf("  %s differs from its sessions\n", key.c_str());
+        CHECK(false);
+    }
+}
+
+int main()
+{
+    std::filesystem::path store = UseTestStore("activity");
+    // Every fifth session idle or locked, every eighth in one of many small executables
+    std::vector<AppLogger> logs = SyntheticSessions(4000, TimeSeconds({2025, 3, 0, 1, 22, 0, 0, 0}), 5);
+    for (size_t i = 0; i < logs.size(); i++) {
+        if (i % 5 == 0) {
+            logs[i].executable = "AFK";
+            logs[i].title = i % 10 == 0 ? "Lock" : "Idle";
+        } else if (i % 8 == 3) {
+            logs[i].executable = "Small" + std::to_string(i / 8) + ".exe";
+        }
+    }
+    std::map<std::string, Minutes> expected;
+    std::set<std::string> small;
+    {
+        std::ofstream file(GetLogFilePath(), std::ios::app);
+        for (const auto& log : logs) {
+            file << GetLineStr(log);
+            bool active = log.executable != "AFK";
+            Mark(expected[active ? ACTIVITY_ACTIVE : log.title == "Lock" ? ACTIVITY_LOCKED : ACTIVITY_AFK], log);
+            if (active) {
+                Mark(expected[log.executable], log);
+            }
+            if (log.executable.rfind("Small", 0) == 0) {
+                small.insert(log.executable);
+            }
+        }
+    }
+    long from = DayNumber(logs.front().start);
+    long to = DayNumber(logs.back().end);
+    CHECK(to - from >= 10 && small.size() + 6 > ACTIVITY_MAX_APPS);
+    StartActivity();
+
+    // Every series, over all of it and a few days in the middle
+    for (const auto& item : expected) {
+        CheckSeries(item.first, item.second, from - 1, to + 1);
+        CheckSeries(item.first, item.second, from + 3, to - 4);
+    }
+    CheckSeries("Missing.exe", {}, from, to);
+
+    // Pairs that mostly overlap, never do and partly do
+    const char* pairs[][2] = {{"Code.exe", ACTIVITY_ACTIVE}, {ACTIVITY_ACTIVE, ACTIVITY_LOCKED},
+                              {"Code.exe", "chrome.exe"}, {ACTIVITY_AFK, "Small3.exe"}, {"Slack.exe", "Missing.exe"}};
+    for (const auto& pair : pairs) {
+        const Minutes& a = expected[pair[0]];
+        const Minutes& b = expected[pair[1]];
+        for (long first : {from, from + 5}) {
+            CHECK(ActivityOverlap(pair[0], pair[1], first, to) == Combine(a, b, first, to, false));
+            CHECK(ActivityUnion(pair[0], pair[1], first, to) == Combine(a, b, first, to, true));
+            CHECK(ActivityUnion(pair[1], pair[0], first, to) == Combine(a, b, first, to, true));
+        }
+    }
+    CHECK(ActivityOverlap("Code.exe", ACTIVITY_ACTIVE, from, to) == Combine(expected["Code.exe"], {}, from, to, true));
+
+    // Saved whole through a temporary file, the small executables past the cap dropped
+    SaveActivity();
+    CHECK(std::filesystem::exists(store / ACTIVITY_FILE));
+    CHECK(!std::filesystem::exists(store / (ACTIVITY_FILE ".tmp")));
+    size_t kept = 0;
+    for (const auto& name : small) {
+        std::vector<unsigned> days = ActivityByDay(name, from, to);
+        kept += std::count_if(days.begin(), days.end(), [](unsigned minutes) { return minutes > 0; }) > 0;
+    }
+    CHECK(kept == ACTIVITY_MAX_APPS - 6);
+    for (const char* key : {ACTIVITY_ACTIVE, ACTIVITY_AFK, ACTIVITY_LOCKED, "Code.exe", "chrome.exe", "explorer.exe",
+                            "Slack.exe", "WINWORD.EXE", "Teams.exe"}) {
+        CheckSeries(key, expected[key], from, to);
+    }
+
+    RemoveTestStore();
+    return TestResult("testActivity");
+}
@@ -0,0 +1,130 @@
+#include "test.h"
+#include "fakes.h"
+#include "allocCounter.h"
+#include "trackerJson.h"
+
+
+// The tracker driven through the real logger with the global operator new
+// counted: once the records and strings are warm, steady ticks, session
+// changes and flushes must not touch the heap, nor must encoding upload
+// payloads once the writer's chunks are
+struct LoggerSink {
+    void Add(const char* executable, const char* title) { AddEntry(executable, title); }
+    bool Extend() { return ExtendEntry(); }
+};
+
+typedef Tracker<FakeClock, FakeFingerprintWindow, FakeIdle, LoggerSink> LoggerTracker;
+
+static size_t Ticks(LoggerTracker& tracker, long long& seconds, int ticks, bool& extended)
+{
+    size_t allocations = ThreadAllocations();
+    extended = true;
+    for (int i = 0; i < ticks; i++) {
+        seconds += tracker.Tick() / 1000;
+        extended &= tracker.Extended();
+    }
+    return ThreadAllocations() - allocations;
+}
+
+// One upload payload of logs, as the exports write them
+static size_t Payload(JsonWriter& json, const std::vector<AppLogger>& logs)
+{
+    size_t allocations = ThreadAllocations();
+    json.Clear();
+    json.BeginObject();
+    json.Key("deviceId");
+    json.Int(42);
+    json.Key("sessions");
+    json.BeginArray();
+    for (const auto& log : logs) {
+        WriteSessionJson(json, log);
+    }
+    json.EndArray();
+    json.EndObject();
+    json.Flush();
+    return ThreadAllocations() - allocations;
+}
+
+static size_t Flush()
+{
+    size_t allocations = ThreadAllocations();
+    PrintToFile();
+    return ThreadAllocations() - allocations;
+}
+
+int main()
+{
+    UseTestStore("alloc");
+    long long seconds = TimeSeconds({2024, 5, 0, 6, 9, 0, 0, 0});
+    std::string executable = "Code.exe";
+    std::string title = "main.cpp - Visual Studio Code";
+    bool afk = false;
+    int wakes = 0;
+    FakeFingerprintWindow window;
+    window.executable = &executable;
+    window.title = &title;
+    LoggerTracker tracker(FakeClock{&seconds}, window, FakeIdle{&afk, &wakes}, LoggerSink());
+
+    // The counter is live: a gate that cannot see allocations proves nothing
+    size_t before = ThreadAllocations();
+    std::string* probe = new std::string(64, 'x');
+    CHECK(ThreadAllocations() > before);
+    delete probe;
+
+    // Warm up on the cycle measured below, so the spare records cover the
+    // sessions buffered between two flushes
+    const char* titles[] = {"main.cpp - Visual Studio Code", "util.cpp - Visual Studio Code",
+                            "test.cpp - Visual Studio Code"};
+    bool extended;
+    for (int round = 0; round < 3; round++) {
+        for (const char* name : titles) {
+            title = name;
+            Ticks(tracker, seconds, 3, extended);
+        }
+        Flush();
+    }
+
+    // Steady ticks only extend the open session, after the one that reopens
+    // it following the flush
+    Ticks(tracker, seconds, 1, extended);
+    size_t steady = Ticks(tracker, seconds, 10000, extended);
+    CHECK(extended);
+    CHECK(steady == 0);
+
+    // Session changes reuse recycled records and their strings, flushes reuse
+    // the line buffer, with the open session alone and with closed ones
+    size_t changes = 0;
+    size_t flushes = Flush();
+    for (int round = 0; round < 10; round++) {
+        for (const char* name : titles) {
+            title = name;
+            changes += Ticks(tracker, seconds, 3, extended);
+        }
+        flushes += Flush();
+    }
+    CHECK(changes == 0);
+    CHECK(flushes == 0);
+    printf("  allocations: %zu in 10000 steady ticks, %zu in 30 session changes, %zu in 11 flushes\n", steady,
+           changes, flushes);
+
+    // Payloads reuse the chunks the first one filled, or the sink's one chunk
+    std::vector<AppLogger> batch = SyntheticSessions(JSON_BATCH_SESSIONS, seconds, 50);
+    JsonWriter kept;
+    size_t sent = 0;
+    JsonWriter streamed([&](const char*, size_t size) {
+        sent += size;
+        return true;
+    });
+    Payload(kept, batch);
+    Payload(streamed, batch);
+    size_t payloads = 0;
+    for (int round = 0; round < 5; round++) {
+        payloads += Payload(kept, batch) + Payload(streamed, batch);
+    }
+    CHECK(kept.Ok() && streamed.Ok() && sent == 6 * kept.Size());
+    CHECK(payloads == 0);
+    printf("  allocations: %zu in 10 payloads of %d sessions\n", payloads, JSON_BATCH_SESSIONS);
+
+    RemoveTestStore();
+    return TestResult("testAlloc");
+}
@@ -0,0 +1,133 @@
+#include "test.h"
+#include "trackerArchive.h"
+#include "trackerImport.h"
+
+#include <atomic>
+#include <fstream>
+#include <thread>
+
+
+static std::string ReadFile(const std::filesystem::path& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+static std::string Lines(const std::vector<AppLogger>& logs)
+{
+    std::string text;
+    for (const auto& log : logs) {
+        AppendLogLine(text, log);
+    }
+    return text;
+}
+
+static std::string StoredLines()
+{
+    std::string text;
+    ForEachStoredSession(0, ~0ULL, [&](const AppLogger& log) {
+        AppendLogLine(text, log);
+        return true;
+    });
+    return text;
+}
+
+static void TestRoundTrip()
+{
+    std::filesystem::path path = GetLogFilePath().parent_path() / "round.csa";
+    std::vector<AppLogger> logs = SyntheticSessions(20000, TimeSeconds({2024, 1, 0, 1, 0, 0, 0, 0}), 27);
+    ArchiveStats stats = WriteArchive(path, logs);
+    CHECK(stats.records == logs.size() && stats.blocks > 1 && stats.compressedBytes < stats.rawBytes);
+
+    ArchiveReader reader;
+    CHECK(OpenArchive(path, reader) && reader.checksums && reader.blocks.size() == stats.blocks);
+    std::vector<AppLogger> back;
+    for (size_t i = 0; i < reader.blocks.size(); i++) {
+        CHECK(ReadArchiveBlock(reader, i, back));
+    }
+    CHECK(Lines(back) == Lines(logs));
+
+    // Only the overlapping blocks, callers filter the sessions themselves
+    back.clear();
+    ReadArchiveRange(reader, TimeKey(logs[10000].start), TimeKey(logs[10100].start), back);
+    CHECK(!back.empty() && back.size() < logs.size() / 2);
+    CHECK(TimeKey(back.front().start) <= TimeKey(logs[10000].start));
+    CHECK(TimeKey(back.back().start) >= TimeKey(logs[10100].start));
+}
+
+static void TestCompaction()
+{
+    std::filesystem::path logPath = GetLogFilePath();
+    std::filesystem::path bakPath = logPath;
+    bakPath += ".bak";
+    std::vector<AppLogger> logs = SyntheticSessions(15000, Now() - 60 * 86400, 270);
+    std::string text = Lines(logs);
+    std::ofstream(logPath, std::ios::binary) << text;
+
+    // A backup that cannot be written: nothing is archived and the log stays as it was
+    std::filesystem::create_directories(bakPath / "busy");
+    CHECK(CompactLogFile() != 0);
+    CHECK(ReadFile(logPath) == text);
+    CHECK(!std::filesystem::exists(logPath.string() + ".compact"));
+    CHECK(!std::filesystem::exists(logPath.parent_path() / "Archive"));
+    CHECK(StoredLines() == text);
+
+    std::filesystem::remove_all(bakPath);
+    CHECK(CompactLogFile() == 0);
+    CHECK(ReadFile(bakPath) == text);
+    std::string kept = ReadFile(logPath);
+    CHECK(!kept.empty() && kept.size() < text.size() / 2);
+    CHECK(StoredLines() == text);
+
+    // Nothing left to age
+    CHECK(CompactLogFile() == 0);
+    CHECK(ReadFile(logPath) == kept);
+    CHECK(StoredLines() == text);
+}
+
+// Lines that do not parse stay in the log, and sessions flushed while the
+// maintenance thread compacts are in the log it swaps in
+static void TestCompactionKeepsLines()
+{
+    std::filesystem::path logPath = GetLogFilePath();
+    std::vector<AppLogger> logs = SyntheticSessions(15000, Now() - 90 * 86400, 271);
+    std::string text = Lines(logs);
+    std::string broken = "2020-13-45T99:00:00 ; half a line\n";
+    text.insert(text.find('\n', text.size() / 10) + 1, broken);
+    std::ofstream(logPath, std::ios::binary) << text;
+
+    std::atomic<bool> compacting(true);
+    size_t flushes = 0;
+    std::thread flusher([&]() {
+        while (compacting || flushes < 20) {
+            AddEntry("Code.exe", ("flushed " + std::to_string(flushes)).c_str());
+            AddEntry("chrome.exe", "Inbox");
+            PrintToFile();
+            flushes++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    });
+    CHECK(CompactLogFile() == 0);
+    compacting = false;
+    flusher.join();
+
+    std::string kept = ReadFile(logPath);
+    CHECK(kept.find(broken) != std::string::npos && kept.size() < text.size() / 2);
+    std::string stored = StoredLines();
+    for (size_t i = 0; i < flushes; i++) {
+        CHECK(stored.find("Code.exe ; flushed " + std::to_string(i) + "\n") != std::string::npos);
+    }
+    CHECK(stored.find(Lines(logs)) == 0);
+}
+
+int main()
+{
+    UseTestStore("archive");
+    TestRoundTrip();
+    TestCompaction();
+    RemoveTestStore();
+    UseTestStore("archive-lines");
+    TestCompactionKeepsLines();
+    RemoveTestStore();
+    return TestResult("testArchive");
+}
@@ -0,0 +1,262 @@
+#include "test.h"
+#include "trackerArchive.h"
+#include "trackerArrow.h"
+#include "trackerImport.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+
+// The exported stream read back without Arrow: a flatbuffer walk over each
+// message checks the layout a reader relies on, and the rows rebuilt from the
+// dictionaries must be the stored sessions of the range, in order
+template<typename T>
+static T Get(const std::string& buf, size_t pos)
+{
+    T value = {};
+    if (pos + sizeof(T) <= buf.size()) {
+        memcpy(&value, buf.data() + pos, sizeof(T));
+    }
+    return value;
+}
+
+// Position of a table field, 0 when absent
+static size_t Field(const std::string& fb, size_t table, int id)
+{
+    size_t vtable = table - Get<int32_t>(fb, table);
+    if (4 + 2 * (size_t)id >= Get<uint16_t>(fb, vtable)) {
+        return 0;
+    }
+    uint16_t at = Get<uint16_t>(fb, vtable + 4 + 2 * id);
+    return at ? table + at : 0;
+}
+
+static size_t Deref(const std::string& fb, size_t pos)
+{
+    return pos + Get<uint32_t>(fb, pos);
+}
+
+static std::string FieldString(const std::string& fb, size_t table, int id)
+{
+    size_t at = Deref(fb, Field(fb, table, id));
+    return fb.substr(at + 4, Get<uint32_t>(fb, at));
+}
+
+typedef struct {
+    int64_t offset;
+    int64_t length;
+} Buffer;
+
+typedef struct {
+    std::vector<AppLogger> rows;
+    size_t batches = 0;
+    size_t largest = 0;
+    bool ok = true;
+} ReadBack;
+
+// Nodes and buffers of a RecordBatch table, the buffers checked against the body
+static std::vector<Buffer> Buffers(const std::string& fb, size_t batch, size_t nodes, const std::string& body, bool& ok)
+{
+    size_t nodeVector = Deref(fb, Field(fb, batch, 1));
+    size_t bufferVector = Deref(fb, Field(fb, batch, 2));
+    int64_t length = Get<int64_t>(fb, Field(fb, batch, 0));
+    ok &= Get<uint32_t>(fb, nodeVector) == nodes;
+    for (size_t i = 0; i < nodes; i++) {
+        ok &= Get<int64_t>(fb, nodeVector + 4 + 16 * i) == length && Get<int64_t>(fb, nodeVector + 12 + 16 * i) == 0;
+    }
+    std::vector<Buffer> buffers(Get<uint32_t>(fb, bufferVector));
+    for (size_t i = 0; i < buffers.size(); i++) {
+        buffers[i] = Get<Buffer>(fb, bufferVector + 4 + 16 * i);
+        ok &= buffers[i].offset % 8 == 0 && buffers[i].offset + buffers[i].length <= (int64_t)body.size();
+    }
+    return buffers;
+}
+
+static void CheckSchema(const std::string& fb, size_t schema, bool& ok)
+{
+    static const char* names[] = {"start", "end", "executable", "title"};
+    size_t fields = Deref(fb, Field(fb, schema, 1));
+    ok &= Get<uint32_t>(fb, fields) == 4;
+    for (int i = 0; i < 4; i++) {
+        size_t field = Deref(fb, fields + 4 + 4 * i);
+        size_t type = Deref(fb, Field(fb, field, 3));
+        size_t dictionary = Field(fb, field, 4);
+        ok &= FieldString(fb, field, 0) == names[i];
+        if (i < 2) {
+            // timestamp[s], no time zone: the local wall clock
+            ok &= Get<uint8_t>(fb, Field(fb, field, 2)) == 10 && Get<int16_t>(fb, Field(fb, type, 0)) == 0;
+            ok &= Field(fb, type, 1) == 0 && dictionary == 0;
+        } else {
+            // utf8 values behind int32 indices, one dictionary per column
+            size_t encoding = Deref(fb, dictionary);
+            size_t index = Deref(fb, Field(fb, encoding, 1));
+            ok &= Get<uint8_t>(fb, Field(fb, field, 2)) == 5 && dictionary != 0;
+            ok &= Get<int64_t>(fb, Field(fb, encoding, 0)) == i - 2;
+            ok &= Get<int32_t>(fb, Field(fb, index, 0)) == 32 && Get<uint8_t>(fb, Field(fb, index, 1)) == 1;
+        }
+    }
+}
+
+static ReadBack ReadStream(const std::string& stream)
+{
+    ReadBack back;
+    bool& ok = back.ok;
+    std::vector<std::string> dictionaries[2];
+    bool schema = false;
+    size_t pos = 0;
+    while (ok) {
+        ok &= Get<uint32_t>(stream, pos) == 0xFFFFFFFFu;
+        uint32_t size = Get<uint32_t>(stream, pos + 4);
+        pos += 8;
+        if (size == 0) {
+            break;
+        }
+        ok &= size % 8 == 0 && pos + size <= stream.size();
+        std::string fb = stream.substr(pos, size);
+        size_t message = Deref(fb, 0);
+        ok &= Get<int16_t>(fb, Field(fb, message, 0)) == 4; // V5
+        uint8_t type = Get<uint8_t>(fb, Field(fb, message, 1));
+        size_t header = Deref(fb, Field(fb, message, 2));
+        int64_t bodyLength = Get<int64_t>(fb, Field(fb, message, 3));
+        pos += size;
+        ok &= bodyLength % 8 == 0 && pos + bodyLength <= stream.size();
+        std::string body = stream.substr(pos, bodyLength);
+        pos += bodyLength;
+
+        if (type == 1) {
+            ok &= !schema;
+            CheckSchema(fb, header, ok);
+            schema = true;
+        } else if (type == 2) {
+            // Dictionary batch: a delta after the first, utf8 offsets and values
+            int64_t id = Get<int64_t>(fb, Field(fb, header, 0));
+            size_t batch = Deref(fb, Field(fb, header, 1));
+            bool delta = Get<uint8_t>(fb, Field(fb, header, 2)) != 0;
+            ok &= schema && (id == 0 || id == 1) && delta == !dictionaries[id].empty();
+            if (!ok) {
+                break;
+            }
+            std::vector<Buffer> buffers = Buffers(fb, batch, 1, body, ok);
+            int64_t length = Get<int64_t>(fb, Field(fb, batch, 0));
+            ok &= buffers.size() == 3 && buffers[1].length == 4 * (length + 1);
+            for (int64_t i = 0; ok && i < length; i++) {
+                int32_t from = Get<int32_t>(body, buffers[1].offset + 4 * i);
+                int32_t to = Get<int32_t>(body, buffers[1].offset + 4 * i + 4);
+                ok &= from <= to && to <= buffers[2].length;
+                dictionaries[id].push_back(body.substr(buffers[2].offset + from, to - from));
+            }
+        } else if (type == 3) {
+            // Record batch: two int64 columns, two int32 index columns, no validity
+            size_t batch = header;
+            int64_t length = Get<int64_t>(fb, Field(fb, batch, 0));
+            std::vector<Buffer> buffers = Buffers(fb, batch, 4, body, ok);
+            ok &= schema && buffers.size() == 8;
+            for (size_t i = 0; ok && i < 8; i++) {
+                ok &= buffers[i].length == (i % 2 == 0 ? 0 : (i < 4 ? 8 : 4) * length);
+            }
+            for (int64_t i = 0; ok && i < length; i++) {
+                int32_t executable = Get<int32_t>(body, buffers[5].offset + 4 * i);
+                int32_t title = Get<int32_t>(body, buffers[7].offset + 4 * i);
+                // Every index was sent before the batch using it
+                ok &= executable >= 0 && executable < (int32_t)dictionaries[0].size();
+                ok &= title >= 0 && title < (int32_t)dictionaries[1].size();
+                if (ok) {
+                    AppLogger& log = back.rows.emplace_back();
+                    log.start = TimeFromSeconds(Get<int64_t>(body, buffers[1].offset + 8 * i));
+                    log.end = TimeFromSeconds(Get<int64_t>(body, buffers[3].offset + 8 * i));
+                    log.executable = dictionaries[0][executable];
+                    log.title = dictionaries[1][title];
+                }
+            }
+            back.batches++;
+            back.largest = std::max<size_t>(back.largest, length);
+        } else {
+            ok = false;
+        }
+    }
+    ok &= pos == stream.size();
+    return back;
+}
+
+static std::string Lines(const std::vector<AppLogger>& logs)
+{
+    std::string text;
+    for (const auto& log : logs) {
+        AppendLogLine(text, log);
+    }
+    return text;
+}
+
+static std::string StoredLines(ULONGLONG from, ULONGLONG to)
+{
+    std::string text;
+    ForEachStoredSession(from, to, [&](const AppLogger& log) {
+        AppendLogLine(text, log);
+        return true;
+    });
+    return text;
+}
+
+static std::string Export(ULONGLONG from, ULONGLONG to, size_t batchRows, ArrowExportStats& stats)
+{
+    std::string stream;
+    stats = ExportArrow(from, to, [&](const char* data, size_t size) {
+        stream.append(data, size);
+        return true;
+    }, batchRows);
+    return stream;
+}
+
+int main()
+{
+    UseTestStore("arrow");
+    // Sessions in archives, in the text log and still buffered
+    std::vector<AppLogger> logs = SyntheticSessions(30000, Now() - 90 * 86400, 44);
+    std::ofstream(GetLogFilePath(), std::ios::binary) << Lines(logs);
+    CHECK(CompactLogFile() == 0);
+    CHECK(std::filesystem::exists(GetLogFilePath().parent_path() / "Archive"));
+    AddEntry("Code.exe", "main.cpp - arrow");
+    AddEntry("chrome.exe", "Inbox");
+
+    // Everything, in small batches so dictionaries go out as deltas
+    ArrowExportStats stats;
+    std::string stream = Export(0, ~0ULL, 1000, stats);
+    ReadBack back = ReadStream(stream);
+    CHECK(back.ok);
+    CHECK(back.rows.size() == logs.size() + 2 && stats.rows == back.rows.size());
+    CHECK(back.batches == stats.batches && back.largest == 1000 && stats.dictionaryBatches > 2);
+    CHECK(stats.bytes == stream.size());
+    CHECK(Lines(back.rows) == StoredLines(0, ~0ULL));
+
+    // A range filter keeps exactly the sessions starting inside it
+    ULONGLONG from = TimeKey(logs[12000].start);
+    ULONGLONG to = TimeKey(logs[18000].start);
+    size_t inside = std::count_if(logs.begin(), logs.end(), [&](const AppLogger& log) {
+        return TimeKey(log.start) >= from && TimeKey(log.start) <= to;
+    });
+    back = ReadStream(Export(from, to, 1000, stats));
+    CHECK(back.ok && back.rows.size() == inside && inside >= 6001);
+    CHECK(Lines(back.rows) == StoredLines(from, to));
+
+    // An empty range is a schema and the end of stream
+    back = ReadStream(Export(1, 2, 1000, stats));
+    CHECK(back.ok && back.rows.empty() && stats.batches == 0);
+
+    // A sink that stops the export stops it
+    size_t calls = 0;
+    stats = ExportArrow(0, ~0ULL, [&](const char*, size_t) { return ++calls < 5; }, 1000);
+    CHECK(stats.rows < 5000);
+
+    // Throughput of a file export at the default batch size
+    std::filesystem::path path = GetLogFilePath().parent_path() / "sessions.arrow";
+    Stopwatch watch;
+    stats = ExportArrowFile(path, 0, ~0ULL);
+    double seconds = watch.Seconds();
+    CHECK(std::filesystem::file_size(path) == stats.bytes);
+    printf("  %zu sessions, %.1f MB in %.1f ms: %.0f MB/s, %.1f M sessions/s\n", stats.rows, stats.bytes / 1e6,
+           seconds * 1e3, stats.bytes / 1e6 / seconds, stats.rows / 1e6 / seconds);
+
+    RemoveTestStore();
+    return TestResult("testArrow");
+}
@@ -0,0 +1,192 @@
+#include "test.h"
+#include "collector.h"
+
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <mutex>
+#include <thread>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// An ack comes once the lines are in their partition files; a spool whose
+// last record a crash cut short is replayed without it once upstream is back;
+// a client that leaves a large reply unread holds up no other client.
+
+static int Connect(const std::filesystem::path& path)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path.c_str());
+    for (int i = 0; i < 200 && connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return fd;
+}
+
+static bool ReadLine(int fd, std::string& line)
+{
+    line.clear();
+    char c;
+    while (recv(fd, &c, 1, 0) == 1) {
+        if (c == '\n') {
+            return true;
+        }
+        line += c;
+    }
+    return false;
+}
+
+static void SendAll(int fd, const std::string& data)
+{
+    for (size_t at = 0; at < data.size();) {
+        ssize_t n = send(fd, data.data() + at, data.size() - at, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return;
+        }
+        at += (size_t)n;
+    }
+}
+
+static size_t PartitionLines(const std::filesystem::path& dir)
+{
+    size_t lines = 0;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+        std::ifstream file(entry.path(), std::ios::binary);
+        std::string line;
+        while (std::getline(file, line)) {
+            lines++;
+        }
+    }
+    return lines;
+}
+
+// Stands in for the upstream collector, acks every batch and keeps its lines
+static std::mutex _received_mutex;
+static std::vector<std::string> _received;
+static std::atomic<bool> _upstream_running(true);
+
+static void FakeUpstream(std::filesystem::path path)
+{
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path.c_str());
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    bind(listener, (sockaddr*)&addr, sizeof(addr));
+    listen(listener, 4);
+    while (_upstream_running) {
+        pollfd pfd = {listener, POLLIN, 0};
+        if (poll(&pfd, 1, 50) <= 0) {
+            continue;
+        }
+        int fd = accept(listener, NULL, NULL);
+        std::string header, line;
+        char user[80];
+        size_t count;
+        while (ReadLine(fd, header) && sscanf(header.c_str(), "BATCH %79s %zu", user, &count) == 2) {
+            for (size_t i = 0; i < count && ReadLine(fd, line); i++) {
+                std::lock_guard<std::mutex> lock(_received_mutex);
+                _received.push_back(line + '\n');
+            }
+            std::string ack = "OK " + std::to_string(count) + ' ' + std::to_string(count) + '\n';
+            SendAll(fd, ack);
+        }
+        close(fd);
+    }
+    close(listener);
+}
+
+static size_t Received()
+{
+    std::lock_guard<std::mutex> lock(_received_mutex);
+    return _received.size();
+}
+
+int main()
+{
+    signal(SIGPIPE, SIG_IGN);
+    std::filesystem::path store = UseTestStore("collector");
+    CollectorConfig config = {};
+    config.socket = store / COLLECTOR_SOCKET_NAME;
+    config.root = store / "Collector";
+    config.upstream = store / "upstream.sock";
+    config.workers = 1;
+    config.ioThreads = 1;
+    std::thread server([&]() { RunCollector(config); });
+
+    // Two days of sessions in batches of 50, each on disk when its ack arrives
+    std::vector<AppLogger> logs = SyntheticSessions(1000, TimeSeconds({2026, 3, 0, 9, 20, 0, 0, 0}), 5);
+    std::vector<std::string> sent;
+    int fd = Connect(config.socket);
+    std::string line;
+    bool flushed = true;
+    for (size_t first = 0; first < logs.size(); first += 50) {
+        std::string batch = "BATCH ack 50\n";
+        for (size_t i = first; i < first + 50; i++) {
+            sent.push_back(GetLineStr(logs[i]));
+            batch += sent.back();
+        }
+        SendAll(fd, batch);
+        CHECK(ReadLine(fd, line) && line == "OK 50 50");
+        flushed = flushed && PartitionLines(config.root / "ack") == first + 50;
+    }
+    CHECK(flushed);
+    CHECK(std::filesystem::exists(config.root / "ack" / "2026-03-09.txt"));
+    CHECK(std::filesystem::exists(config.root / "ack" / "2026-03-10.txt"));
+
+    // Upstream is down: every record goes to the spool, then a crash cuts a
+    // last record short
+    for (int i = 0; i < 500 && GetCollectorStats().spooled < sent.size(); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    CHECK(GetCollectorStats().spooled == sent.size());
+    {
+        std::ofstream spool(config.root / "upstream.spool", std::ios::binary | std::ios::app);
+        spool << "ack 3\n" << sent[0] << sent[1].substr(0, 20);
+    }
+
+    // Upstream is back: the spool is replayed and removed, the cut record dropped
+    std::thread upstream(FakeUpstream, config.upstream);
+    for (int i = 0; i < 500 && (Received() < sent.size() || std::filesystem::exists(config.root / "upstream.spool")); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    CHECK(!std::filesystem::exists(config.root / "upstream.spool"));
+    {
+        std::lock_guard<std::mutex> lock(_received_mutex);
+        CHECK(_received == sent);
+    }
+
+    // A client asks for digests and never reads them, another one's batch is
+    // still acked at once and the first gets every reply once it reads
+    int slow = Connect(config.socket);
+    std::string digest = "DIGEST ack 1000\n" + std::string(1000, '\n');
+    for (int i = 0; i < 40; i++) {
+        SendAll(slow, digest);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    Stopwatch watch;
+    SendAll(fd, "BATCH ack 1\n" + sent[0]);
+    CHECK(ReadLine(fd, line) && line == "OK 1 1");
+    CHECK(watch.Seconds() < 0.5);
+    printf("  ack beside a stalled reader in %.1f ms\n", watch.Seconds() * 1000);
+    int ends = 0;
+    while (ends < 40 && ReadLine(slow, line)) {
+        ends += line == "END";
+    }
+    CHECK(ends == 40);
+    close(slow);
+    close(fd);
+
+    StopCollector();
+    server.join();
+    _upstream_running = false;
+    upstream.join();
+    RemoveTestStore();
+    return TestResult("testCollector");
+}
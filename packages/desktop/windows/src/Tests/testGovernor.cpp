@@ -0,0 +1,68 @@
+#include "test.h"
+#include "trackerGovernor.h"
+
+
+// Synthetic load through GovernorFeed, one GOVERNOR_INTERVAL per step. The
+// tracker loop wakes once per tick, stretched by GovernorDelayScale(); cpu
+// and I/O are given per second.
+static GovernorUsage _usage = {};
+
+static GovernorMode Step(unsigned tickMs, double cpuPercent, double ioPerSecond)
+{
+    for (unsigned ms = 0; ms < GOVERNOR_INTERVAL; ms += tickMs * GovernorDelayScale()) {
+        GovernorWakeup();
+    }
+    _usage.wakeups = SampleGovernorUsage().wakeups;
+    _usage.cpuSeconds += cpuPercent / 100.0 * GOVERNOR_INTERVAL / 1000;
+    _usage.ioBytes += (unsigned long long)(ioPerSecond * GOVERNOR_INTERVAL / 1000);
+    return GovernorFeed(_usage, GOVERNOR_INTERVAL);
+}
+
+int main()
+{
+    GovernorBudget budget = DefaultGovernorBudget();
+    GovernorFeed(SampleGovernorUsage(), 0);
+
+    // Steady tracking at one tick a second stays well inside the budget
+    for (int i = 0; i < 30; i++) {
+        CHECK(Step(1000, 0.2, 1024) == GOVERNOR_NORMAL);
+    }
+    CHECK(GetGovernorLoad() < 0.5);
+    CHECK(GovernorAllowsMaintenance());
+
+    // One CPU burst steps down once, quiet intervals bring it back
+    CHECK(Step(1000, budget.cpuPercent * 3, 0) == GOVERNOR_REDUCED);
+    CHECK(GovernorDelayScale() == 2 && !GovernorAllowsMaintenance());
+    CHECK(!GovernorAllowsProbe(0, 1000) && GovernorAllowsProbe(0, 3600000));
+    for (int i = 1; i < GOVERNOR_RESTORE_INTERVALS; i++) {
+        CHECK(Step(1000, 0.2, 0) == GOVERNOR_REDUCED);
+    }
+    CHECK(Step(1000, 0.2, 0) == GOVERNOR_NORMAL);
+
+    // Sustained I/O over budget goes down to minimal and stays there
+    CHECK(Step(1000, 0.2, budget.ioBytesPerSecond * 2) == GOVERNOR_REDUCED);
+    CHECK(Step(1000, 0.2, budget.ioBytesPerSecond * 2) == GOVERNOR_MINIMAL);
+    for (int i = 0; i < 10; i++) {
+        CHECK(Step(1000, 0.2, budget.ioBytesPerSecond * 2) == GOVERNOR_MINIMAL);
+    }
+    CHECK(GovernorDelayScale() == 5);
+    // An interval at the budget but not under half of it restores nothing
+    for (int i = 0; i < 10; i++) {
+        CHECK(Step(1000, 0.2, budget.ioBytesPerSecond * 0.8) == GOVERNOR_MINIMAL);
+    }
+    for (int i = 0; i < 2 * GOVERNOR_RESTORE_INTERVALS; i++) {
+        Step(1000, 0.2, 0);
+    }
+    CHECK(GetGovernorMode() == GOVERNOR_NORMAL);
+
+    // A loop ticking too fast for the wakeup budget is slowed to fit it, and
+    // does not flap back: at the reduced pace it sits at the budget
+    double fast = 1000.0 / (budget.wakeupsPerSecond * 2);
+    CHECK(Step((unsigned)fast, 0.2, 0) == GOVERNOR_REDUCED);
+    for (int i = 0; i < 20; i++) {
+        CHECK(Step((unsigned)fast, 0.2, 0) == GOVERNOR_REDUCED);
+    }
+    CHECK(GetGovernorLoad() <= 1.0 && GetGovernorLoad() >= 0.5);
+
+    return TestResult("testGovernor");
+}
@@ -0,0 +1,113 @@
+#include "test.h"
+#include "trackerImport.h"
+
+#include <cstring>
+#include <fstream>
+
+
+static bool SameSession(const AppLogger& a, const AppLogger& b)
+{
+    return TimeKey(a.start) == TimeKey(b.start) && TimeKey(a.end) == TimeKey(b.end) &&
+           a.executable == b.executable && a.title == b.title;
+}
+
+static void TestParseLine()
+{
+    AppLogger log;
+    const char* line = "2024-03-05 10:20:30 ; 2024-03-05 10:21:00 ; Code.exe ; a ; b ; c";
+    CHECK(ParseLogLine(line, strlen(line), log));
+    CHECK(log.start.wYear == 2024 && log.start.wMonth == 3 && log.start.wDay == 5);
+    CHECK(log.start.wHour == 10 && log.start.wMinute == 20 && log.start.wSecond == 30);
+    CHECK(log.end.wMinute == 21 && log.end.wSecond == 0);
+    // The executable ends at the first delimiter, titles keep theirs
+    CHECK(log.executable == "Code.exe");
+    CHECK(log.title == "a ; b ; c");
+
+    line = "2024-03-05 10:20:30 ; 2024-03-05 10:21:00 ;  ; ";
+    CHECK(ParseLogLine(line, strlen(line), log));
+    CHECK(log.executable.empty() && log.title.empty());
+
+    const char* malformed[] = {
+        "",
+        "garbage line",
+        "2024-03-05 10:20:30 ; 2024-03-05 10:21:00",
+        "2024-03-05 10:2x:30 ; 2024-03-05 10:21:00 ; a ; b",
+        "2024/03/05 10:20:30 ; 2024-03-05 10:21:00 ; a ; b",
+        "2024-03-05 10:20:30 ; 2024-03-05 10:21:00 ; a-b",
+    };
+    for (const char* bad : malformed) {
+        CHECK(!ParseLogLine(bad, strlen(bad), log));
+    }
+}
+
+static void TestAppendRoundTrip()
+{
+    for (const auto& log : SyntheticSessions(1000, TimeSeconds({2024, 1, 0, 1, 0, 0, 0, 0}), 26)) {
+        std::string line;
+        AppendLogLine(line, log);
+        CHECK(line == GetLineStr(log));
+        AppLogger back;
+        CHECK(!line.empty() && line.back() == '\n');
+        CHECK(ParseLogLine(line.data(), line.size() - 1, back) && SameSession(back, log));
+    }
+}
+
+// Every thread count splits the buffer differently, the result must not change
+static void TestThreadedImport()
+{
+    std::vector<AppLogger> logs = SyntheticSessions(50000, TimeSeconds({2024, 1, 0, 1, 0, 0, 0, 0}), 260);
+    std::string text;
+    for (size_t i = 0; i < logs.size(); i++) {
+        AppendLogLine(text, logs[i]);
+        if (i % 97 == 0) {
+            // CRLF endings and a malformed line now and then
+            text.insert(text.size() - 1, "\r");
+            text += "not a session\n";
+        }
+    }
+    size_t malformed = (logs.size() + 96) / 97;
+    for (unsigned threads : {1u, 2u, 3u, 8u}) {
+        std::vector<AppLogger> out;
+        ImportStats stats = ImportLogBuffer(text.data(), text.size(), out, threads);
+        CHECK(stats.imported == logs.size());
+        CHECK(stats.malformed == malformed);
+        CHECK(stats.lines == logs.size() + malformed);
+        bool same = out.size() == logs.size();
+        for (size_t i = 0; same && i < out.size(); i++) {
+            same = SameSession(out[i], logs[i]);
+        }
+        CHECK(same);
+    }
+}
+
+static void TestTail()
+{
+    UseTestStore("import");
+    std::vector<AppLogger> logs = SyntheticSessions(5000, TimeSeconds({2024, 1, 0, 1, 0, 0, 0, 0}), 2600);
+    std::string text;
+    for (const auto& log : logs) {
+        AppendLogLine(text, log);
+    }
+    std::ofstream(GetLogFilePath(), std::ios::binary) << text;
+
+    std::vector<AppLogger> tail;
+    ImportLogTail(GetLogFilePath(), TimeKey(logs[4000].start), tail);
+    CHECK(tail.size() == 1000 && SameSession(tail.front(), logs[4000]) && SameSession(tail.back(), logs.back()));
+
+    AppLogger last;
+    uint64_t offset = 0;
+    CHECK(ReadLastLogRecord(GetLogFilePath(), last, offset));
+    CHECK(SameSession(last, logs.back()));
+    CHECK(offset == text.size() - GetLineStr(logs.back()).size());
+    RemoveTestStore();
+}
+
+
+int main()
+{
+    TestParseLine();
+    TestAppendRoundTrip();
+    TestThreadedImport();
+    TestTail();
+    return TestResult("testImport");
+}
@@ -0,0 +1,137 @@
+#include "test.h"
+#include "trackerIndex.h"
+
+
+static AppLogger Session(long long start, long long length, const char* executable, const char* title)
+{
+    AppLogger log;
+    log.start = TimeFromSeconds(start);
+    log.end = TimeFromSeconds(start + length);
+    log.executable = executable;
+    log.title = title;
+    return log;
+}
+
+static std::vector<AppLogger> Search(const IndexSegment& segment, const char* text)
+{
+    IndexQuery query;
+    std::vector<AppLogger> out;
+    ParseIndexQuery(text, query);
+    segment.Search(query, 0, 1LL << 62, 100, out);
+    return out;
+}
+
+static size_t Matches(const IndexSegment& segment, const char* text)
+{
+    return Search(segment, text).size();
+}
+
+static bool NewestFirst(const std::vector<AppLogger>& out)
+{
+    for (size_t i = 1; i < out.size(); i++) {
+        if (TimeSeconds(out[i].start) > TimeSeconds(out[i - 1].start)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Sessions are told apart by start, executable and title, not by arriving
+// after the newest one, and come back newest first either way. Prefixes,
+// phrases and the executable filter; time ranges over several monthly
+// segments.
+int main()
+{
+    std::filesystem::path store = UseTestStore("index");
+    long long t = TimeSeconds({2024, 3, 0, 4, 9, 0, 0, 0});
+    IndexSegment segment(202403);
+
+    CHECK(segment.Add(Session(t, 60, "Code.exe", "main.cpp - project")));
+    // Same start: another window the same second, and the same one again
+    CHECK(segment.Add(Session(t, 30, "chrome.exe", "Inbox - Mail")));
+    CHECK(segment.Add(Session(t, 30, "Code.exe", "notes.md - project")));
+    CHECK(!segment.Add(Session(t, 60, "Code.exe", "main.cpp - project")));
+    CHECK(!segment.Add(Session(t, 10, "Code.exe", "main.cpp - project")));
+    // Earlier than everything indexed, e.g. an import of an older log
+    CHECK(segment.Add(Session(t - 3600, 60, "WINWORD.EXE", "report.docx")));
+    CHECK(segment.Sessions() == 4);
+    CHECK(Matches(segment, "project") == 2);
+    CHECK(Matches(segment, "report") == 1);
+    std::vector<AppLogger> out = Search(segment, "exe:code.exe");
+    CHECK(out.size() == 2 && NewestFirst(out));
+    CHECK(segment.Add(Session(t - 7200, 60, "Code.exe", "older.cpp - project")));
+    CHECK(segment.Add(Session(t - 60, 60, "Code.exe", "release notes - project")));
+    out = Search(segment, "project");
+    CHECK(out.size() == 4 && NewestFirst(out) && out.back().title == "older.cpp - project");
+
+    // Prefixes, phrases and the executable filter, alone and together
+    CHECK(segment.Add(Session(t + 600, 60, "chrome.exe", "Release plan - relative dates")));
+    CHECK(Matches(segment, "rel*") == 2);
+    CHECK(Matches(segment, "release*") == 2);
+    CHECK(Matches(segment, "rel") == 0);
+    CHECK(Matches(segment, "rel* exe:chrome.exe") == 1);
+    CHECK(Matches(segment, "rel* exe:CODE*") == 1);
+    CHECK(Matches(segment, "exe:c*") == 6);
+    CHECK(Matches(segment, "\"release notes\"") == 1);
+    CHECK(Matches(segment, "\"notes release\"") == 0);
+    CHECK(Matches(segment, "\"release plan\"") == 1);
+    CHECK(Matches(segment, "\"release pl*\"") == 1);
+    CHECK(Matches(segment, "\"main.cpp project\"") == 1);
+    CHECK(Matches(segment, "\"main project\"") == 0);
+    CHECK(Matches(segment, "\"main cpp\" project") == 1);
+    CHECK(Matches(segment, "project exe:chrome.exe") == 0);
+
+    // A resumed session comes back with a later end
+    CHECK(segment.Add(Session(t, 300, "Code.exe", "main.cpp - project")));
+    CHECK(segment.Sessions() == 7);
+    IndexQuery query;
+    out.clear();
+    ParseIndexQuery("main.cpp", query);
+    segment.Search(query, t + 200, t + 250, 10, out);
+    CHECK(out.size() == 1 && TimeSeconds(out[0].end) == t + 300);
+
+    // The same holds after a round trip through the file
+    IndexSegment loaded;
+    CHECK(segment.Save(store / "2024-03.idx") && loaded.Load(store / "2024-03.idx"));
+    CHECK(!loaded.Add(Session(t, 30, "chrome.exe", "Inbox - Mail")));
+    CHECK(!loaded.Add(Session(t - 3600, 60, "WINWORD.EXE", "report.docx")));
+    CHECK(loaded.Add(Session(t - 3600, 60, "WINWORD.EXE", "report v2.docx")));
+    CHECK(loaded.Sessions() == 8);
+    CHECK(Matches(loaded, "report") == 2);
+    out = Search(loaded, "project");
+    CHECK(out.size() == 4 && NewestFirst(out));
+
+    // Three months in the text log, indexed on start: ranges across segments
+    // come back newest first, bounded and limited as a whole
+    std::vector<AppLogger> logs = SyntheticSessions(30000, TimeSeconds({2024, 5, 0, 20, 0, 0, 0, 0}), 3);
+    {
+        std::ofstream file(GetLogFilePath(), std::ios::binary);
+        for (const auto& log : logs) {
+            file << GetLineStr(log);
+        }
+    }
+    StartTitleIndex();
+    ULONGLONG from = TimeKey({2024, 6, 0, 25, 0, 0, 0, 0});
+    ULONGLONG to = TimeKey({2024, 7, 0, 5, 23, 59, 59, 0});
+    size_t expected = 0;
+    for (const auto& log : logs) {
+        bool inside = TimeKey(log.end) >= from && TimeKey(log.start) <= to;
+        expected += inside && log.title.find("report") != std::string::npos && log.executable == "Slack.exe";
+    }
+    out = SearchTitles("report exe:slack.exe", from, to, 100000);
+    CHECK(out.size() == expected && expected > 10 && NewestFirst(out));
+    CHECK(!out.empty() && out.front().start.wMonth == 7 && out.back().start.wMonth == 6);
+    bool bounded = true;
+    for (const auto& log : out) {
+        bounded = bounded && TimeKey(log.end) >= from && TimeKey(log.start) <= to;
+    }
+    CHECK(bounded);
+    std::vector<AppLogger> limited = SearchTitles("report exe:slack.exe", from, to, 5);
+    CHECK(limited.size() == 5 && TimeKey(limited[0].start) == TimeKey(out[0].start));
+    // Open ends reach every segment
+    out = SearchTitles("budget*", 0, 0, 100000);
+    CHECK(out.size() > expected && out.back().start.wMonth == 5 && out.front().start.wMonth >= 7);
+
+    RemoveTestStore();
+    return TestResult("testIndex");
+}
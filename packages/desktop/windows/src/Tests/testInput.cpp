@@ -0,0 +1,96 @@
+#include "test.h"
+#include "syntheticInput.h"
+
+#include <atomic>
+#include <fstream>
+#include <thread>
+
+
+// Input counting on its real evdev path, fed by synthetic devices: every
+// press, click and wheel turn reaches the sessions, auto-repeat, releases and
+// moves do not, and an unplugged device does not stop the others
+static InputSummary _taken = {};
+
+static uint32_t Total(const InputSummary& input)
+{
+    return input.keys + input.clicks + input.scrolls;
+}
+
+// Reduces until the expected total arrived or a second passed
+static void Drain(uint32_t expected)
+{
+    for (int i = 0; i < 200 && Total(_taken) < expected; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        ReduceInput();
+        InputSummary input;
+        TakeSessionInput(input);
+        _taken.keys += input.keys;
+        _taken.clicks += input.clicks;
+        _taken.scrolls += input.scrolls;
+        _taken.activeMinutes += input.activeMinutes;
+    }
+}
+
+int main()
+{
+    std::filesystem::path store = UseTestStore("input");
+    CHECK(!BeginInputCounting((store / "none").c_str()));
+    CHECK(!IsInputCountingActive());
+
+    SyntheticInput devices(store / "devices", 3);
+    CHECK(BeginInputCounting((store / "devices").c_str()));
+    ReduceInput();
+    InputSummary dropped;
+    TakeSessionInput(dropped);
+
+    InputSummary expected = devices.Generate(30000, 47);
+    uint32_t counted = Total(expected);
+    Drain(Total(expected));
+    CHECK(_taken.keys == expected.keys && _taken.clicks == expected.clicks && _taken.scrolls == expected.scrolls);
+    CHECK(_taken.activeMinutes >= 1);
+
+    // One device gone, the other two still counted
+    devices.Unplug(1);
+    _taken = {};
+    expected = devices.Generate(10000, 48);
+    counted += Total(expected);
+    Drain(Total(expected));
+    CHECK(_taken.keys == expected.keys && _taken.clicks == expected.clicks && _taken.scrolls == expected.scrolls);
+
+    EndInputCounting();
+    CHECK(!IsInputCountingActive());
+
+    // Ending writes the open minute: the minutes add up to what was counted
+    SaveInput();
+    std::ifstream file(store / INPUT_FILE);
+    std::string line;
+    unsigned long long minutes = 0;
+    while (std::getline(file, line)) {
+        unsigned keys, clicks, scrolls;
+        CHECK(sscanf(line.c_str() + 16, " ; %u ; %u ; %u", &keys, &clicks, &scrolls) == 3);
+        minutes += keys + clicks + scrolls;
+    }
+    CHECK(minutes == counted);
+
+    // Counted on another thread while the reducer runs: nothing lost
+    std::atomic<bool> running(true);
+    uint32_t recorded = 0;
+    std::thread generator([&]() {
+        while (running) {
+            RecordInput((InputKind)(recorded % INPUT_KINDS));
+            recorded++;
+        }
+    });
+    _taken = {};
+    for (int i = 0; i < 500; i++) {
+        ReduceInput();
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    running = false;
+    generator.join();
+    Drain(recorded);
+    CHECK(Total(_taken) == recorded);
+
+    RemoveTestStore();
+    return TestResult("testInput");
+}
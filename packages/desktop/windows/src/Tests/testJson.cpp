@@ -0,0 +1,225 @@
+#include "test.h"
+#include "trackerArchive.h"
+#include "trackerImport.h"
+#include "trackerJson.h"
+
+#include <climits>
+#include <fstream>
+#include <random>
+
+
+// The writer against a plain reference encoder, one byte at a time with
+// JSON.stringify's escapes: sessions with every kind of byte in titles long
+// enough to cross chunks, in payloads of random sizes, buffered and through a
+// sink, then the export of a store and nesting the writer must refuse
+static std::string Quote(const std::string& text)
+{
+    std::string out = "\"";
+    for (unsigned char c : text) {
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\b': out += "\\b"; break;
+        case '\f': out += "\\f"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (c < 0x20) {
+                char escape[8];
+                snprintf(escape, sizeof(escape), "\\u%04x", c);
+                out += escape;
+            } else {
+                out += (char)c;
+            }
+        }
+    }
+    return out + "\"";
+}
+
+static std::string Stamp(const SYSTEMTIME& st)
+{
+    char text[64];
+    snprintf(text, sizeof(text), "\"%04u-%02u-%02uT%02u:%02u:%02u\"", st.wYear, st.wMonth, st.wDay, st.wHour,
+             st.wMinute, st.wSecond);
+    return text;
+}
+
+static std::string Reference(long long deviceId, const std::vector<AppLogger>& logs, size_t from, size_t to)
+{
+    std::string out = "{\"deviceId\":" + std::to_string(deviceId) + ",\"sessions\":[";
+    for (size_t i = from; i < to; i++) {
+        const AppLogger& log = logs[i];
+        out += i > from ? "," : "";
+        out += "{\"start\":" + Stamp(log.start) + ",\"end\":" + Stamp(log.end) + ",\"executable\":" +
+               Quote(log.executable) + ",\"title\":" + Quote(log.title) + "}";
+    }
+    return out + "]}\n";
+}
+
+static std::mt19937 _random(50);
+
+static std::string RandomText(size_t size)
+{
+    static const char* pieces[] = {"\"", "\\", "\n", "\t", "\b", "\f", "\r", "\x01", "\x1f", "\x7f", "/", "é",
+                                   "日本", "😀", "</script>", "\xe2\x80\xa8", "'"};
+    std::string text;
+    while (text.size() < size) {
+        if (_random() % 4 == 0) {
+            text += pieces[_random() % (sizeof(pieces) / sizeof(*pieces))];
+        } else {
+            text += (char)(' ' + _random() % 95);
+        }
+    }
+    return text;
+}
+
+static SYSTEMTIME RandomTime()
+{
+    SYSTEMTIME st = {};
+    st.wYear = 1990 + _random() % 80;
+    st.wMonth = 1 + _random() % 12;
+    st.wDay = 1 + _random() % 28;
+    st.wHour = _random() % 24;
+    st.wMinute = _random() % 60;
+    st.wSecond = _random() % 60;
+    return st;
+}
+
+static std::string Chunks(const JsonWriter& json)
+{
+    std::string out;
+    json.ForEachChunk([&](const char* data, size_t size) { out.append(data, size); });
+    return out;
+}
+
+static void Payload(JsonWriter& json, long long deviceId, const std::vector<AppLogger>& logs, size_t from, size_t to)
+{
+    json.BeginObject();
+    json.Key("deviceId");
+    json.Int(deviceId);
+    json.Key("sessions");
+    json.BeginArray();
+    for (size_t i = from; i < to; i++) {
+        WriteSessionJson(json, logs[i]);
+    }
+    json.EndArray();
+    json.EndObject();
+    json.Raw("\n", 1);
+}
+
+int main()
+{
+    // Every byte alone, and each special byte at every offset of a 16-byte compare
+    JsonWriter json;
+    for (int c = 0; c < 256; c++) {
+        json.Clear();
+        json.String(std::string(1, (char)c));
+        CHECK(Chunks(json) == Quote(std::string(1, (char)c)));
+    }
+    for (const char* special : {"\"", "\\", "\x1f", "\x7f", "\xff"}) {
+        for (size_t at = 0; at < 40; at++) {
+            std::string text(40, 'x');
+            text[at] = *special;
+            json.Clear();
+            json.String(text);
+            CHECK(Chunks(json) == Quote(text));
+        }
+    }
+    json.Clear();
+    json.BeginArray();
+    for (long long value : {0LL, -1LL, 9LL, 10LL, LLONG_MAX, LLONG_MIN}) {
+        json.Int(value);
+    }
+    json.EndArray();
+    CHECK(Chunks(json) == "[0,-1,9,10,9223372036854775807,-9223372036854775808]" && json.Ok());
+
+    // Random sessions, a tenth with titles up to 200 KB
+    std::vector<AppLogger> logs(4000);
+    for (auto& log : logs) {
+        log.start = RandomTime();
+        log.end = RandomTime();
+        log.executable = RandomText(_random() % 40);
+        log.title = RandomText(_random() % 10 == 0 ? _random() % 200000 : _random() % 100);
+    }
+    std::string sunk, expected;
+    JsonWriter sink([&](const char* data, size_t size) {
+        sunk.append(data, size);
+        return true;
+    });
+    size_t payloads = 0, differing = 0;
+    for (size_t from = 0; from < logs.size(); payloads++) {
+        size_t to = std::min<size_t>(logs.size(), from + 1 + _random() % 700);
+        long long deviceId = -(long long)from * 1000003;
+        std::string reference = Reference(deviceId, logs, from, to);
+        json.Clear();
+        Payload(json, deviceId, logs, from, to);
+        differing += Chunks(json) != reference || json.Size() != reference.size() || !json.Ok();
+        Payload(sink, deviceId, logs, from, to);
+        expected += reference;
+        from = to;
+    }
+    CHECK(differing == 0);
+    CHECK(sink.Flush() && sunk == expected && sink.Size() == expected.size());
+    printf("  %zu sessions in %zu payloads, %.1f MB, %zu differing\n", logs.size(), payloads, expected.size() / 1e6,
+           differing);
+
+    // The export of a store is the reference over the sessions it holds
+    UseTestStore("json");
+    std::vector<AppLogger> stored = SyntheticSessions(3000, Now() - 10 * 86400, 50);
+    {
+        std::ofstream file(GetLogFilePath(), std::ios::binary);
+        for (const auto& log : stored) {
+            file << GetLineStr(log);
+        }
+    }
+    stored.clear();
+    ForEachStoredSession(0, ~0ULL, [&](const AppLogger& log) {
+        stored.push_back(log);
+        return true;
+    });
+    std::string exported;
+    JsonExportStats stats = ExportJson(0, ~0ULL, 42, [&](const char* data, size_t size) {
+        exported.append(data, size);
+        return true;
+    }, 700);
+    expected.clear();
+    for (size_t from = 0; from < stored.size(); from += 700) {
+        expected += Reference(42, stored, from, std::min<size_t>(stored.size(), from + 700));
+    }
+    CHECK(stats.sessions == 3000 && stats.payloads == 5 && exported == expected && stats.bytes == exported.size());
+    size_t calls = 0;
+    stats = ExportJson(0, ~0ULL, 42, [&](const char*, size_t) { return ++calls < 2; }, 700);
+    CHECK(calls == 2 && stats.sessions < 3000);
+    RemoveTestStore();
+
+    // Nesting the commas cannot follow, or an End without its Begin, fails the payload
+    json.Clear();
+    for (int depth = 1; depth < JSON_MAX_DEPTH; depth++) {
+        json.BeginArray();
+        json.Int(depth);
+    }
+    for (int depth = 1; depth < JSON_MAX_DEPTH; depth++) {
+        json.EndArray();
+    }
+    std::string nested;
+    for (int depth = 1; depth < JSON_MAX_DEPTH; depth++) {
+        nested += (depth > 1 ? ",[" : "[") + std::to_string(depth);
+    }
+    CHECK(json.Ok() && Chunks(json) == nested + std::string(JSON_MAX_DEPTH - 1, ']'));
+    json.Clear();
+    for (int depth = 0; depth < JSON_MAX_DEPTH; depth++) {
+        json.BeginObject();
+        json.Key("a");
+    }
+    CHECK(!json.Ok());
+    json.Clear();
+    json.BeginArray();
+    json.EndArray();
+    json.EndArray();
+    CHECK(!json.Ok());
+    json.Clear();
+    CHECK(json.Ok());
+
+    return TestResult("testJson");
+}
@@ -0,0 +1,107 @@
+#include "test.h"
+#include "trackerLimits.h"
+
+#include <fstream>
+
+
+// Each kind of rule around its reset: a daily total at midnight, a streak
+// after a gap, a sliding window once old use slides out. Executables match
+// whatever their case, and a restart replays the log without alerting again.
+static std::vector<std::pair<std::string, long long>> _fired;
+
+static void Record(const LimitRule& rule, long long used)
+{
+    _fired.push_back({rule.name, used});
+}
+
+static LimitEngine Engine(const std::string& rule)
+{
+    LimitEngine engine;
+    CHECK(engine.AddRule(rule));
+    engine.SetCallback(Record);
+    _fired.clear();
+    return engine;
+}
+
+// Ten-second samples over [start, end), as the tracker gives them
+static void Use(LimitEngine& engine, const std::string& executable, long long start, long long end)
+{
+    for (long long t = start; t < end; t += 10) {
+        engine.Add(executable, t, std::min(end, t + 10));
+    }
+}
+
+int main()
+{
+    long long midnight = TimeSeconds({2024, 5, 0, 7, 0, 0, 0, 0});
+
+    // Daily: the total restarts at midnight, even within one span
+    LimitEngine daily = Engine("daily 3600 ; Games ; Steam.exe,eldenring.exe");
+    Use(daily, "STEAM.exe", midnight - 3000, midnight);
+    CHECK(daily.Used(0) == 3000 && _fired.empty());
+    daily.Add("eldenring.exe", midnight - 300, midnight + 1200);
+    CHECK(daily.Used(0) == 1200 && _fired.empty());
+    Use(daily, "steam.exe", midnight + 1200, midnight + 3600);
+    CHECK(_fired.size() == 1 && _fired[0].first == "Games" && _fired[0].second == 3600);
+    Use(daily, "Steam.exe", midnight + 3600, midnight + 7200);
+    CHECK(_fired.size() == 1);
+    Use(daily, "Steam.exe", midnight + 86400, midnight + 86400 + 3600);
+    CHECK(_fired.size() == 2);
+    Use(daily, "notepad.exe", midnight + 86400 + 3600, midnight + 86400 + 4000);
+    CHECK(daily.Used(0) == 3600);
+
+    // Streak: a short break continues it, a longer one re-arms it
+    LimitEngine streak = Engine("streak 600 ; Social ; Discord.exe");
+    Use(streak, "discord.exe", midnight, midnight + 500);
+    Use(streak, "discord.exe", midnight + 500 + LIMIT_STREAK_GAP, midnight + 700);
+    CHECK(_fired.size() == 1 && streak.Used(0) == 640);
+    Use(streak, "discord.exe", midnight + 700, midnight + 1500);
+    CHECK(_fired.size() == 1);
+    long long back = midnight + 1500 + LIMIT_STREAK_GAP + 10;
+    Use(streak, "DISCORD.EXE", back, back + 590);
+    CHECK(_fired.size() == 1 && streak.Used(0) == 590);
+    Use(streak, "discord.exe", back + 590, back + 600);
+    CHECK(_fired.size() == 2);
+
+    // Sliding window: use older than the window stops counting and re-arms the rule
+    LimitEngine window = Engine("window 300 600 ; Video ; vlc.exe");
+    Use(window, "vlc.exe", midnight, midnight + 240);
+    Use(window, "vlc.exe", midnight + 420, midnight + 480);
+    CHECK(_fired.size() == 1 && window.Used(0) == 300);
+    Use(window, "vlc.exe", midnight + 720, midnight + 780);
+    CHECK(window.Used(0) == 180 && _fired.size() == 1);
+    Use(window, "vlc.exe", midnight + 780, midnight + 900);
+    CHECK(window.Used(0) == 240 && _fired.size() == 1);
+    Use(window, "vlc.exe", midnight + 900, midnight + 960);
+    CHECK(window.Used(0) == 300 && _fired.size() == 2);
+    Use(window, "vlc.exe", midnight + 5000, midnight + 5060);
+    CHECK(window.Used(0) == 60);
+
+    // Restart: rules that fired before it stay quiet as the log is replayed
+    // and the next samples come in
+    std::filesystem::path store = UseTestStore("limits");
+    long long now = Now();
+    std::ofstream(store / LIMITS_FILE) << "streak 600 ; Social ; discord.exe\n"
+                                       << "window 600 3600 ; Video ; VLC.exe\n"
+                                       << "window 2700 3600 ; Later ; *\n";
+    {
+        std::ofstream log(GetLogFilePath(), std::ios::app);
+        log << GetLineStr({TimeFromSeconds(now - 2400), TimeFromSeconds(now - 1600), "vlc.exe", "movie"});
+        log << GetLineStr({TimeFromSeconds(now - 1600), TimeFromSeconds(now - 1590), "AFK", "Idle"});
+        log << GetLineStr({TimeFromSeconds(now - 1590), TimeFromSeconds(now - 10), "Discord.exe", "general"});
+    }
+    _fired.clear();
+    StartLimits(Record);
+    for (long long t = now; t <= now + 300; t += 10) {
+        SampleLimits({TimeFromSeconds(now - 1590), TimeFromSeconds(t), "discord.exe", "general"}, TimeFromSeconds(t));
+    }
+    CHECK(_fired.empty());
+    // Use the replay had not crossed still alerts
+    for (long long t = now + 300; t <= now + 1000; t += 10) {
+        SampleLimits({TimeFromSeconds(now - 1590), TimeFromSeconds(t), "discord.exe", "general"}, TimeFromSeconds(t));
+    }
+    CHECK(_fired.size() == 1 && _fired[0].first == "Later");
+
+    RemoveTestStore();
+    return TestResult("testLimits");
+}
@@ -0,0 +1,193 @@
+#include "test.h"
+
+#include "queryServer.h"
+#include "trackerArchive.h"
+#include "trackerImport.h"
+#include "trackerRollup.h"
+
+#include <csignal>
+#include <map>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+// RANGE over a store with sessions in the text log, in the rollups and in an
+// archive, against totals computed from the sessions directly; a session past
+// midnight split between its days; an old day never compacted; whole command
+// words only; the socket and its directory private to the user; connections
+// capped.
+
+static int Connect(const std::string& path)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    for (int i = 0; i < 200 && connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return fd;
+}
+
+static std::string Request(const std::string& path, const std::string& request)
+{
+    int fd = Connect(path);
+    std::string out = request + "\n";
+    write(fd, out.data(), out.size());
+    out.clear();
+    char buffer[4096];
+    ssize_t n;
+    // Every response ends with an empty line, an empty response is that line alone
+    while (out != "\n" && (out.size() < 2 || out.compare(out.size() - 2, 2, "\n\n") != 0)) {
+        if ((n = read(fd, buffer, sizeof(buffer))) <= 0) {
+            break;
+        }
+        out.append(buffer, n);
+    }
+    close(fd);
+    return out;
+}
+
+typedef std::map<std::string, std::pair<long long, size_t>> Totals;
+
+// "executable ; seconds ; sessions" lines up to the empty one
+static Totals ParseUsage(const std::string& response)
+{
+    Totals totals;
+    char executable[64];
+    long long seconds;
+    size_t sessions;
+    for (size_t at = 0, next; (next = response.find('\n', at)) != std::string::npos && next > at; at = next + 1) {
+        if (sscanf(response.c_str() + at, "%63s ; %lld ; %zu", executable, &seconds, &sessions) == 3) {
+            totals[executable] = {seconds, sessions};
+        }
+    }
+    return totals;
+}
+
+static std::string Key(long long seconds)
+{
+    return std::to_string(TimeKey(TimeFromSeconds(seconds)));
+}
+
+int main()
+{
+    // A turned away client writes to a closed connection
+    signal(SIGPIPE, SIG_IGN);
+    std::filesystem::path store = UseTestStore("query");
+    long long today = DayNumber(GetTime()) * 86400LL;
+
+    // An archived month, well before what the rollups keep
+    std::vector<AppLogger> archived = SyntheticSessions(300, today - 70 * 86400LL, 3);
+    SYSTEMTIME month = archived.front().start;
+    char name[32];
+    snprintf(name, sizeof(name), "%04u-%02u.csa", month.wYear, month.wMonth);
+    std::filesystem::create_directories(store / "Archive");
+    archived.erase(std::remove_if(archived.begin(), archived.end(),
+                                  [&](const AppLogger& log) { return log.start.wMonth != month.wMonth; }),
+                   archived.end());
+    WriteArchive(store / "Archive" / name, archived);
+
+    // An old day the compaction left in the text log, recent days sealed into
+    // the rollups on start, and a session running 10 minutes before midnight
+    // and 20 after
+    std::vector<AppLogger> recent = SyntheticSessions(400, today - 10 * 86400LL, 4);
+    AppLogger uncompacted = {TimeFromSeconds(today - 60 * 86400LL + 3600), TimeFromSeconds(today - 60 * 86400LL + 4000),
+                             "Old.exe", "left in the log"};
+    AppLogger night = {TimeFromSeconds(today - 4 * 86400LL - 600), TimeFromSeconds(today - 4 * 86400LL + 1200),
+                       "Night.exe", "past midnight"};
+    {
+        std::ofstream file(GetLogFilePath(), std::ios::app);
+        file << GetLineStr(uncompacted);
+        for (const auto& log : recent) {
+            if (DayNumber(log.start) < DayNumber(GetTime())) {
+                file << GetLineStr(log);
+            }
+        }
+        file << GetLineStr(night);
+    }
+    recent.push_back(night);
+    StartRollups();
+
+    // A directory somebody else could have made is refused
+    unsetenv("XDG_RUNTIME_DIR");
+    std::string path = QuerySocketPath();
+    std::string dir = path.substr(0, path.rfind('/'));
+    std::filesystem::remove_all(dir);
+    mkdir(dir.c_str(), 0755);
+    QueryServerLoop();
+    CHECK(!std::filesystem::exists(path));
+    std::filesystem::remove_all(dir);
+
+    std::thread server(QueryServerLoop);
+    Request(path, "CURRENT");
+    struct stat st;
+    CHECK(stat(dir.c_str(), &st) == 0 && (st.st_mode & 0777) == 0700 && st.st_uid == getuid());
+    CHECK(stat(path.c_str(), &st) == 0 && (st.st_mode & 0777) == 0600);
+
+    CHECK(Request(path, "TOPX") == "ERROR unknown request\n\n");
+    CHECK(Request(path, "RANGEX 0 99999999999999") == "ERROR unknown request\n\n");
+    CHECK(Request(path, "TOP") == Request(path, "TOP 10"));
+
+    // Whole days from the first to the last, counted on the day they start
+    Totals expected;
+    archived.push_back(uncompacted);
+    for (const auto* logs : {&archived, &recent}) {
+        for (const auto& log : *logs) {
+            if (DayNumber(log.start) < DayNumber(GetTime())) {
+                auto& e = expected[log.executable];
+                e.first += TimeSeconds(log.end) - TimeSeconds(log.start);
+                e.second++;
+            }
+        }
+    }
+    Totals got = ParseUsage(Request(path, "RANGE " + Key(today - 80 * 86400LL) + " " + Key(today - 1) + " 100"));
+    CHECK(!expected.empty());
+    CHECK(got == expected);
+
+    // Only the archived days
+    Totals old;
+    for (const auto& log : archived) {
+        auto& e = old[log.executable];
+        e.first += TimeSeconds(log.end) - TimeSeconds(log.start);
+        e.second++;
+    }
+    got = ParseUsage(Request(path, "RANGE " + Key(today - 80 * 86400LL) + " " + Key(today - 50 * 86400LL) + " 100"));
+    CHECK(got["Old.exe"] == std::make_pair(400LL, (size_t)1));
+    CHECK(got == old);
+
+    // The session past midnight counts on the day it started, its seconds on each day
+    got = ParseUsage(Request(path, "RANGE " + Key(today - 5 * 86400LL) + " " + Key(today - 5 * 86400LL) + " 100"));
+    CHECK(got["Night.exe"] == std::make_pair(600LL, (size_t)1));
+    got = ParseUsage(Request(path, "RANGE " + Key(today - 4 * 86400LL) + " " + Key(today - 4 * 86400LL) + " 100"));
+    CHECK(got["Night.exe"] == std::make_pair(1200LL, (size_t)0));
+
+    // Connections past the cap are turned away instead of each getting a thread
+    std::vector<int> subscribers;
+    for (int i = 0; i < 16; i++) {
+        subscribers.push_back(Connect(path));
+        write(subscribers.back(), "SUBSCRIBE\n", 10);
+        char line[512];
+        read(subscribers.back(), line, sizeof(line));
+    }
+    CHECK(Request(path, "CURRENT") == "ERROR busy\n\n");
+    close(subscribers.back());
+    subscribers.pop_back();
+    std::string answer;
+    for (int i = 0; i < 200 && (answer = Request(path, "CURRENT")) == "ERROR busy\n\n"; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    CHECK(answer != "ERROR busy\n\n");
+    for (int fd : subscribers) {
+        close(fd);
+    }
+
+    StopQueryServer();
+    server.join();
+    CHECK(!std::filesystem::exists(path));
+    std::filesystem::remove_all(dir);
+    RemoveTestStore();
+    return TestResult("testQuery");
+}
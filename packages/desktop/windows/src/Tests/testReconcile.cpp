@@ -0,0 +1,165 @@
+#include "test.h"
+#include "collector.h"
+
+#include <algorithm>
+#include <fstream>
+#include <thread>
+
+
+// Trees updated a day at a time against trees built whole. A local collector
+// as the stub server: a store that diverged from it is reconciled for a small
+// fraction of what re-uploading everything costs, and a second pass finds
+// nothing left
+static size_t FullUpload(const std::vector<AppLogger>& logs)
+{
+    size_t bytes = 0;
+    for (const auto& log : logs) {
+        bytes += GetLineStr(log).size();
+    }
+    return bytes;
+}
+
+// Every line of the user's partition files, and whether one appears twice
+static std::vector<std::string> PartitionLines(const std::filesystem::path& dir, bool& duplicates)
+{
+    std::vector<std::string> lines;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+        std::ifstream file(entry.path(), std::ios::binary);
+        std::string line;
+        while (std::getline(file, line)) {
+            lines.push_back(line + '\n');
+        }
+    }
+    std::sort(lines.begin(), lines.end());
+    duplicates = std::adjacent_find(lines.begin(), lines.end()) != lines.end();
+    return lines;
+}
+
+static bool SameLines(const std::filesystem::path& dir, const std::vector<AppLogger>& logs)
+{
+    std::vector<std::string> expected;
+    for (const auto& log : logs) {
+        expected.push_back(GetLineStr(log));
+    }
+    std::sort(expected.begin(), expected.end());
+    bool duplicates;
+    return PartitionLines(dir, duplicates) == expected && !duplicates;
+}
+
+static CollectorReconcileStats Reconcile(const std::filesystem::path& socket, const std::string& user,
+                                         const std::vector<AppLogger>& logs)
+{
+    DigestTree tree;
+    tree.Build(logs);
+    CollectorReconcileStats stats = {};
+    CHECK(ReconcileWithCollector(socket, user, tree, stats));
+    printf("  %s: %zu sessions, %zu sent, %zu round trips, %zu bytes out, %zu bytes in\n", user.c_str(), logs.size(),
+           stats.reconcile.sessionsSent, stats.reconcile.roundTrips, stats.bytesSent, stats.bytesReceived);
+    return stats;
+}
+
+int main()
+{
+    std::filesystem::path store = UseTestStore("reconcile");
+    CollectorConfig config = {};
+    config.socket = store / COLLECTOR_SOCKET_NAME;
+    config.root = store / "Collector";
+    config.workers = 1;
+    config.ioThreads = 1;
+    std::thread server([&]() { RunCollector(config); });
+    for (int i = 0; i < 200 && !std::filesystem::exists(config.socket); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    // A year of sessions
+    std::vector<AppLogger> year = SyntheticSessions(100000, TimeSeconds({2025, 1, 0, 1, 0, 0, 0, 0}), 9);
+    size_t full = FullUpload(year);
+
+    // A tree rebuilt a day at a time matches one built from everything: the
+    // lost day comes back, a day is emptied, a new month appears
+    {
+        std::vector<AppLogger> days[3];
+        std::vector<AppLogger> rest;
+        for (const auto& log : year) {
+            int which = log.start.wMonth == 3 && log.start.wDay == 7 ? 0 : log.start.wMonth == 8 && log.start.wDay == 1 ? 1
+                      : log.start.wMonth == 12 ? 2 : -1;
+            (which >= 0 ? days[which] : rest).push_back(log);
+        }
+        DigestTree partial, whole;
+        partial.Build(rest);
+        partial.ReplaceDay("2025-03-07", days[0]);
+        partial.ReplaceDay("2025-08-01", days[1]);
+        for (int day = 1; day <= 31; day++) {
+            char name[16];
+            snprintf(name, sizeof(name), "2025-12-%02d", day);
+            std::vector<AppLogger> logs;
+            for (const auto& log : days[2]) {
+                if (log.start.wDay == day) {
+                    logs.push_back(log);
+                }
+            }
+            partial.ReplaceDay(name, logs);
+        }
+        whole.Build(year);
+        CHECK(partial.Root() == whole.Root() && partial.Sessions() == whole.Sessions());
+        std::vector<std::string> a, b;
+        partial.Lines("2025-08", a);
+        whole.Lines("2025-08", b);
+        CHECK(a == b);
+        partial.ReplaceDay("2025-08-01", {});
+        whole.Build(rest);
+        partial.ReplaceDay("2025-03-07", {});
+        for (int day = 1; day <= 31; day++) {
+            char name[16];
+            snprintf(name, sizeof(name), "2025-12-%02d", day);
+            partial.ReplaceDay(name, {});
+        }
+        std::vector<DigestEntry> months;
+        CHECK(partial.Root() == whole.Root() && partial.Children("", months) && months.size() == 11);
+    }
+
+    // First upload to an empty server sends everything, then it is in sync
+    CollectorReconcileStats stats = Reconcile(config.socket, "first", year);
+    CHECK(stats.reconcile.sessionsSent == year.size());
+    stats = Reconcile(config.socket, "first", year);
+    CHECK(stats.reconcile.sessionsSent == 0 && stats.reconcile.roundTrips == 1);
+    CHECK(stats.bytesSent + stats.bytesReceived < 1024);
+
+    // The server lost one day and a few scattered sessions
+    std::vector<AppLogger> kept;
+    size_t lost = 0;
+    for (size_t i = 0; i < year.size(); i++) {
+        bool lostDay = year[i].start.wMonth == 6 && year[i].start.wDay == 15;
+        if (lostDay || i % 5000 == 17) {
+            lost++;
+        } else {
+            kept.push_back(year[i]);
+        }
+    }
+    Reconcile(config.socket, "lossy", kept);
+    stats = Reconcile(config.socket, "lossy", year);
+    CHECK(stats.reconcile.sessionsSent >= lost);
+    CHECK(stats.reconcile.roundTrips <= 5);
+    CHECK((stats.bytesSent + stats.bytesReceived) * 20 < full);
+    printf("  full upload %zu bytes, %.0fx more than the exchange\n", full,
+           (double)full / (stats.bytesSent + stats.bytesReceived));
+    stats = Reconcile(config.socket, "lossy", year);
+    CHECK(stats.reconcile.sessionsSent == 0);
+    // Blocks that differed were sent whole, the lines the server had are not written twice
+    CHECK(SameLines(config.root / "lossy", year));
+
+    // A client restored from an older backup has nothing the server lacks: at
+    // most the block it ends in differs, and the server keeps no duplicates
+    std::vector<AppLogger> backup(year.begin(), year.begin() + year.size() / 2);
+    stats = Reconcile(config.socket, "first", backup);
+    CHECK(stats.reconcile.sessionsSent <= DIGEST_BLOCK_SESSIONS);
+    stats = Reconcile(config.socket, "first", year);
+    CHECK(stats.reconcile.sessionsSent == 0);
+    CHECK(SameLines(config.root / "first", year));
+
+    StopCollector();
+    server.join();
+    RemoveTestStore();
+    return TestResult("testReconcile");
+}
@@ -0,0 +1,111 @@
+#include "test.h"
+#include "trackerArchive.h"
+#include "trackerImport.h"
+#include "trackerIndex.h"
+#include "trackerRollup.h"
+
+#include <fstream>
+#include <thread>
+
+
+// A restart resumes the last session: its line stays in the log until the
+// next flush replaces it, and the stores that counted it before the restart
+// neither count it twice nor miss what came after
+static std::vector<AppLogger> _notified;
+
+static void Record(const AppLogger& log)
+{
+    _notified.push_back(log);
+}
+
+static std::vector<AppLogger> ReadLog()
+{
+    std::vector<AppLogger> logs;
+    ImportLogFile(GetLogFilePath(), logs);
+    return logs;
+}
+
+static std::string ReadText()
+{
+    std::ifstream file(GetLogFilePath(), std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+int main()
+{
+    UseTestStore("resume");
+    long long now = Now();
+    std::vector<AppLogger> logs = SyntheticSessions(20, now - 15000, 2);
+    AppLogger& last = logs.back();
+    last.executable = "Code.exe";
+    last.title = "main.cpp - resume";
+    last.end = TimeFromSeconds(now - 10);
+    last.start = TimeFromSeconds(now - 70);
+    {
+        std::ofstream file(GetLogFilePath(), std::ios::app);
+        for (const auto& log : logs) {
+            file << GetLineStr(log);
+        }
+    }
+    uintmax_t size = std::filesystem::file_size(GetLogFilePath());
+    std::string head = ReadText().substr(0, size - GetLineStr(last).size());
+    long today = DayNumber(GetTime());
+    auto rollup = [&](DailyRollup& out) {
+        std::map<std::string, DailyRollup> day;
+        out = {};
+        return GetDailyRollup(today, day) && day.count("Code.exe") && (out = day["Code.exe"], true);
+    };
+    StartRollups();
+    StartTitleIndex();
+    AddSessionListener(Record);
+    DailyRollup before, after;
+    CHECK(rollup(before));
+
+    CHECK(!ResumeSession("Code.exe", "another title"));
+    CHECK(ResumeSession("Code.exe", "main.cpp - resume"));
+    // Nothing is cut: a crash now still finds the line
+    CHECK(std::filesystem::file_size(GetLogFilePath()) == size);
+    CHECK(ReadLog().size() == logs.size());
+
+    // Readers of the log and the buffer see the session once
+    size_t visited = 0, resumed = 0;
+    ForEachStoredSession(0, ~0ULL, [&](const AppLogger& log) {
+        visited++;
+        resumed += log.resumed;
+        return true;
+    });
+    CHECK(visited == logs.size() && resumed == 1);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    CHECK(ExtendEntry());
+    PrintToFile();
+
+    // The flush replaced the line with the longer one
+    std::vector<AppLogger> written = ReadLog();
+    CHECK(written.size() == logs.size());
+    CHECK(TimeKey(written.back().start) == TimeKey(last.start) && written.back().title == last.title);
+    CHECK(TimeSeconds(written.back().end) > now - 10);
+    // Rewritten from the resumed line on, everything before it untouched
+    std::string text = ReadText();
+    CHECK(text.compare(0, head.size(), head) == 0 && text.size() == head.size() + GetLineStr(written.back()).size());
+    CHECK(!std::filesystem::exists(GetLogFilePath().string() + ".tmp"));
+
+    // Listeners got it once, marked, and only what came after counts
+    CHECK(_notified.size() == 1 && _notified[0].resumed);
+    CHECK(TimeSeconds(_notified[0].resumedEnd) == now - 10);
+    CHECK(UnseenSeconds(_notified[0]) == TimeSeconds(written.back().end) - (now - 10));
+    CHECK(rollup(after));
+    CHECK(after.sessions == before.sessions);
+    CHECK(after.seconds == before.seconds + UnseenSeconds(_notified[0]));
+    std::vector<AppLogger> found = SearchTitles("resume", 0, 0);
+    CHECK(found.size() == 1 && TimeSeconds(found[0].end) == TimeSeconds(written.back().end));
+
+    // The next session is an ordinary one, appended
+    AddEntry("chrome.exe", "Inbox");
+    PrintToFile();
+    CHECK(ReadLog().size() == logs.size() + 1);
+    CHECK(_notified.size() == 2 && !_notified[1].resumed);
+
+    RemoveTestStore();
+    return TestResult("testResume");
+}
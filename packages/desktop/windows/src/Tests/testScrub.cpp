@@ -0,0 +1,137 @@
+#include "test.h"
+#include "checksum.h"
+#include "trackerArchive.h"
+#include "trackerScrub.h"
+
+#include <fstream>
+#include <set>
+
+
+// The CRC32C instructions against the table at every alignment and odd
+// lengths, then a scrub over archives with a damaged block: flagged, the file
+// quarantined, the sessions taken back from the backup log, and counted lost
+// once the backup no longer has them.
+static std::multiset<std::string> StoredSessions()
+{
+    std::multiset<std::string> lines;
+    ForEachStoredSession(0, ~0ULL, [&](const AppLogger& log) {
+        lines.insert(GetLineStr(log));
+        return true;
+    });
+    return lines;
+}
+
+static void Flip(const std::filesystem::path& path, uint64_t offset)
+{
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekg(offset);
+    char c;
+    file.read(&c, 1);
+    c ^= 0x10;
+    file.seekp(offset);
+    file.write(&c, 1);
+}
+
+// Damages a block in the middle of the archive and returns its sessions
+static std::vector<AppLogger> DamageBlock(const std::filesystem::path& path)
+{
+    ArchiveReader reader;
+    CHECK(OpenArchive(path, reader) && reader.blocks.size() > 2);
+    size_t block = reader.blocks.size() / 2;
+    std::vector<AppLogger> logs;
+    CHECK(ReadArchiveBlock(reader, block, logs));
+    Flip(path, reader.blocks[block].offset + reader.blocks[block].compressedSize / 2);
+    std::vector<AppLogger> none;
+    CHECK(!ReadArchiveBlock(reader, block, none) && none.empty());
+    return logs;
+}
+
+static size_t Quarantined(const std::filesystem::path& archive)
+{
+    size_t count = 0;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(archive.parent_path() / ARCHIVE_QUARANTINE_DIR, ec)) {
+        count += entry.path().filename().string().rfind(archive.stem().string() + ".", 0) == 0;
+    }
+    return count;
+}
+
+int main()
+{
+    std::string data(4096 + 64, '\0');
+    std::mt19937 rng(49);
+    for (char& c : data) {
+        c = (char)rng();
+    }
+    CHECK(Crc32c("123456789", 9) == 0xE3069283 && Crc32cTable("123456789", 9) == 0xE3069283);
+    bool same = true;
+    for (size_t offset = 0; offset < 16; offset++) {
+        for (size_t size = 0; size <= 300; size++) {
+            same = same && Crc32c(data.data() + offset, size) == Crc32cTable(data.data() + offset, size);
+        }
+        for (size_t size : {1021, 4093, 4096}) {
+            uint32_t whole = Crc32cTable(data.data() + offset, size);
+            // In pieces that leave the next one unaligned
+            uint32_t pieces = Crc32c(data.data() + offset, 7);
+            pieces = Crc32c(data.data() + offset + 7, 100, pieces);
+            pieces = Crc32c(data.data() + offset + 107, size - 107, pieces);
+            same = same && Crc32c(data.data() + offset, size) == whole && pieces == whole;
+        }
+    }
+    CHECK(same);
+    printf("  crc32c: %s\n", Crc32cImplementation());
+
+    std::filesystem::path store = UseTestStore("scrub");
+    std::vector<AppLogger> logs = SyntheticSessions(30000, Now() - 200 * 86400LL, 49);
+    {
+        std::ofstream file(GetLogFilePath(), std::ios::binary);
+        for (const auto& log : logs) {
+            file << GetLineStr(log);
+        }
+    }
+    CompactLogFile();
+    std::multiset<std::string> original = StoredSessions();
+    CHECK(original.size() == logs.size());
+    std::vector<std::filesystem::path> archives;
+    for (const auto& entry : std::filesystem::directory_iterator(store / "Archive")) {
+        if (entry.path().extension() == ".csa") {
+            archives.push_back(entry.path());
+        }
+    }
+    std::sort(archives.begin(), archives.end());
+    CHECK(archives.size() >= 3);
+
+    ScrubStats stats = {};
+    CHECK(ScrubArchives(stats, nullptr));
+    CHECK(stats.archives == archives.size() && stats.damaged == 0 && stats.upgraded == 0);
+
+    // A damaged block comes back whole from the backup the compaction left
+    std::vector<AppLogger> damaged = DamageBlock(archives[1]);
+    stats = {};
+    CHECK(ScrubArchives(stats, nullptr));
+    CHECK(stats.damaged == 1 && stats.recovered == damaged.size() && stats.lost == 0);
+    CHECK(Quarantined(archives[1]) == 1);
+    CHECK(StoredSessions() == original);
+    stats = {};
+    CHECK(ScrubArchives(stats, nullptr) && stats.damaged == 0);
+
+    // Without a backup holding them its sessions are counted lost
+    std::ofstream(GetLogFilePath().string() + ".bak", std::ios::trunc);
+    damaged = DamageBlock(archives[2]);
+    stats = {};
+    CHECK(ScrubArchives(stats, nullptr));
+    CHECK(stats.damaged == 1 && stats.recovered == 0 && stats.lost == damaged.size());
+    CHECK(Quarantined(archives[2]) == 1);
+    std::multiset<std::string> expected = original;
+    for (const auto& log : damaged) {
+        expected.erase(expected.find(GetLineStr(log)));
+    }
+    CHECK(StoredSessions() == expected);
+
+    // A pace that stops the pass ends it early
+    stats = {};
+    CHECK(!ScrubArchives(stats, [](size_t) { return true; }) && stats.blocks == 1);
+
+    RemoveTestStore();
+    return TestResult("testScrub");
+}
@@ -0,0 +1,40 @@
+#include "test.h"
+#include "trackerSettings.h"
+
+#include <fstream>
+
+
+// Tray toggles and numbers survive a restart: off or missing until set, each
+// kept on its own line, and a file edited by hand or cut short reads what it
+// still holds
+int main()
+{
+    std::filesystem::path store = UseTestStore("settings");
+    CHECK(!GetSetting(SETTING_INPUT_COUNTING) && !GetSetting(SETTING_VISIBLE_WINDOWS));
+
+    CHECK(SetSetting(SETTING_INPUT_COUNTING, true));
+    CHECK(GetSetting(SETTING_INPUT_COUNTING) && !GetSetting(SETTING_VISIBLE_WINDOWS));
+    CHECK(SetSetting(SETTING_VISIBLE_WINDOWS, true));
+    CHECK(SetSetting(SETTING_INPUT_COUNTING, false));
+    CHECK(!GetSetting(SETTING_INPUT_COUNTING) && GetSetting(SETTING_VISIBLE_WINDOWS));
+    CHECK(!std::filesystem::exists(store / (SETTINGS_FILE ".tmp")));
+
+    std::ofstream(store / SETTINGS_FILE, std::ios::app) << "garbage\r\ninput_counting ; 1\r\nvisible_win";
+    CHECK(GetSetting(SETTING_INPUT_COUNTING) && GetSetting(SETTING_VISIBLE_WINDOWS));
+    CHECK(SetSetting(SETTING_VISIBLE_WINDOWS, false));
+    std::ifstream file(store / SETTINGS_FILE);
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    CHECK(text == "input_counting ; 1\nvisible_windows ; 0\n");
+
+    // Numbers next to the toggles, a value that is not one reads as missing
+    CHECK(GetSettingNumber(SETTING_LAST_SCRUB, -1) == -1);
+    CHECK(SetSettingNumber(SETTING_LAST_SCRUB, 20123));
+    CHECK(GetSettingNumber(SETTING_LAST_SCRUB, -1) == 20123 && GetSetting(SETTING_INPUT_COUNTING));
+    std::ofstream(store / SETTINGS_FILE, std::ios::app) << "last_scrub ; soon\n";
+    CHECK(GetSettingNumber(SETTING_LAST_SCRUB, -1) == -1);
+    CHECK(SetSettingNumber(SETTING_LAST_SCRUB, 20130));
+    CHECK(GetSettingNumber(SETTING_LAST_SCRUB, -1) == 20130 && !GetSetting(SETTING_VISIBLE_WINDOWS));
+
+    RemoveTestStore();
+    return TestResult("testSettings");
+}
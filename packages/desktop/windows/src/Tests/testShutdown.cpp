@@ -0,0 +1,131 @@
+#include "test.h"
+#include "trackerImport.h"
+
+#include <atomic>
+#include <fstream>
+#include <map>
+#include <thread>
+
+#include <sys/wait.h>
+
+
+#define ROUNDS 16
+
+static std::atomic<bool> _hold_logger(false);
+
+// Listeners run under the logger lock, this one keeps it the way a long compaction would
+static void HoldLogger(const AppLogger&)
+{
+    while (_hold_logger) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+}
+
+static long WindowNumber(const std::string& title)
+{
+    return title.rfind("window ", 0) == 0 ? atol(title.c_str() + 7) : -1;
+}
+
+// A tracker thread opening a new window every few ticks and a saver flushing
+// under it, closed after ms while both are still running
+static void ShutdownRound(int ms)
+{
+    UseTestStore("shutdown");
+    std::atomic<bool> running(true);
+    std::atomic<long> added(-1);
+    std::thread tracker([&]() {
+        char title[32];
+        for (long n = 0; running; n++) {
+            snprintf(title, sizeof(title), "window %ld", n);
+            AddEntry("app.exe", title);
+            added = n;
+            for (int i = 0; i < 3; i++) {
+                ExtendEntry();
+            }
+        }
+    });
+    std::thread saver([&]() {
+        while (running) {
+            ProgSave();
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+            PrintToFile();
+        }
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    // Every window up to here was added before the close
+    long before = added;
+    CHECK(CloseLogger(1000));
+    uintmax_t size = std::filesystem::file_size(GetLogFilePath());
+    // The loops outlived the deadline: whatever they do now must not reach the log
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    running = false;
+    tracker.join();
+    saver.join();
+    CHECK(std::filesystem::file_size(GetLogFilePath()) == size);
+
+    std::vector<AppLogger> logs;
+    ImportStats stats = ImportLogFile(GetLogFilePath(), logs);
+    CHECK(stats.malformed == 0);
+    // A flush cuts the open session, the next tick goes on with the same
+    // window: a window may span lines, but only back to back and in order
+    std::map<long, int> seen;
+    long last = -1;
+    for (size_t i = 0; i < logs.size(); i++) {
+        long n = WindowNumber(logs[i].title);
+        CHECK(n >= last);
+        if (i > 0) {
+            CHECK(TimeKey(logs[i - 1].end) <= TimeKey(logs[i].start));
+        }
+        last = n;
+        seen[n]++;
+    }
+    for (long n = 0; n <= before; n++) {
+        CHECK(seen.count(n) == 1);
+    }
+    CHECK(last <= added);
+    RemoveTestStore();
+}
+
+// The final flush waits for the logger no longer than it was given
+static void BusyLoggerRound()
+{
+    UseTestStore("shutdown-busy");
+    AddSessionListener(HoldLogger);
+    AddEntry("app.exe", "window 0");
+    _hold_logger = true;
+    std::thread tracker([]() {
+        AddEntry("app.exe", "window 1");
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    Stopwatch watch;
+    CHECK(!CloseLogger(100));
+    CHECK(watch.Seconds() < 0.5);
+    _hold_logger = false;
+    tracker.join();
+    CHECK(CloseLogger(1000));
+    RemoveTestStore();
+}
+
+// The logger closes once per process, so each round runs in its own
+static bool InChild(const std::function<void()>& round)
+{
+    pid_t pid = fork();
+    if (pid == 0) {
+        round();
+        _exit(_test_failures == 0 ? 0 : 1);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+
+int main()
+{
+    for (int round = 0; round < ROUNDS; round++) {
+        CHECK(InChild([round]() { ShutdownRound(10 + round * 7); }));
+    }
+    CHECK(InChild(BusyLoggerRound));
+    return TestResult("testShutdown");
+}
@@ -0,0 +1,57 @@
+#include "test.h"
+#include "usageSketch.h"
+
+#include <fstream>
+#include <thread>
+
+
+// Sealed days are written once: closing sessions of today leaves their files
+// alone, and the shutdown save writes today only
+static std::filesystem::path SketchFile(const std::filesystem::path& store, long day)
+{
+    SYSTEMTIME st = TimeFromSeconds((long long)day * 86400);
+    char name[32];
+    snprintf(name, sizeof(name), "%04u-%02u-%02u.sk", st.wYear, st.wMonth, st.wDay);
+    return store / "Sketch" / name;
+}
+
+int main()
+{
+    std::filesystem::path store = UseTestStore("sketch");
+    long today = DayNumber(GetTime());
+    std::filesystem::create_directories(store / "Sketch");
+    for (long day = today - 3; day < today; day++) {
+        UsageSketch sketch;
+        for (const auto& log : SyntheticSessions(50, (long long)day * 86400, (unsigned)day)) {
+            AddToUsageSketch(sketch, log);
+        }
+        std::string data;
+        SerializeUsageSketch(sketch, data);
+        std::ofstream(SketchFile(store, day), std::ios::binary) << data;
+    }
+    StartUsageSketches();
+    CHECK(!TopApps(10, 4).empty());
+
+    // Missing files show which days were written again
+    for (long day = today - 3; day < today; day++) {
+        std::filesystem::remove(SketchFile(store, day));
+    }
+    for (int i = 0; i < 3; i++) {
+        AddEntry("Code.exe", ("main.cpp #" + std::to_string(i)).c_str());
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    }
+    PrintToFile();
+    for (long day = today - 3; day < today; day++) {
+        CHECK(!std::filesystem::exists(SketchFile(store, day)));
+    }
+    CHECK(!std::filesystem::exists(SketchFile(store, today)));
+
+    SaveUsageSketches();
+    CHECK(std::filesystem::exists(SketchFile(store, today)));
+    for (long day = today - 3; day < today; day++) {
+        CHECK(!std::filesystem::exists(SketchFile(store, day)));
+    }
+
+    RemoveTestStore();
+    return TestResult("testSketch");
+}
@@ -0,0 +1,84 @@
+#include "test.h"
+#include "trackerState.h"
+
+#include <atomic>
+#include <thread>
+
+
+// Readers pinning snapshots while the writer publishes as fast as it can.
+// Every field of a published state follows from its tick count and the title
+// is long enough to live on the heap, so a reader handed a state that was
+// being rewritten, or recycled under it, sees fields that disagree.
+static bool Consistent(const TrackerState& state)
+{
+    std::string title = "a window title long enough for the heap #" + std::to_string(state.ticks);
+    return state.hasSession && state.sessions == state.ticks * 3 && state.current.title == title &&
+           state.current.executable == (state.ticks % 2 ? "odd.exe" : "even.exe") && state.afk == (state.ticks % 5 == 0);
+}
+
+int main()
+{
+    const unsigned long long publishes = 200000;
+    std::atomic<bool> writing(true);
+    std::atomic<size_t> reads(0);
+    std::atomic<size_t> torn(0);
+    std::atomic<size_t> backwards(0);
+    TrackerStateView none;
+    CHECK(none.get() == nullptr);
+
+    auto reader = [&](int rounds) {
+        unsigned long long last = 0;
+        for (int round = 0; round < rounds && writing; round++) {
+            TrackerStateView view;
+            if (view.get() == nullptr) {
+                continue;
+            }
+            torn += !Consistent(*view.get());
+            backwards += view->ticks < last;
+            last = view->ticks;
+            // A nested view on the same thread pins nothing older
+            TrackerStateView nested;
+            torn += nested.get() == nullptr || !Consistent(*nested.get());
+            backwards += nested->ticks < view->ticks;
+            reads++;
+            // Hands the core back to the writer on a single-core machine
+            std::this_thread::yield();
+        }
+    };
+
+    // Long-lived readers, and short-lived ones whose slots are handed on
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 3; i++) {
+        readers.emplace_back(reader, 1 << 30);
+    }
+    std::thread churn([&]() {
+        while (writing) {
+            std::thread(reader, 100).join();
+        }
+    });
+
+    TrackerState state = {};
+    state.hasSession = true;
+    for (unsigned long long tick = 1; tick <= publishes; tick++) {
+        state.ticks = tick;
+        state.sessions = tick * 3;
+        state.current.title = "a window title long enough for the heap #" + std::to_string(tick);
+        state.current.executable = tick % 2 ? "odd.exe" : "even.exe";
+        state.afk = tick % 5 == 0;
+        PublishTrackerState(state);
+    }
+    writing = false;
+    for (auto& thread : readers) {
+        thread.join();
+    }
+    churn.join();
+
+    TrackerStateView last;
+    CHECK(last.get() != nullptr && last->ticks == publishes && Consistent(*last.get()));
+    CHECK(reads > 1000);
+    CHECK(torn == 0);
+    CHECK(backwards == 0);
+    printf("  %llu publishes, %zu reads, %zu torn, %zu older than the last read\n", publishes, reads.load(),
+           torn.load(), backwards.load());
+    return TestResult("testState");
+}
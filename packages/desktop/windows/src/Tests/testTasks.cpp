@@ -0,0 +1,126 @@
+#include "test.h"
+#include "trackerTasks.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+
+// Both attribution modes over a few hundred sessions and overlapping blocks,
+// against walking every second of every session through every block
+typedef struct {
+    std::string task;
+    std::string type;
+    long long start;
+    long long end;
+} Block;
+
+static std::map<std::string, TaskTime> BruteForce(const std::vector<AppLogger>& logs, const std::vector<Block>& blocks,
+                                                  const std::multimap<std::string, std::string>& rules, AttributionMode mode)
+{
+    std::map<std::string, TaskTime> totals;
+    // An empty block is never added
+    for (const auto& block : blocks) {
+        if (block.end <= block.start) {
+            continue;
+        }
+        TaskTime& total = totals[block.task];
+        total.task = block.task;
+        total.plannedSeconds += block.end - block.start;
+    }
+    auto allowed = [&](const Block& block, const std::string& executable) {
+        auto range = rules.equal_range(block.type);
+        if (range.first == range.second) {
+            return true;
+        }
+        for (auto it = range.first; it != range.second; it++) {
+            if (it->second == executable) {
+                return true;
+            }
+        }
+        return false;
+    };
+    for (const auto& log : logs) {
+        if (log.executable == "AFK") {
+            continue;
+        }
+        std::map<std::string, bool> credited;
+        for (long long t = TimeSeconds(log.start); t < TimeSeconds(log.end); t++) {
+            std::vector<const Block*> covering;
+            for (const auto& block : blocks) {
+                if (block.start <= t && t < block.end && allowed(block, log.executable)) {
+                    covering.push_back(&block);
+                }
+            }
+            for (const Block* block : covering) {
+                totals[block->task].seconds += mode == ATTRIBUTE_EACH ? 1.0 : 1.0 / covering.size();
+                credited[block->task] = true;
+            }
+        }
+        for (const auto& item : credited) {
+            totals[item.first].sessions++;
+        }
+    }
+    return totals;
+}
+
+int main()
+{
+    long long start = TimeSeconds({2024, 9, 0, 2, 8, 0, 0, 0});
+    std::vector<AppLogger> logs = SyntheticSessions(300, start, 11);
+    for (size_t i = 0; i < logs.size(); i += 7) {
+        logs[i].executable = "AFK";
+        logs[i].title = "Idle";
+    }
+    long long span = TimeSeconds(logs.back().end) - start;
+
+    // Random blocks, one nested in another, one repeated, one empty
+    std::mt19937 rng(11);
+    std::vector<Block> blocks;
+    for (int i = 0; i < 40; i++) {
+        long long from = start + rng() % span;
+        blocks.push_back({"task " + std::to_string(rng() % 12), "type " + std::to_string(rng() % 4), from,
+                          from + 60 + (long long)(rng() % 7200)});
+    }
+    blocks.push_back({"outer", "type 0", start + 1000, start + 9000});
+    blocks.push_back({"inner", "type 0", start + 2000, start + 3000});
+    blocks.push_back(blocks[5]);
+    blocks.push_back({"empty", "type 1", start + 5000, start + 5000});
+    std::multimap<std::string, std::string> rules = {{"type 2", "Code.exe"}, {"type 2", "Slack.exe"},
+                                                     {"type 3", "chrome.exe"}};
+
+    for (AttributionMode mode : {ATTRIBUTE_SHARED, ATTRIBUTE_EACH}) {
+        TaskAttribution attribution(mode);
+        for (const auto& block : blocks) {
+            attribution.AddBlock(block.task, block.type, block.start, block.end);
+        }
+        for (const auto& rule : rules) {
+            attribution.AddRule(rule.first, rule.second);
+        }
+        // In any order
+        std::vector<AppLogger> shuffled = logs;
+        std::shuffle(shuffled.begin(), shuffled.end(), rng);
+        for (const auto& log : shuffled) {
+            attribution.Add(log);
+        }
+        std::map<std::string, TaskTime> expected = BruteForce(logs, blocks, rules, mode);
+        std::vector<TaskTime> results = attribution.Results();
+        CHECK(results.size() == expected.size());
+        double total = 0;
+        for (const auto& result : results) {
+            const TaskTime& e = expected[result.task];
+            total += result.seconds;
+            if (std::fabs(result.seconds - e.seconds) > 1e-6 || result.plannedSeconds != e.plannedSeconds ||
+                result.sessions != e.sessions) {
+                printf("  %s %s: %.3f s in %zu sessions, expected %.3f s in %zu\n",
+                       mode == ATTRIBUTE_SHARED ? "shared" : "each", result.task.c_str(), result.seconds,
+                       result.sessions, e.seconds, e.sessions);
+                CHECK(false);
+            }
+        }
+        CHECK(total > 0);
+        CHECK(std::is_sorted(results.begin(), results.end(),
+                             [](const TaskTime& a, const TaskTime& b) { return a.seconds > b.seconds; }));
+    }
+    return TestResult("testTasks");
+}
@@ -0,0 +1,204 @@
+#include "test.h"
+#include "fakes.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+
+struct Desk {
+    long long seconds = TimeSeconds({2024, 5, 0, 6, 9, 0, 0, 0});
+    std::string executable = "Code.exe";
+    std::string title = "main.cpp - Visual Studio Code";
+    bool afk = false;
+    int wakes = 0;
+    int closed = 0;
+    std::vector<AppLogger> log;
+    std::vector<AppLogger> spare;
+    Sessionizer<FakeClock> sessionizer{log, spare, FakeClock{&seconds}};
+
+    Tracker<FakeClock, FakeWindow, FakeIdle, FakeSink> tracker{
+        FakeClock{&seconds}, FakeWindow{&executable, &title}, FakeIdle{&afk, &wakes}, FakeSink{&sessionizer, &closed}};
+
+    DWORD Tick()
+    {
+        DWORD delay = tracker.Tick();
+        seconds += delay / 1000;
+        return delay;
+    }
+};
+
+static void TestSessions()
+{
+    Desk desk;
+    // Starts as if just unlocked: the first tick only wakes the idle source
+    CHECK(desk.Tick() == 1000);
+    CHECK(desk.wakes == 1 && desk.log.empty());
+    for (int i = 0; i < 10; i++) {
+        CHECK(desk.Tick() == 1000);
+    }
+    CHECK(desk.log.size() == 1 && desk.closed == 0);
+    CHECK(desk.log[0].title == "main.cpp - Visual Studio Code");
+    CHECK(TimeSeconds(desk.log[0].end) - TimeSeconds(desk.log[0].start) == 9);
+
+    desk.title = "util.cpp - Visual Studio Code";
+    desk.Tick();
+    CHECK(desk.log.size() == 2 && desk.closed == 1);
+    // The closed session ends where the next one starts
+    CHECK(TimeKey(desk.log[0].end) == TimeKey(desk.log[1].start));
+
+    desk.afk = true;
+    CHECK(desk.Tick() == 10000);
+    CHECK(desk.tracker.IsAFK() && desk.log.back().executable == "AFK" && desk.log.back().title == "AFK");
+    desk.Tick();
+    CHECK(desk.log.size() == 3);
+
+    desk.afk = false;
+    int wakes = desk.wakes;
+    desk.Tick();
+    CHECK(desk.wakes == wakes + 1 && !desk.tracker.IsAFK());
+    desk.Tick();
+    CHECK(desk.log.size() == 4 && desk.log.back().title == "util.cpp - Visual Studio Code");
+
+    desk.executable = "LockApp.exe";
+    desk.Tick();
+    CHECK(desk.tracker.IsLocked() && desk.log.back().title == "Lock");
+    // Locked beats AFK, idling behind the lock screen stays one session
+    desk.afk = true;
+    desk.Tick();
+    CHECK(desk.log.back().title == "Lock" && desk.log.size() == 5);
+}
+
+static void TestSpareRecords()
+{
+    Desk desk;
+    desk.Tick();
+    for (int i = 0; i < 100; i++) {
+        if (desk.log.size() > 4) {
+            // What a flush does: written records go back as spares
+            for (auto& log : desk.log) {
+                desk.spare.push_back(std::move(log));
+            }
+            desk.log.clear();
+        }
+        desk.title = "page " + std::to_string(i);
+        desk.Tick();
+    }
+    CHECK(desk.log.size() + desk.spare.size() <= 5);
+    CHECK(desk.log.back().title == "page 99");
+    CHECK(desk.log.back().resources.cpuMs == 0 && desk.log.back().input.keys == 0);
+}
+
+// Random samples against a map of what was on screen: the transitions, the
+// sessions closed with their start times, and the order the sample is left in
+static void TestVisibleSet()
+{
+    long long seconds = TimeSeconds({2024, 5, 0, 6, 9, 0, 0, 0});
+    std::vector<AppLogger> closed;
+    VisibleSet<FakeClock, FakeWindowNames> set(closed, FakeClock{&seconds});
+    std::mt19937 rng(7);
+    std::vector<VisibleSample> screen, last;
+    std::map<HWND, std::pair<bool, long long>> expected; // minimized, session start
+    bool same = true;
+    for (int step = 0; step < 5000 && same; step++) {
+        seconds++;
+        // Handles share their upper bytes, so some radix passes have nothing to move
+        for (int changes = rng() % 4; changes > 0; changes--) {
+            switch (rng() % 5) {
+            case 0:
+                screen.insert(screen.begin() + rng() % (screen.size() + 1),
+                              {(HWND)(uintptr_t)(0x20000 + rng() % 0x400 * 4), rng() % 4 == 0});
+                break;
+            case 1:
+                if (!screen.empty()) {
+                    screen.erase(screen.begin() + rng() % screen.size());
+                }
+                break;
+            case 2:
+                if (!screen.empty()) {
+                    screen[rng() % screen.size()].minimized ^= true;
+                }
+                break;
+            default:
+                if (screen.size() > 1) {
+                    std::swap(screen[rng() % screen.size()], screen[rng() % screen.size()]);
+                }
+            }
+        }
+        // A window appears once on screen
+        std::set<HWND> seen;
+        screen.erase(std::remove_if(screen.begin(), screen.end(),
+                                    [&](const VisibleSample& s) { return !seen.insert(s.hwnd).second; }),
+                     screen.end());
+
+        size_t transitions = 0;
+        std::vector<long long> starts;
+        std::map<HWND, std::pair<bool, long long>> next;
+        for (const auto& window : screen) {
+            auto it = expected.find(window.hwnd);
+            auto& state = next[window.hwnd];
+            if (it == expected.end()) {
+                state = {window.minimized, seconds};
+                transitions++;
+            } else if (it->second.first != window.minimized) {
+                state = {window.minimized, seconds};
+                transitions++;
+                if (window.minimized) {
+                    starts.push_back(it->second.second);
+                }
+            } else {
+                state = it->second;
+            }
+        }
+        for (const auto& item : expected) {
+            if (!next.count(item.first)) {
+                transitions++;
+                if (!item.second.first) {
+                    starts.push_back(item.second.second);
+                }
+            }
+        }
+        expected.swap(next);
+
+        std::vector<VisibleSample> sample = screen;
+        bool unchanged = sample.size() == last.size() &&
+                         std::equal(sample.begin(), sample.end(), last.begin(), [](const auto& a, const auto& b) {
+                             return a.hwnd == b.hwnd && a.minimized == b.minimized;
+                         });
+        last = screen;
+        size_t from = closed.size();
+        same = set.Update(sample) == transitions && closed.size() - from == starts.size();
+        std::vector<long long> got;
+        for (size_t i = from; i < closed.size(); i++) {
+            same = same && TimeSeconds(closed[i].end) == seconds;
+            got.push_back(TimeSeconds(closed[i].start));
+        }
+        std::sort(got.begin(), got.end());
+        std::sort(starts.begin(), starts.end());
+        same = same && got == starts;
+        same = same && (unchanged ? std::equal(sample.begin(), sample.end(), screen.begin(),
+                                               [](const auto& a, const auto& b) { return a.hwnd == b.hwnd; })
+                                  : std::is_sorted(sample.begin(), sample.end(), [](const auto& a, const auto& b) {
+                                        return (uintptr_t)a.hwnd < (uintptr_t)b.hwnd;
+                                    }));
+        if (!same) {
+            printf("  visible set differs at sample %d\n", step);
+        }
+    }
+    CHECK(same);
+
+    // Clearing ends what is still on screen
+    size_t visible = std::count_if(expected.begin(), expected.end(), [](const auto& item) { return !item.second.first; });
+    size_t from = closed.size();
+    set.Clear();
+    CHECK(closed.size() - from == visible);
+}
+
+
+int main()
+{
+    TestSessions();
+    TestSpareRecords();
+    TestVisibleSet();
+    return TestResult("testTracker");
+}
@@ -0,0 +1,117 @@
+#include "test.h"
+#include "utfConvert.h"
+
+#include <cstring>
+
+#include <iconv.h>
+
+
+// Randomized differential fuzz of the transcoder against a plain scalar
+// encoder, and against iconv for well-formed input. Inputs mix every code
+// unit class in runs, so the vector blocks see ASCII, 2-byte, 3-byte and
+// surrogate units at every offset.
+
+static inline bool IsHigh(uint16_t c) { return c >= 0xD800 && c < 0xDC00; }
+static inline bool IsLow(uint16_t c) { return c >= 0xDC00 && c < 0xE000; }
+
+static std::string Reference(const std::vector<uint16_t>& in)
+{
+    std::string out;
+    for (size_t i = 0; i < in.size(); i++) {
+        uint32_t c = in[i];
+        if (IsHigh(in[i]) && i + 1 < in.size() && IsLow(in[i + 1])) {
+            c = 0x10000 + ((c - 0xD800) << 10) + (in[++i] - 0xDC00);
+        } else if (IsHigh(in[i]) || IsLow(in[i])) {
+            c = 0xFFFD;
+        }
+        if (c < 0x80) {
+            out += (char)c;
+        } else if (c < 0x800) {
+            out += (char)(0xC0 | c >> 6);
+            out += (char)(0x80 | (c & 0x3F));
+        } else if (c < 0x10000) {
+            out += (char)(0xE0 | c >> 12);
+            out += (char)(0x80 | ((c >> 6) & 0x3F));
+            out += (char)(0x80 | (c & 0x3F));
+        } else {
+            out += (char)(0xF0 | c >> 18);
+            out += (char)(0x80 | ((c >> 12) & 0x3F));
+            out += (char)(0x80 | ((c >> 6) & 0x3F));
+            out += (char)(0x80 | (c & 0x3F));
+        }
+    }
+    return out;
+}
+
+static bool ReferenceValid(const std::vector<uint16_t>& in)
+{
+    for (size_t i = 0; i < in.size(); i++) {
+        if (IsLow(in[i]) || (IsHigh(in[i]) && (i + 1 == in.size() || !IsLow(in[++i])))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static std::string Iconv(const std::vector<uint16_t>& in)
+{
+    iconv_t cd = iconv_open("UTF-8", "UTF-16LE");
+    char* src = (char*)in.data();
+    size_t srcLeft = in.size() * 2;
+    std::string out(in.size() * 4, '\0');
+    char* dst = out.data();
+    size_t dstLeft = out.size();
+    iconv(cd, &src, &srcLeft, &dst, &dstLeft);
+    iconv_close(cd);
+    out.resize(out.size() - dstLeft);
+    return out;
+}
+
+static uint16_t Unit(std::mt19937& rng, unsigned kind)
+{
+    switch (kind) {
+    case 0:
+        return rng() % 0x80;
+    case 1:
+        return 0x80 + rng() % 0x780;
+    case 2:
+        return 0x800 + rng() % (0xD800 - 0x800);
+    case 3:
+        return 0xD800 + rng() % 0x800; // Lone, either half
+    case 4:
+        return 0xE000 + rng() % 0x2000;
+    default:
+        return (uint16_t)rng();
+    }
+}
+
+int main()
+{
+    std::mt19937 rng(1);
+    size_t cases = 300000, invalid = 0;
+    for (size_t n = 0; n < cases && _test_failures == 0; n++) {
+        std::vector<uint16_t> in(rng() % 80);
+        unsigned mode = rng() % 6;
+        for (size_t i = 0; i < in.size(); i++) {
+            in[i] = Unit(rng, mode == 5 || rng() % 4 == 0 ? rng() % 6 : mode);
+            if (rng() % 16 == 0 && i + 1 < in.size()) {
+                in[i] = 0xD800 + rng() % 0x400;
+                in[++i] = 0xDC00 + rng() % 0x400;
+            }
+        }
+        // Exactly the documented capacity, a sanitizer build catches overruns
+        std::vector<char> out(std::max<size_t>(1, UTF8_CAPACITY(in.size())));
+        std::string expected = Reference(in);
+        CHECK(std::string(out.data(), Utf16ToUtf8(in.data(), in.size(), out.data())) == expected);
+        bool valid = ReferenceValid(in);
+        CHECK(IsValidUtf16(in.data(), in.size()) == valid);
+        if (valid) {
+            CHECK(Iconv(in) == expected);
+        } else {
+            invalid++;
+        }
+    }
+    printf("  %zu cases, %zu with unpaired surrogates\n", cases, invalid);
+    CHECK(invalid > cases / 10 && invalid < cases * 9 / 10);
+    return TestResult("testUtf");
+}
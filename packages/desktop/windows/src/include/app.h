@@ -6,9 +6,12 @@
 #endif // _DEBUG
 
 #include "tracker.h"
+#include "trackerPipeline.hpp"
 
 void TrackerLoop();
 void SaveToFileLoop();
+// Verifies the archives every SCRUB_INTERVAL_DAYS in background mode
+void ScrubLoop();
 
 #ifdef _DEBUG
 void MessageLoop();
@@ -20,5 +23,7 @@ bool IsCaffeine();
 
 void Stop();
 bool IsRunning();
+// Sleep up to ms, returning early with true once Stop() is called
+bool WaitForStop(DWORD ms);
 
 #endif // APP_H
\ No newline at end of file
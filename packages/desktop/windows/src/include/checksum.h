@@ -0,0 +1,17 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <cstddef>
+#include <cstdint>
+
+// CRC32C (Castagnoli), as used by iSCSI, ext4 and most storage formats. Pass
+// the value returned for the preceding bytes as crc to checksum a buffer in
+// pieces. Uses the SSE4.2 or ARMv8 CRC instructions when the CPU has them,
+// checked once at startup, and a slicing-by-8 table otherwise.
+uint32_t Crc32c(const void* data, size_t size, uint32_t crc = 0);
+// The table version, for CPUs without the instructions
+uint32_t Crc32cTable(const void* data, size_t size, uint32_t crc = 0);
+// "sse4.2", "armv8" or "table"
+const char* Crc32cImplementation();
+
+#endif // CHECKSUM_H
@@ -0,0 +1,61 @@
+#ifndef COLLECTOR_H
+#define COLLECTOR_H
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+
+#include "trackerDigest.h"
+
+#define COLLECTOR_SOCKET_NAME "chronosync-collector.sock"
+#define COLLECTOR_SHARDS 256
+#define COLLECTOR_MAX_USER 64
+#define COLLECTOR_MAX_BATCH 4096        // Lines per client batch
+#define COLLECTOR_MAX_PAYLOAD (8 << 20) // Bytes per client batch
+#define COLLECTOR_OPEN_FILES 64         // Cached partition handles per shard
+#define COLLECTOR_FORWARD_RECORDS 8192  // Records per consolidated upstream batch
+#define COLLECTOR_FORWARD_MS 1000       // Oldest a partial upstream batch may get
+
+typedef struct {
+    std::filesystem::path socket;
+    std::filesystem::path root;     // Partitions go to root/<user>/YYYY-MM-DD.txt
+    std::filesystem::path upstream; // Another collector's socket, empty to only persist
+    unsigned workers;               // 0 for one per core
+    unsigned ioThreads;             // 0 for one per four cores
+} CollectorConfig;
+
+typedef struct {
+    ReconcileStats reconcile;
+    size_t bytesSent;
+    size_t bytesReceived;
+} CollectorReconcileStats;
+
+typedef struct {
+    size_t connections;
+    size_t batches;
+    size_t records;
+    size_t malformed;
+    size_t forwarded;
+    size_t spooled;
+    size_t steals;
+} CollectorStats;
+
+// Clients send
+//   BATCH <user> <count>\n followed by <count> log lines (GetLineStr format)
+// and get "OK <count> <accepted>\n" once the shard owning <user> has written
+// them to its partitions, or "ERROR <reason>\n" before the connection closes.
+// A line a partition already holds counts as accepted and is not written again.
+// Users hash onto COLLECTOR_SHARDS shards, a shard runs on one worker at a
+// time so each user's records stay in order.
+int RunCollector(const CollectorConfig& config);
+// Async-signal-safe, RunCollector drains and returns
+void StopCollector();
+CollectorStats GetCollectorStats();
+
+// Client side of "DIGEST <user> <count>" (count node paths, the root is an
+// empty line): walks the Merkle tree one level per round trip and uploads
+// only the sessions under subtrees whose digests differ
+bool ReconcileWithCollector(const std::filesystem::path& socket, const std::string& user, const DigestTree& local,
+                            CollectorReconcileStats& stats);
+
+#endif // COLLECTOR_H
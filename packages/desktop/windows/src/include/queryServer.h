@@ -0,0 +1,46 @@
+#ifndef QUERY_SERVER_H
+#define QUERY_SERVER_H
+
+#include "trackerLogger.h"
+
+#ifdef _WIN32
+#define QUERY_PIPE_NAME "\\\\.\\pipe\\ChronoSync"
+#else
+#define QUERY_SOCKET_NAME "chronosync.sock"
+#define QUERY_SOCKET_FALLBACK "/tmp/chronosync-" // + uid, when XDG_RUNTIME_DIR is not set
+#endif // _WIN32
+
+#include <string>
+
+// Line-based request/response protocol, each response ends with an empty line:
+//   CURRENT                 -> the open session as a log line
+//   TOP <n>                 -> "executable ; seconds" for today, longest first
+//   RANGE <from> <to> [n]   -> "executable ; seconds ; sessions" for the whole days from
+//                              <from> to <to> (YYYYMMDDhhmmss), seconds split at midnight,
+//                              sessions counted on the day they start: the rollups for the
+//                              days they keep, the archive blocks of those days and the
+//                              start of the text log for older ones
+//   APPS <days> [n]         -> "executable ; seconds ; error" from the heavy-hitter sketches
+//   TITLES <days> [n]       -> "title ; seconds ; error" from the heavy-hitter sketches
+//   SEARCH [from to] <q>    -> matching sessions as log lines, newest first (see IndexQuery)
+//   HEATMAP <days> [exe]    -> per weekday from Sunday, "weekday ; minutes per hour 0..23" for
+//                              active time or one executable, from the activity bitmaps
+//   TASKS <from> <to> [EACH] -> "task ; seconds ; planned seconds ; sessions" for the task
+//                              blocks, time shared between overlapping ones unless EACH
+//   GOVERNOR                -> "mode load", the self-overhead governor state
+//   EXPORT <from> <to>      -> sessions starting in [from, to] as an Arrow IPC stream, then
+//                              the connection closes (see ExportArrow)
+//   JSON <from> <to> <device> -> the same sessions as upload payloads for the backend, one
+//                              per line, then the connection closes (see ExportJson)
+//   SUBSCRIBE               -> the open session again on every session change, until closed
+// A connection past the cap on open ones gets "ERROR busy" and is closed.
+// Serves the current user only: the pipe carries a DACL for the user and
+// cannot be created while another process owns the name, the socket is 0600
+// in a 0700 directory
+void QueryServerLoop();
+void StopQueryServer();
+#ifndef _WIN32
+std::string QuerySocketPath();
+#endif // _WIN32
+
+#endif // QUERY_SERVER_H
@@ -4,6 +4,19 @@
 #include "trackerWindow.h"
 #include "trackerAFK.h"
 #include "trackerLogger.h"
+#include "trackerArchive.h"
 #include "trackerDevice.h"
+#include "trackerTime.h"
+#include "trackerState.h"
+#include "trackerGovernor.h"
+#include "trackerRollup.h"
+#include "trackerIndex.h"
+#include "trackerActivity.h"
+#include "trackerVisible.h"
+#include "trackerResources.h"
+#include "trackerInput.h"
+#include "trackerLimits.h"
+#include "trackerScrub.h"
+#include "trackerSettings.h"
 
 #endif // TRACKER_H
\ No newline at end of file
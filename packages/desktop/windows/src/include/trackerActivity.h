@@ -0,0 +1,73 @@
+#ifndef TRACKER_ACTIVITY_H
+#define TRACKER_ACTIVITY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "trackerLogger.h"
+
+#define ACTIVITY_MINUTES 1440
+#define ACTIVITY_WORDS 24 // 1440 bits, padded to whole 32-byte lanes
+#define ACTIVITY_FILE "activity.bin"
+#define ACTIVITY_MAX_APPS 100 // Per-executable series kept on save, the most active ones
+
+// Series keys for the user-level states. '*' never appears in a Windows file
+// name, so these cannot collide with the per-executable series.
+#define ACTIVITY_ACTIVE "*active"
+#define ACTIVITY_AFK "*afk"
+#define ACTIVITY_LOCKED "*locked"
+
+// One bit per minute of the day, bit m of the day is minute m after midnight
+typedef struct alignas(32) {
+    uint64_t words[ACTIVITY_WORDS];
+} DayBitmap;
+
+// Sets minutes [from, to], both within the day
+void MarkMinutes(DayBitmap& map, unsigned from, unsigned to);
+unsigned CountMinutes(const DayBitmap& map);
+unsigned CountMinutesAnd(const DayBitmap& a, const DayBitmap& b);
+unsigned CountMinutesOr(const DayBitmap& a, const DayBitmap& b);
+// Minutes set within each hour of the day
+void CountHours(const DayBitmap& map, unsigned out[24]);
+
+// The days one series was seen on, sorted, bitmaps stored back to back so
+// range queries walk contiguous memory
+class ActivitySeries {
+public:
+    void Mark(long day, unsigned from, unsigned to);
+    // ORs in every day of other
+    void Merge(const ActivitySeries& other);
+    // Index of the first stored day at or after day
+    size_t Find(long day) const;
+
+    size_t Size() const { return _days.size(); }
+    long Day(size_t i) const { return _days[i]; }
+    const DayBitmap& Bitmap(size_t i) const { return _maps[i]; }
+
+    void Serialize(std::string& out) const;
+    bool Deserialize(const char*& p, const char* end);
+
+private:
+    std::vector<long> _days; // DayNumber
+    std::vector<DayBitmap> _maps;
+};
+
+// Series for ACTIVITY_ACTIVE, ACTIVITY_AFK, ACTIVITY_LOCKED and every
+// executable, updated as sessions close and saved to Cache/activity.bin.
+// Saving keeps the ACTIVITY_MAX_APPS executables with the most minutes.
+// Starting reads only the file header and the log past its checkpoint, the
+// series themselves load on the first query or save.
+void StartActivity();
+void SaveActivity();
+
+// Day bounds are DayNumber values, inclusive. Weekdays start on Sunday.
+// Active minutes for every day in [from, to], for calendar heatmaps
+std::vector<unsigned> ActivityByDay(const std::string& key, long from, long to);
+void ActivityByWeekday(const std::string& key, long from, long to, unsigned long long out[7]);
+void ActivityByHour(const std::string& key, long from, long to, unsigned long long out[7][24]);
+// Minutes where both series, or either series, were set
+unsigned long long ActivityOverlap(const std::string& a, const std::string& b, long from, long to);
+unsigned long long ActivityUnion(const std::string& a, const std::string& b, long from, long to);
+
+#endif // TRACKER_ACTIVITY_H
@@ -0,0 +1,90 @@
+#ifndef TRACKER_ARCHIVE_H
+#define TRACKER_ARCHIVE_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+#include "trackerLogger.h"
+
+#define ARCHIVE_AFTER_DAYS 30
+#define ARCHIVE_BLOCK_SIZE (32 * 1024)
+#define ARCHIVE_DICT_SIZE (16 * 1024)
+#define ARCHIVE_QUARANTINE_DIR "Quarantine" // Under Archive, copies of damaged archives
+
+typedef struct {
+    uint64_t offset;
+    uint32_t compressedSize;
+    uint32_t rawSize;
+    uint32_t records;
+    uint64_t firstStart; // TimeKey of the first session
+    uint64_t lastEnd;    // TimeKey of the last session
+    uint32_t crc;        // CRC32C of the compressed bytes
+} ArchiveBlock;
+
+typedef struct {
+    std::filesystem::path path;
+    std::string dict;
+    std::vector<ArchiveBlock> blocks;
+    // Version 1 archives carry no checksums, their blocks are only checked
+    // by decompressing them
+    bool checksums;
+} ArchiveReader;
+
+typedef struct {
+    size_t records;
+    size_t blocks;
+    size_t rawBytes;
+    size_t compressedBytes;
+} ArchiveStats;
+
+typedef struct {
+    size_t damaged;   // Blocks that failed their check
+    size_t recovered; // Sessions of those blocks found again in the backup log
+    size_t lost;      // Sessions of those blocks found nowhere
+} ArchiveRepair;
+
+// Build a dictionary from the most repeated title and executable fragments
+std::string TrainArchiveDict(const std::vector<AppLogger>& logs, size_t maxSize = ARCHIVE_DICT_SIZE);
+
+void CompressArchiveBlock(const std::string& dict, const char* src, size_t size, std::string& out);
+bool DecompressArchiveBlock(const std::string& dict, const char* src, size_t size, size_t rawSize, std::string& out);
+
+// Every block decompresses on its own with the shared dictionary. The
+// dictionary, the index and every block carry a CRC32C.
+ArchiveStats WriteArchive(const std::filesystem::path& path, const std::vector<AppLogger>& logs);
+// Fails when the dictionary or the index does not match its checksum
+bool OpenArchive(const std::filesystem::path& path, ArchiveReader& reader);
+// Fails on a block that does not match its checksum, nothing is appended then
+bool ReadArchiveBlock(const ArchiveReader& reader, size_t block, std::vector<AppLogger>& out);
+// Checks a block without decoding its sessions, returns the bytes read so
+// callers can pace themselves
+size_t VerifyArchiveBlock(const ArchiveReader& reader, size_t block, bool& intact);
+// Decompress only the blocks overlapping [from, to] (TimeKey values)
+size_t ReadArchiveRange(const ArchiveReader& reader, uint64_t from, uint64_t to, std::vector<AppLogger>& out);
+
+// Checks the archive again under the compaction lock and rewrites it without
+// its damaged blocks. Their sessions are taken back from the text log's
+// backup, which holds what the last compaction moved, unless the log itself
+// still holds them for the next one. The damaged file is first copied to
+// ARCHIVE_QUARANTINE_DIR. With a damaged dictionary or index the whole month
+// is taken from the backup, and the file is left alone when it has none of it.
+// An intact version 1 archive is rewritten with checksums.
+ArchiveRepair RepairArchive(const std::filesystem::path& path);
+
+// Visits the sessions starting within [from, to] (TimeKey values) in time
+// order until visit returns false: the archives a block at a time, then the
+// text log a line at a time, then the sessions still buffered. Returns false
+// when visit stopped it.
+bool ForEachStoredSession(ULONGLONG from, ULONGLONG to, const std::function<bool(const AppLogger&)>& visit);
+
+// Move sessions older than ARCHIVE_AFTER_DAYS from the text log to monthly
+// archives. A month whose archive has a damaged block is left in the text
+// log until the scrubber has repaired it, sessions an archive already holds
+// are not added twice. Runs beside the tracker, sessions flushed meanwhile
+// stay in the log; lines that do not parse stay there too.
+int CompactLogFile();
+
+#endif // TRACKER_ARCHIVE_H
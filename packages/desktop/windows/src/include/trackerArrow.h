@@ -0,0 +1,32 @@
+#ifndef TRACKER_ARROW_H
+#define TRACKER_ARROW_H
+
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+
+#include "trackerLogger.h"
+
+#define ARROW_BATCH_ROWS 16384
+
+typedef struct {
+    size_t rows;
+    size_t batches;
+    size_t dictionaryBatches;
+    size_t bytes;
+} ArrowExportStats;
+
+// Receives the stream piece by piece, returning false stops the export
+typedef std::function<bool(const char* data, size_t size)> ArrowSink;
+
+// Writes the sessions starting within [from, to] (TimeKey values) as an Arrow
+// IPC stream with four columns: start and end as timestamp[s] of the local
+// wall clock, executable and title as dictionary<int32, utf8>. Archives are
+// read a block at a time, then the text log a line at a time, then the
+// sessions still buffered, and at most batchRows rows are held at once.
+// Dictionary entries go out as delta batches just before the first record
+// batch using them, so only the distinct values are kept.
+ArrowExportStats ExportArrow(ULONGLONG from, ULONGLONG to, const ArrowSink& sink, size_t batchRows = ARROW_BATCH_ROWS);
+ArrowExportStats ExportArrowFile(const std::filesystem::path& path, ULONGLONG from, ULONGLONG to, size_t batchRows = ARROW_BATCH_ROWS);
+
+#endif // TRACKER_ARROW_H
@@ -0,0 +1,69 @@
+#ifndef TRACKER_DIGEST_H
+#define TRACKER_DIGEST_H
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "trackerLogger.h"
+
+#define DIGEST_BLOCK_SESSIONS 16
+
+// Node paths, one level per storage unit:
+//   ""                root, its children are the monthly partitions
+//   2026-10           partition
+//   2026-10-19        day
+//   2026-10-19T10     hour
+//   2026-10-19T10#3   block of DIGEST_BLOCK_SESSIONS sessions, by start time
+typedef struct {
+    std::string path;
+    uint64_t digest;
+} DigestEntry;
+
+uint64_t HashBytes(const char* data, size_t size, uint64_t seed = 0);
+
+// Merkle tree over a set of sessions. Duplicates collapse, so two stores that
+// hold the same sessions in any order and multiplicity get the same digests.
+class DigestTree {
+public:
+    void Build(const std::vector<AppLogger>& sessions);
+    // Rebuilds one day (YYYY-MM-DD) from its sessions, the rest of the tree is
+    // only shifted, so the digests match a Build over everything
+    void ReplaceDay(const std::string& day, const std::vector<AppLogger>& sessions);
+
+    bool Children(const std::string& path, std::vector<DigestEntry>& out) const;
+    // Every session under path, as log lines
+    void Lines(const std::string& path, std::vector<std::string>& out) const;
+    uint64_t Root() const { return _root; }
+    size_t Sessions() const { return _lines.size(); }
+
+private:
+    typedef struct {
+        size_t first;
+        size_t count;
+    } Range;
+
+    void BuildDay(size_t first, size_t last, std::vector<DigestEntry>& hours);
+
+    std::vector<std::string> _lines; // Sorted, unique
+    std::map<std::string, std::vector<DigestEntry>> _children;
+    std::map<std::string, Range> _ranges;
+    uint64_t _root = 0;
+};
+
+typedef struct {
+    size_t roundTrips;
+    size_t nodesCompared;
+    size_t sessionsSent;
+} ReconcileStats;
+
+// fetch gets the peer's children for a whole level of paths in one round trip
+// (absent nodes come back empty), send gets the local lines the peer lacks.
+// Takes at most one round trip per tree level.
+typedef std::function<bool(const std::vector<std::string>& paths, std::vector<std::vector<DigestEntry>>& children)> DigestFetch;
+typedef std::function<bool(const std::vector<std::string>& lines)> DigestSend;
+bool Reconcile(const DigestTree& local, const DigestFetch& fetch, const DigestSend& send, ReconcileStats& stats);
+
+#endif // TRACKER_DIGEST_H
@@ -0,0 +1,73 @@
+#ifndef TRACKER_GOVERNOR_H
+#define TRACKER_GOVERNOR_H
+
+#define GOVERNOR_INTERVAL 10000 // ms between samples of our own usage
+#define GOVERNOR_RESTORE_INTERVALS 6 // Quiet intervals before stepping back up
+
+typedef enum {
+    GOVERNOR_NORMAL,
+    GOVERNOR_REDUCED, // Slower ticks, throttled probes, maintenance deferred
+    GOVERNOR_MINIMAL  // Slowest ticks, no optional probes
+} GovernorMode;
+
+// What the tracker may spend, per second of wall time
+typedef struct {
+    double cpuPercent; // Of one core
+    double wakeupsPerSecond;
+    double ioBytesPerSecond;
+} GovernorBudget;
+
+// Cumulative counters for the whole process
+typedef struct {
+    double cpuSeconds;
+    unsigned long long wakeups;
+    unsigned long long ioBytes;
+} GovernorUsage;
+
+// Steps down one mode per interval over budget, and back up one mode after
+// GOVERNOR_RESTORE_INTERVALS in a row under half the budget, so a single
+// burst or a single quiet interval does not make it flap
+class Governor {
+public:
+    explicit Governor(const GovernorBudget& budget);
+
+    // usage is cumulative, elapsedMs the wall time since the previous sample
+    GovernorMode Update(const GovernorUsage& usage, unsigned long elapsedMs);
+
+    GovernorMode Mode() const { return _mode; }
+    // Highest usage/budget ratio of the last interval, 1.0 is at budget
+    double Load() const { return _load; }
+
+private:
+    GovernorBudget _budget;
+    GovernorUsage _last;
+    bool _primed;
+    unsigned _quiet;
+    double _load;
+    GovernorMode _mode;
+};
+
+GovernorBudget DefaultGovernorBudget();
+const char* GovernorModeName(GovernorMode mode);
+
+// Reads our own CPU time and I/O from the OS, wakeups from GovernorWakeup()
+GovernorUsage SampleGovernorUsage();
+// Called by the tracker loop after each wait: the wakeup budget is the
+// tracker's, the only loop whose pace the governor scales
+void GovernorWakeup();
+
+// Called from the tracker loop, samples once per GOVERNOR_INTERVAL
+void GovernorTick();
+// Feeds one interval of usage directly, for driving the governor with synthetic load
+GovernorMode GovernorFeed(const GovernorUsage& usage, unsigned long elapsedMs);
+
+GovernorMode GetGovernorMode();
+double GetGovernorLoad();
+// Multiplier for the tracker's sample interval
+unsigned GovernorDelayScale();
+// Whether an optional probe last run at lastMs (GetTickCount64) may run again
+bool GovernorAllowsProbe(unsigned long long lastMs, unsigned long long nowMs);
+// Compaction, index saves and rollup sealing wait for normal mode
+bool GovernorAllowsMaintenance();
+
+#endif // TRACKER_GOVERNOR_H
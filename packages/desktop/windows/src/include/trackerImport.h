@@ -0,0 +1,41 @@
+#ifndef TRACKER_IMPORT_H
+#define TRACKER_IMPORT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <filesystem>
+
+#include "trackerLogger.h"
+
+typedef struct {
+    size_t lines;
+    size_t imported;
+    size_t malformed;
+    size_t bytes;
+} ImportStats;
+
+// Parse one "start ; end ; executable ; title" line (without its newline).
+// The executable ends at the first " ; " so titles may contain the delimiter.
+bool ParseLogLine(const char* line, size_t len, AppLogger& log);
+// Inverse of ParseLogLine, same text as GetLineStr but appended in place
+void AppendLogLine(std::string& out, const AppLogger& log);
+
+// Import a whole log, splitting it at newline boundaries across threads.
+// Entries are appended in file order, malformed lines are skipped and counted.
+ImportStats ImportLogBuffer(const char* data, size_t size, std::vector<AppLogger>& out, unsigned threads = 0);
+ImportStats ImportLogFile(const std::filesystem::path& path, std::vector<AppLogger>& out, unsigned threads = 0);
+
+// Visit lines newest first, with their byte offsets, until visit returns false.
+// Only a window at the end of the file is mapped, doubled whenever a line
+// reaches past it, so the cost follows how far back the caller reads.
+typedef std::function<bool(const char* line, size_t len, uint64_t offset)> LineVisitor;
+bool ScanLinesBackward(const std::filesystem::path& path, const LineVisitor& visit);
+// Sessions starting at or after fromKey (TimeKey), in file order. The log is
+// ordered by start, so the scan stops at the first older session.
+ImportStats ImportLogTail(const std::filesystem::path& path, ULONGLONG fromKey, std::vector<AppLogger>& out);
+// The last well-formed session and the offset its line starts at
+bool ReadLastLogRecord(const std::filesystem::path& path, AppLogger& log, uint64_t& offset);
+
+#endif // TRACKER_IMPORT_H
@@ -0,0 +1,90 @@
+#ifndef TRACKER_INDEX_H
+#define TRACKER_INDEX_H
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "trackerLogger.h"
+
+#define INDEX_MAX_TOKEN 64
+#define INDEX_DEFAULT_LIMIT 50
+
+typedef struct {
+    long long start; // TimeSeconds
+    long long end;
+    uint32_t exe;
+    uint32_t title;
+} IndexedSession;
+
+typedef struct {
+    std::vector<std::string> tokens; // More than one token is a phrase
+    bool prefix;                     // The last token matches as a prefix
+} IndexClause;
+
+// Whitespace separated clauses, all of which must match:
+//   report.docx   "quarterly report"   proj*   exe:code.exe   exe:chrome*
+typedef struct {
+    std::vector<IndexClause> clauses;
+    std::string exe;
+    bool exePrefix;
+} IndexQuery;
+
+// Lowercased runs of letters, digits and non-ASCII bytes
+void TokenizeTitle(const std::string& title, std::vector<std::string>& out);
+bool ParseIndexQuery(const std::string& text, IndexQuery& query);
+
+// One month of sessions, matching the monthly archives. Session ids are the
+// order sessions were added; each term keeps a delta-varint list of them.
+// Matches go newest first by start, sorted when sessions came out of order.
+class IndexSegment {
+public:
+    explicit IndexSegment(unsigned month = 0);
+
+    // A session already indexed with the same start, executable and title is
+    // not added again, only its end moves later. Returns false when nothing changed.
+    bool Add(const AppLogger& log);
+    // Matches newest first, bounds in seconds
+    void Search(const IndexQuery& query, long long from, long long to, size_t limit, std::vector<AppLogger>& out) const;
+
+    bool Save(const std::filesystem::path& path) const;
+    bool Load(const std::filesystem::path& path);
+
+    unsigned Month() const { return _month; }
+    size_t Sessions() const { return _sessions.size(); }
+    size_t Terms() const { return _terms.size(); }
+    long long LastStart() const { return _sessions.empty() ? -1 : _sessions.back().start; }
+
+private:
+    typedef struct {
+        std::string data;
+        uint32_t last;
+        uint32_t count;
+    } Postings;
+
+    void AddTerm(const std::string& term, uint32_t session);
+    void Lookup(const std::string& term, bool prefix, std::vector<uint32_t>& out) const;
+    AppLogger Session(uint32_t id) const;
+
+    unsigned _month; // YYYYMM
+    bool _ordered;   // Ids follow start times, as long as no session came in before the last one
+    std::vector<std::string> _exes;
+    std::vector<std::string> _titles;
+    std::unordered_map<std::string, uint32_t> _exe_ids;
+    std::unordered_map<std::string, uint32_t> _title_ids;
+    std::vector<IndexedSession> _sessions;
+    std::unordered_multimap<long long, uint32_t> _starts; // Session ids by start
+    std::map<std::string, Postings> _terms;
+};
+
+// Segments live in Cache/Index/YYYY-MM.idx, missing ones are rebuilt from the
+// archives and the text log, then kept current by the session listener
+void StartTitleIndex();
+void SaveTitleIndex();
+// from/to are TimeKey bounds, 0 for open ends
+std::vector<AppLogger> SearchTitles(const std::string& query, ULONGLONG from, ULONGLONG to, size_t limit = INDEX_DEFAULT_LIMIT);
+
+#endif // TRACKER_INDEX_H
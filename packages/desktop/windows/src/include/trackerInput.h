@@ -0,0 +1,44 @@
+#ifndef TRACKER_INPUT_H
+#define TRACKER_INPUT_H
+
+#include <cstdint>
+
+#include "trackerLogger.h"
+
+#define INPUT_FILE "input.txt"
+#define INPUT_DEVICE_DIR "/dev/input"
+
+typedef enum {
+    INPUT_KEY,    // Key pressed, auto-repeat excluded
+    INPUT_CLICK,  // Mouse button pressed
+    INPUT_SCROLL, // Wheel event, either axis
+    INPUT_KINDS,
+} InputKind;
+
+// Counts one event. Only ever called from the input thread, so it is a
+// relaxed load and store with no locked instruction, and the hooks return
+// to the system within a few nanoseconds.
+void RecordInput(InputKind kind);
+
+// Optional mode: low-level keyboard and mouse hooks on Windows, evdev devices
+// elsewhere, on a thread of their own. Only the event kind is looked at.
+#ifdef _WIN32
+bool BeginInputCounting();
+#else
+// Reads the event nodes of deviceDir, tests point it at FIFOs of their own
+bool BeginInputCounting(const char* deviceDir = INPUT_DEVICE_DIR);
+#endif // _WIN32
+void EndInputCounting();
+bool IsInputCountingActive();
+
+// Called from the tracker thread before each tick: folds what was counted
+// since the last call into the open minute and the open session
+void ReduceInput();
+// Called by the logger as a record closes, before the listeners see it
+void TakeSessionInput(InputSummary& out);
+// Appends the finished minutes with any input to INPUT_FILE, as
+// "YYYY-MM-DD hh:mm ; keys ; clicks ; scrolls"
+void SaveInput();
+
+
+#endif // TRACKER_INPUT_H
@@ -0,0 +1,101 @@
+#ifndef TRACKER_JSON_H
+#define TRACKER_JSON_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "trackerLogger.h"
+
+#define JSON_CHUNK_SIZE (64 * 1024)
+#define JSON_MAX_DEPTH 16 // Nesting below this gets its commas, deeper fails the payload
+#define JSON_BATCH_SESSIONS 5000 // The cap the backend puts on rollup uploads
+
+// Receives a full chunk, returning false stops the writer
+typedef std::function<bool(const char* data, size_t size)> JsonSink;
+
+typedef struct {
+    size_t sessions;
+    size_t payloads;
+    size_t bytes;
+} JsonExportStats;
+
+// Streaming JSON encoder writing into JSON_CHUNK_SIZE chunks. Without a sink
+// the chunks fill one after the other and Clear() keeps them, so a payload no
+// larger than the previous one allocates nothing and none ever needs one
+// contiguous buffer. With a sink every full chunk is handed over and then
+// reused, so memory stays at one chunk whatever the payload's size.
+// Commas between members and elements are placed by the writer; nesting
+// JSON_MAX_DEPTH deep or an unmatched End makes Ok() false.
+class JsonWriter {
+public:
+    JsonWriter();
+    explicit JsonWriter(JsonSink sink);
+
+    // Starts a new payload, keeping the chunks
+    void Clear();
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+    // Keys are written as given, they are never user text
+    void Key(const char* key);
+    // UTF-8 is passed through, quotes, backslashes and control characters
+    // are escaped as JSON.stringify does. Runs needing no escape are found
+    // 16 bytes at a time with SSE2 compares and copied whole.
+    void String(const char* text, size_t size);
+    void String(const std::string& text) { String(text.data(), text.size()); }
+    void Int(long long value);
+    // Local wall clock as "YYYY-MM-DDThh:mm:ss", as in the text log
+    void Time(const SYSTEMTIME& st);
+    // Bytes outside any value, such as the newline between two payloads
+    void Raw(const char* data, size_t size);
+
+    // Hands the partly filled chunk to the sink, returning Ok()
+    bool Flush();
+    // False once the sink refused a chunk or the nesting was refused
+    bool Ok() const { return _ok; }
+    // Bytes written since Clear(), including those already handed to the sink
+    size_t Size() const;
+    // The payload a chunk at a time, when there is no sink
+    void ForEachChunk(const std::function<void(const char* data, size_t size)>& visit) const;
+
+private:
+    void Separate();
+    void Open(char bracket);
+    void Close(char bracket);
+    void Escape(unsigned char c);
+    void Put(char c)
+    {
+        if (_at == _end) {
+            NextChunk();
+        }
+        *_at++ = c;
+    }
+    void NextChunk();
+
+    JsonSink _sink;
+    std::vector<std::unique_ptr<char[]>> _chunks;
+    std::vector<size_t> _sizes;
+    size_t _chunk;
+    char* _at;
+    char* _end;
+    size_t _flushed;
+    bool _ok;
+    int _depth;
+    bool _first[JSON_MAX_DEPTH]; // No member or element yet at this depth
+    bool _afterKey;
+};
+
+// {"start":"...","end":"...","executable":"...","title":"..."}
+void WriteSessionJson(JsonWriter& json, const AppLogger& log);
+// Writes the sessions starting within [from, to] (TimeKey values) as
+// {"deviceId":N,"sessions":[...]} payloads of at most batchSessions
+// sessions, one per line, each ready to be posted on its own
+JsonExportStats ExportJson(ULONGLONG from, ULONGLONG to, long long deviceId, const JsonSink& sink,
+                           size_t batchSessions = JSON_BATCH_SESSIONS);
+
+
+#endif // TRACKER_JSON_H
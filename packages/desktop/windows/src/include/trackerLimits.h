@@ -0,0 +1,88 @@
+#ifndef TRACKER_LIMITS_H
+#define TRACKER_LIMITS_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "trackerLogger.h"
+
+// One rule per line, "<kind> <seconds> [window seconds] ; <name> ; <exe>[,<exe>...]",
+// "*" standing for every executable, names matched case-insensitively:
+//   daily 3600 ; Games ; steam.exe,eldenring.exe
+//   streak 2700 ; Social media ; discord.exe,firefox.exe
+//   window 7200 86400 ; Video ; vlc.exe
+#define LIMITS_FILE "limits.txt"
+#define LIMIT_STREAK_GAP 60           // Seconds away that still continue a streak
+#define LIMIT_MAX_WINDOW (7 * 86400)  // Sliding windows are restored from the text log
+#define LIMIT_MAX_STEP 30             // Longest sample gap counted as use, seconds
+
+typedef enum {
+    LIMIT_DAILY,  // Total since local midnight
+    LIMIT_STREAK, // Continuous use, broken by LIMIT_STREAK_GAP away
+    LIMIT_WINDOW, // Total over the last window seconds, minute buckets
+} LimitKind;
+
+typedef struct {
+    LimitKind kind;
+    uint32_t seconds;
+    uint32_t window;
+    std::string name;
+} LimitRule;
+
+typedef void (*LimitCallback)(const LimitRule& rule, long long used);
+
+// Every rule keeps the state of its own window and is only touched when a
+// sample matches it: daily totals reset lazily on the first sample of a new
+// day, streaks on the first sample after a gap, and sliding windows drop the
+// buckets they moved past. A sample costs one hash lookup plus O(1) per
+// matching rule. A rule fires once as its threshold is crossed, then again
+// the next day, after the next streak, or once its window fell below it.
+class LimitEngine {
+public:
+    size_t Load(const std::filesystem::path& path);
+    // Takes "<kind> <seconds> [window] ; <name> ; <executables>", false when malformed
+    bool AddRule(const std::string& line);
+    void SetCallback(LimitCallback callback) { _callback = callback; }
+
+    // Use of executable over [start, end), TimeSeconds. Spans must come in
+    // order; replayed history passes notify = false so old crossings stay quiet.
+    void Add(const std::string& executable, long long start, long long end, bool notify = true);
+    // Time counted for rule i as of the last sample
+    long long Used(size_t i) const;
+    size_t Rules() const { return _rules.size(); }
+    const LimitRule& Rule(size_t i) const { return _rules[i].rule; }
+
+private:
+    struct State {
+        LimitRule rule;
+        long long used;
+        long long period; // Day of a daily rule, end of the last span for a streak
+        bool fired;
+        // Sliding windows: seconds per minute, the newest at head
+        std::vector<uint32_t> buckets;
+        long long headMinute;
+        size_t head;
+    };
+
+    void Update(State& state, long long start, long long end, bool notify);
+    void Advance(State& state, long long minute);
+
+    std::vector<State> _rules;
+    std::unordered_map<std::string, std::vector<uint32_t>> _byExecutable; // Lowercased
+    std::string _lowered; // Reused for lookups
+    std::vector<uint32_t> _everyExecutable;
+    LimitCallback _callback = nullptr;
+};
+
+// Loads LIMITS_FILE next to the log and replays the text log back to the
+// start of the longest window, so today's totals survive a restart
+void StartLimits(LimitCallback callback);
+// Called from the tracker thread once per tick with the focused session,
+// not while away or locked
+void SampleLimits(const AppLogger& current, const SYSTEMTIME& now);
+
+
+#endif // TRACKER_LIMITS_H
@@ -1,29 +1,84 @@
 #ifndef TRACKER_LOGGER_H
 #define TRACKER_LOGGER_H
 
-#include <windows.h>
+#include "platform.h"
+#include <cstdint>
 #include <string>
 #include <fstream>
 #include <filesystem>
+#include <functional>
+
+#define RESUME_GRACE 300 // Seconds a restart may take and still continue the last session
+
+// What the session's process used while focused, and what the other tracked
+// processes used meanwhile. Filled as the record closes, never written to the log.
+typedef struct {
+    uint32_t cpuMs;
+    uint32_t backgroundCpuMs;
+    uint32_t peakRssKb;
+    uint32_t ioKb;
+} ResourceSummary;
+
+// Input counted while the session was open, contents are never captured
+typedef struct {
+    uint32_t keys;
+    uint32_t clicks;
+    uint32_t scrolls;
+    uint32_t activeMinutes; // Minutes whose first input came during the session
+} InputSummary;
 
 typedef struct {
     SYSTEMTIME start;
     SYSTEMTIME end;
     std::string executable;
     std::string title;
+    ResourceSummary resources = {};
+    InputSummary input = {};
+    // Set on a session reopened by ResumeSession, the listeners saw it up to
+    // resumedEnd before the restart
+    bool resumed = false;
+    SYSTEMTIME resumedEnd = {};
 } AppLogger;
 
 void ProgSave();
 SYSTEMTIME GetTime();
 
 void ClearLogger();
-void AddEntry(std::string executable, std::string title);
+void AddEntry(const char* executable, const char* title);
+// Moves the open session's end to now, false when no session is buffered
+bool ExtendEntry();
+// Reopens the last logged session when it ended within RESUME_GRACE and the
+// same window is still focused, so a restart does not split it in two. Its
+// line stays in the log until the next flush replaces it, a crash before
+// then keeps it as it was.
+bool ResumeSession(const char* executable, const char* title);
+// Copy of the open session, false when none is buffered
+bool GetCurrentSession(AppLogger& log);
+// Visit the sessions not yet written to the log file, oldest first
+void ForEachBufferedSession(const std::function<void(const AppLogger&)>& visit);
+// Listeners run under the logger lock once per record, when it closes or a flush cuts it
+void AddSessionListener(void (*listener)(const AppLogger&));
+// Seconds of the session a listener has not seen: all of it, or for a resumed
+// session what came after resumedEnd. A resumed session is not a new one.
+long long UnseenSeconds(const AppLogger& log);
+std::string GetLineStr(const AppLogger& log);
 
 #ifdef _DEBUG
 void PrintToConsole();
 #endif // _DEBUG
 
 int CreateLogFile();
+std::filesystem::path GetLogFilePath();
+// The log's size between two flushes, so always at the end of a line
+uint64_t GetLogFileSize();
+// Appends what flushes wrote to the log past from to the file at path, then
+// renames it over the log, under the logger lock. For rewrites of the log
+// that read it up to from without holding the lock.
+bool ReplaceLogFile(const std::filesystem::path& path, uint64_t from);
 void PrintToFile();
+// Final flush: later entries are dropped so nothing is written twice. False
+// when another thread held the logger for longer than timeout milliseconds,
+// the buffered sessions are lost then.
+bool CloseLogger(DWORD timeout);
 
 #endif // TRACKER_LOGGER_H
\ No newline at end of file
@@ -0,0 +1,349 @@
+#ifndef TRACKER_PIPELINE_HPP
+#define TRACKER_PIPELINE_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "trackerLogger.h"
+
+// Policies are plain structs resolved at compile time so the production
+// pipeline inlines completely, while tests and benchmarks can plug in fakes.
+
+template<typename T>
+concept ClockPolicy = requires(T clock, DWORD ms) {
+    { clock.Now() } -> std::same_as<SYSTEMTIME>;
+    clock.Sleep(ms);
+};
+
+template<typename T>
+concept WindowSourcePolicy = requires(T source) {
+    { source.Executable() } -> std::convertible_to<const char*>;
+    { source.Title() } -> std::convertible_to<const char*>;
+};
+
+// Optional fast path: a window source that can tell whether the window and
+// title are the same as on the previous call, and a sink that can extend the
+// open session without being handed its strings again
+template<typename T>
+concept FingerprintSourcePolicy = requires(T source) {
+    { source.Unchanged() } -> std::same_as<bool>;
+};
+
+template<typename T>
+concept ExtendSinkPolicy = requires(T sink) {
+    { sink.Extend() } -> std::same_as<bool>;
+};
+
+template<typename T>
+concept IdleSourcePolicy = requires(T source) {
+    { source.IsAFK() } -> std::same_as<bool>;
+    source.Wake();
+};
+
+// Reads the names of a window that comes on screen in the visible-window set
+template<typename T>
+concept WindowNamesPolicy = requires(T names, HWND hwnd) {
+    { names.Executable(hwnd) } -> std::convertible_to<const char*>;
+    { names.Title(hwnd) } -> std::convertible_to<const char*>;
+};
+
+template<typename T>
+concept SinkPolicy = requires(T sink, const char* text) {
+    sink.Add(text, text);
+};
+
+
+template<ClockPolicy Clock>
+class Sessionizer {
+public:
+    explicit Sessionizer(std::vector<AppLogger>& log, Clock clock = Clock())
+        : _log(log), _clock(std::move(clock)) {}
+    // Records handed back through spare are reused for new sessions, their
+    // strings keep their capacity so a new session does not allocate
+    Sessionizer(std::vector<AppLogger>& log, std::vector<AppLogger>& spare, Clock clock = Clock())
+        : _log(log), _spare(&spare), _clock(std::move(clock)) {}
+
+    // Extend the open session, or close it and open a new one when the title
+    // changes. onBoundary runs between the two so callers can flush first.
+    template<typename OnBoundary>
+    bool Add(const char* executable, const char* title, OnBoundary&& onBoundary)
+    {
+        SYSTEMTIME now = _clock.Now();
+        if (!_log.empty()) {
+            _log.back().end = now;
+            if (_log.back().title == title) {
+                return false;
+            }
+            onBoundary();
+        }
+        if (_spare == nullptr || _spare->empty()) {
+            _log.push_back({now, now, executable, title});
+            return true;
+        }
+        _log.push_back(std::move(_spare->back()));
+        _spare->pop_back();
+        AppLogger& log = _log.back();
+        log.start = log.end = now;
+        log.executable.assign(executable);
+        log.title.assign(title);
+        log.resources = {};
+        log.input = {};
+        log.resumed = false;
+        return true;
+    }
+
+private:
+    std::vector<AppLogger>& _log;
+    std::vector<AppLogger>* _spare = nullptr;
+    Clock _clock;
+};
+
+
+template<ClockPolicy Clock, WindowSourcePolicy WindowSource, IdleSourcePolicy IdleSource, SinkPolicy Sink>
+class Tracker {
+public:
+    explicit Tracker(Clock clock = Clock(), WindowSource window = WindowSource(),
+                     IdleSource idle = IdleSource(), Sink sink = Sink())
+        : _clock(std::move(clock)), _window(std::move(window)),
+          _idle(std::move(idle)), _sink(std::move(sink)) {}
+
+    // Take one sample and return the delay before the next one in milliseconds
+    DWORD Tick()
+    {
+        _extended = false;
+        if constexpr (FingerprintSourcePolicy<WindowSource> && ExtendSinkPolicy<Sink>) {
+            // Called on every tick so the source always compares against the last one
+            bool unchanged = _window.Unchanged();
+            if (unchanged && _tracking) {
+                if (_idle.IsAFK()) {
+                    _tracking = false;
+                    _afk = true;
+                    _sink.Add("AFK", "AFK");
+                    return 10000;
+                }
+                if (_sink.Extend()) {
+                    _extended = true;
+                    return 1000;
+                }
+            }
+        }
+
+        _tracking = false;
+        const char* exec = _window.Executable();
+        if (strcmp(exec, "LockApp.exe") == 0) {
+            _locked = true;
+            _sink.Add("AFK", "Lock");
+        } else if (!_locked && _idle.IsAFK()) {
+            _afk = true;
+            _sink.Add("AFK", "AFK");
+        } else if (_afk || _locked) {
+            _idle.Wake();
+            _afk = false;
+            _locked = false;
+        } else {
+            _sink.Add(exec, _window.Title());
+            _tracking = true;
+        }
+        return (_afk || _locked) ? 10000 : 1000;
+    }
+
+    template<typename Running>
+    void Run(Running&& running)
+    {
+        while (running()) {
+            _clock.Sleep(Tick());
+        }
+    }
+
+    bool IsAFK() const { return _afk; }
+    bool IsLocked() const { return _locked; }
+    // The last tick only moved the open session's end
+    bool Extended() const { return _extended; }
+
+private:
+    Clock _clock;
+    WindowSource _window;
+    IdleSource _idle;
+    Sink _sink;
+    bool _afk = false;
+    bool _locked = true;
+    bool _tracking = false; // The last tick added the foreground window
+    bool _extended = false;
+};
+
+
+// One top-level window as sampled
+typedef struct {
+    HWND hwnd;
+    bool minimized;
+} VisibleSample;
+
+// The set of windows on screen, diffed sample to sample. Every window that is
+// on screen has a secondary session, from when it appears or is restored to
+// when it closes or is minimized; sessions are moved to closed as they end.
+template<ClockPolicy Clock, WindowNamesPolicy Names>
+class VisibleSet {
+public:
+    explicit VisibleSet(std::vector<AppLogger>& closed, Clock clock = Clock(), Names names = Names())
+        : _closed(closed), _clock(std::move(clock)), _names(std::move(names)) {}
+
+    // Takes a sample as enumerated, in Z order, and returns how many
+    // transitions it had. The sample is sorted by handle on return, unless it
+    // matched the last one exactly: then it is left in Z order.
+    size_t Update(std::vector<VisibleSample>& sample)
+    {
+        // Usually nothing opened, closed, changed state or even moved in Z
+        // order: one compare against the last enumeration and no sort
+        if (sample.size() == _last.size() && std::equal(sample.begin(), sample.end(), _last.begin(), SameSample)) {
+            return 0;
+        }
+        _last = sample;
+        SortByHandle(sample);
+
+        // Merge of the two sorted handle arrays, only the differences do any work
+        SYSTEMTIME now = _clock.Now();
+        size_t changes = 0;
+        size_t i = 0;
+        size_t j = 0;
+        _next.clear();
+        while (i < _tracked.size() || j < sample.size()) {
+            bool closed = j == sample.size() ||
+                          (i < _tracked.size() && HandleBefore(_tracked[i].sample.hwnd, sample[j].hwnd));
+            bool opened = !closed && (i == _tracked.size() || HandleBefore(sample[j].hwnd, _tracked[i].sample.hwnd));
+            if (closed) {
+                Tracked& window = _tracked[i++];
+                if (!window.sample.minimized) {
+                    CloseSession(window, now);
+                }
+                changes++;
+            } else if (opened) {
+                Tracked& window = _next.emplace_back();
+                window.sample = sample[j++];
+                window.slot = 0;
+                if (!window.sample.minimized) {
+                    OpenSession(window, now);
+                }
+                changes++;
+            } else {
+                Tracked& window = _next.emplace_back(_tracked[i++]);
+                bool minimized = sample[j++].minimized;
+                if (window.sample.minimized != minimized) {
+                    window.sample.minimized = minimized;
+                    if (minimized) {
+                        CloseSession(window, now);
+                    } else {
+                        OpenSession(window, now);
+                    }
+                    changes++;
+                }
+            }
+        }
+        _tracked.swap(_next);
+        return changes;
+    }
+
+    // Ends every open session and forgets the set
+    void Clear()
+    {
+        SYSTEMTIME now = _clock.Now();
+        for (auto& window : _tracked) {
+            if (!window.sample.minimized) {
+                CloseSession(window, now);
+            }
+        }
+        _tracked.clear();
+        _last.clear();
+        _sessions.clear();
+        _free.clear();
+    }
+
+private:
+    // A window of the last sample. Its session, while it is on screen, lives
+    // in a slot so the merge only ever moves these small entries.
+    typedef struct {
+        VisibleSample sample;
+        uint32_t slot;
+    } Tracked;
+
+    // Window handles only carry 32 significant bits, even in 64-bit processes
+    static uint32_t HandleKey(HWND hwnd) { return (uint32_t)reinterpret_cast<uintptr_t>(hwnd); }
+    static bool HandleBefore(HWND a, HWND b) { return HandleKey(a) < HandleKey(b); }
+    static bool SameSample(const VisibleSample& a, const VisibleSample& b)
+    {
+        return a.hwnd == b.hwnd && a.minimized == b.minimized;
+    }
+
+    // LSD radix sort on the handle, a byte per pass. Z order is as good as
+    // random by handle and costs a comparison sort a mispredict on most compares.
+    void SortByHandle(std::vector<VisibleSample>& samples)
+    {
+        _scratch.resize(samples.size());
+        for (int shift = 0; shift < 32; shift += 8) {
+            size_t counts[257] = {};
+            for (const auto& sample : samples) {
+                counts[((HandleKey(sample.hwnd) >> shift) & 0xFF) + 1]++;
+            }
+            // Every handle has the same byte here, nothing to move
+            if (std::find(counts + 1, counts + 257, samples.size()) != counts + 257) {
+                continue;
+            }
+            for (int b = 0; b < 256; b++) {
+                counts[b + 1] += counts[b];
+            }
+            for (const auto& sample : samples) {
+                _scratch[counts[(HandleKey(sample.hwnd) >> shift) & 0xFF]++] = sample;
+            }
+            samples.swap(_scratch);
+        }
+    }
+
+    // Title and executable are only read when a window comes on screen
+    void OpenSession(Tracked& window, const SYSTEMTIME& now)
+    {
+        if (_free.empty()) {
+            _free.push_back((uint32_t)_sessions.size());
+            _sessions.emplace_back();
+        }
+        window.slot = _free.back();
+        _free.pop_back();
+        _sessions[window.slot] = {now, now, _names.Executable(window.sample.hwnd), _names.Title(window.sample.hwnd)};
+    }
+
+    void CloseSession(Tracked& window, const SYSTEMTIME& now)
+    {
+        AppLogger& session = _sessions[window.slot];
+        session.end = now;
+        _closed.push_back(std::move(session));
+        _free.push_back(window.slot);
+    }
+
+    std::vector<AppLogger>& _closed;
+    Clock _clock;
+    Names _names;
+    // The previous sample as enumerated, in Z order
+    std::vector<VisibleSample> _last;
+    std::vector<VisibleSample> _scratch;
+    std::vector<Tracked> _tracked;
+    std::vector<Tracked> _next;
+    std::vector<AppLogger> _sessions;
+    std::vector<uint32_t> _free;
+};
+
+
+struct LocalClock {
+    SYSTEMTIME Now() { return GetTime(); }
+#ifdef _WIN32
+    void Sleep(DWORD ms) { ::Sleep(ms); }
+#else
+    void Sleep(DWORD ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+#endif // _WIN32
+};
+
+#endif // TRACKER_PIPELINE_HPP
@@ -0,0 +1,80 @@
+#ifndef TRACKER_RESOURCES_H
+#define TRACKER_RESOURCES_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "trackerLogger.h"
+
+#define RESOURCE_MAX_PROCESSES 128
+#define RESOURCE_BATCH 16 // Background processes read per tick, in turn
+#define RESOURCE_FILE "resources.txt"
+
+// Cumulative counters of one process
+typedef struct {
+    double cpuSeconds;
+    uint64_t rssBytes; // Working set on Windows, resident set elsewhere
+    uint64_t ioBytes;
+} ProcessCounters;
+
+// Reads process counters through handles, or /proc file descriptors, kept
+// open between samples. Each sample reads the foreground process and the next
+// RESOURCE_BATCH background ones, so the cost per tick stays flat however many
+// processes are tracked. Counters are cumulative, so a process read less often
+// loses nothing but the resolution of its peak RSS.
+class ResourceSampler {
+public:
+    ResourceSampler() = default;
+    ResourceSampler(const ResourceSampler&) = delete;
+    ResourceSampler& operator=(const ResourceSampler&) = delete;
+    ~ResourceSampler();
+
+    // The foreground process joins the tracked set, making room by dropping
+    // the one focused longest ago. What every read process used since its
+    // last read goes to the open summary.
+    void Sample(DWORD foregroundPid);
+    // Moves the open summary to out and starts a new one
+    void Take(ResourceSummary& out);
+    void Clear();
+
+    size_t Tracked() const { return _processes.size(); }
+
+private:
+    struct Process {
+        DWORD pid;
+#ifdef _WIN32
+        HANDLE handle;
+#else
+        int stat;
+        int io;
+#endif // _WIN32
+        ProcessCounters last;
+        unsigned long long focused; // Sample count when last in the foreground
+    };
+
+    bool Open(Process& process);
+    void Close(Process& process);
+    bool Read(Process& process, ProcessCounters& counters);
+    // Reads one process and books its usage, false once it is gone
+    bool Account(Process& process, bool foreground);
+
+    std::vector<Process> _processes;
+    size_t _cursor = 0;
+    unsigned long long _samples = 0;
+    double _cpu = 0.0;
+    double _backgroundCpu = 0.0;
+    uint64_t _peakRss = 0;
+    uint64_t _io = 0;
+};
+
+// Called from the tracker thread before each tick
+void SampleResources(DWORD foregroundPid);
+// Called by the logger as a record closes, before the listeners see it
+void TakeSessionResources(ResourceSummary& out);
+// Summaries of closed sessions are kept for RESOURCE_FILE next to the log
+void StartResources();
+void SaveResources();
+
+
+#endif // TRACKER_RESOURCES_H
@@ -0,0 +1,32 @@
+#ifndef TRACKER_ROLLUP_H
+#define TRACKER_ROLLUP_H
+
+#include <map>
+#include <string>
+
+#include "trackerLogger.h"
+
+#define ROLLUP_FILE "rollups.txt"
+#define ROLLUP_KEEP_DAYS 40 // Sealed days kept in memory to correct late sessions
+
+typedef struct {
+    long long seconds;
+    unsigned sessions;
+    unsigned revision; // 0 while the day is open
+} DailyRollup;
+
+// Per-day, per-executable totals, a session's seconds split at midnight and
+// the session counted on the day it started. Sealed days are appended to
+// Cache/rollups.txt as
+//   YYYY-MM-DD ; executable ; seconds ; sessions ; revision
+// and a session landing on a sealed day appends the new totals with revision + 1,
+// so upserting the highest revision per (day, executable) is idempotent
+void StartRollups();
+// Seal every open day before today, called periodically and on shutdown
+void SealRollups();
+bool GetDailyRollup(long day, std::map<std::string, DailyRollup>& out);
+// Seconds of the session not counted before it was resumed that fall within
+// the days [first, last]
+long long RollupSeconds(const AppLogger& log, long first, long last);
+
+#endif // TRACKER_ROLLUP_H
@@ -0,0 +1,34 @@
+#ifndef TRACKER_SCRUB_H
+#define TRACKER_SCRUB_H
+
+#include <cstddef>
+#include <filesystem>
+
+#define SCRUB_INTERVAL_DAYS 7
+#define SCRUB_BYTES_PER_SECOND (16 * 1024) // A quarter of the governor's I/O budget
+#define SCRUB_WAIT 600000                  // ms between checks whether a pass is due
+
+typedef struct {
+    size_t archives;
+    size_t blocks;
+    size_t bytes;
+    size_t damaged;   // Blocks, or whole archives with a damaged index
+    size_t recovered; // Sessions put back from the backup log
+    size_t lost;
+    size_t upgraded;  // Version 1 archives rewritten with checksums
+} ScrubStats;
+
+// Called after every block with the bytes just read, returning true stops the pass
+typedef bool (*ScrubPace)(size_t bytes);
+
+// Reads every block of the archive at path and checks it against its CRC32C
+// without decoding it, then hands a damaged archive to RepairArchive. The pass
+// takes no lock: a block that only failed because compaction rewrote the file
+// meanwhile passes when the repair checks it again under the compaction lock.
+// False when pace stopped it.
+bool ScrubArchive(const std::filesystem::path& path, ScrubStats& stats, ScrubPace pace);
+// Every archive under the log's Archive directory, oldest month first
+bool ScrubArchives(ScrubStats& stats, ScrubPace pace);
+
+
+#endif // TRACKER_SCRUB_H
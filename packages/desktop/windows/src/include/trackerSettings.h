@@ -0,0 +1,22 @@
+#ifndef TRACKER_SETTINGS_H
+#define TRACKER_SETTINGS_H
+
+#include "trackerLogger.h"
+
+// Tray toggles and a few numbers kept across restarts, one "name ; value"
+// line each, toggles as 0 or 1
+#define SETTINGS_FILE "settings.txt"
+#define SETTING_VISIBLE_WINDOWS "visible_windows"
+#define SETTING_INPUT_COUNTING "input_counting"
+#define SETTING_LAST_SCRUB "last_scrub" // DayNumber of the last complete scrub pass
+
+// Read from SETTINGS_FILE next to the log, a missing file or name is off
+bool GetSetting(const char* name);
+// Rewrites SETTINGS_FILE through a temporary file, false when that failed
+bool SetSetting(const char* name, bool on);
+// missing when the name is absent or its value is not a number
+long long GetSettingNumber(const char* name, long long missing);
+bool SetSettingNumber(const char* name, long long value);
+
+
+#endif // TRACKER_SETTINGS_H
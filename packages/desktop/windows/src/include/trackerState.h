@@ -0,0 +1,46 @@
+#ifndef TRACKER_STATE_H
+#define TRACKER_STATE_H
+
+#include "trackerGovernor.h"
+#include "trackerLogger.h"
+
+typedef struct {
+    AppLogger current;
+    bool hasSession;
+    unsigned long long ticks;
+    unsigned long long sessions;
+    bool caffeine;
+    bool afk;
+    bool locked;
+    bool afkMonitoring;
+    GovernorMode governor;
+} TrackerState;
+
+struct StateReaderSlot;
+
+// Pins the latest published state for as long as it lives. Readers never
+// block or retry, the writer only frees a state once no pin can reference it.
+class TrackerStateView {
+public:
+    TrackerStateView();
+    ~TrackerStateView();
+    TrackerStateView(const TrackerStateView&) = delete;
+    TrackerStateView& operator=(const TrackerStateView&) = delete;
+
+    // Null until the tracker publishes its first state
+    const TrackerState* get() const { return _state; }
+    const TrackerState* operator->() const { return _state; }
+
+private:
+    StateReaderSlot* _slot;
+    const TrackerState* _state;
+};
+
+// Single writer: the tracker thread
+void PublishTrackerState(const TrackerState& state);
+
+#ifdef _DEBUG
+void PrintTrackerState();
+#endif // _DEBUG
+
+#endif // TRACKER_STATE_H
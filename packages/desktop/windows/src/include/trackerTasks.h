@@ -0,0 +1,106 @@
+#ifndef TRACKER_TASKS_H
+#define TRACKER_TASKS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "trackerLogger.h"
+
+// Both use the log line format: blocks are "start ; end ; task ; type", as
+// exported from todo_tasks (a block ends at due_date and lasts duration),
+// rules are "type ; executable"
+#define TASK_BLOCKS_FILE "task_blocks.txt"
+#define TASK_RULES_FILE "task_rules.txt"
+
+// One planned time block, times are TimeSeconds
+typedef struct {
+    long long start;
+    long long end;
+    uint32_t task;
+    uint32_t type;
+} TaskBlock;
+
+typedef struct {
+    std::string task;
+    double seconds;          // Session time attributed
+    long long plannedSeconds; // Sum of the task's blocks
+    size_t sessions;
+} TaskTime;
+
+typedef enum {
+    ATTRIBUTE_SHARED, // Time covered by several blocks is split evenly between them
+    ATTRIBUTE_EACH,   // Every overlapping block gets the whole overlap
+} AttributionMode;
+
+// Static interval tree: blocks sorted by start form an implicit balanced
+// tree over the array, each node keeping the latest end of its subtree, so
+// an overlap query costs O(log m + k) for k matches
+class TaskIntervalTree {
+public:
+    void Build(std::vector<TaskBlock> blocks);
+    // Visits the blocks with start < end and block end > start
+    void Overlapping(long long start, long long end, const std::function<void(const TaskBlock&)>& visit) const;
+    size_t Size() const { return _blocks.size(); }
+
+private:
+    void Visit(size_t lo, size_t hi, long long start, long long end, const std::function<void(const TaskBlock&)>& visit) const;
+
+    std::vector<TaskBlock> _blocks;
+    std::vector<long long> _maxEnd; // Latest end in the subtree rooted at each index
+};
+
+// Sessions are streamed through the tree in any order. AFK sessions are never
+// attributed, and a task type with rules only takes time from the executables
+// listed for it.
+class TaskAttribution {
+public:
+    explicit TaskAttribution(AttributionMode mode = ATTRIBUTE_SHARED) : _mode(mode) {}
+
+    // Times are parsed as log lines, malformed lines are skipped
+    size_t LoadBlocks(const std::filesystem::path& path);
+    size_t LoadRules(const std::filesystem::path& path);
+    void AddBlock(const std::string& task, const std::string& type, long long start, long long end);
+    void AddRule(const std::string& type, const std::string& executable);
+
+    void Add(const AppLogger& log);
+    // Longest attributed first, tasks without time included
+    std::vector<TaskTime> Results() const;
+    size_t Blocks() const { return _blocks.size(); }
+
+private:
+    uint32_t TaskId(const std::string& task);
+    uint32_t TypeId(const std::string& type);
+    bool Allowed(uint32_t type, const std::string& executable) const;
+
+    AttributionMode _mode;
+    std::vector<TaskBlock> _blocks;
+    TaskIntervalTree _tree; // Rebuilt on the first session after blocks change
+    bool _built = false;
+    std::unordered_map<std::string, uint32_t> _taskIds;
+    std::unordered_map<std::string, uint32_t> _typeIds;
+    std::vector<std::string> _tasks;
+    std::vector<std::unordered_set<std::string>> _rules; // By type, empty for any executable
+    std::vector<double> _seconds;
+    std::vector<long long> _planned;
+    std::vector<size_t> _sessions;
+    std::vector<uint32_t> _lastSession; // Session count when each task was last credited
+    uint32_t _sessionCount = 0;
+    // Reused between sessions
+    std::vector<TaskBlock> _matches;
+    std::vector<std::pair<long long, int>> _events;
+    std::vector<std::pair<long long, double>> _shares;
+};
+
+// Streams the sessions starting within [from, to] (TimeKey values) from the
+// archives, the text log and the logger buffer, against TASK_BLOCKS_FILE and
+// TASK_RULES_FILE next to the log
+std::vector<TaskTime> AttributeTasks(ULONGLONG from, ULONGLONG to, AttributionMode mode = ATTRIBUTE_SHARED);
+
+
+#endif // TRACKER_TASKS_H
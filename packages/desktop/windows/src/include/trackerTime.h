@@ -0,0 +1,15 @@
+#ifndef TRACKER_TIME_H
+#define TRACKER_TIME_H
+
+#include "platform.h"
+
+// Sortable YYYYMMDDhhmmss key
+ULONGLONG TimeKey(const SYSTEMTIME& st);
+SYSTEMTIME TimeFromKey(ULONGLONG key);
+// Days since 1970-01-01
+long DayNumber(const SYSTEMTIME& st);
+// Seconds since 1970-01-01 (local wall clock, no timezone applied)
+long long TimeSeconds(const SYSTEMTIME& st);
+SYSTEMTIME TimeFromSeconds(long long seconds);
+
+#endif // TRACKER_TIME_H
@@ -0,0 +1,29 @@
+#ifndef TRACKER_VISIBLE_H
+#define TRACKER_VISIBLE_H
+
+#include <windows.h>
+#include <vector>
+
+#include "trackerPipeline.hpp"
+
+#define VISIBLE_FILE "visible_windows.txt"
+
+// Appends the windows an Alt+Tab list would show: visible, unowned, not tool
+// windows, not cloaked, with a title. Unsorted.
+void EnumVisibleWindows(std::vector<VisibleSample>& out);
+
+// Optional mode: the windows on screen are kept as a VisibleSet, its sessions
+// go to VISIBLE_FILE next to the main log, in the same line format, in the
+// order they close.
+void BeginVisibleTracking();
+void EndVisibleTracking();
+bool IsVisibleTrackingActive();
+
+// Diffs the visible set against the previous sample and records the
+// transitions, returns how many there were. Called from the tracker thread.
+size_t SampleVisibleWindows();
+// Appends the closed secondary sessions to VISIBLE_FILE
+void SaveVisibleWindows();
+
+
+#endif // TRACKER_VISIBLE_H
@@ -3,7 +3,14 @@
 
 #include <windows.h>
 #include <psapi.h>
+#include <stdint.h>
 
+// Identifies the foreground window and its title without building any strings
+typedef struct {
+    HWND hwnd;
+    DWORD pid;
+    uint64_t title; // Hash of the UTF-16 title
+} WindowFingerprint;
 
 char* GetWindowTitle(HWND hwnd);
 char* GetActiveWindowTitle();
@@ -12,6 +19,10 @@ char* GetWindowExecutable(HWND hwnd);
 char* GetActiveWindowExecutable();
 char* GetWindowExecutableName(HWND hwnd);
 char* GetActiveWindowExecutableName();
+DWORD GetActiveWindowProcessId();
+
+WindowFingerprint GetActiveWindowFingerprint();
+bool SameWindow(const WindowFingerprint* a, const WindowFingerprint* b);
 
 
 #endif // TRACKER_WINDOW_H
\ No newline at end of file
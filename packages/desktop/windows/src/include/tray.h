@@ -21,13 +21,16 @@ void CreateTrayIcon(HWND hwnd);
 void CreateTrayIcon(HWND hwnd, const char* name);
 void CreateTrayIcon(HWND hwnd, const char* name, const char* icon);
 void RemoveTrayIcon(HWND hwnd);
+// Balloon on the tray icon, safe to call from any thread
+void ShowTrayNotification(const char* title, const char* text);
 
 void SetTrayCommandCallback(int (*callback)(HWND, WPARAM));
 void SetTrayUserCallback(int (*callback)(HWND, LPARAM));
+void SetTrayEndSessionCallback(void (*callback)());
 HWND CreateTrayWindow(HINSTANCE hInstance, const char* name);
 
 void CreateTrayMenu(HWND hwnd);
-void AddMenuItem(TrayMenu item);
+void AddMenuItem(const TrayMenu& item);
 void InitTrayMenu(std::vector<TrayMenu> vMenu);
 
 #endif // TRAY_ICON_H
\ No newline at end of file
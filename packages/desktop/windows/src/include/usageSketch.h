@@ -0,0 +1,88 @@
+#ifndef USAGE_SKETCH_H
+#define USAGE_SKETCH_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "trackerLogger.h"
+
+#define SKETCH_CAPACITY 256     // Space-Saving counters per key kind
+#define SKETCH_EPSILON 0.0005   // Count-Min error, as a fraction of total seconds
+#define SKETCH_DELTA 0.01       // Count-Min failure probability
+#define SKETCH_DAYS 30          // Rolling window kept in memory
+
+// Count-Min sketch with conservative update: estimates never undercount and
+// overcount by at most epsilon * total with probability 1 - delta
+class CountMinSketch {
+public:
+    CountMinSketch(double epsilon = SKETCH_EPSILON, double delta = SKETCH_DELTA);
+
+    void Add(const std::string& key, uint64_t weight);
+    uint64_t Estimate(const std::string& key) const;
+    uint64_t Total() const { return _total; }
+    // Both sketches must share the same dimensions
+    bool Merge(const CountMinSketch& other);
+
+    void Serialize(std::string& out) const;
+    bool Deserialize(const char*& p, const char* end);
+
+private:
+    uint32_t _width;
+    uint32_t _depth;
+    uint64_t _total;
+    std::vector<uint64_t> _counters;
+};
+
+// Space-Saving top-k: any key heavier than total / capacity is kept, and
+// each count overestimates the true value by at most its error field
+class SpaceSaving {
+public:
+    typedef struct {
+        std::string key;
+        uint64_t count;
+        uint64_t error;
+    } Counter;
+
+    explicit SpaceSaving(size_t capacity = SKETCH_CAPACITY);
+
+    void Add(const std::string& key, uint64_t weight);
+    std::vector<Counter> Top(size_t n) const;
+    bool Merge(const SpaceSaving& other);
+
+    void Serialize(std::string& out) const;
+    bool Deserialize(const char*& p, const char* end);
+
+private:
+    void SiftDown(size_t i);
+    void SiftUp(size_t i);
+    void Swap(size_t a, size_t b);
+
+    size_t _capacity;
+    std::vector<Counter> _heap; // min-heap on count
+    std::unordered_map<std::string, size_t> _index;
+};
+
+typedef struct {
+    SpaceSaving apps;
+    SpaceSaving titles;
+    CountMinSketch titleSeconds;
+} UsageSketch;
+
+void AddToUsageSketch(UsageSketch& sketch, const AppLogger& log);
+bool MergeUsageSketch(UsageSketch& into, const UsageSketch& other);
+void SerializeUsageSketch(const UsageSketch& sketch, std::string& out);
+bool DeserializeUsageSketch(UsageSketch& sketch, const std::string& data);
+
+// Rolling per-day sketches fed by the logger's session listener
+void StartUsageSketches();
+// Persists the days changed since they were last written, the open one
+// included; called once the logger has been closed
+void SaveUsageSketches();
+std::vector<SpaceSaving::Counter> TopApps(size_t n, int days);
+std::vector<SpaceSaving::Counter> TopTitles(size_t n, int days);
+uint64_t EstimateTitleSeconds(const std::string& title, int days);
+
+#endif // USAGE_SKETCH_H
@@ -0,0 +1,19 @@
+#ifndef UTF_CONVERT_H
+#define UTF_CONVERT_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Worst case UTF-8 size for len UTF-16 units: 3 bytes per unit, a surrogate
+// pair takes 4 bytes for 2 units
+#define UTF8_CAPACITY(len) ((len) * 3)
+
+// Writes UTF-8 to out, which must hold UTF8_CAPACITY(len) bytes, and returns
+// the number of bytes written. Unpaired surrogates become U+FFFD, as with
+// WideCharToMultiByte. Runs of ASCII and surrogate-free blocks take an SSE2
+// path, anything else and builds without SSE2 use scalar code.
+size_t Utf16ToUtf8(const uint16_t* in, size_t len, char* out);
+// True when every surrogate is paired
+bool IsValidUtf16(const uint16_t* in, size_t len);
+
+#endif // UTF_CONVERT_H
@@ -0,0 +1,51 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of workers, each with its own deque. Owners run their tasks in
+// submission order so a task that keeps resubmitting itself cannot starve the
+// others, idle workers steal from the other end of a victim's deque.
+class WorkStealingPool {
+public:
+    WorkStealingPool(unsigned threads, std::function<void(size_t task)> run);
+    ~WorkStealingPool();
+
+    // hint picks the worker the task is queued on, e.g. the submitting thread
+    void Submit(size_t task, unsigned hint);
+    // Finish every queued task, then join the workers
+    void Stop();
+
+    unsigned Size() const { return (unsigned)_workers.size(); }
+    size_t Steals() const { return _steals.load(std::memory_order_relaxed); }
+
+private:
+    typedef struct {
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    } Worker;
+
+    bool Pop(unsigned self, size_t& task);
+    bool Steal(unsigned self, size_t& task);
+    void WorkerLoop(unsigned self);
+
+    std::function<void(size_t)> _run;
+    std::vector<std::unique_ptr<Worker>> _workers;
+    std::vector<std::thread> _threads;
+
+    std::mutex _idle_mutex;
+    std::condition_variable _idle;
+    std::atomic<size_t> _queued;
+    std::atomic<size_t> _steals;
+    std::atomic<bool> _stopping;
+};
+
+#endif // WORK_POOL_H
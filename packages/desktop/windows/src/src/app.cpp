@@ -1,59 +1,157 @@
 #include "app.h"
 
+#include <atomic>
+
 #define TIME_BETWEEN_SAVE 180000
 
 
-bool _is_running = true;
-bool _is_caffeine = false;
-bool _is_afk = false;
-bool _is_locked = true;
+std::atomic<bool> _is_running(true);
+std::atomic<bool> _is_caffeine(false);
+HANDLE _stop_event = CreateEventA(NULL, TRUE, FALSE, NULL);
+HANDLE _caffeine_event = CreateEventA(NULL, FALSE, FALSE, NULL);
 
-void StopAfk()
-{
-    for (int i = 0; i < 4; i++) {
-        ResetAFKtime();
-        Sleep(500);
+
+struct ForegroundWindowSource {
+    const char* Executable() { return GetActiveWindowExecutableName(); }
+    const char* Title() { return GetActiveWindowTitle(); }
+    bool Unchanged()
+    {
+        WindowFingerprint print = GetActiveWindowFingerprint();
+        bool same = SameWindow(&print, &last);
+        last = print;
+        return same;
     }
-}
 
+    WindowFingerprint last = {};
+};
 
-void TrackerLoop() {
-    while (IsRunning()) 
+struct SystemIdleSource {
+    bool IsAFK() { return !IsCaffeine() && ::IsAFK(AFK_TIME); }
+    void Wake()
     {
-        std::string exec = GetActiveWindowExecutableName();
-        std::string title = GetActiveWindowTitle();
-        if ( exec == "LockApp.exe" ) {
-            _is_locked = true;
-            AddEntry("AFK", "Lock");
-        } else if (!_is_locked && !IsCaffeine() && IsAFK(AFK_TIME))  {
-            _is_afk = true;
-            AddEntry("AFK", "AFK");
+        for (int i = 0; i < 4; i++) {
+            ResetAFKtime();
+            if (WaitForStop(500)) {
+                return;
+            }
+        }
+    }
+};
+
+struct LoggerSink {
+    void Add(const char* executable, const char* title) { AddEntry(executable, title); }
+    bool Extend() { return ExtendEntry(); }
+};
+
+typedef Tracker<LocalClock, ForegroundWindowSource, SystemIdleSource, LoggerSink> SystemTracker;
+
+
+void TrackerLoop() {
+    SystemTracker tracker;
+    TrackerState state = {};
+    ULONGLONG lastVisibleSample = 0;
+    ULONGLONG lastResourceSample = 0;
+    while (IsRunning()) {
+        // Before the tick, so what was used since the last one goes to the session it may close
+        if (GovernorAllowsProbe(lastResourceSample, GetTickCount64())) {
+            lastResourceSample = GetTickCount64();
+            SampleResources(GetActiveWindowProcessId());
+        }
+        ReduceInput();
+        DWORD delay = tracker.Tick();
+
+        if (tracker.Extended() && state.hasSession) {
+            state.current.end = GetTime();
         } else {
-            if (_is_afk || _is_locked) {
-                StopAfk();
-                _is_afk = false;
-                _is_locked = false;
-            } else {
-                AddEntry(exec, title);
+            ULONGLONG start = state.hasSession ? TimeKey(state.current.start) : 0;
+            state.hasSession = GetCurrentSession(state.current);
+            if (state.hasSession && TimeKey(state.current.start) != start) {
+                state.sessions++;
             }
         }
-        Sleep((_is_afk || _is_locked) ? 10000 : 1000);
+        state.ticks++;
+        state.caffeine = IsCaffeine();
+        state.afk = tracker.IsAFK();
+        state.locked = tracker.IsLocked();
+        state.afkMonitoring = IsAFKMonitoringActive();
+        state.governor = GetGovernorMode();
+        if (state.hasSession) {
+            SampleLimits(state.current, GetTime());
+        }
+        PublishTrackerState(state);
+
+        if (IsVisibleTrackingActive() && GovernorAllowsProbe(lastVisibleSample, GetTickCount64())) {
+            lastVisibleSample = GetTickCount64();
+            SampleVisibleWindows();
+        }
+        GovernorTick();
+        // Only this loop's wakeups count against the budget, it is the one the
+        // governor slows down; the other threads wait on fixed schedules
+        bool stopped = WaitForStop(delay * GovernorDelayScale());
+        GovernorWakeup();
+        if (stopped) {
+            break;
+        }
     }
 }
 
 void SaveToFileLoop() 
 {
-    while (IsRunning())
+    long lastCompaction = -1;
+    while (!WaitForStop(TIME_BETWEEN_SAVE))
     {
-        Sleep(TIME_BETWEEN_SAVE);
+        // Deferred while over budget, caught up on the first pass back in normal mode
+        bool maintenance = GovernorAllowsMaintenance();
+        long today = DayNumber(GetTime());
+        if (maintenance && today != lastCompaction) {
+            lastCompaction = today;
+            SaveTitleIndex();
+            SaveActivity();
+            // Here rather than on the tracker thread, which only waits for the
+            // logger lock while the rewritten log is swapped in
+            CompactLogFile();
+        }
         ProgSave();
+        SaveVisibleWindows();
+        SaveResources();
+        SaveInput();
+        if (maintenance) {
+            SealRollups();
+        }
+    }
+}
+
+// Paced well under the governor's I/O budget, a pass cut short by a busier
+// mode or by Stop() starts over on a later check
+static bool PaceScrub(size_t bytes)
+{
+    return WaitForStop((DWORD)(bytes * 1000 / SCRUB_BYTES_PER_SECOND)) || !GovernorAllowsMaintenance();
+}
+
+void ScrubLoop()
+{
+    // Lowers the thread's I/O and memory priority along with its CPU priority
+    SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+    // Kept with the settings, so restarts more often than the interval do not
+    // each start a pass
+    long long lastScrub = GetSettingNumber(SETTING_LAST_SCRUB, -1);
+    while (!WaitForStop(SCRUB_WAIT)) {
+        long today = DayNumber(GetTime());
+        if (!GovernorAllowsMaintenance() || (lastScrub >= 0 && today - lastScrub < SCRUB_INTERVAL_DAYS)) {
+            continue;
+        }
+        ScrubStats stats = {};
+        if (ScrubArchives(stats, PaceScrub)) {
+            lastScrub = today;
+            SetSettingNumber(SETTING_LAST_SCRUB, lastScrub);
+        }
     }
 }
 
 #ifdef _DEBUG
 void MessageLoop() 
 {
-    while (IsRunning())
+    do
     {
         if (!IsCaffeine() && IsAFK(AFK_TIME)) {
             std::cout << "AFK\n";
@@ -64,23 +162,24 @@ void MessageLoop()
         if (isSleepPrevented()) {
             std::cout << "Sleep Prevented\n";
         }
-        Sleep(5000);
-    }
+    } while (!WaitForStop(5000));
 }
 #endif // _DEBUG
 
 
 void CaffeineLoop()
 {
+    HANDLE events[] = {_stop_event, _caffeine_event};
     while (IsRunning() && IsCaffeine()) {
         ResetAFKtime();
-        Sleep(30000);
+        WaitForMultipleObjects(2, events, FALSE, 30000);
     }
 }
 
 void Caffeine()
 {
     _is_caffeine = !_is_caffeine;
+    SetEvent(_caffeine_event);
 }
 
 bool IsCaffeine()
@@ -92,8 +191,14 @@ bool IsCaffeine()
 void Stop()
 {
     _is_running = false;
+    SetEvent(_stop_event);
 }
 bool IsRunning()
 {
     return _is_running;
+}
+
+bool WaitForStop(DWORD ms)
+{
+    return WaitForSingleObject(_stop_event, ms) != WAIT_TIMEOUT;
 }
\ No newline at end of file
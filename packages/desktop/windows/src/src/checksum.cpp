@@ -0,0 +1,167 @@
+#include "checksum.h"
+
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define CRC32C_X86
+#elif defined(__aarch64__)
+#include <arm_acle.h>
+#define CRC32C_ARM
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif // _WIN32
+#endif
+
+#define CRC32C_POLY 0x82F63B78 // Reflected Castagnoli polynomial
+
+typedef uint32_t (*Crc32cFunction)(const uint8_t* p, size_t size, uint32_t crc);
+
+
+// _crc32c_table[k][b] is the CRC of byte b followed by k zero bytes
+static constexpr std::array<std::array<uint32_t, 256>, 8> MakeTable()
+{
+    std::array<std::array<uint32_t, 256>, 8> table = {};
+    for (uint32_t b = 0; b < 256; b++) {
+        uint32_t crc = b;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (CRC32C_POLY & (0 - (crc & 1)));
+        }
+        table[0][b] = crc;
+    }
+    for (int k = 1; k < 8; k++) {
+        for (uint32_t b = 0; b < 256; b++) {
+            table[k][b] = (table[k - 1][b] >> 8) ^ table[0][table[k - 1][b] & 0xFF];
+        }
+    }
+    return table;
+}
+
+static constexpr std::array<std::array<uint32_t, 256>, 8> _crc32c_table = MakeTable();
+
+
+static uint32_t TableUpdate(const uint8_t* p, size_t size, uint32_t crc)
+{
+    const auto& t = _crc32c_table;
+    crc = ~crc;
+    while (size >= 8) {
+        uint32_t low;
+        uint32_t high;
+        memcpy(&low, p, 4);
+        memcpy(&high, p + 4, 4);
+        low ^= crc;
+        crc = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^ t[5][(low >> 16) & 0xFF] ^ t[4][low >> 24] ^
+              t[3][high & 0xFF] ^ t[2][(high >> 8) & 0xFF] ^ t[1][(high >> 16) & 0xFF] ^ t[0][high >> 24];
+        p += 8;
+        size -= 8;
+    }
+    while (size--) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+    }
+    return ~crc;
+}
+
+#ifdef CRC32C_X86
+// One crc32 instruction per 8 bytes, after aligning the loads
+__attribute__((target("sse4.2"))) static uint32_t Sse42Update(const uint8_t* p, size_t size, uint32_t crc)
+{
+    crc = ~crc;
+    while (size > 0 && ((uintptr_t)p & 7)) {
+        crc = _mm_crc32_u8(crc, *p++);
+        size--;
+    }
+#ifdef __x86_64__
+    uint64_t crc64 = crc;
+    for (; size >= 8; p += 8, size -= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        crc64 = _mm_crc32_u64(crc64, v);
+    }
+    crc = (uint32_t)crc64;
+#endif // __x86_64__
+    for (; size >= 4; p += 4, size -= 4) {
+        uint32_t v;
+        memcpy(&v, p, 4);
+        crc = _mm_crc32_u32(crc, v);
+    }
+    while (size--) {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+    return ~crc;
+}
+
+static Crc32cFunction PickCrc32c()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2") ? Sse42Update : TableUpdate;
+}
+#elif defined(CRC32C_ARM)
+#ifdef __clang__
+__attribute__((target("crc")))
+#else
+__attribute__((target("+crc")))
+#endif // __clang__
+static uint32_t Armv8Update(const uint8_t* p, size_t size, uint32_t crc)
+{
+    crc = ~crc;
+    while (size > 0 && ((uintptr_t)p & 7)) {
+        crc = __crc32cb(crc, *p++);
+        size--;
+    }
+    for (; size >= 8; p += 8, size -= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        crc = __crc32cd(crc, v);
+    }
+    while (size--) {
+        crc = __crc32cb(crc, *p++);
+    }
+    return ~crc;
+}
+
+static Crc32cFunction PickCrc32c()
+{
+#ifdef _WIN32
+    bool supported = IsProcessorFeaturePresent(PF_ARM_V8_CRC32_INSTRUCTIONS_AVAILABLE);
+#else
+    bool supported = getauxval(AT_HWCAP) & HWCAP_CRC32;
+#endif // _WIN32
+    return supported ? Armv8Update : TableUpdate;
+}
+#else
+static Crc32cFunction PickCrc32c()
+{
+    return TableUpdate;
+}
+#endif // CRC32C_X86
+
+static const Crc32cFunction _crc32c = PickCrc32c();
+
+
+uint32_t Crc32c(const void* data, size_t size, uint32_t crc)
+{
+    return _crc32c((const uint8_t*)data, size, crc);
+}
+
+uint32_t Crc32cTable(const void* data, size_t size, uint32_t crc)
+{
+    return TableUpdate((const uint8_t*)data, size, crc);
+}
+
+const char* Crc32cImplementation()
+{
+#ifdef CRC32C_X86
+    if (_crc32c == Sse42Update) {
+        return "sse4.2";
+    }
+#elif defined(CRC32C_ARM)
+    if (_crc32c == Armv8Update) {
+        return "armv8";
+    }
+#endif // CRC32C_X86
+    return "table";
+}
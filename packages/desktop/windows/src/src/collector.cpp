@@ -0,0 +1,999 @@
+#include "collector.h"
+#include "trackerDigest.h"
+#include "trackerImport.h"
+#include "workPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define COLLECTOR_READ_SIZE (64 << 10)
+#define COLLECTOR_MAX_EVENTS 256
+#define COLLECTOR_RETRY_MS 1000
+#define COLLECTOR_MAX_UNSENT (8 << 20) // Reply bytes a client may leave unread before it is dropped
+#define COLLECTOR_MAX_DIGEST_PATHS 1024
+
+
+typedef struct Connection {
+    int fd;
+    int epoll;         // Of the I/O thread reading it, which also sends what replies left unsent
+    std::string in;
+    size_t offset;     // Start of the unparsed input
+    size_t scan;       // Where the newline count of the pending batch resumes
+    size_t lines;      // Lines already seen in the pending batch
+    std::mutex write;
+    std::string unsent; // Under write
+
+    ~Connection() { close(fd); }
+} Connection;
+
+typedef struct {
+    std::shared_ptr<Connection> connection;
+    std::string user;
+    std::string payload;
+    size_t count;
+    bool digest; // Payload is a list of node paths, not log lines
+} Batch;
+
+typedef struct {
+    std::string lines;
+    size_t records;
+} Outgoing;
+
+typedef struct {
+    FILE* file;
+    std::unordered_set<uint64_t> lines; // Hashes of the lines it holds, a line is written once
+} Partition;
+
+typedef struct {
+    std::mutex mutex;
+    std::vector<Batch> inbox;
+    bool scheduled;
+
+    // Upstream outbox, swapped out by the forwarder under the mutex
+    std::unordered_map<std::string, Outgoing> outbox;
+    size_t outboxRecords;
+    std::chrono::steady_clock::time_point outboxSince;
+
+    // Only touched by the worker running the shard
+    std::unordered_map<std::string, Partition> files;
+    std::unordered_set<std::string> users;
+    std::unordered_map<std::string, DigestTree> trees;
+    std::unordered_map<std::string, std::set<std::string>> staleDays; // Partitions written since the tree was built
+} Shard;
+
+typedef struct {
+    int epoll;
+    std::thread thread;
+    std::mutex mutex;
+    std::unordered_map<int, std::shared_ptr<Connection>> connections;
+} IoThread;
+
+
+static CollectorConfig _config;
+static int _wake_pipe[2] = {-1, -1};
+static std::atomic<bool> _collector_running(false);
+
+static std::vector<std::unique_ptr<Shard>> _shards;
+static std::unique_ptr<WorkStealingPool> _pool;
+
+static std::mutex _upstream_mutex;
+static std::condition_variable _upstream_ready;
+static std::deque<std::pair<std::string, Outgoing>> _upstream_queue;
+static bool _upstream_stopping = false;
+
+static std::atomic<size_t> _stat_connections(0);
+static std::atomic<size_t> _stat_batches(0);
+static std::atomic<size_t> _stat_records(0);
+static std::atomic<size_t> _stat_malformed(0);
+static std::atomic<size_t> _stat_forwarded(0);
+static std::atomic<size_t> _stat_spooled(0);
+
+
+static size_t ShardOf(const std::string& user)
+{
+    // FNV-1a, stable across runs so a user keeps its shard
+    uint32_t h = 2166136261u;
+    for (unsigned char c : user) {
+        h = (h ^ c) * 16777619u;
+    }
+    return h % COLLECTOR_SHARDS;
+}
+
+static bool ValidUser(const char* user, size_t len)
+{
+    if (len == 0 || len > COLLECTOR_MAX_USER || user[0] == '.') {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        char c = user[i];
+        if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+              c == '-' || c == '_' || c == '.')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool SendAll(int fd, const char* data, size_t size)
+{
+    while (size > 0) {
+        ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+static void WatchWritable(Connection& connection, bool writable)
+{
+    epoll_event event = {};
+    event.events = EPOLLIN | EPOLLRDHUP | (writable ? (uint32_t)EPOLLOUT : 0u);
+    event.data.fd = connection.fd;
+    epoll_ctl(connection.epoll, EPOLL_CTL_MOD, connection.fd, &event);
+}
+
+// Sends what the socket takes; connection.write must be held
+static bool SendUnsent(Connection& connection)
+{
+    while (!connection.unsent.empty()) {
+        ssize_t n = send(connection.fd, connection.unsent.data(), connection.unsent.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        connection.unsent.erase(0, (size_t)n);
+    }
+    return true;
+}
+
+static void Reply(Connection& connection, const char* text, size_t size)
+{
+    // Clients wait for each reply, so the socket buffer only fills on large
+    // digest listings. What it does not take is left to the I/O thread, so a
+    // worker never waits on a client; one that stops reading is dropped.
+    std::lock_guard<std::mutex> lock(connection.write);
+    bool waiting = !connection.unsent.empty();
+    connection.unsent.append(text, size);
+    if (waiting) {
+        if (connection.unsent.size() > COLLECTOR_MAX_UNSENT) {
+            shutdown(connection.fd, SHUT_RDWR);
+        }
+        return;
+    }
+    if (!SendUnsent(connection)) {
+        shutdown(connection.fd, SHUT_RDWR);
+    } else if (!connection.unsent.empty()) {
+        WatchWritable(connection, true);
+    }
+}
+
+static void Reply(Connection& connection, const char* text)
+{
+    Reply(connection, text, strlen(text));
+}
+
+
+static Partition* OpenPartition(Shard& shard, const std::string& user, const SYSTEMTIME& day)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%04u-%02u-%02u", day.wYear, day.wMonth, day.wDay);
+    std::string key = user + '/' + name;
+    auto it = shard.files.find(key);
+    if (it != shard.files.end()) {
+        return &it->second;
+    }
+
+    if (shard.files.size() >= COLLECTOR_OPEN_FILES) {
+        // Any victim will do, a user's writes stay on one or two days
+        fclose(shard.files.begin()->second.file);
+        shard.files.erase(shard.files.begin());
+    }
+    if (shard.users.insert(user).second) {
+        std::error_code ec;
+        std::filesystem::create_directories(_config.root / user, ec);
+    }
+    std::filesystem::path path = _config.root / user / (std::string(name) + ".txt");
+    Partition partition;
+    partition.file = fopen(path.c_str(), "a+b");
+    if (partition.file == NULL) {
+        return NULL;
+    }
+    // A day holds a few hundred lines, reading them back is cheaper than
+    // letting a re-sent block pile up duplicates
+    char* line = NULL;
+    size_t capacity = 0;
+    ssize_t len;
+    while ((len = getline(&line, &capacity, partition.file)) > 0) {
+        len -= line[len - 1] == '\n';
+        len -= len > 0 && line[len - 1] == '\r';
+        partition.lines.insert(HashBytes(line, (size_t)len));
+    }
+    free(line);
+    return &(shard.files[key] = std::move(partition));
+}
+
+// Built from every partition of the user once, then only the partitions
+// written since are read again
+static const DigestTree& UserTree(Shard& shard, const std::string& user)
+{
+    std::vector<AppLogger> logs;
+    auto it = shard.trees.find(user);
+    if (it != shard.trees.end()) {
+        auto stale = shard.staleDays.find(user);
+        if (stale != shard.staleDays.end()) {
+            for (const auto& day : stale->second) {
+                logs.clear();
+                ImportLogFile(_config.root / user / (day + ".txt"), logs, 1);
+                it->second.ReplaceDay(day, logs);
+            }
+            shard.staleDays.erase(stale);
+        }
+        return it->second;
+    }
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(_config.root / user, ec)) {
+        if (entry.path().extension() == ".txt") {
+            ImportLogFile(entry.path(), logs, 1);
+        }
+    }
+    DigestTree& tree = shard.trees[user];
+    tree.Build(logs);
+    return tree;
+}
+
+// "<path> <n>" then n lines of "<child> <digest>" per requested path, then "END"
+static void ReplyDigests(Shard& shard, Batch& batch)
+{
+    const DigestTree& tree = UserTree(shard, batch.user);
+    std::string out;
+    std::vector<DigestEntry> children;
+    char number[40];
+    const char* p = batch.payload.data();
+    const char* end = p + batch.payload.size();
+    while (p < end) {
+        const char* eol = (const char*)memchr(p, '\n', end - p);
+        std::string path(p, eol);
+        tree.Children(path, children);
+        snprintf(number, sizeof(number), " %zu\n", children.size());
+        out += path;
+        out += number;
+        for (const auto& child : children) {
+            snprintf(number, sizeof(number), " %016llx\n", (unsigned long long)child.digest);
+            out += child.path;
+            out += number;
+        }
+        p = eol + 1;
+    }
+    out += "END\n";
+    Reply(*batch.connection, out.data(), out.size());
+}
+
+static void RunShard(size_t index)
+{
+    Shard& shard = *_shards[index];
+    std::vector<Batch> batches;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        batches.swap(shard.inbox);
+    }
+
+    std::unordered_map<std::string, Outgoing> forward;
+    std::vector<size_t> accepted(batches.size(), 0);
+    std::vector<FILE*> touched;
+    FILE* last = NULL;
+    AppLogger log;
+    for (size_t b = 0; b < batches.size(); b++) {
+        Batch& batch = batches[b];
+        if (batch.digest) {
+            // Digests must see the lines written earlier in this run
+            for (auto& item : shard.files) {
+                fflush(item.second.file);
+            }
+            ReplyDigests(shard, batch);
+            continue;
+        }
+        Outgoing& out = forward[batch.user];
+        // A cached tree learns which days were written, a batch rarely spans more than two
+        std::set<std::string>* stale = shard.trees.count(batch.user) ? &shard.staleDays[batch.user] : NULL;
+        SYSTEMTIME day = {};
+        const char* p = batch.payload.data();
+        const char* end = p + batch.payload.size();
+        while (p < end) {
+            const char* eol = (const char*)memchr(p, '\n', end - p);
+            size_t len = eol - p;
+            if (len > 0 && p[len - 1] == '\r') {
+                len--;
+            }
+            if (ParseLogLine(p, len, log)) {
+                // A line the partition already holds is acked without writing it again
+                Partition* partition = OpenPartition(shard, batch.user, log.start);
+                if (partition != NULL && partition->lines.insert(HashBytes(p, len)).second) {
+                    if (stale != NULL &&
+                        (log.start.wDay != day.wDay || log.start.wMonth != day.wMonth || log.start.wYear != day.wYear)) {
+                        day = log.start;
+                        char name[32];
+                        snprintf(name, sizeof(name), "%04u-%02u-%02u", day.wYear, day.wMonth, day.wDay);
+                        stale->insert(name);
+                    }
+                    if (partition->file != last) {
+                        touched.push_back(partition->file);
+                        last = partition->file;
+                    }
+                    fwrite(p, 1, len, partition->file);
+                    fputc('\n', partition->file);
+                    if (!_config.upstream.empty()) {
+                        out.lines.append(p, len);
+                        out.lines += '\n';
+                        out.records++;
+                    }
+                }
+                accepted[b] += partition != NULL;
+            } else {
+                _stat_malformed.fetch_add(1, std::memory_order_relaxed);
+            }
+            p = eol + 1;
+        }
+    }
+    // Evicted files were flushed by fclose, only live handles are looked up
+    std::sort(touched.begin(), touched.end());
+    for (auto& item : shard.files) {
+        if (std::binary_search(touched.begin(), touched.end(), item.second.file)) {
+            fflush(item.second.file);
+        }
+    }
+
+    char ack[64];
+    for (size_t b = 0; b < batches.size(); b++) {
+        if (batches[b].digest) {
+            continue;
+        }
+        snprintf(ack, sizeof(ack), "OK %zu %zu\n", batches[b].count, accepted[b]);
+        Reply(*batches[b].connection, ack);
+        _stat_records.fetch_add(accepted[b], std::memory_order_relaxed);
+    }
+
+    bool full = false;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto& item : forward) {
+            if (item.second.records == 0) {
+                continue;
+            }
+            if (shard.outboxRecords == 0) {
+                shard.outboxSince = std::chrono::steady_clock::now();
+            }
+            Outgoing& out = shard.outbox[item.first];
+            out.lines += item.second.lines;
+            out.records += item.second.records;
+            shard.outboxRecords += item.second.records;
+        }
+        full = shard.outboxRecords >= COLLECTOR_FORWARD_RECORDS;
+
+        if (shard.inbox.empty()) {
+            shard.scheduled = false;
+        } else {
+            _pool->Submit(index, (unsigned)index);
+        }
+    }
+    if (full) {
+        _upstream_ready.notify_one();
+    }
+}
+
+static void Enqueue(Batch&& batch)
+{
+    size_t index = ShardOf(batch.user);
+    Shard& shard = *_shards[index];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.inbox.push_back(std::move(batch));
+    if (!shard.scheduled) {
+        shard.scheduled = true;
+        _pool->Submit(index, (unsigned)index);
+    }
+}
+
+
+// Returns false on a protocol error, the reply has been sent
+static bool ParseBatches(const std::shared_ptr<Connection>& connection)
+{
+    Connection& c = *connection;
+    while (true) {
+        const char* base = c.in.data() + c.offset;
+        const char* end = c.in.data() + c.in.size();
+        const char* header_end = (const char*)memchr(base, '\n', end - base);
+        if (header_end == NULL) {
+            if ((size_t)(end - base) > COLLECTOR_MAX_USER + 32) {
+                Reply(c, "ERROR header too long\n");
+                return false;
+            }
+            break;
+        }
+
+        char kind[8];
+        char user[COLLECTOR_MAX_USER + 1];
+        size_t count;
+        std::string header(base, header_end);
+        if (sscanf(header.c_str(), "%7s %64s %zu", kind, user, &count) != 3 || !ValidUser(user, strlen(user)) ||
+            (strcmp(kind, "BATCH") != 0 && strcmp(kind, "DIGEST") != 0) ||
+            count > (kind[0] == 'D' ? COLLECTOR_MAX_DIGEST_PATHS : COLLECTOR_MAX_BATCH)) {
+            Reply(c, "ERROR bad batch header\n");
+            return false;
+        }
+
+        // Resume the line count where the previous read stopped
+        const char* body = header_end + 1;
+        const char* p = c.scan > 0 ? c.in.data() + c.scan : body;
+        while (c.lines < count) {
+            const char* eol = (const char*)memchr(p, '\n', end - p);
+            if (eol == NULL) {
+                break;
+            }
+            c.lines++;
+            p = eol + 1;
+        }
+        if (c.lines < count) {
+            if ((size_t)(end - body) > COLLECTOR_MAX_PAYLOAD) {
+                Reply(c, "ERROR batch too large\n");
+                return false;
+            }
+            c.scan = p - c.in.data();
+            break;
+        }
+
+        Batch batch;
+        batch.connection = connection;
+        batch.user = user;
+        batch.payload.assign(body, p);
+        batch.count = count;
+        batch.digest = kind[0] == 'D';
+        _stat_batches.fetch_add(1, std::memory_order_relaxed);
+        Enqueue(std::move(batch));
+
+        c.offset = p - c.in.data();
+        c.scan = 0;
+        c.lines = 0;
+    }
+
+    // Drop consumed input once it dominates the buffer
+    if (c.offset > 0 && c.offset * 2 >= c.in.size()) {
+        if (c.scan > 0) {
+            c.scan -= c.offset;
+        }
+        c.in.erase(0, c.offset);
+        c.offset = 0;
+    }
+    return true;
+}
+
+static void CloseConnection(IoThread& io, int fd)
+{
+    epoll_ctl(io.epoll, EPOLL_CTL_DEL, fd, NULL);
+    std::lock_guard<std::mutex> lock(io.mutex);
+    // Pending batches keep the connection, the fd closes with the last reference
+    io.connections.erase(fd);
+    _stat_connections.fetch_sub(1, std::memory_order_relaxed);
+}
+
+static void IoLoop(IoThread* io)
+{
+    epoll_event events[COLLECTOR_MAX_EVENTS];
+    while (_collector_running) {
+        int n = epoll_wait(io->epoll, events, COLLECTOR_MAX_EVENTS, -1);
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == _wake_pipe[0]) {
+                continue;
+            }
+            std::shared_ptr<Connection> connection;
+            {
+                std::lock_guard<std::mutex> lock(io->mutex);
+                auto it = io->connections.find(fd);
+                if (it == io->connections.end()) {
+                    continue;
+                }
+                connection = it->second;
+            }
+
+            bool open = true;
+            if (events[i].events & EPOLLOUT) {
+                std::lock_guard<std::mutex> lock(connection->write);
+                open = SendUnsent(*connection);
+                if (open && connection->unsent.empty()) {
+                    WatchWritable(*connection, false);
+                }
+            }
+            if (!(events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+                if (!open) {
+                    CloseConnection(*io, fd);
+                }
+                continue;
+            }
+            while (open) {
+                size_t size = connection->in.size();
+                connection->in.resize(size + COLLECTOR_READ_SIZE);
+                ssize_t r = recv(fd, &connection->in[size], COLLECTOR_READ_SIZE, 0);
+                connection->in.resize(size + std::max<ssize_t>(r, 0));
+                if (r > 0) {
+                    open = ParseBatches(connection);
+                    if (r < COLLECTOR_READ_SIZE) {
+                        break;
+                    }
+                } else if (r < 0 && errno == EINTR) {
+                    continue;
+                } else if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    break;
+                } else {
+                    open = false;
+                }
+            }
+            if (!open) {
+                CloseConnection(*io, fd);
+            }
+        }
+    }
+}
+
+
+static int ConnectUnix(const std::filesystem::path& path)
+{
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (path.native().size() >= sizeof(addr.sun_path)) {
+        return -1;
+    }
+    strcpy(addr.sun_path, path.c_str());
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd >= 0 && connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+static bool ReadAck(int fd)
+{
+    char line[64];
+    size_t len = 0;
+    while (len < sizeof(line) - 1) {
+        ssize_t n = recv(fd, line + len, 1, 0);
+        if (n <= 0) {
+            return false;
+        }
+        if (line[len++] == '\n') {
+            break;
+        }
+    }
+    return len >= 3 && memcmp(line, "OK ", 3) == 0;
+}
+
+// Split into batches the upstream collector accepts and wait for each ack
+static bool Forward(int fd, const std::string& user, const Outgoing& out)
+{
+    const char* p = out.lines.data();
+    const char* end = p + out.lines.size();
+    char header[COLLECTOR_MAX_USER + 32];
+    while (p < end) {
+        const char* q = p;
+        size_t count = 0;
+        while (q < end && count < COLLECTOR_MAX_BATCH && (size_t)(q - p) < COLLECTOR_MAX_PAYLOAD / 2) {
+            // A last line without its newline ends the buffer
+            const char* eol = (const char*)memchr(q, '\n', end - q);
+            q = eol != NULL ? eol + 1 : end;
+            count++;
+        }
+        int len = snprintf(header, sizeof(header), "BATCH %s %zu\n", user.c_str(), count);
+        if (!SendAll(fd, header, len) || !SendAll(fd, p, q - p) || !ReadAck(fd)) {
+            return false;
+        }
+        p = q;
+    }
+    return true;
+}
+
+static void Spool(const std::string& user, const Outgoing& out)
+{
+    FILE* file = fopen((_config.root / "upstream.spool").c_str(), "ab");
+    if (file == NULL) {
+        return;
+    }
+    fprintf(file, "%s %zu\n", user.c_str(), out.records);
+    fwrite(out.lines.data(), 1, out.lines.size(), file);
+    fclose(file);
+    _stat_spooled.fetch_add(out.records, std::memory_order_relaxed);
+}
+
+// Replays the spool once upstream is back, it is only removed when all of it
+// went through. A record cut short by a crash while spooling is dropped.
+static bool ReplaySpool(int fd)
+{
+    std::filesystem::path path = _config.root / "upstream.spool";
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == NULL) {
+        return true;
+    }
+    bool ok = true;
+    char header[COLLECTOR_MAX_USER + 32];
+    char user[COLLECTOR_MAX_USER + 1];
+    char* line = NULL;
+    size_t capacity = 0;
+    Outgoing out;
+    while (ok && fgets(header, sizeof(header), file) != NULL &&
+           sscanf(header, "%64s %zu", user, &out.records) == 2) {
+        out.lines.clear();
+        size_t lines = 0;
+        for (; lines < out.records; lines++) {
+            ssize_t len = getline(&line, &capacity, file);
+            if (len <= 0 || line[len - 1] != '\n') {
+                break;
+            }
+            out.lines.append(line, len);
+        }
+        if (lines < out.records) {
+            break;
+        }
+        ok = Forward(fd, user, out);
+    }
+    free(line);
+    fclose(file);
+    if (ok) {
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+    }
+    return ok;
+}
+
+static void CollectOutboxes(bool all)
+{
+    auto now = std::chrono::steady_clock::now();
+    for (auto& shard : _shards) {
+        std::unordered_map<std::string, Outgoing> outbox;
+        {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            if (shard->outboxRecords == 0 ||
+                (!all && shard->outboxRecords < COLLECTOR_FORWARD_RECORDS &&
+                 now - shard->outboxSince < std::chrono::milliseconds(COLLECTOR_FORWARD_MS))) {
+                continue;
+            }
+            outbox.swap(shard->outbox);
+            shard->outboxRecords = 0;
+        }
+        std::lock_guard<std::mutex> lock(_upstream_mutex);
+        for (auto& item : outbox) {
+            _upstream_queue.emplace_back(item.first, std::move(item.second));
+        }
+    }
+}
+
+static void UpstreamLoop()
+{
+    int fd = -1;
+    auto retry = std::chrono::steady_clock::now();
+    while (true) {
+        bool stopping;
+        {
+            std::unique_lock<std::mutex> lock(_upstream_mutex);
+            _upstream_ready.wait_for(lock, std::chrono::milliseconds(COLLECTOR_FORWARD_MS / 4));
+            stopping = _upstream_stopping;
+        }
+        CollectOutboxes(stopping);
+
+        std::deque<std::pair<std::string, Outgoing>> queue;
+        {
+            std::lock_guard<std::mutex> lock(_upstream_mutex);
+            queue.swap(_upstream_queue);
+        }
+
+        if (fd < 0 && std::chrono::steady_clock::now() >= retry) {
+            fd = ConnectUnix(_config.upstream);
+            if (fd >= 0 && !ReplaySpool(fd)) {
+                close(fd);
+                fd = -1;
+            }
+            if (fd < 0) {
+                retry = std::chrono::steady_clock::now() + std::chrono::milliseconds(COLLECTOR_RETRY_MS);
+            }
+        }
+        for (auto& item : queue) {
+            if (fd >= 0 && !Forward(fd, item.first, item.second)) {
+                // Delivery is at least once: acked parts of this batch are spooled again
+                close(fd);
+                fd = -1;
+                retry = std::chrono::steady_clock::now() + std::chrono::milliseconds(COLLECTOR_RETRY_MS);
+            }
+            if (fd >= 0) {
+                _stat_forwarded.fetch_add(item.second.records, std::memory_order_relaxed);
+            } else {
+                Spool(item.first, item.second);
+            }
+        }
+        if (stopping) {
+            break;
+        }
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+
+typedef struct {
+    int fd;
+    std::string buffer;
+    size_t offset;
+    size_t received;
+} LineReader;
+
+static bool ReadLine(LineReader& reader, std::string& line)
+{
+    while (true) {
+        size_t eol = reader.buffer.find('\n', reader.offset);
+        if (eol != std::string::npos) {
+            line.assign(reader.buffer, reader.offset, eol - reader.offset);
+            reader.offset = eol + 1;
+            return true;
+        }
+        reader.buffer.erase(0, reader.offset);
+        reader.offset = 0;
+        char chunk[4096];
+        ssize_t n = recv(reader.fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+            return false;
+        }
+        reader.buffer.append(chunk, n);
+        reader.received += (size_t)n;
+    }
+}
+
+bool ReconcileWithCollector(const std::filesystem::path& socket, const std::string& user, const DigestTree& local,
+                            CollectorReconcileStats& stats)
+{
+    stats = {};
+    int fd = ConnectUnix(socket);
+    if (fd < 0) {
+        return false;
+    }
+    LineReader reader = {fd, std::string(), 0, 0};
+
+    auto fetch = [&](const std::vector<std::string>& paths, std::vector<std::vector<DigestEntry>>& children) {
+        for (size_t first = 0; first < paths.size(); first += COLLECTOR_MAX_DIGEST_PATHS) {
+            size_t count = std::min<size_t>(COLLECTOR_MAX_DIGEST_PATHS, paths.size() - first);
+            std::string request = "DIGEST " + user + ' ' + std::to_string(count) + '\n';
+            for (size_t i = first; i < first + count; i++) {
+                request += paths[i];
+                request += '\n';
+            }
+            if (!SendAll(fd, request.data(), request.size())) {
+                return false;
+            }
+            stats.bytesSent += request.size();
+
+            std::string line;
+            char path[64];
+            size_t n;
+            unsigned long long digest;
+            while (ReadLine(reader, line) && line != "END") {
+                // The root path is empty, so its header is just " <n>"
+                size_t space = line.rfind(' ');
+                if (space == std::string::npos || sscanf(line.c_str() + space, " %zu", &n) != 1) {
+                    return false;
+                }
+                children.emplace_back();
+                for (size_t i = 0; i < n && ReadLine(reader, line); i++) {
+                    if (sscanf(line.c_str(), "%63s %llx", path, &digest) == 2) {
+                        children.back().push_back({path, digest});
+                    }
+                }
+            }
+            if (line != "END") {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    auto send_lines = [&](const std::vector<std::string>& lines) {
+        std::string line;
+        for (size_t first = 0; first < lines.size(); first += COLLECTOR_MAX_BATCH) {
+            size_t count = std::min<size_t>(COLLECTOR_MAX_BATCH, lines.size() - first);
+            std::string request = "BATCH " + user + ' ' + std::to_string(count) + '\n';
+            for (size_t i = first; i < first + count; i++) {
+                request += lines[i];
+            }
+            if (!SendAll(fd, request.data(), request.size()) || !ReadLine(reader, line) || line.compare(0, 3, "OK ") != 0) {
+                return false;
+            }
+            stats.bytesSent += request.size();
+        }
+        return true;
+    };
+
+    bool ok = Reconcile(local, fetch, send_lines, stats.reconcile);
+    stats.bytesReceived = reader.received;
+    close(fd);
+    return ok;
+}
+
+static int Listen(const std::filesystem::path& path)
+{
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (path.native().size() >= sizeof(addr.sun_path)) {
+        return -1;
+    }
+    strcpy(addr.sun_path, path.c_str());
+    unlink(path.c_str());
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int RunCollector(const CollectorConfig& config)
+{
+    _config = config;
+    std::error_code ec;
+    std::filesystem::create_directories(_config.root, ec);
+
+    if (pipe2(_wake_pipe, O_CLOEXEC | O_NONBLOCK) != 0) {
+        return 1;
+    }
+    int listener = Listen(_config.socket);
+    if (listener < 0) {
+        perror("collector: listen");
+        return 1;
+    }
+    _collector_running = true;
+
+    _shards.clear();
+    for (size_t i = 0; i < COLLECTOR_SHARDS; i++) {
+        _shards.push_back(std::make_unique<Shard>());
+        _shards.back()->scheduled = false;
+        _shards.back()->outboxRecords = 0;
+    }
+    _pool = std::make_unique<WorkStealingPool>(_config.workers, RunShard);
+
+    unsigned ioCount = _config.ioThreads;
+    if (ioCount == 0) {
+        ioCount = std::max(1u, std::thread::hardware_concurrency() / 4);
+    }
+    std::vector<std::unique_ptr<IoThread>> io;
+    epoll_event event = {};
+    for (unsigned i = 0; i < ioCount; i++) {
+        io.push_back(std::make_unique<IoThread>());
+        io[i]->epoll = epoll_create1(EPOLL_CLOEXEC);
+        event.events = EPOLLIN;
+        event.data.fd = _wake_pipe[0];
+        epoll_ctl(io[i]->epoll, EPOLL_CTL_ADD, _wake_pipe[0], &event);
+        io[i]->thread = std::thread(IoLoop, io[i].get());
+    }
+
+    std::thread upstream;
+    if (!_config.upstream.empty()) {
+        _upstream_stopping = false;
+        upstream = std::thread(UpstreamLoop);
+    }
+
+    // Accept until stopped, connections go round robin to the I/O threads
+    int accept_epoll = epoll_create1(EPOLL_CLOEXEC);
+    event.events = EPOLLIN;
+    event.data.fd = listener;
+    epoll_ctl(accept_epoll, EPOLL_CTL_ADD, listener, &event);
+    event.data.fd = _wake_pipe[0];
+    epoll_ctl(accept_epoll, EPOLL_CTL_ADD, _wake_pipe[0], &event);
+    unsigned next = 0;
+    epoll_event ready[2];
+    while (_collector_running) {
+        int n = epoll_wait(accept_epoll, ready, 2, -1);
+        for (int i = 0; i < n; i++) {
+            if (ready[i].data.fd == _wake_pipe[0]) {
+                _collector_running = false;
+                continue;
+            }
+            int fd;
+            while ((fd = accept4(listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                auto connection = std::make_shared<Connection>();
+                connection->fd = fd;
+                IoThread& target = *io[next++ % ioCount];
+                connection->epoll = target.epoll;
+                connection->offset = 0;
+                connection->scan = 0;
+                connection->lines = 0;
+
+                {
+                    std::lock_guard<std::mutex> lock(target.mutex);
+                    target.connections[fd] = connection;
+                }
+                _stat_connections.fetch_add(1, std::memory_order_relaxed);
+                event.events = EPOLLIN | EPOLLRDHUP;
+                event.data.fd = fd;
+                epoll_ctl(target.epoll, EPOLL_CTL_ADD, fd, &event);
+            }
+        }
+    }
+
+    // Stop reading, finish every queued batch, then forward what is left
+    close(accept_epoll);
+    close(listener);
+    unlink(_config.socket.c_str());
+    for (auto& thread : io) {
+        thread->thread.join();
+        close(thread->epoll);
+        thread->connections.clear();
+    }
+    _pool->Stop();
+    if (upstream.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(_upstream_mutex);
+            _upstream_stopping = true;
+        }
+        _upstream_ready.notify_one();
+        upstream.join();
+    }
+    for (auto& shard : _shards) {
+        for (auto& item : shard->files) {
+            fclose(item.second.file);
+        }
+    }
+    close(_wake_pipe[0]);
+    close(_wake_pipe[1]);
+    return 0;
+}
+
+void StopCollector()
+{
+    char c = 1;
+    _collector_running = false;
+    if (_wake_pipe[1] >= 0) {
+        ssize_t n = write(_wake_pipe[1], &c, 1);
+        (void)n;
+    }
+}
+
+CollectorStats GetCollectorStats()
+{
+    CollectorStats stats;
+    stats.connections = _stat_connections.load(std::memory_order_relaxed);
+    stats.batches = _stat_batches.load(std::memory_order_relaxed);
+    stats.records = _stat_records.load(std::memory_order_relaxed);
+    stats.malformed = _stat_malformed.load(std::memory_order_relaxed);
+    stats.forwarded = _stat_forwarded.load(std::memory_order_relaxed);
+    stats.spooled = _stat_spooled.load(std::memory_order_relaxed);
+    stats.steals = _pool ? _pool->Steals() : 0;
+    return stats;
+}
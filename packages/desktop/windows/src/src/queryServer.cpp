@@ -0,0 +1,646 @@
+#include "queryServer.h"
+#include "trackerActivity.h"
+#include "trackerArchive.h"
+#include "trackerArrow.h"
+#include "trackerGovernor.h"
+#include "trackerImport.h"
+#include "trackerIndex.h"
+#include "trackerJson.h"
+#include "trackerRollup.h"
+#include "trackerState.h"
+#include "trackerTasks.h"
+#include "trackerTime.h"
+#include "usageSketch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#include <sddl.h>
+#else
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif // _WIN32
+
+#define QUERY_BUFFER_SIZE 4096
+#define QUERY_MAX_LINE 256
+#define QUERY_DEFAULT_TOP 10
+#define QUERY_EXPORT_CHUNK 65536
+#define QUERY_MAX_CONNECTIONS 16 // Each has a thread, subscribers keep theirs
+#define QUERY_SUBSCRIBE_PROBE 1000 // ms between checks that an idle subscriber is still there
+
+#ifdef _WIN32
+typedef HANDLE Channel;
+#else
+typedef int Channel;
+#endif // _WIN32
+
+typedef struct {
+    long long seconds;
+    size_t sessions;
+} Usage;
+
+typedef std::unordered_map<std::string, Usage> UsageMap;
+
+
+std::atomic<bool> _query_running(false);
+std::atomic<int> _query_connections(0);
+std::mutex _query_mutex;
+std::condition_variable _session_changed;
+unsigned long long _session_seq = 0;
+long _usage_day = -1;
+UsageMap _today_usage;
+#ifndef _WIN32
+int _listen_fd = -1;
+#endif // _WIN32
+
+
+static void CountSession(UsageMap& usage, const AppLogger& log)
+{
+    Usage& u = usage[log.executable];
+    u.seconds += UnseenSeconds(log);
+    u.sessions += !log.resumed;
+}
+
+static void OnSessionClosed(const AppLogger& log)
+{
+    {
+        std::lock_guard<std::mutex> lock(_query_mutex);
+        long day = DayNumber(log.start);
+        if (day > _usage_day) {
+            _usage_day = day;
+            _today_usage.clear();
+        }
+        if (day == _usage_day) {
+            CountSession(_today_usage, log);
+        }
+        _session_seq++;
+    }
+    _session_changed.notify_all();
+}
+
+
+static bool ChannelWrite(Channel channel, const std::string& data)
+{
+#ifdef _WIN32
+    DWORD written = 0;
+    return WriteFile(channel, data.data(), (DWORD)data.size(), &written, NULL) && written == data.size();
+#else
+    size_t offset = 0;
+    while (offset < data.size()) {
+        ssize_t n = send(channel, data.data() + offset, data.size() - offset, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        offset += n;
+    }
+    return true;
+#endif // _WIN32
+}
+
+static long ChannelRead(Channel channel, char* buffer, size_t size)
+{
+#ifdef _WIN32
+    DWORD read = 0;
+    if (!ReadFile(channel, buffer, (DWORD)size, &read, NULL)) {
+        return -1;
+    }
+    return (long)read;
+#else
+    return (long)recv(channel, buffer, size, 0);
+#endif // _WIN32
+}
+
+// False once the client closed its end
+static bool ChannelOpen(Channel channel)
+{
+#ifdef _WIN32
+    DWORD available = 0;
+    return PeekNamedPipe(channel, NULL, 0, NULL, &available, NULL) != 0;
+#else
+    char byte;
+    ssize_t n = recv(channel, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    return n > 0 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+#endif // _WIN32
+}
+
+static void ChannelClose(Channel channel)
+{
+#ifdef _WIN32
+    FlushFileBuffers(channel);
+    DisconnectNamedPipe(channel);
+    CloseHandle(channel);
+#else
+    close(channel);
+#endif // _WIN32
+}
+
+
+static void AppendUsage(std::string& out, const UsageMap& usage, size_t count, bool sessions)
+{
+    std::vector<std::pair<const std::string*, Usage>> rows;
+    rows.reserve(usage.size());
+    for (const auto& item : usage) {
+        rows.push_back({&item.first, item.second});
+    }
+    count = std::min(count, rows.size());
+    std::partial_sort(rows.begin(), rows.begin() + count, rows.end(), [](const auto& a, const auto& b) {
+        return a.second.seconds != b.second.seconds ? a.second.seconds > b.second.seconds : *a.first < *b.first;
+    });
+
+    char number[48];
+    for (size_t i = 0; i < count; i++) {
+        out += *rows[i].first;
+        if (sessions) {
+            snprintf(number, sizeof(number), " ; %lld ; %zu\n", rows[i].second.seconds, rows[i].second.sessions);
+        } else {
+            snprintf(number, sizeof(number), " ; %lld\n", rows[i].second.seconds);
+        }
+        out += number;
+    }
+}
+
+static void AppendCurrent(std::string& out)
+{
+    TrackerStateView view;
+    if (view.get() != nullptr && view->hasSession) {
+        out += GetLineStr(view->current);
+    }
+}
+
+static void AppendTop(std::string& out, size_t count)
+{
+    UsageMap usage;
+    long day;
+    {
+        std::lock_guard<std::mutex> lock(_query_mutex);
+        usage = _today_usage;
+        day = _usage_day;
+    }
+    // The open session is only counted once it closes
+    AppLogger current;
+    if (GetCurrentSession(current) && DayNumber(current.start) >= day) {
+        if (DayNumber(current.start) > day) {
+            usage.clear();
+        }
+        CountSession(usage, current);
+    }
+    AppendUsage(out, usage, count, false);
+}
+
+static void AddUsage(UsageMap& usage, const std::string& executable, long long seconds, size_t sessions)
+{
+    Usage& u = usage[executable];
+    u.seconds += seconds;
+    u.sessions += sessions;
+}
+
+// Only the seconds within the days [first, last], the session counts on the day it started
+static void CountSessionWithin(UsageMap& usage, const AppLogger& log, long first, long last)
+{
+    long day = DayNumber(log.start);
+    bool started = day >= first && day <= last;
+    long long seconds = RollupSeconds(log, first, last);
+    if (seconds > 0 || started) {
+        AddUsage(usage, log.executable, seconds, started && !log.resumed);
+    }
+}
+
+// Seconds split at midnight, sessions counted on the day they started. Days
+// the rollups keep in memory come from them. Older ones come from the archive
+// blocks covering those days, and from the start of the text log for days it
+// still holds, e.g. a month left there until its archive is repaired; the log
+// is read only until the first session past them.
+static void AppendRange(std::string& out, ULONGLONG from, ULONGLONG to, size_t count)
+{
+    long first = DayNumber(TimeFromKey(from));
+    long last = DayNumber(TimeFromKey(to));
+    long today = DayNumber(GetTime());
+    long kept = today - ROLLUP_KEEP_DAYS;
+    UsageMap usage;
+
+    std::map<std::string, DailyRollup> rollups;
+    for (long day = std::max(first, kept); day <= std::min(last, today); day++) {
+        if (GetDailyRollup(day, rollups)) {
+            for (const auto& item : rollups) {
+                AddUsage(usage, item.first, item.second.seconds, item.second.sessions);
+            }
+        }
+    }
+    // Rollups count a session as it closes, the open one is added here
+    AppLogger current;
+    if (GetCurrentSession(current) && std::max(first, kept) <= last) {
+        CountSessionWithin(usage, current, std::max(first, kept), last);
+    }
+
+    long archived = std::min(last, kept - 1);
+    if (first <= archived) {
+        // From the day before, a session may run past midnight into the range
+        SYSTEMTIME start = TimeFromSeconds((long long)(first - 1) * 86400);
+        SYSTEMTIME end = TimeFromSeconds((long long)archived * 86400 + 86399);
+        unsigned firstMonth = start.wYear * 100u + start.wMonth;
+        unsigned lastMonth = end.wYear * 100u + end.wMonth;
+        std::vector<AppLogger> logs;
+        std::error_code ec;
+        unsigned year, month;
+        for (const auto& entry : std::filesystem::directory_iterator(GetLogFilePath().parent_path() / "Archive", ec)) {
+            ArchiveReader reader;
+            if (entry.path().extension() == ".csa" &&
+                sscanf(entry.path().stem().string().c_str(), "%u-%u", &year, &month) == 2 &&
+                year * 100 + month >= firstMonth && year * 100 + month <= lastMonth && OpenArchive(entry.path(), reader)) {
+                ReadArchiveRange(reader, TimeKey(start), TimeKey(end), logs);
+            }
+        }
+        std::ifstream file(GetLogFilePath(), std::ios::binary);
+        std::string line;
+        AppLogger log;
+        while (std::getline(file, line)) {
+            if (!ParseLogLine(line.data(), line.size(), log)) {
+                continue;
+            }
+            if (TimeKey(log.start) > TimeKey(end)) {
+                break;
+            }
+            if (TimeKey(log.start) >= TimeKey(start)) {
+                logs.push_back(log);
+            }
+        }
+        for (const auto& log : logs) {
+            CountSessionWithin(usage, log, first, archived);
+        }
+    }
+    AppendUsage(out, usage, count, true);
+}
+
+static void AppendSketch(std::string& out, const std::vector<SpaceSaving::Counter>& top)
+{
+    char number[48];
+    for (const auto& counter : top) {
+        out += counter.key;
+        snprintf(number, sizeof(number), " ; %llu ; %llu\n", (unsigned long long)counter.count,
+                 (unsigned long long)counter.error);
+        out += number;
+    }
+}
+
+static void AppendTasks(std::string& out, ULONGLONG from, ULONGLONG to, AttributionMode mode)
+{
+    char number[64];
+    for (const auto& task : AttributeTasks(from, to, mode)) {
+        out += task.task;
+        snprintf(number, sizeof(number), " ; %llu ; %lld ; %zu\n", (unsigned long long)(task.seconds + 0.5),
+                 task.plannedSeconds, task.sessions);
+        out += number;
+    }
+}
+
+static void AppendHeatmap(std::string& out, const std::string& key, int days)
+{
+    unsigned long long hours[7][24];
+    long today = DayNumber(GetTime());
+    ActivityByHour(key, today - days + 1, today, hours);
+    char number[24];
+    for (int day = 0; day < 7; day++) {
+        snprintf(number, sizeof(number), "%d ;", day);
+        out += number;
+        for (int hour = 0; hour < 24; hour++) {
+            snprintf(number, sizeof(number), " %llu", hours[day][hour]);
+            out += number;
+        }
+        out += '\n';
+    }
+}
+
+static void Subscribe(Channel channel)
+{
+    unsigned long long seen;
+    {
+        std::lock_guard<std::mutex> lock(_query_mutex);
+        seen = _session_seq;
+    }
+    std::string out;
+    AppLogger current;
+    while (true) {
+        // Read through the logger lock: the snapshot is only republished after the tick
+        out.clear();
+        if (GetCurrentSession(current)) {
+            out += GetLineStr(current);
+        }
+        out += '\n';
+        if (!ChannelWrite(channel, out)) {
+            return;
+        }
+
+        // A subscriber that went away between two changes gives its slot back
+        // on the next probe rather than on the next change
+        std::unique_lock<std::mutex> lock(_query_mutex);
+        while (!_session_changed.wait_for(lock, std::chrono::milliseconds(QUERY_SUBSCRIBE_PROBE),
+                                          [&]() { return _session_seq != seen || !_query_running; })) {
+            lock.unlock();
+            bool open = ChannelOpen(channel);
+            lock.lock();
+            if (!open) {
+                return;
+            }
+        }
+        if (!_query_running) {
+            return;
+        }
+        seen = _session_seq;
+    }
+}
+
+// Streams an export in chunks, the reader sees the connection close at the end.
+// exporter is called with the sink to hand to ExportArrow or ExportJson.
+template<typename Exporter>
+static void Export(Channel channel, std::string& out, Exporter exporter)
+{
+    out.clear();
+    exporter([&](const char* data, size_t size) {
+        out.append(data, size);
+        if (out.size() < QUERY_EXPORT_CHUNK) {
+            return true;
+        }
+        bool ok = ChannelWrite(channel, out);
+        out.clear();
+        return ok;
+    });
+    if (!out.empty()) {
+        ChannelWrite(channel, out);
+    }
+}
+
+// The arguments after a whole command word, NULL when line is another request
+static const char* CommandArgs(const char* line, const char* command)
+{
+    size_t len = strlen(command);
+    if (strncmp(line, command, len) != 0 || (line[len] != '\0' && line[len] != ' ')) {
+        return NULL;
+    }
+    return line + len;
+}
+
+// Returns false when the connection should close
+static bool HandleRequest(Channel channel, const char* line, std::string& out)
+{
+    size_t count = QUERY_DEFAULT_TOP;
+    unsigned long long from, to;
+    long long device;
+    int days;
+    int used = 0;
+    const char* args;
+
+    out.clear();
+    if (strcmp(line, "CURRENT") == 0) {
+        AppendCurrent(out);
+    } else if ((args = CommandArgs(line, "TOP"))) {
+        sscanf(args, "%zu", &count);
+        AppendTop(out, count);
+    } else if ((args = CommandArgs(line, "RANGE")) && sscanf(args, "%llu %llu %zu", &from, &to, &count) >= 2) {
+        AppendRange(out, from, to, count);
+    } else if ((args = CommandArgs(line, "APPS")) && sscanf(args, "%d %zu", &days, &count) >= 1 && days > 0) {
+        AppendSketch(out, TopApps(count, std::min(days, SKETCH_DAYS)));
+    } else if ((args = CommandArgs(line, "TITLES")) && sscanf(args, "%d %zu", &days, &count) >= 1 && days > 0) {
+        AppendSketch(out, TopTitles(count, std::min(days, SKETCH_DAYS)));
+    } else if ((args = CommandArgs(line, "SEARCH")) && *args == ' ') {
+        args++;
+        if (sscanf(args, "%llu %llu %n", &from, &to, &used) < 2 || used == 0) {
+            from = to = 0;
+        }
+        for (const auto& log : SearchTitles(args + used, from, to)) {
+            out += GetLineStr(log);
+        }
+    } else if ((args = CommandArgs(line, "HEATMAP")) && sscanf(args, "%d %n", &days, &used) >= 1 && days > 0) {
+        AppendHeatmap(out, used > 0 && args[used] != '\0' ? args + used : ACTIVITY_ACTIVE, days);
+    } else if (strcmp(line, "GOVERNOR") == 0) {
+        char load[32];
+        snprintf(load, sizeof(load), " %.2f\n", GetGovernorLoad());
+        out += GovernorModeName(GetGovernorMode());
+        out += load;
+    } else if ((args = CommandArgs(line, "TASKS")) && sscanf(args, "%llu %llu %n", &from, &to, &used) >= 2) {
+        AppendTasks(out, from, to, used > 0 && strcmp(args + used, "EACH") == 0 ? ATTRIBUTE_EACH : ATTRIBUTE_SHARED);
+    } else if ((args = CommandArgs(line, "EXPORT")) && sscanf(args, "%llu %llu", &from, &to) == 2) {
+        Export(channel, out, [&](const auto& sink) { ExportArrow(from, to, sink); });
+        return false;
+    } else if ((args = CommandArgs(line, "JSON")) && sscanf(args, "%llu %llu %lld", &from, &to, &device) == 3) {
+        Export(channel, out, [&](const auto& sink) { ExportJson(from, to, device, sink); });
+        return false;
+    } else if (strcmp(line, "SUBSCRIBE") == 0) {
+        Subscribe(channel);
+        return false;
+    } else {
+        out += "ERROR unknown request\n";
+    }
+    out += '\n';
+    return ChannelWrite(channel, out);
+}
+
+static void ServeConnection(Channel channel)
+{
+    char buffer[QUERY_BUFFER_SIZE];
+    std::string line;
+    std::string out;
+    long n;
+    bool open = true;
+    while (open && _query_running && (n = ChannelRead(channel, buffer, sizeof(buffer))) > 0) {
+        for (long i = 0; open && i < n; i++) {
+            if (buffer[i] != '\n') {
+                if (buffer[i] != '\r' && line.size() < QUERY_MAX_LINE) {
+                    line += buffer[i];
+                }
+                continue;
+            }
+            open = HandleRequest(channel, line.c_str(), out);
+            line.clear();
+        }
+    }
+    ChannelClose(channel);
+    _query_connections--;
+}
+
+// A thread per connection up to QUERY_MAX_CONNECTIONS, past that the client
+// is told to come back later rather than the process growing without bound
+static void StartConnection(Channel channel)
+{
+    if (++_query_connections > QUERY_MAX_CONNECTIONS) {
+        ChannelWrite(channel, "ERROR busy\n\n");
+        ChannelClose(channel);
+        _query_connections--;
+        return;
+    }
+    std::thread(ServeConnection, channel).detach();
+}
+
+// Today's sessions already in the log, counted under the lock and before the
+// pipe or socket exists, so no reply is built from a partial seed
+static void SeedTodayUsage()
+{
+    long today = DayNumber(GetTime());
+    std::vector<AppLogger> logs;
+    std::lock_guard<std::mutex> lock(_query_mutex);
+    if (_usage_day > today) {
+        return;
+    }
+    ImportLogTail(GetLogFilePath(), TimeKey(TimeFromSeconds((long long)today * 86400)), logs);
+    _usage_day = today;
+    for (const auto& log : logs) {
+        if (DayNumber(log.start) == today) {
+            CountSession(_today_usage, log);
+        }
+    }
+}
+
+#ifdef _WIN32
+// A DACL granting the current user alone, so other users on the machine can
+// neither read the history nor open instances of the pipe
+static bool CurrentUserSecurity(SECURITY_ATTRIBUTES& security)
+{
+    HANDLE token;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_QUERY, &token)) {
+        return false;
+    }
+    DWORD size = 0;
+    GetTokenInformation(token, TokenUser, NULL, 0, &size);
+    std::vector<char> user(size);
+    char* sid = NULL;
+    bool ok = size > 0 && GetTokenInformation(token, TokenUser, user.data(), size, &size) &&
+              ConvertSidToStringSidA(((TOKEN_USER*)user.data())->User.Sid, &sid);
+    CloseHandle(token);
+    if (!ok) {
+        return false;
+    }
+    std::string sddl = std::string("D:P(A;;GA;;;") + sid + ")";
+    LocalFree(sid);
+    security.nLength = sizeof(security);
+    security.bInheritHandle = FALSE;
+    return ConvertStringSecurityDescriptorToSecurityDescriptorA(sddl.c_str(), SDDL_REVISION_1,
+                                                                &security.lpSecurityDescriptor, NULL);
+}
+
+static HANDLE CreatePipeInstance(SECURITY_ATTRIBUTES& security, DWORD flags)
+{
+    return CreateNamedPipeA(QUERY_PIPE_NAME, PIPE_ACCESS_DUPLEX | flags,
+                            PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                            PIPE_UNLIMITED_INSTANCES, QUERY_BUFFER_SIZE, QUERY_BUFFER_SIZE, 0, &security);
+}
+#else
+std::string QuerySocketPath()
+{
+    const char* dir = getenv("XDG_RUNTIME_DIR");
+    if (dir && *dir) {
+        return std::string(dir) + "/" + QUERY_SOCKET_NAME;
+    }
+    return std::string(QUERY_SOCKET_FALLBACK) + std::to_string(getuid()) + "/" + QUERY_SOCKET_NAME;
+}
+
+// XDG_RUNTIME_DIR is private to the user by definition. The fallback under
+// /tmp is created 0700 and refused when someone else made it first.
+static bool PrivateSocketDir(const std::string& path)
+{
+    const char* runtime = getenv("XDG_RUNTIME_DIR");
+    if (runtime && *runtime) {
+        return true;
+    }
+    std::string dir = path.substr(0, path.rfind('/'));
+    struct stat st;
+    if (mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST) {
+        return false;
+    }
+    return lstat(dir.c_str(), &st) == 0 && S_ISDIR(st.st_mode) && st.st_uid == getuid() &&
+           (st.st_mode & 0777) == 0700;
+}
+#endif // _WIN32
+
+void QueryServerLoop()
+{
+    _query_running = true;
+    SeedTodayUsage();
+    AddSessionListener(OnSessionClosed);
+
+#ifdef _WIN32
+    SECURITY_ATTRIBUTES security = {};
+    if (!CurrentUserSecurity(security)) {
+        return;
+    }
+    // Fails when another process already owns the name
+    HANDLE pipe = CreatePipeInstance(security, FILE_FLAG_FIRST_PIPE_INSTANCE);
+    while (_query_running && pipe != INVALID_HANDLE_VALUE) {
+        if (!ConnectNamedPipe(pipe, NULL) && GetLastError() != ERROR_PIPE_CONNECTED) {
+            DisconnectNamedPipe(pipe);
+            continue;
+        }
+        if (!_query_running) {
+            break;
+        }
+        // The next instance exists before this one is handed off, so the name
+        // never lapses for another process to take
+        HANDLE next = CreatePipeInstance(security, 0);
+        StartConnection(pipe);
+        pipe = next;
+    }
+    if (pipe != INVALID_HANDLE_VALUE) {
+        CloseHandle(pipe);
+    }
+    LocalFree(security.lpSecurityDescriptor);
+#else
+    std::string path = QuerySocketPath();
+    if (!PrivateSocketDir(path)) {
+        return;
+    }
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        return;
+    }
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    _listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path.c_str());
+    if (_listen_fd < 0 || bind(_listen_fd, (sockaddr*)&addr, sizeof(addr)) != 0 || chmod(path.c_str(), 0600) != 0 ||
+        listen(_listen_fd, SOMAXCONN) != 0) {
+        return;
+    }
+    while (_query_running) {
+        int fd = accept(_listen_fd, NULL, NULL);
+        if (fd < 0) {
+            break;
+        }
+        StartConnection(fd);
+    }
+    close(_listen_fd);
+    unlink(path.c_str());
+#endif // _WIN32
+}
+
+void StopQueryServer()
+{
+    {
+        std::lock_guard<std::mutex> lock(_query_mutex);
+        _query_running = false;
+    }
+    _session_changed.notify_all();
+
+    // Unblock the accept loop
+#ifdef _WIN32
+    HANDLE pipe = CreateFileA(QUERY_PIPE_NAME, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+    if (pipe != INVALID_HANDLE_VALUE) {
+        CloseHandle(pipe);
+    }
+#else
+    if (_listen_fd >= 0) {
+        shutdown(_listen_fd, SHUT_RDWR);
+    }
+#endif // _WIN32
+}
@@ -1,6 +1,8 @@
 #include "trackerAFK.h"
 #include "admin.h"
+#include "trackerGovernor.h"
 
+#include <atomic>
 #include <fstream>
 #include <string>
 #include <sstream>
@@ -10,7 +12,7 @@
 #endif // _DEBUG
 
 
-bool _afk_monitoring = true;
+std::atomic<bool> _afk_monitoring(true);
 
 bool isSleepPrevented() 
 {
@@ -118,9 +120,23 @@ DWORD AFKtime()
     return GetTickCount() - lastInputInfo.dwTime;
 }
 
+// Spawning powercfg is the most expensive thing the tracker does, so over
+// budget the last answer is reused until the governor allows another probe
+static bool SleepPreventedThrottled()
+{
+    static std::atomic<bool> prevented(false);
+    static std::atomic<ULONGLONG> last(0);
+    ULONGLONG now = GetTickCount64();
+    if (last == 0 || GovernorAllowsProbe(last, now)) {
+        prevented = isSleepPrevented();
+        last = now;
+    }
+    return prevented;
+}
+
 bool IsAFK(DWORD time) 
 {
-    return (IsAFKMonitoringActive() && AFKtime() > time && !isSleepPrevented());
+    return (IsAFKMonitoringActive() && AFKtime() > time && !SleepPreventedThrottled());
 }
 
 
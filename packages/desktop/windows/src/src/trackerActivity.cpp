@@ -0,0 +1,496 @@
+#include "trackerActivity.h"
+#include "trackerArchive.h"
+#include "trackerImport.h"
+#include "trackerTime.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif // __SSE2__
+
+#define ACTIVITY_MAGIC 0x32544341 // "ACT2"
+#define HOUR_MASK ((1ULL << 60) - 1)
+
+
+template<typename T>
+static void Put(std::string& out, T value)
+{
+    out.append((const char*)&value, sizeof(value));
+}
+
+template<typename T>
+static bool Get(const char*& p, const char* end, T& value)
+{
+    if ((size_t)(end - p) < sizeof(value)) {
+        return false;
+    }
+    memcpy(&value, p, sizeof(value));
+    p += sizeof(value);
+    return true;
+}
+
+
+static inline unsigned Popcount64(uint64_t x)
+{
+#ifdef __POPCNT__
+    return (unsigned)__builtin_popcountll(x);
+#else
+    x -= (x >> 1) & 0x5555555555555555ULL;
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (unsigned)((x * 0x0101010101010101ULL) >> 56);
+#endif // __POPCNT__
+}
+
+#ifdef __SSE2__
+// Bit count of every byte, the same steps as Popcount64 on 16 bytes at once
+static inline __m128i PopcountBytes(__m128i v)
+{
+    const __m128i m1 = _mm_set1_epi8(0x55);
+    const __m128i m2 = _mm_set1_epi8(0x33);
+    const __m128i m4 = _mm_set1_epi8(0x0F);
+    v = _mm_sub_epi8(v, _mm_and_si128(_mm_srli_epi16(v, 1), m1));
+    v = _mm_add_epi8(_mm_and_si128(v, m2), _mm_and_si128(_mm_srli_epi16(v, 2), m2));
+    return _mm_and_si128(_mm_add_epi8(v, _mm_srli_epi16(v, 4)), m4);
+}
+
+// Byte counts stay under 8 * ACTIVITY_WORDS / 2 = 96, so a single sum at the end
+template<typename Op>
+static inline unsigned CountWords(const DayBitmap& a, const DayBitmap& b, Op op)
+{
+    __m128i bytes = _mm_setzero_si128();
+    for (int i = 0; i < ACTIVITY_WORDS; i += 2) {
+        __m128i v = op(_mm_load_si128((const __m128i*)(a.words + i)), _mm_load_si128((const __m128i*)(b.words + i)));
+        bytes = _mm_add_epi8(bytes, PopcountBytes(v));
+    }
+    __m128i sums = _mm_sad_epu8(bytes, _mm_setzero_si128());
+    return (unsigned)(_mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_srli_si128(sums, 8)));
+}
+#else
+template<typename Op>
+static inline unsigned CountWords(const DayBitmap& a, const DayBitmap& b, Op op)
+{
+    unsigned count = 0;
+    for (int i = 0; i < ACTIVITY_WORDS; i++) {
+        count += Popcount64(op(a.words[i], b.words[i]));
+    }
+    return count;
+}
+#endif // __SSE2__
+
+#ifdef __SSE2__
+#define ACTIVITY_AND [](__m128i x, __m128i y) { return _mm_and_si128(x, y); }
+#define ACTIVITY_OR [](__m128i x, __m128i y) { return _mm_or_si128(x, y); }
+#else
+#define ACTIVITY_AND [](uint64_t x, uint64_t y) { return x & y; }
+#define ACTIVITY_OR [](uint64_t x, uint64_t y) { return x | y; }
+#endif // __SSE2__
+
+
+void MarkMinutes(DayBitmap& map, unsigned from, unsigned to)
+{
+    for (unsigned w = from / 64; w <= to / 64; w++) {
+        uint64_t mask = ~0ULL;
+        if (w == from / 64) {
+            mask &= ~0ULL << (from % 64);
+        }
+        if (w == to / 64) {
+            mask &= ~0ULL >> (63 - to % 64);
+        }
+        map.words[w] |= mask;
+    }
+}
+
+unsigned CountMinutes(const DayBitmap& map)
+{
+    return CountWords(map, map, ACTIVITY_AND);
+}
+
+unsigned CountMinutesAnd(const DayBitmap& a, const DayBitmap& b)
+{
+    return CountWords(a, b, ACTIVITY_AND);
+}
+
+unsigned CountMinutesOr(const DayBitmap& a, const DayBitmap& b)
+{
+    return CountWords(a, b, ACTIVITY_OR);
+}
+
+void CountHours(const DayBitmap& map, unsigned out[24])
+{
+    // 60 bits per hour, spanning at most two words
+    for (unsigned h = 0; h < 24; h++) {
+        unsigned w = h * 60 / 64;
+        unsigned s = h * 60 % 64;
+        uint64_t bits = map.words[w] >> s;
+        if (s > 4) {
+            bits |= map.words[w + 1] << (64 - s);
+        }
+        out[h] = Popcount64(bits & HOUR_MASK);
+    }
+}
+
+
+void ActivitySeries::Mark(long day, unsigned from, unsigned to)
+{
+    // Sessions close in order, so the day is nearly always the last one or new
+    size_t i;
+    if (_days.empty() || _days.back() < day) {
+        i = _days.size();
+        _days.push_back(day);
+        _maps.push_back({});
+    } else {
+        i = _days.back() == day ? _days.size() - 1 : Find(day);
+        if (_days[i] != day) {
+            _days.insert(_days.begin() + i, day);
+            _maps.insert(_maps.begin() + i, DayBitmap{});
+        }
+    }
+    MarkMinutes(_maps[i], from, to);
+}
+
+void ActivitySeries::Merge(const ActivitySeries& other)
+{
+    for (size_t j = 0; j < other._days.size(); j++) {
+        size_t i = Find(other._days[j]);
+        if (i == _days.size() || _days[i] != other._days[j]) {
+            _days.insert(_days.begin() + i, other._days[j]);
+            _maps.insert(_maps.begin() + i, other._maps[j]);
+            continue;
+        }
+        for (int w = 0; w < ACTIVITY_WORDS; w++) {
+            _maps[i].words[w] |= other._maps[j].words[w];
+        }
+    }
+}
+
+size_t ActivitySeries::Find(long day) const
+{
+    return std::lower_bound(_days.begin(), _days.end(), day) - _days.begin();
+}
+
+void ActivitySeries::Serialize(std::string& out) const
+{
+    Put(out, (uint32_t)_days.size());
+    for (size_t i = 0; i < _days.size(); i++) {
+        Put(out, (int32_t)_days[i]);
+        out.append((const char*)_maps[i].words, sizeof(_maps[i].words));
+    }
+}
+
+bool ActivitySeries::Deserialize(const char*& p, const char* end)
+{
+    uint32_t count;
+    if (!Get(p, end, count) || (size_t)(end - p) / (sizeof(int32_t) + sizeof(DayBitmap::words)) < count) {
+        return false;
+    }
+    _days.resize(count);
+    _maps.resize(count);
+    int32_t day = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        Get(p, end, day);
+        _days[i] = day;
+        memcpy(_maps[i].words, p, sizeof(_maps[i].words));
+        p += sizeof(_maps[i].words);
+    }
+    return std::is_sorted(_days.begin(), _days.end());
+}
+
+
+std::mutex _activity_mutex;
+std::unordered_map<std::string, ActivitySeries> _activity;
+bool _activity_dirty = false;
+// TimeKey of the newest session start marked, saved with the series
+ULONGLONG _activity_checkpoint = 0;
+// False while the saved series have not been merged in yet
+bool _activity_loaded = true;
+
+static std::filesystem::path ActivityPath()
+{
+    return GetLogFilePath().parent_path() / ACTIVITY_FILE;
+}
+
+// Caller holds _activity_mutex. Marking is idempotent, replaying a session is harmless.
+static void MarkSession(const AppLogger& log)
+{
+    long long start = TimeSeconds(log.start);
+    long long end = std::max(start, TimeSeconds(log.end));
+    bool active = log.executable != "AFK";
+    const char* state = active ? ACTIVITY_ACTIVE : log.title == "Lock" ? ACTIVITY_LOCKED : ACTIVITY_AFK;
+    ActivitySeries& states = _activity[state];
+    ActivitySeries* app = active ? &_activity[log.executable] : nullptr;
+
+    // A session ending exactly on a minute boundary does not reach into that minute
+    long long last = end > start ? end - 1 : start;
+    for (long day = (long)(start / 86400); day <= (long)(last / 86400); day++) {
+        unsigned from = day == start / 86400 ? (unsigned)(start % 86400 / 60) : 0;
+        unsigned to = day == last / 86400 ? (unsigned)(last % 86400 / 60) : ACTIVITY_MINUTES - 1;
+        states.Mark(day, from, to);
+        if (app != nullptr) {
+            app->Mark(day, from, to);
+        }
+    }
+    _activity_checkpoint = std::max(_activity_checkpoint, TimeKey(log.start));
+    _activity_dirty = true;
+}
+
+static void OnSessionClosed(const AppLogger& log)
+{
+    std::lock_guard<std::mutex> lock(_activity_mutex);
+    MarkSession(log);
+}
+
+// Reads only the magic and the checkpoint
+static bool ReadActivityCheckpoint(ULONGLONG& checkpoint)
+{
+    char header[sizeof(uint32_t) + sizeof(uint64_t)];
+    std::ifstream file(ActivityPath(), std::ios::binary);
+    if (!file.read(header, sizeof(header))) {
+        return false;
+    }
+    const char* p = header;
+    uint32_t magic;
+    uint64_t key;
+    if (!Get(p, header + sizeof(header), magic) || magic != ACTIVITY_MAGIC || !Get(p, header + sizeof(header), key)) {
+        return false;
+    }
+    checkpoint = key;
+    return true;
+}
+
+static bool LoadActivity(std::unordered_map<std::string, ActivitySeries>& activity)
+{
+    std::ifstream file(ActivityPath(), std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    const char* p = data.data();
+    const char* end = p + data.size();
+    uint32_t magic, count, size;
+    uint64_t checkpoint;
+    if (!Get(p, end, magic) || magic != ACTIVITY_MAGIC || !Get(p, end, checkpoint) || !Get(p, end, count)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        if (!Get(p, end, size) || (size_t)(end - p) < size) {
+            return false;
+        }
+        std::string key(p, size);
+        p += size;
+        if (!activity[key].Deserialize(p, end)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Caller holds _activity_mutex. Folds the saved series under whatever was
+// marked since start.
+static void EnsureActivityLoaded()
+{
+    if (_activity_loaded) {
+        return;
+    }
+    _activity_loaded = true;
+    std::unordered_map<std::string, ActivitySeries> saved;
+    if (!LoadActivity(saved)) {
+        return;
+    }
+    for (const auto& item : saved) {
+        _activity[item.first].Merge(item.second);
+    }
+}
+
+
+void StartActivity()
+{
+    std::filesystem::path logPath = GetLogFilePath();
+    {
+        std::lock_guard<std::mutex> lock(_activity_mutex);
+        ULONGLONG checkpoint = 0;
+        if (ReadActivityCheckpoint(checkpoint)) {
+            _activity_checkpoint = checkpoint;
+            _activity_loaded = false;
+        } else {
+            // First run: everything already archived
+            std::error_code ec;
+            for (const auto& entry : std::filesystem::directory_iterator(logPath.parent_path() / "Archive", ec)) {
+                ArchiveReader reader;
+                if (entry.path().extension() != ".csa" || !OpenArchive(entry.path(), reader)) {
+                    continue;
+                }
+                std::vector<AppLogger> logs;
+                for (size_t i = 0; i < reader.blocks.size(); i++) {
+                    ReadArchiveBlock(reader, i, logs);
+                }
+                for (const auto& log : logs) {
+                    MarkSession(log);
+                }
+            }
+        }
+
+        // Only what the log gained since the last save
+        std::vector<AppLogger> logs;
+        ImportLogTail(logPath, checkpoint, logs);
+        for (const auto& log : logs) {
+            MarkSession(log);
+        }
+    }
+    AddSessionListener(OnSessionClosed);
+}
+
+// Caller holds _activity_mutex. Drops the executables past the
+// ACTIVITY_MAX_APPS with the most minutes, the user-level states stay.
+static void PruneActivity()
+{
+    std::vector<std::pair<unsigned long long, std::string>> apps;
+    for (const auto& item : _activity) {
+        if (item.first[0] == '*') {
+            continue;
+        }
+        unsigned long long minutes = 0;
+        for (size_t i = 0; i < item.second.Size(); i++) {
+            minutes += CountMinutes(item.second.Bitmap(i));
+        }
+        apps.emplace_back(minutes, item.first);
+    }
+    if (apps.size() <= ACTIVITY_MAX_APPS) {
+        return;
+    }
+    std::nth_element(apps.begin(), apps.begin() + ACTIVITY_MAX_APPS, apps.end(),
+                     [](const auto& a, const auto& b) { return a.first > b.first; });
+    for (size_t i = ACTIVITY_MAX_APPS; i < apps.size(); i++) {
+        _activity.erase(apps[i].second);
+    }
+}
+
+void SaveActivity()
+{
+    std::lock_guard<std::mutex> lock(_activity_mutex);
+    if (!_activity_dirty) {
+        return;
+    }
+    EnsureActivityLoaded();
+    PruneActivity();
+    std::string data;
+    Put(data, (uint32_t)ACTIVITY_MAGIC);
+    Put(data, (uint64_t)_activity_checkpoint);
+    Put(data, (uint32_t)_activity.size());
+    for (const auto& item : _activity) {
+        Put(data, (uint32_t)item.first.size());
+        data += item.first;
+        item.second.Serialize(data);
+    }
+    std::filesystem::path tmpPath = ActivityPath();
+    tmpPath += ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!file.write(data.data(), data.size())) {
+            return;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, ActivityPath(), ec);
+    _activity_dirty = ec.value() != 0;
+}
+
+
+// Calls visit(day, bitmap) for every stored day of key within [from, to]
+template<typename Visit>
+static void VisitDays(const std::string& key, long from, long to, Visit&& visit)
+{
+    std::lock_guard<std::mutex> lock(_activity_mutex);
+    EnsureActivityLoaded();
+    auto it = _activity.find(key);
+    if (it == _activity.end()) {
+        return;
+    }
+    const ActivitySeries& series = it->second;
+    for (size_t i = series.Find(from); i < series.Size() && series.Day(i) <= to; i++) {
+        visit(series.Day(i), series.Bitmap(i));
+    }
+}
+
+static inline unsigned Weekday(long day)
+{
+    // 1970-01-01 was a Thursday
+    return (unsigned)(((day + 4) % 7 + 7) % 7);
+}
+
+std::vector<unsigned> ActivityByDay(const std::string& key, long from, long to)
+{
+    std::vector<unsigned> out(to >= from ? to - from + 1 : 0, 0);
+    VisitDays(key, from, to, [&](long day, const DayBitmap& map) {
+        out[day - from] = CountMinutes(map);
+    });
+    return out;
+}
+
+void ActivityByWeekday(const std::string& key, long from, long to, unsigned long long out[7])
+{
+    std::fill(out, out + 7, 0ULL);
+    VisitDays(key, from, to, [&](long day, const DayBitmap& map) {
+        out[Weekday(day)] += CountMinutes(map);
+    });
+}
+
+void ActivityByHour(const std::string& key, long from, long to, unsigned long long out[7][24])
+{
+    std::fill(&out[0][0], &out[0][0] + 7 * 24, 0ULL);
+    unsigned hours[24];
+    VisitDays(key, from, to, [&](long day, const DayBitmap& map) {
+        CountHours(map, hours);
+        unsigned long long* row = out[Weekday(day)];
+        for (int h = 0; h < 24; h++) {
+            row[h] += hours[h];
+        }
+    });
+}
+
+// Merge join of two series over [from, to]. Days only one side has count
+// towards a union, never towards an overlap.
+template<typename Count>
+static unsigned long long CombineSeries(const std::string& a, const std::string& b, long from, long to, bool single, Count count)
+{
+    std::lock_guard<std::mutex> lock(_activity_mutex);
+    EnsureActivityLoaded();
+    static const ActivitySeries none;
+    auto ia = _activity.find(a);
+    auto ib = _activity.find(b);
+    const ActivitySeries& sa = ia != _activity.end() ? ia->second : none;
+    const ActivitySeries& sb = ib != _activity.end() ? ib->second : none;
+
+    unsigned long long total = 0;
+    size_t i = sa.Find(from);
+    size_t j = sb.Find(from);
+    while ((i < sa.Size() && sa.Day(i) <= to) || (j < sb.Size() && sb.Day(j) <= to)) {
+        long da = i < sa.Size() && sa.Day(i) <= to ? sa.Day(i) : to + 1;
+        long db = j < sb.Size() && sb.Day(j) <= to ? sb.Day(j) : to + 1;
+        if (da == db) {
+            total += count(sa.Bitmap(i++), sb.Bitmap(j++));
+        } else if (da < db) {
+            total += single ? CountMinutes(sa.Bitmap(i)) : 0;
+            i++;
+        } else {
+            total += single ? CountMinutes(sb.Bitmap(j)) : 0;
+            j++;
+        }
+    }
+    return total;
+}
+
+unsigned long long ActivityOverlap(const std::string& a, const std::string& b, long from, long to)
+{
+    return CombineSeries(a, b, from, to, false, CountMinutesAnd);
+}
+
+unsigned long long ActivityUnion(const std::string& a, const std::string& b, long from, long to)
+{
+    return CombineSeries(a, b, from, to, true, CountMinutesOr);
+}
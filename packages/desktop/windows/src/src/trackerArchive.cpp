@@ -0,0 +1,750 @@
+#include "trackerArchive.h"
+#include "trackerImport.h"
+#include "trackerTime.h"
+#include "checksum.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+#ifdef _DEBUG
+#include <iostream>
+#endif // _DEBUG
+
+#define ARCHIVE_MAGIC_V1 0x31415343 // "CSA1", no checksums
+#define ARCHIVE_MAGIC 0x32415343 // "CSA2"
+#define ARCHIVE_INDEX_MAGIC 0x49415343 // "CSAI"
+#define ARCHIVE_FOOTER_SIZE_V1 16
+#define ARCHIVE_FOOTER_SIZE 20
+#define ARCHIVE_INDEX_ENTRY_SIZE_V1 36
+#define ARCHIVE_INDEX_ENTRY_SIZE 40
+#define HASH_BITS 14
+#define MIN_MATCH 4
+#define MAX_OFFSET 65535
+#define DICT_SAMPLE 50000
+
+
+// Held while archives are rewritten, by compaction and by repairs
+std::mutex _archive_mutex;
+
+
+static inline uint32_t Read32(const char* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t Hash32(uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+static void Put32(std::string& out, uint32_t v)
+{
+    out.append((const char*)&v, sizeof(v));
+}
+
+static void Put64(std::string& out, uint64_t v)
+{
+    out.append((const char*)&v, sizeof(v));
+}
+
+static void PutLength(std::string& out, size_t len)
+{
+    while (len >= 255) {
+        out.push_back((char)255);
+        len -= 255;
+    }
+    out.push_back((char)len);
+}
+
+static bool GetLength(const uint8_t*& ip, const uint8_t* iend, size_t& len)
+{
+    uint8_t b;
+    do {
+        if (ip >= iend) {
+            return false;
+        }
+        b = *ip++;
+        len += b;
+    } while (b == 255);
+    return true;
+}
+
+static void EmitSequence(std::string& out, const char* literals, size_t litLen, size_t offset, size_t matchLen)
+{
+    size_t ml = matchLen ? matchLen - MIN_MATCH : 0;
+    out.push_back((char)(((litLen < 15 ? litLen : 15) << 4) | (ml < 15 ? ml : 15)));
+    if (litLen >= 15) {
+        PutLength(out, litLen - 15);
+    }
+    out.append(literals, litLen);
+    if (matchLen == 0) {
+        return;
+    }
+    out.push_back((char)(offset & 0xFF));
+    out.push_back((char)(offset >> 8));
+    if (ml >= 15) {
+        PutLength(out, ml - 15);
+    }
+}
+
+// Split titles at the separators window managers and apps use between
+// document, application and path parts, keeping the separator with the fragment
+static void AddFragments(const std::string& text, std::unordered_map<std::string, size_t>& score)
+{
+    static const char* separators[] = {" - ", " | ", " \xE2\x80\x94 ", "\\", "/"};
+    size_t begin = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        for (const char* sep : separators) {
+            size_t len = strlen(sep);
+            if (text.compare(i, len, sep) == 0) {
+                if (i - begin >= MIN_MATCH) {
+                    score[text.substr(begin, i - begin)] += i - begin;
+                }
+                if (text.size() - i >= MIN_MATCH) {
+                    score[text.substr(i)] += text.size() - i;
+                }
+                begin = i;
+                break;
+            }
+        }
+    }
+    if (text.size() - begin >= MIN_MATCH && begin != 0) {
+        score[text.substr(begin)] += text.size() - begin;
+    }
+}
+
+std::string TrainArchiveDict(const std::vector<AppLogger>& logs, size_t maxSize)
+{
+    std::unordered_map<std::string, size_t> score;
+    size_t step = std::max<size_t>(1, logs.size() / DICT_SAMPLE);
+    for (size_t i = 0; i < logs.size(); i += step) {
+        score[" ; " + logs[i].executable + " ; "] += logs[i].executable.size() + 6;
+        AddFragments(logs[i].title, score);
+    }
+
+    std::vector<std::pair<size_t, const std::string*>> ranked;
+    for (const auto& item : score) {
+        // A fragment seen once carries no information the block does not already have
+        if (item.second >= 2 * item.first.size() && item.first.size() <= 256) {
+            ranked.push_back({item.second, &item.first});
+        }
+    }
+    std::sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b) {
+        return a.first != b.first ? a.first > b.first : *a.second < *b.second;
+    });
+
+    // Best fragments go last so they sit closest to the block data
+    std::vector<const std::string*> picked;
+    size_t size = 0;
+    for (const auto& item : ranked) {
+        if (size + item.second->size() > maxSize) {
+            continue;
+        }
+        picked.push_back(item.second);
+        size += item.second->size();
+    }
+    std::string dict;
+    dict.reserve(size);
+    for (auto it = picked.rbegin(); it != picked.rend(); ++it) {
+        dict += **it;
+    }
+    return dict;
+}
+
+void CompressArchiveBlock(const std::string& dict, const char* src, size_t size, std::string& out)
+{
+    out.clear();
+    std::string window;
+    window.reserve(dict.size() + size);
+    window.append(dict).append(src, size);
+
+    const char* base = window.data();
+    size_t start = dict.size();
+    size_t end = window.size();
+    std::vector<int32_t> table(1 << HASH_BITS, -1);
+    for (size_t i = 0; i + MIN_MATCH <= start; i++) {
+        table[Hash32(Read32(base + i))] = (int32_t)i;
+    }
+
+    size_t anchor = start;
+    size_t pos = start;
+    while (pos + MIN_MATCH <= end) {
+        uint32_t h = Hash32(Read32(base + pos));
+        int32_t cand = table[h];
+        table[h] = (int32_t)pos;
+        if (cand >= 0 && pos - cand <= MAX_OFFSET && Read32(base + cand) == Read32(base + pos)) {
+            size_t len = MIN_MATCH;
+            while (pos + len < end && base[cand + len] == base[pos + len]) {
+                len++;
+            }
+            EmitSequence(out, base + anchor, pos - anchor, pos - cand, len);
+            pos += len;
+            anchor = pos;
+            if (pos - 2 >= start && pos + MIN_MATCH <= end) {
+                table[Hash32(Read32(base + pos - 2))] = (int32_t)(pos - 2);
+            }
+        } else {
+            pos++;
+        }
+    }
+    EmitSequence(out, base + anchor, end - anchor, 0, 0);
+}
+
+bool DecompressArchiveBlock(const std::string& dict, const char* src, size_t size, size_t rawSize, std::string& out)
+{
+    out.resize(dict.size() + rawSize);
+    memcpy(&out[0], dict.data(), dict.size());
+
+    char* obase = &out[0];
+    char* op = obase + dict.size();
+    char* oend = obase + out.size();
+    const uint8_t* ip = (const uint8_t*)src;
+    const uint8_t* iend = ip + size;
+
+    while (ip < iend) {
+        unsigned token = *ip++;
+        size_t lit = token >> 4;
+        if (lit == 15 && !GetLength(ip, iend, lit)) {
+            return false;
+        }
+        if (lit > (size_t)(iend - ip) || lit > (size_t)(oend - op)) {
+            return false;
+        }
+        memcpy(op, ip, lit);
+        op += lit;
+        ip += lit;
+        if (ip == iend) {
+            break;
+        }
+
+        if (iend - ip < 2) {
+            return false;
+        }
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        size_t len = token & 15;
+        if (len == 15 && !GetLength(ip, iend, len)) {
+            return false;
+        }
+        len += MIN_MATCH;
+        if (offset == 0 || offset > (size_t)(op - obase) || len > (size_t)(oend - op)) {
+            return false;
+        }
+        const char* match = op - offset;
+        if (offset >= len) {
+            memcpy(op, match, len);
+            op += len;
+        } else {
+            while (len--) {
+                *op++ = *match++;
+            }
+        }
+    }
+    if (op != oend) {
+        return false;
+    }
+    out.erase(0, dict.size());
+    return true;
+}
+
+ArchiveStats WriteArchive(const std::filesystem::path& path, const std::vector<AppLogger>& logs)
+{
+    ArchiveStats stats = {logs.size(), 0, 0, 0};
+    std::string dict = TrainArchiveDict(logs);
+
+    std::string data;
+    Put32(data, ARCHIVE_MAGIC);
+    Put32(data, (uint32_t)dict.size());
+    Put32(data, Crc32c(dict.data(), dict.size()));
+    data += dict;
+
+    std::vector<ArchiveBlock> blocks;
+    std::string raw;
+    std::string packed;
+    ArchiveBlock block = {0, 0, 0, 0, 0, 0, 0};
+    auto flush = [&]() {
+        if (block.records == 0) {
+            return;
+        }
+        CompressArchiveBlock(dict, raw.data(), raw.size(), packed);
+        block.offset = data.size();
+        block.compressedSize = (uint32_t)packed.size();
+        block.rawSize = (uint32_t)raw.size();
+        block.crc = Crc32c(packed.data(), packed.size());
+        data += packed;
+        blocks.push_back(block);
+        stats.rawBytes += raw.size();
+        stats.compressedBytes += packed.size();
+        raw.clear();
+        block = {0, 0, 0, 0, 0, 0, 0};
+    };
+
+    for (const auto& log : logs) {
+        if (block.records == 0) {
+            block.firstStart = TimeKey(log.start);
+        }
+        block.lastEnd = std::max<uint64_t>(block.lastEnd, TimeKey(log.end));
+        block.records++;
+        raw += GetLineStr(log);
+        if (raw.size() >= ARCHIVE_BLOCK_SIZE) {
+            flush();
+        }
+    }
+    flush();
+
+    uint64_t indexOffset = data.size();
+    for (const auto& b : blocks) {
+        Put64(data, b.offset);
+        Put32(data, b.compressedSize);
+        Put32(data, b.rawSize);
+        Put32(data, b.records);
+        Put64(data, b.firstStart);
+        Put64(data, b.lastEnd);
+        Put32(data, b.crc);
+    }
+    uint32_t indexCrc = Crc32c(data.data() + indexOffset, data.size() - indexOffset);
+    Put64(data, indexOffset);
+    Put32(data, (uint32_t)blocks.size());
+    Put32(data, indexCrc);
+    Put32(data, ARCHIVE_INDEX_MAGIC);
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.write(data.data(), data.size())) {
+        return ArchiveStats{0, 0, 0, 0};
+    }
+    stats.blocks = blocks.size();
+    return stats;
+}
+
+bool OpenArchive(const std::filesystem::path& path, ArchiveReader& reader)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    uint32_t header[3];
+    if (!file.read((char*)header, 2 * sizeof(uint32_t)) || (header[0] != ARCHIVE_MAGIC && header[0] != ARCHIVE_MAGIC_V1)) {
+        return false;
+    }
+    reader.checksums = header[0] == ARCHIVE_MAGIC;
+    if (reader.checksums && !file.read((char*)&header[2], sizeof(uint32_t))) {
+        return false;
+    }
+    // Sizes are checked before anything is allocated for them
+    if (header[1] > ARCHIVE_DICT_SIZE) {
+        return false;
+    }
+    reader.path = path;
+    reader.dict.resize(header[1]);
+    if (!file.read(&reader.dict[0], header[1]) ||
+        (reader.checksums && Crc32c(reader.dict.data(), reader.dict.size()) != header[2])) {
+        return false;
+    }
+
+    int footerSize = reader.checksums ? ARCHIVE_FOOTER_SIZE : ARCHIVE_FOOTER_SIZE_V1;
+    size_t entrySize = reader.checksums ? ARCHIVE_INDEX_ENTRY_SIZE : ARCHIVE_INDEX_ENTRY_SIZE_V1;
+    char footer[ARCHIVE_FOOTER_SIZE];
+    if (!file.seekg(-footerSize, std::ios::end) || !file.read(footer, footerSize) ||
+        Read32(footer + footerSize - 4) != ARCHIVE_INDEX_MAGIC) {
+        return false;
+    }
+    uint64_t fileSize = file.tellg();
+    uint64_t indexOffset;
+    memcpy(&indexOffset, footer, sizeof(indexOffset));
+    uint32_t count = Read32(footer + 8);
+    if (indexOffset + (uint64_t)count * entrySize + footerSize != fileSize) {
+        return false;
+    }
+
+    std::string index(count * entrySize, '\0');
+    if (!file.seekg(indexOffset) || !file.read(&index[0], index.size()) ||
+        (reader.checksums && Crc32c(index.data(), index.size()) != Read32(footer + 12))) {
+        return false;
+    }
+    reader.blocks.resize(count);
+    for (uint32_t i = 0; i < count; i++) {
+        const char* p = index.data() + i * entrySize;
+        ArchiveBlock& b = reader.blocks[i];
+        memcpy(&b.offset, p, 8);
+        b.compressedSize = Read32(p + 8);
+        b.rawSize = Read32(p + 12);
+        b.records = Read32(p + 16);
+        memcpy(&b.firstStart, p + 20, 8);
+        memcpy(&b.lastEnd, p + 28, 8);
+        b.crc = reader.checksums ? Read32(p + 36) : 0;
+    }
+    return true;
+}
+
+static bool ReadPacked(const ArchiveReader& reader, const ArchiveBlock& b, std::string& packed)
+{
+    std::ifstream file(reader.path, std::ios::binary);
+    packed.resize(b.compressedSize);
+    return file.seekg(b.offset) && file.read(&packed[0], packed.size()) &&
+           (!reader.checksums || Crc32c(packed.data(), packed.size()) == b.crc);
+}
+
+bool ReadArchiveBlock(const ArchiveReader& reader, size_t block, std::vector<AppLogger>& out)
+{
+    if (block >= reader.blocks.size()) {
+        return false;
+    }
+    const ArchiveBlock& b = reader.blocks[block];
+    std::string packed;
+    if (!ReadPacked(reader, b, packed)) {
+        return false;
+    }
+    std::string raw;
+    if (!DecompressArchiveBlock(reader.dict, packed.data(), packed.size(), b.rawSize, raw)) {
+        return false;
+    }
+    ImportLogBuffer(raw.data(), raw.size(), out, 1);
+    return true;
+}
+
+size_t VerifyArchiveBlock(const ArchiveReader& reader, size_t block, bool& intact)
+{
+    intact = false;
+    if (block >= reader.blocks.size()) {
+        return 0;
+    }
+    const ArchiveBlock& b = reader.blocks[block];
+    std::string packed;
+    std::string raw;
+    intact = ReadPacked(reader, b, packed) &&
+             (reader.checksums || DecompressArchiveBlock(reader.dict, packed.data(), packed.size(), b.rawSize, raw));
+    return b.compressedSize;
+}
+
+size_t ReadArchiveRange(const ArchiveReader& reader, uint64_t from, uint64_t to, std::vector<AppLogger>& out)
+{
+    size_t count = 0;
+    std::vector<AppLogger> logs;
+    for (size_t i = 0; i < reader.blocks.size(); i++) {
+        const ArchiveBlock& b = reader.blocks[i];
+        if (b.lastEnd < from || b.firstStart > to) {
+            continue;
+        }
+        logs.clear();
+        if (!ReadArchiveBlock(reader, i, logs)) {
+            continue;
+        }
+        for (auto& log : logs) {
+            if (TimeKey(log.end) >= from && TimeKey(log.start) <= to) {
+                out.push_back(std::move(log));
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+bool ForEachStoredSession(ULONGLONG from, ULONGLONG to, const std::function<bool(const AppLogger&)>& visit)
+{
+    auto add = [&](const AppLogger& log) {
+        ULONGLONG start = TimeKey(log.start);
+        return start < from || start > to || visit(log);
+    };
+
+    // Archives hold the oldest sessions, one month per file
+    std::filesystem::path logPath = GetLogFilePath();
+    std::vector<std::filesystem::path> archives;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(logPath.parent_path() / "Archive", ec)) {
+        if (entry.path().extension() == ".csa") {
+            archives.push_back(entry.path());
+        }
+    }
+    std::sort(archives.begin(), archives.end());
+    bool ok = true;
+    std::vector<AppLogger> logs;
+    for (const auto& path : archives) {
+        ArchiveReader reader;
+        if (!ok || !OpenArchive(path, reader)) {
+            continue;
+        }
+        for (size_t i = 0; ok && i < reader.blocks.size(); i++) {
+            if (reader.blocks[i].lastEnd < from || reader.blocks[i].firstStart > to) {
+                continue;
+            }
+            logs.clear();
+            ReadArchiveBlock(reader, i, logs);
+            for (size_t j = 0; ok && j < logs.size(); j++) {
+                ok = add(logs[j]);
+            }
+        }
+    }
+
+    // Each line is visited once the next one parsed: the last one may be a
+    // resumed session still buffered, whose longer record replaces it
+    std::ifstream file(logPath, std::ios::binary);
+    std::string line;
+    AppLogger log, last;
+    bool hasLast = false;
+    while (ok && std::getline(file, line)) {
+        if (ParseLogLine(line.data(), line.size(), log)) {
+            ok = !hasLast || add(last);
+            std::swap(last, log);
+            hasLast = true;
+        }
+    }
+
+    // Copied first, the visitor may block and the logger lock must not wait on it
+    logs.clear();
+    ForEachBufferedSession([&](const AppLogger& buffered) {
+        logs.push_back(buffered);
+    });
+    if (ok && hasLast &&
+        !(!logs.empty() && logs[0].resumed && TimeKey(logs[0].start) == TimeKey(last.start) &&
+          logs[0].executable == last.executable && logs[0].title == last.title)) {
+        ok = add(last);
+    }
+    for (size_t j = 0; ok && j < logs.size(); j++) {
+        ok = add(logs[j]);
+    }
+    return ok;
+}
+
+// Keeps the damaged bytes for a later manual look, _archive_mutex must be held
+static void QuarantineArchive(const std::filesystem::path& path)
+{
+    std::error_code ec;
+    std::filesystem::path dir = path.parent_path() / ARCHIVE_QUARANTINE_DIR;
+    std::filesystem::create_directories(dir, ec);
+    std::filesystem::path copy = dir / path.stem();
+    copy += "." + std::to_string(TimeKey(GetTime())) + path.extension().string();
+    std::filesystem::copy_file(path, copy, std::filesystem::copy_options::skip_existing, ec);
+}
+
+// Sessions of the text log at path starting within one of ranges (TimeKey,
+// inclusive) and not in seen yet, appended to out unless it is null
+static size_t CollectSessions(const std::filesystem::path& path, const std::vector<std::pair<uint64_t, uint64_t>>& ranges,
+                              std::unordered_set<std::string>& seen, std::vector<AppLogger>* out)
+{
+    size_t count = 0;
+    std::vector<AppLogger> logs;
+    ImportLogFile(path, logs);
+    for (auto& log : logs) {
+        uint64_t key = TimeKey(log.start);
+        bool inRange = std::any_of(ranges.begin(), ranges.end(), [key](const auto& range) {
+            return key >= range.first && key <= range.second;
+        });
+        if (inRange && seen.insert(GetLineStr(log)).second) {
+            if (out != nullptr) {
+                out->push_back(std::move(log));
+            }
+            count++;
+        }
+    }
+    return count;
+}
+
+// _archive_mutex must be held
+static bool ReplaceArchive(const std::filesystem::path& path, std::vector<AppLogger>& logs)
+{
+    std::stable_sort(logs.begin(), logs.end(), [](const AppLogger& a, const AppLogger& b) {
+        return TimeKey(a.start) < TimeKey(b.start);
+    });
+    std::filesystem::path tmpPath = path;
+    tmpPath += ".tmp";
+    if (WriteArchive(tmpPath, logs).records != logs.size()) {
+        return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, path, ec);
+    return !ec;
+}
+
+ArchiveRepair RepairArchive(const std::filesystem::path& path)
+{
+    ArchiveRepair repair = {0, 0, 0};
+    std::error_code ec;
+    std::lock_guard<std::mutex> lock(_archive_mutex);
+    if (!std::filesystem::is_regular_file(path, ec)) {
+        return repair;
+    }
+    std::vector<AppLogger> logs;
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    size_t missing = 0;
+    ArchiveReader reader;
+    unsigned year;
+    unsigned month;
+    if (OpenArchive(path, reader)) {
+        for (size_t i = 0; i < reader.blocks.size(); i++) {
+            const ArchiveBlock& b = reader.blocks[i];
+            if (!ReadArchiveBlock(reader, i, logs)) {
+                repair.damaged++;
+                missing += b.records;
+                ranges.push_back({b.firstStart, b.lastEnd});
+            }
+        }
+        if (repair.damaged == 0 && reader.checksums) {
+            return repair;
+        }
+    } else if (sscanf(path.stem().string().c_str(), "%4u-%2u", &year, &month) == 2) {
+        repair.damaged = 1;
+        uint64_t first = (year * 100ull + month) * 100000000ull;
+        ranges.push_back({first, first + 99999999ull});
+    } else {
+        return repair;
+    }
+
+    if (repair.damaged > 0) {
+        QuarantineArchive(path);
+        std::unordered_set<std::string> seen;
+        for (const auto& log : logs) {
+            seen.insert(GetLineStr(log));
+        }
+        std::filesystem::path logPath = GetLogFilePath();
+        std::filesystem::path bakPath = logPath;
+        bakPath += ".bak";
+        CollectSessions(logPath, ranges, seen, nullptr);
+        repair.recovered = CollectSessions(bakPath, ranges, seen, &logs);
+        repair.lost = missing > repair.recovered ? missing - repair.recovered : 0;
+    }
+    // An unreadable archive nothing was found for stays, readers skip it either way
+    if (!logs.empty() || !reader.blocks.empty()) {
+        if (!ReplaceArchive(path, logs)) {
+            repair.recovered = 0;
+            repair.lost = missing;
+        }
+    }
+#ifdef _DEBUG
+    std::cout << "Archive " << path.filename().string() << ": " << repair.damaged << " damaged, "
+              << repair.recovered << " sessions recovered, " << repair.lost << " lost\n";
+#endif // _DEBUG
+    return repair;
+}
+
+int CompactLogFile()
+{
+    // Flushes go on meanwhile: the log is read up to the end of a line, what
+    // they append past it is carried over when the rewritten log replaces it
+    std::filesystem::path logPath = GetLogFilePath();
+    std::string text(GetLogFileSize(), '\0');
+    std::ifstream(logPath, std::ios::binary).read(text.data(), text.size());
+    std::vector<AppLogger> logs;
+    ImportStats stats = ImportLogBuffer(text.data(), text.size(), logs);
+
+    long cutoff = DayNumber(GetTime()) - ARCHIVE_AFTER_DAYS;
+    std::map<unsigned, std::vector<AppLogger>> aged;
+    std::vector<bool> archived(logs.size(), false);
+    for (size_t i = 0; i < logs.size(); i++) {
+        if (DayNumber(logs[i].end) < cutoff) {
+            aged[logs[i].start.wYear * 100u + logs[i].start.wMonth].push_back(logs[i]);
+            archived[i] = true;
+        }
+    }
+    if (aged.empty()) {
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(_archive_mutex);
+    std::error_code ec;
+    // The previous text log is kept as a backup until the next compaction.
+    // A repair takes damaged blocks back from it, so nothing moves without it.
+    std::filesystem::path bakPath = logPath;
+    bakPath += ".bak";
+    {
+        std::ofstream bakFile(bakPath, std::ios::binary | std::ios::trunc);
+        bakFile.write(text.data(), text.size());
+        bakFile.close();
+        if (!bakFile) {
+            return 1;
+        }
+    }
+
+    std::filesystem::path archiveDir = logPath.parent_path() / "Archive";
+    std::filesystem::create_directories(archiveDir, ec);
+    std::unordered_set<unsigned> skipped;
+    for (auto& month : aged) {
+        char name[16];
+        snprintf(name, sizeof(name), "%04u-%02u.csa", month.first / 100, month.first % 100);
+        std::filesystem::path archivePath = archiveDir / name;
+
+        // A month archived earlier is merged and rewritten with its new dictionary.
+        // Were one of its blocks damaged, the rewrite would drop it for good.
+        std::vector<AppLogger> merged;
+        ArchiveReader reader;
+        bool present = std::filesystem::exists(archivePath, ec) || ec;
+        bool intact = !present || OpenArchive(archivePath, reader);
+        for (size_t i = 0; intact && i < reader.blocks.size(); i++) {
+            intact = ReadArchiveBlock(reader, i, merged);
+        }
+        if (!intact) {
+            skipped.insert(month.first);
+            continue;
+        }
+        // A repair may already have put back sessions the log still held
+        std::unordered_set<std::string> seen;
+        for (const auto& log : merged) {
+            seen.insert(GetLineStr(log));
+        }
+        for (auto& log : month.second) {
+            if (seen.count(GetLineStr(log)) == 0) {
+                merged.push_back(std::move(log));
+            }
+        }
+
+        std::filesystem::path tmpPath = archivePath;
+        tmpPath += ".tmp";
+        if (WriteArchive(tmpPath, merged).records != merged.size()) {
+            return 1;
+        }
+        std::filesystem::rename(tmpPath, archivePath, ec);
+        if (ec) {
+            return 1;
+        }
+    }
+
+    // The lines kept are copied as they are, those that do not parse included:
+    // they stay in the log for someone to fix rather than being lost
+    std::filesystem::path tmpPath = logPath;
+    tmpPath += ".compact";
+    {
+        std::ofstream outFile(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!outFile) {
+            return 1;
+        }
+        AppLogger log;
+        size_t i = 0;
+        const char* end = text.data() + text.size();
+        for (const char* p = text.data(); p < end;) {
+            const char* eol = (const char*)memchr(p, '\n', end - p);
+            eol = eol != nullptr ? eol : end;
+            if (eol > p && !(eol - p == 1 && *p == '\r')) {
+                bool parsed = stats.malformed == 0 || ParseLogLine(p, eol - p, log);
+                if (!parsed || !archived[i] || skipped.count(logs[i].start.wYear * 100u + logs[i].start.wMonth)) {
+                    outFile.write(p, eol - p);
+                    outFile.put('\n');
+                }
+                i += parsed;
+            }
+            p = eol + 1;
+        }
+        outFile.close();
+        if (!outFile) {
+            std::filesystem::remove(tmpPath, ec);
+            return 1;
+        }
+    }
+#ifdef _DEBUG
+    if (stats.malformed > 0) {
+        std::cout << "Compaction kept " << stats.malformed << " malformed lines in the log\n";
+    }
+#endif // _DEBUG
+    // Until the next pass dedupes them, a failed replace leaves the sessions
+    // both archived and in the log
+    if (!ReplaceLogFile(tmpPath, text.size())) {
+        std::filesystem::remove(tmpPath, ec);
+        return 1;
+    }
+    return 0;
+}
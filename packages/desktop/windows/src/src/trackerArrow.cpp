@@ -0,0 +1,382 @@
+#include "trackerArrow.h"
+#include "trackerArchive.h"
+#include "trackerTime.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define ARROW_METADATA_V5 4
+#define ARROW_HEADER_SCHEMA 1
+#define ARROW_HEADER_DICTIONARY 2
+#define ARROW_HEADER_RECORD_BATCH 3
+#define ARROW_TYPE_UTF8 5
+#define ARROW_TYPE_TIMESTAMP 10
+#define ARROW_TIME_SECOND 0
+#define ARROW_CONTINUATION 0xFFFFFFFFu
+
+
+template<typename T>
+static void Put(std::string& out, T value)
+{
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Minimal flatbuffer writer for the IPC metadata. Objects go front to back:
+// a table is written with placeholders for its offset fields, and Link fills
+// them in once the children are appended after it, so every uoffset points
+// forward as the format requires. Alignment is relative to the start of the
+// buffer, which the message framing keeps on an 8-byte boundary.
+class FlatBuilder {
+public:
+    typedef struct {
+        uint16_t id;
+        uint8_t size; // 1, 2, 4 or 8 bytes, offsets are 4
+        uint64_t value;
+    } Field;
+
+    FlatBuilder() : _buf(4, '\0') {}
+
+    // Returns the table's position, slots[id] receives the position of each field
+    size_t Table(std::initializer_list<Field> fields, size_t* slots)
+    {
+        std::vector<Field> sorted(fields);
+        std::stable_sort(sorted.begin(), sorted.end(), [](const Field& a, const Field& b) { return a.size > b.size; });
+        uint16_t count = 0;
+        size_t inlineSize = 4;
+        std::vector<uint16_t> at;
+        for (const Field& field : sorted) {
+            inlineSize = (inlineSize + field.size - 1) / field.size * field.size;
+            at.push_back((uint16_t)inlineSize);
+            inlineSize += field.size;
+            count = std::max<uint16_t>(count, field.id + 1);
+        }
+
+        std::vector<uint16_t> vtable(2 + count, 0);
+        vtable[0] = (uint16_t)(2 * vtable.size());
+        vtable[1] = (uint16_t)inlineSize;
+        for (size_t i = 0; i < sorted.size(); i++) {
+            vtable[2 + sorted[i].id] = at[i];
+        }
+        Align(2);
+        size_t vtablePos = _buf.size();
+        _buf.append(reinterpret_cast<const char*>(vtable.data()), 2 * vtable.size());
+        Align(8);
+        size_t table = _buf.size();
+        _buf.resize(table + inlineSize, '\0');
+        int32_t back = (int32_t)(table - vtablePos);
+        memcpy(&_buf[table], &back, 4);
+        for (size_t i = 0; i < sorted.size(); i++) {
+            memcpy(&_buf[table + at[i]], &sorted[i].value, sorted[i].size);
+            slots[sorted[i].id] = table + at[i];
+        }
+        return table;
+    }
+
+    size_t String(const std::string& text)
+    {
+        Align(4);
+        size_t pos = _buf.size();
+        Put(_buf, (uint32_t)text.size());
+        _buf += text;
+        _buf += '\0';
+        return pos;
+    }
+
+    // Vector of 8-byte aligned structs
+    size_t Structs(const void* data, size_t count, size_t size)
+    {
+        Align(8, 4);
+        size_t pos = _buf.size();
+        Put(_buf, (uint32_t)count);
+        _buf.append(static_cast<const char*>(data), count * size);
+        return pos;
+    }
+
+    // Vector of count offsets, returns the position of the first one for Link
+    size_t Offsets(size_t count)
+    {
+        Align(4);
+        size_t pos = _buf.size();
+        Put(_buf, (uint32_t)count);
+        _buf.resize(_buf.size() + 4 * count, '\0');
+        return pos + 4;
+    }
+
+    void Link(size_t slot, size_t target)
+    {
+        uint32_t offset = (uint32_t)(target - slot);
+        memcpy(&_buf[slot], &offset, 4);
+    }
+
+    const std::string& Finish(size_t root)
+    {
+        Link(0, root);
+        Align(8);
+        return _buf;
+    }
+
+private:
+    // Pads so that the next write plus extra lands on a multiple of n
+    void Align(size_t n, size_t extra = 0)
+    {
+        _buf.resize((_buf.size() + extra + n - 1) / n * n - extra, '\0');
+    }
+
+    std::string _buf;
+};
+
+
+// Body buffer layout of one record or dictionary batch
+typedef struct {
+    int64_t length;
+    int64_t nullCount;
+} FieldNode;
+
+typedef struct {
+    int64_t offset;
+    int64_t length;
+} BodyBuffer;
+
+typedef struct {
+    std::unordered_map<std::string, int32_t> index;
+    std::vector<const std::string*> pending; // Keys not yet sent, in index order
+    bool sent = false;
+} Dictionary;
+
+class ArrowStreamWriter {
+public:
+    ArrowStreamWriter(const ArrowSink& sink, size_t batchRows)
+        : _sink(sink), _batchRows(std::max<size_t>(batchRows, 1)), _stats(), _ok(true)
+    {
+        _start.reserve(_batchRows);
+        _end.reserve(_batchRows);
+        _executable.reserve(_batchRows);
+        _title.reserve(_batchRows);
+        WriteSchema();
+    }
+
+    bool Add(const AppLogger& log)
+    {
+        _start.push_back(TimeSeconds(log.start));
+        _end.push_back(TimeSeconds(log.end));
+        _executable.push_back(Lookup(_dictionaries[0], log.executable));
+        _title.push_back(Lookup(_dictionaries[1], log.title));
+        if (_start.size() >= _batchRows) {
+            Flush();
+        }
+        return _ok;
+    }
+
+    ArrowExportStats Finish()
+    {
+        Flush();
+        std::string eos;
+        Put(eos, ARROW_CONTINUATION);
+        Put(eos, (uint32_t)0);
+        Write(eos);
+        return _stats;
+    }
+
+private:
+    static int32_t Lookup(Dictionary& dictionary, const std::string& value)
+    {
+        auto inserted = dictionary.index.try_emplace(value, (int32_t)dictionary.index.size());
+        if (inserted.second) {
+            dictionary.pending.push_back(&inserted.first->first);
+        }
+        return inserted.first->second;
+    }
+
+    bool Write(const std::string& data)
+    {
+        if (_ok && !_sink(data.data(), data.size())) {
+            _ok = false;
+        }
+        _stats.bytes += data.size();
+        return _ok;
+    }
+
+    // Continuation marker, metadata size, metadata, body: the metadata is
+    // padded to 8 bytes, so the body keeps the alignment of the stream
+    void WriteMessage(const std::string& metadata, const std::string& body)
+    {
+        _frame.clear();
+        Put(_frame, ARROW_CONTINUATION);
+        Put(_frame, (uint32_t)metadata.size());
+        _frame += metadata;
+        Write(_frame);
+        Write(body);
+    }
+
+    // Appends one buffer to the body, padded to 8 bytes
+    void AddBuffer(const void* data, size_t size)
+    {
+        _buffers.push_back({(int64_t)_body.size(), (int64_t)size});
+        _body.append(static_cast<const char*>(data), size);
+        _body.resize((_body.size() + 7) / 8 * 8, '\0');
+    }
+
+    // Message table around a header, returns the slot the header links to
+    static size_t MessageTable(FlatBuilder& fb, uint8_t headerType, size_t bodyLength, size_t& message)
+    {
+        size_t slots[4];
+        message = fb.Table({{0, 2, ARROW_METADATA_V5}, {1, 1, headerType}, {2, 4, 0}, {3, 8, bodyLength}}, slots);
+        return slots[2];
+    }
+
+    // RecordBatch table for the nodes and buffers collected so far
+    size_t RecordBatchTable(FlatBuilder& fb, size_t length)
+    {
+        size_t slots[3];
+        size_t batch = fb.Table({{0, 8, length}, {1, 4, 0}, {2, 4, 0}}, slots);
+        fb.Link(slots[1], fb.Structs(_nodes.data(), _nodes.size(), sizeof(FieldNode)));
+        fb.Link(slots[2], fb.Structs(_buffers.data(), _buffers.size(), sizeof(BodyBuffer)));
+        return batch;
+    }
+
+    void WriteSchema()
+    {
+        static const char* names[] = {"start", "end", "executable", "title"};
+        FlatBuilder fb;
+        size_t message;
+        size_t header = MessageTable(fb, ARROW_HEADER_SCHEMA, 0, message);
+        size_t schemaSlots[2];
+        fb.Link(header, fb.Table({{0, 2, 0}, {1, 4, 0}}, schemaSlots));
+        size_t fields = fb.Offsets(4);
+        fb.Link(schemaSlots[1], fields - 4);
+        for (int i = 0; i < 4; i++) {
+            bool dictionary = i >= 2;
+            size_t slots[6];
+            size_t field = dictionary
+                ? fb.Table({{0, 4, 0}, {1, 1, 0}, {2, 1, ARROW_TYPE_UTF8}, {3, 4, 0}, {4, 4, 0}, {5, 4, 0}}, slots)
+                : fb.Table({{0, 4, 0}, {1, 1, 0}, {2, 1, ARROW_TYPE_TIMESTAMP}, {3, 4, 0}, {5, 4, 0}}, slots);
+            fb.Link(fields + 4 * i, field);
+            fb.Link(slots[0], fb.String(names[i]));
+            size_t typeSlots[1];
+            fb.Link(slots[3], dictionary ? fb.Table({}, typeSlots) : fb.Table({{0, 2, ARROW_TIME_SECOND}}, typeSlots));
+            if (dictionary) {
+                size_t encodingSlots[3];
+                fb.Link(slots[4], fb.Table({{0, 8, (uint64_t)(i - 2)}, {1, 4, 0}, {2, 1, 0}}, encodingSlots));
+                size_t intSlots[2];
+                fb.Link(encodingSlots[1], fb.Table({{0, 4, 32}, {1, 1, 1}}, intSlots));
+            }
+            // Readers expect the children vector even when it is empty
+            fb.Link(slots[5], fb.Offsets(0) - 4);
+        }
+        WriteMessage(fb.Finish(message), std::string());
+    }
+
+    void WriteDictionary(int64_t id, Dictionary& dictionary)
+    {
+        _body.clear();
+        _nodes.clear();
+        _buffers.clear();
+        _offsets.clear();
+        _values.clear();
+        int32_t offset = 0;
+        _offsets.push_back(offset);
+        for (const std::string* value : dictionary.pending) {
+            _values += *value;
+            offset += (int32_t)value->size();
+            _offsets.push_back(offset);
+        }
+        _nodes.push_back({(int64_t)dictionary.pending.size(), 0});
+        AddBuffer(nullptr, 0);
+        AddBuffer(_offsets.data(), _offsets.size() * sizeof(int32_t));
+        AddBuffer(_values.data(), _values.size());
+
+        FlatBuilder fb;
+        size_t message;
+        size_t header = MessageTable(fb, ARROW_HEADER_DICTIONARY, _body.size(), message);
+        size_t slots[3];
+        fb.Link(header, fb.Table({{0, 8, (uint64_t)id}, {1, 4, 0}, {2, 1, dictionary.sent ? 1u : 0u}}, slots));
+        fb.Link(slots[1], RecordBatchTable(fb, dictionary.pending.size()));
+        WriteMessage(fb.Finish(message), _body);
+
+        dictionary.pending.clear();
+        dictionary.sent = true;
+        _stats.dictionaryBatches++;
+    }
+
+    void Flush()
+    {
+        if (_start.empty() || !_ok) {
+            return;
+        }
+        for (int i = 0; i < 2; i++) {
+            if (!_dictionaries[i].pending.empty() || !_dictionaries[i].sent) {
+                WriteDictionary(i, _dictionaries[i]);
+            }
+        }
+
+        size_t rows = _start.size();
+        _body.clear();
+        _nodes.clear();
+        _buffers.clear();
+        for (int i = 0; i < 4; i++) {
+            _nodes.push_back({(int64_t)rows, 0});
+        }
+        AddBuffer(nullptr, 0);
+        AddBuffer(_start.data(), rows * sizeof(int64_t));
+        AddBuffer(nullptr, 0);
+        AddBuffer(_end.data(), rows * sizeof(int64_t));
+        AddBuffer(nullptr, 0);
+        AddBuffer(_executable.data(), rows * sizeof(int32_t));
+        AddBuffer(nullptr, 0);
+        AddBuffer(_title.data(), rows * sizeof(int32_t));
+
+        FlatBuilder fb;
+        size_t message;
+        size_t header = MessageTable(fb, ARROW_HEADER_RECORD_BATCH, _body.size(), message);
+        fb.Link(header, RecordBatchTable(fb, rows));
+        WriteMessage(fb.Finish(message), _body);
+
+        _stats.rows += rows;
+        _stats.batches++;
+        _start.clear();
+        _end.clear();
+        _executable.clear();
+        _title.clear();
+    }
+
+    const ArrowSink& _sink;
+    size_t _batchRows;
+    ArrowExportStats _stats;
+    bool _ok;
+    Dictionary _dictionaries[2]; // Executable, title
+    std::vector<int64_t> _start;
+    std::vector<int64_t> _end;
+    std::vector<int32_t> _executable;
+    std::vector<int32_t> _title;
+    // Reused between messages
+    std::string _body;
+    std::string _frame;
+    std::string _values;
+    std::vector<int32_t> _offsets;
+    std::vector<FieldNode> _nodes;
+    std::vector<BodyBuffer> _buffers;
+};
+
+
+ArrowExportStats ExportArrow(ULONGLONG from, ULONGLONG to, const ArrowSink& sink, size_t batchRows)
+{
+    ArrowStreamWriter writer(sink, batchRows);
+    ForEachStoredSession(from, to, [&](const AppLogger& log) {
+        return writer.Add(log);
+    });
+    return writer.Finish();
+}
+
+ArrowExportStats ExportArrowFile(const std::filesystem::path& path, ULONGLONG from, ULONGLONG to, size_t batchRows)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    return ExportArrow(from, to, [&](const char* data, size_t size) {
+        file.write(data, size);
+        return (bool)file;
+    }, batchRows);
+}
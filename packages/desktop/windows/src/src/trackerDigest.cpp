@@ -0,0 +1,273 @@
+#include "trackerDigest.h"
+#include "trackerImport.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+#define MONTH_LEN 7 // YYYY-MM
+#define DAY_LEN 10  // YYYY-MM-DD
+
+
+// MurmurHash64A
+uint64_t HashBytes(const char* data, size_t size, uint64_t seed)
+{
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+    uint64_t h = seed ^ (size * m);
+
+    const char* end = data + (size & ~(size_t)7);
+    for (; data != end; data += 8) {
+        uint64_t k;
+        memcpy(&k, data, 8);
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, data, size & 7);
+    if (size & 7) {
+        h ^= tail;
+        h *= m;
+    }
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+static uint64_t CombineDigests(const std::vector<DigestEntry>& children)
+{
+    uint64_t h = children.size();
+    for (const auto& child : children) {
+        h = HashBytes((const char*)&child.digest, sizeof(child.digest), h);
+    }
+    return h;
+}
+
+
+static std::vector<std::string> SortedLines(const std::vector<AppLogger>& sessions)
+{
+    // Log lines start with the start time, so text order is time order
+    std::vector<std::string> lines;
+    lines.reserve(sessions.size());
+    for (const auto& log : sessions) {
+        std::string line;
+        AppendLogLine(line, log);
+        lines.push_back(std::move(line));
+    }
+    std::sort(lines.begin(), lines.end());
+    lines.erase(std::unique(lines.begin(), lines.end()), lines.end());
+    return lines;
+}
+
+// Hours and blocks of the lines [first, last), which all start on one day
+void DigestTree::BuildDay(size_t first, size_t last, std::vector<DigestEntry>& hours)
+{
+    hours.clear();
+    for (size_t i = first; i < last;) {
+        std::string hour = _lines[i].substr(0, DAY_LEN) + 'T' + _lines[i].substr(DAY_LEN + 1, 2);
+        size_t j = i;
+        while (j < last && _lines[j].compare(DAY_LEN + 1, 2, hour, DAY_LEN + 1, 2) == 0) {
+            j++;
+        }
+        std::vector<DigestEntry>& blocks = _children[hour];
+        blocks.clear();
+        for (size_t b = i; b < j; b += DIGEST_BLOCK_SESSIONS) {
+            size_t count = std::min<size_t>(DIGEST_BLOCK_SESSIONS, j - b);
+            uint64_t h = count;
+            for (size_t k = b; k < b + count; k++) {
+                h = HashBytes(_lines[k].data(), _lines[k].size(), h);
+            }
+            std::string block = hour + '#' + std::to_string((b - i) / DIGEST_BLOCK_SESSIONS);
+            _ranges[block] = {b, count};
+            blocks.push_back({block, h});
+        }
+        _ranges[hour] = {i, j - i};
+        hours.push_back({hour, CombineDigests(blocks)});
+        i = j;
+    }
+}
+
+void DigestTree::Build(const std::vector<AppLogger>& sessions)
+{
+    _lines = SortedLines(sessions);
+    _children.clear();
+    _ranges.clear();
+
+    // Days, each with its hours and blocks
+    std::vector<DigestEntry> level;
+    std::vector<DigestEntry> hours;
+    for (size_t i = 0; i < _lines.size();) {
+        std::string day = _lines[i].substr(0, DAY_LEN);
+        size_t j = i;
+        while (j < _lines.size() && _lines[j].compare(0, DAY_LEN, day) == 0) {
+            j++;
+        }
+        BuildDay(i, j, hours);
+        _ranges[day] = {i, j - i};
+        level.push_back({day, CombineDigests(hours)});
+        _children[day].swap(hours);
+        i = j;
+    }
+
+    // Partitions, grouping the days by month
+    std::vector<DigestEntry> months;
+    for (size_t i = 0; i < level.size();) {
+        std::string month = level[i].path.substr(0, MONTH_LEN);
+        std::vector<DigestEntry>& children = _children[month];
+        size_t first = _ranges[level[i].path].first;
+        size_t count = 0;
+        for (; i < level.size() && level[i].path.compare(0, MONTH_LEN, month) == 0; i++) {
+            children.push_back(level[i]);
+            count += _ranges[level[i].path].count;
+        }
+        _ranges[month] = {first, count};
+        months.push_back({month, CombineDigests(children)});
+    }
+    _ranges[""] = {0, _lines.size()};
+    _children[""] = months;
+    _root = CombineDigests(months);
+}
+
+// Replaces or inserts the entry at path in a list sorted by path, or removes
+// it when remove is set
+static void SetEntry(std::vector<DigestEntry>& entries, const std::string& path, uint64_t digest, bool remove)
+{
+    auto it = std::lower_bound(entries.begin(), entries.end(), path,
+                               [](const DigestEntry& entry, const std::string& key) { return entry.path < key; });
+    bool found = it != entries.end() && it->path == path;
+    if (remove) {
+        if (found) {
+            entries.erase(it);
+        }
+    } else if (found) {
+        it->digest = digest;
+    } else {
+        entries.insert(it, {path, digest});
+    }
+}
+
+void DigestTree::ReplaceDay(const std::string& day, const std::vector<AppLogger>& sessions)
+{
+    std::vector<std::string> lines = SortedLines(sessions);
+    lines.erase(std::remove_if(lines.begin(), lines.end(),
+                               [&](const std::string& line) { return line.compare(0, DAY_LEN, day) != 0; }),
+                lines.end());
+
+    // The day's nodes go, the nodes after it move by the change in lines and
+    // the ones above it grow or shrink by it
+    size_t first = std::lower_bound(_lines.begin(), _lines.end(), day) - _lines.begin();
+    size_t count = 0;
+    auto found = _ranges.find(day);
+    if (found != _ranges.end()) {
+        first = found->second.first;
+        count = found->second.count;
+    }
+    for (auto it = _ranges.lower_bound(day); it != _ranges.end() && it->first.compare(0, DAY_LEN, day) == 0;) {
+        _children.erase(it->first);
+        it = _ranges.erase(it);
+    }
+    long long delta = (long long)lines.size() - (long long)count;
+    for (auto& item : _ranges) {
+        if (item.first < day && day.compare(0, item.first.size(), item.first) == 0) {
+            item.second.count += delta;
+        } else if (item.first > day) {
+            item.second.first += delta;
+        }
+    }
+    _lines.erase(_lines.begin() + first, _lines.begin() + first + count);
+    _lines.insert(_lines.begin() + first, std::make_move_iterator(lines.begin()), std::make_move_iterator(lines.end()));
+
+    std::vector<DigestEntry> hours;
+    BuildDay(first, first + lines.size(), hours);
+    std::string month = day.substr(0, MONTH_LEN);
+    std::vector<DigestEntry>& days = _children[month];
+    SetEntry(days, day, CombineDigests(hours), lines.empty());
+    if (!lines.empty()) {
+        _ranges[day] = {first, lines.size()};
+        _children[day].swap(hours);
+    }
+
+    // A month left without days goes too, a new one starts where its first day does
+    if (days.empty()) {
+        _children.erase(month);
+        _ranges.erase(month);
+    } else if (_ranges.find(month) == _ranges.end()) {
+        _ranges[month] = {first, lines.size()};
+    } else {
+        _ranges[month].first = _ranges[days.front().path].first;
+    }
+    std::vector<DigestEntry>& months = _children[""];
+    auto it = _children.find(month);
+    SetEntry(months, month, it != _children.end() ? CombineDigests(it->second) : 0, it == _children.end());
+    _ranges[""] = {0, _lines.size()};
+    _root = CombineDigests(months);
+}
+
+bool DigestTree::Children(const std::string& path, std::vector<DigestEntry>& out) const
+{
+    out.clear();
+    auto it = _children.find(path);
+    if (it == _children.end()) {
+        return false;
+    }
+    out = it->second;
+    return true;
+}
+
+void DigestTree::Lines(const std::string& path, std::vector<std::string>& out) const
+{
+    auto it = _ranges.find(path);
+    if (it == _ranges.end()) {
+        return;
+    }
+    out.insert(out.end(), _lines.begin() + it->second.first, _lines.begin() + it->second.first + it->second.count);
+}
+
+
+bool Reconcile(const DigestTree& local, const DigestFetch& fetch, const DigestSend& send, ReconcileStats& stats)
+{
+    stats = {};
+    std::vector<std::string> level(1, std::string());
+    std::vector<std::string> missing;
+    std::vector<DigestEntry> children;
+    std::vector<std::vector<DigestEntry>> remote;
+    std::unordered_map<std::string, uint64_t> theirs;
+
+    while (!level.empty()) {
+        remote.clear();
+        if (!fetch(level, remote) || remote.size() != level.size()) {
+            return false;
+        }
+        stats.roundTrips++;
+
+        std::vector<std::string> next;
+        for (size_t k = 0; k < level.size(); k++) {
+            theirs.clear();
+            for (const auto& entry : remote[k]) {
+                theirs[entry.path] = entry.digest;
+            }
+            local.Children(level[k], children);
+            for (const auto& child : children) {
+                stats.nodesCompared++;
+                auto it = theirs.find(child.path);
+                if (it != theirs.end() && it->second == child.digest) {
+                    continue;
+                }
+                // A subtree the peer lacks entirely, or a differing block, goes as is
+                if (it == theirs.end() || child.path.find('#') != std::string::npos) {
+                    local.Lines(child.path, missing);
+                } else {
+                    next.push_back(child.path);
+                }
+            }
+        }
+        level.swap(next);
+    }
+
+    stats.sessionsSent = missing.size();
+    return missing.empty() || send(missing);
+}
@@ -0,0 +1,190 @@
+#include "trackerGovernor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+#ifdef _DEBUG
+#include <iostream>
+#endif // _DEBUG
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cstdio>
+#include <sys/resource.h>
+#endif // _WIN32
+
+#define GOVERNOR_REDUCED_PROBE_MS 60000
+#define GOVERNOR_MINIMAL_PROBE_MS 300000
+
+
+std::atomic<unsigned long long> _governor_wakeups(0);
+std::atomic<int> _governor_mode(GOVERNOR_NORMAL);
+std::atomic<double> _governor_load(0.0);
+std::mutex _governor_mutex;
+Governor _governor(DefaultGovernorBudget());
+
+
+Governor::Governor(const GovernorBudget& budget)
+    : _budget(budget), _last(), _primed(false), _quiet(0), _load(0.0), _mode(GOVERNOR_NORMAL)
+{
+}
+
+GovernorMode Governor::Update(const GovernorUsage& usage, unsigned long elapsedMs)
+{
+    if (!_primed || elapsedMs == 0) {
+        _primed = true;
+        _last = usage;
+        return _mode;
+    }
+    double seconds = elapsedMs / 1000.0;
+    double cpu = std::max(0.0, usage.cpuSeconds - _last.cpuSeconds) * 100.0 / seconds;
+    double wakeups = (usage.wakeups >= _last.wakeups ? usage.wakeups - _last.wakeups : 0) / seconds;
+    double io = (usage.ioBytes >= _last.ioBytes ? usage.ioBytes - _last.ioBytes : 0) / seconds;
+    _last = usage;
+
+    _load = std::max({cpu / _budget.cpuPercent, wakeups / _budget.wakeupsPerSecond, io / _budget.ioBytesPerSecond});
+    if (_load > 1.0) {
+        _quiet = 0;
+        if (_mode != GOVERNOR_MINIMAL) {
+            _mode = (GovernorMode)(_mode + 1);
+        }
+    } else if (_load < 0.5 && _mode != GOVERNOR_NORMAL) {
+        if (++_quiet >= GOVERNOR_RESTORE_INTERVALS) {
+            _quiet = 0;
+            _mode = (GovernorMode)(_mode - 1);
+        }
+    } else {
+        _quiet = 0;
+    }
+    return _mode;
+}
+
+
+GovernorBudget DefaultGovernorBudget()
+{
+    return {1.0, 5.0, 64 * 1024.0};
+}
+
+const char* GovernorModeName(GovernorMode mode)
+{
+    switch (mode) {
+    case GOVERNOR_REDUCED:
+        return "reduced";
+    case GOVERNOR_MINIMAL:
+        return "minimal";
+    default:
+        return "normal";
+    }
+}
+
+
+GovernorUsage SampleGovernorUsage()
+{
+    GovernorUsage usage = {};
+    usage.wakeups = _governor_wakeups;
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+        ULARGE_INTEGER k = {{kernel.dwLowDateTime, kernel.dwHighDateTime}};
+        ULARGE_INTEGER u = {{user.dwLowDateTime, user.dwHighDateTime}};
+        usage.cpuSeconds = (k.QuadPart + u.QuadPart) / 1e7;
+    }
+    IO_COUNTERS io;
+    if (GetProcessIoCounters(GetCurrentProcess(), &io)) {
+        usage.ioBytes = io.ReadTransferCount + io.WriteTransferCount + io.OtherTransferCount;
+    }
+#else
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == 0) {
+        usage.cpuSeconds = ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+    }
+    if (FILE* file = fopen("/proc/self/io", "r")) {
+        char line[64];
+        unsigned long long value;
+        while (fgets(line, sizeof(line), file)) {
+            if (sscanf(line, "rchar: %llu", &value) == 1 || sscanf(line, "wchar: %llu", &value) == 1) {
+                usage.ioBytes += value;
+            }
+        }
+        fclose(file);
+    }
+#endif // _WIN32
+    return usage;
+}
+
+void GovernorWakeup()
+{
+    _governor_wakeups++;
+}
+
+
+GovernorMode GovernorFeed(const GovernorUsage& usage, unsigned long elapsedMs)
+{
+    std::lock_guard<std::mutex> lock(_governor_mutex);
+    GovernorMode mode = _governor.Update(usage, elapsedMs);
+#ifdef _DEBUG
+    if (mode != _governor_mode) {
+        std::cout << "Governor: " << GovernorModeName(mode) << " (load " << _governor.Load() << ")\n";
+    }
+#endif // _DEBUG
+    _governor_mode = mode;
+    _governor_load = _governor.Load();
+    return mode;
+}
+
+void GovernorTick()
+{
+    static auto last = std::chrono::steady_clock::now();
+    static bool primed = false;
+    auto now = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - last).count();
+    if (primed && elapsed < GOVERNOR_INTERVAL) {
+        return;
+    }
+    GovernorFeed(SampleGovernorUsage(), primed ? (unsigned long)elapsed : 0);
+    last = now;
+    primed = true;
+}
+
+
+GovernorMode GetGovernorMode()
+{
+    return (GovernorMode)_governor_mode.load();
+}
+
+double GetGovernorLoad()
+{
+    return _governor_load;
+}
+
+unsigned GovernorDelayScale()
+{
+    switch (GetGovernorMode()) {
+    case GOVERNOR_REDUCED:
+        return 2;
+    case GOVERNOR_MINIMAL:
+        return 5;
+    default:
+        return 1;
+    }
+}
+
+bool GovernorAllowsProbe(unsigned long long lastMs, unsigned long long nowMs)
+{
+    switch (GetGovernorMode()) {
+    case GOVERNOR_REDUCED:
+        return nowMs - lastMs >= GOVERNOR_REDUCED_PROBE_MS;
+    case GOVERNOR_MINIMAL:
+        return nowMs - lastMs >= GOVERNOR_MINIMAL_PROBE_MS;
+    default:
+        return true;
+    }
+}
+
+bool GovernorAllowsMaintenance()
+{
+    return GetGovernorMode() == GOVERNOR_NORMAL;
+}
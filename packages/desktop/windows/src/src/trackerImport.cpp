@@ -0,0 +1,427 @@
+#include "trackerImport.h"
+#include "trackerTime.h"
+
+#include <algorithm>
+#include <iterator>
+#include <thread>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif // __SSE2__
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // _WIN32
+
+// "YYYY-MM-DD HH:MM:SS ; YYYY-MM-DD HH:MM:SS ; " is always 44 bytes
+#define TIME_LEN 19
+#define EXEC_OFFSET 44
+#define CHUNK_MIN_SIZE (1 << 20)
+#define TAIL_WINDOW (64 * 1024)
+
+
+static inline const char* FindByte(const char* p, const char* end, char c)
+{
+#ifdef __SSE2__
+    const __m128i needle = _mm_set1_epi8(c);
+    while (end - p >= 16) {
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), needle));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+#endif // __SSE2__
+    while (p < end && *p != c) {
+        p++;
+    }
+    return p;
+}
+
+// Find the first " ; " whose ';' is at or after p
+static inline const char* FindDelimiter(const char* p, const char* end)
+{
+    while ((p = FindByte(p, end, ';')) < end) {
+        if (p[-1] == ' ' && p + 1 < end && p[1] == ' ') {
+            return p;
+        }
+        p++;
+    }
+    return end;
+}
+
+static inline unsigned Digit(const char* p, unsigned& bad)
+{
+    unsigned d = (unsigned char)(*p - '0');
+    bad |= (d > 9);
+    return d;
+}
+
+static inline WORD Number2(const char* p, unsigned& bad)
+{
+    return (WORD)(Digit(p, bad) * 10 + Digit(p + 1, bad));
+}
+
+static bool ParseTime(const char* p, SYSTEMTIME& st)
+{
+    if (p[4] != '-' || p[7] != '-' || p[10] != ' ' || p[13] != ':' || p[16] != ':') {
+        return false;
+    }
+    unsigned bad = 0;
+    st.wYear = (WORD)(Number2(p, bad) * 100 + Number2(p + 2, bad));
+    st.wMonth = Number2(p + 5, bad);
+    st.wDay = Number2(p + 8, bad);
+    st.wHour = Number2(p + 11, bad);
+    st.wMinute = Number2(p + 14, bad);
+    st.wSecond = Number2(p + 17, bad);
+    st.wDayOfWeek = 0;
+    st.wMilliseconds = 0;
+    return !bad && st.wMonth >= 1 && st.wMonth <= 12 && st.wDay >= 1 && st.wDay <= 31 &&
+           st.wHour < 24 && st.wMinute < 60 && st.wSecond < 60;
+}
+
+bool ParseLogLine(const char* line, size_t len, AppLogger& log)
+{
+    if (len > 0 && line[len - 1] == '\r') {
+        len--;
+    }
+    // Shortest valid line has an empty executable: "... ; <end> ;  ; "
+    if (len < EXEC_OFFSET + 2) {
+        return false;
+    }
+    if (memcmp(line + TIME_LEN, " ; ", 3) != 0 || memcmp(line + 2 * TIME_LEN + 3, " ; ", 3) != 0) {
+        return false;
+    }
+    if (!ParseTime(line, log.start) || !ParseTime(line + TIME_LEN + 3, log.end)) {
+        return false;
+    }
+
+    const char* end = line + len;
+    const char* delim = FindDelimiter(line + EXEC_OFFSET + 1, end);
+    if (delim == end) {
+        return false;
+    }
+    log.executable.assign(line + EXEC_OFFSET, delim - 1);
+    log.title.assign(delim + 2, end);
+    return true;
+}
+
+static inline char* PutTime(char* p, const SYSTEMTIME& st)
+{
+    auto put2 = [](char* q, unsigned v) { q[0] = (char)('0' + v / 10 % 10); q[1] = (char)('0' + v % 10); };
+    put2(p, st.wYear / 100);
+    put2(p + 2, st.wYear);
+    p[4] = '-';
+    put2(p + 5, st.wMonth);
+    p[7] = '-';
+    put2(p + 8, st.wDay);
+    p[10] = ' ';
+    put2(p + 11, st.wHour);
+    p[13] = ':';
+    put2(p + 14, st.wMinute);
+    p[16] = ':';
+    put2(p + 17, st.wSecond);
+    return p + TIME_LEN;
+}
+
+void AppendLogLine(std::string& out, const AppLogger& log)
+{
+    char prefix[EXEC_OFFSET];
+    char* p = PutTime(prefix, log.start);
+    memcpy(p, " ; ", 3);
+    p = PutTime(p + 3, log.end);
+    memcpy(p, " ; ", 3);
+    out.append(prefix, EXEC_OFFSET);
+    out += log.executable;
+    out += " ; ";
+    out += log.title;
+    out += '\n';
+}
+
+static void ImportChunk(const char* p, const char* end, std::vector<AppLogger>& out, ImportStats& stats)
+{
+    AppLogger log;
+    while (p < end) {
+        const char* eol = FindByte(p, end, '\n');
+        if (eol > p && !(eol - p == 1 && *p == '\r')) {
+            stats.lines++;
+            if (ParseLogLine(p, eol - p, log)) {
+                out.push_back(std::move(log));
+                stats.imported++;
+            } else {
+                stats.malformed++;
+            }
+        }
+        p = eol + 1;
+    }
+}
+
+ImportStats ImportLogBuffer(const char* data, size_t size, std::vector<AppLogger>& out, unsigned threads)
+{
+    ImportStats total = {0, 0, 0, size};
+    if (size == 0) {
+        return total;
+    }
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    size_t chunks = std::max<size_t>(1, std::min<size_t>(threads, size / CHUNK_MIN_SIZE));
+
+    // Chunk boundaries always sit right after a newline
+    const char* end = data + size;
+    std::vector<const char*> bounds(chunks + 1, end);
+    bounds[0] = data;
+    for (size_t i = 1; i < chunks; i++) {
+        const char* p = std::max(bounds[i - 1], data + size / chunks * i);
+        p = FindByte(p, end, '\n');
+        bounds[i] = (p < end) ? p + 1 : end;
+    }
+
+    if (chunks == 1) {
+        ImportStats stats = {0, 0, 0, 0};
+        ImportChunk(data, end, out, stats);
+        total.lines = stats.lines;
+        total.imported = stats.imported;
+        total.malformed = stats.malformed;
+        return total;
+    }
+
+    std::vector<std::vector<AppLogger>> parts(chunks);
+    std::vector<ImportStats> stats(chunks, ImportStats{0, 0, 0, 0});
+    std::vector<std::thread> workers;
+    workers.reserve(chunks);
+    for (size_t i = 0; i < chunks; i++) {
+        workers.emplace_back([&, i]() {
+            parts[i].reserve((bounds[i + 1] - bounds[i]) / 96);
+            ImportChunk(bounds[i], bounds[i + 1], parts[i], stats[i]);
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    size_t count = 0;
+    for (const auto& part : parts) {
+        count += part.size();
+    }
+    out.reserve(out.size() + count);
+    for (size_t i = 0; i < chunks; i++) {
+        std::move(parts[i].begin(), parts[i].end(), std::back_inserter(out));
+        total.lines += stats[i].lines;
+        total.imported += stats[i].imported;
+        total.malformed += stats[i].malformed;
+    }
+    return total;
+}
+
+ImportStats ImportLogFile(const std::filesystem::path& path, std::vector<AppLogger>& out, unsigned threads)
+{
+    ImportStats stats = {0, 0, 0, 0};
+#ifdef _WIN32
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return stats;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return stats;
+    }
+    HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL) {
+        CloseHandle(file);
+        return stats;
+    }
+    const char* data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data != NULL) {
+        stats = ImportLogBuffer(data, (size_t)size.QuadPart, out, threads);
+        UnmapViewOfFile(data);
+    }
+    CloseHandle(mapping);
+    CloseHandle(file);
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return stats;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return stats;
+    }
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED) {
+        madvise(data, st.st_size, MADV_SEQUENTIAL);
+        stats = ImportLogBuffer((const char*)data, (size_t)st.st_size, out, threads);
+        munmap(data, st.st_size);
+    }
+    close(fd);
+#endif // _WIN32
+    return stats;
+}
+
+
+typedef struct {
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int fd;
+#endif // _WIN32
+    uint64_t size;
+    uint64_t granularity;
+} MappedFile;
+
+static bool OpenMapped(const std::filesystem::path& path, MappedFile& mapped)
+{
+#ifdef _WIN32
+    mapped.file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (mapped.file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER size;
+    mapped.mapping = NULL;
+    if (GetFileSizeEx(mapped.file, &size) && size.QuadPart > 0) {
+        mapped.mapping = CreateFileMappingW(mapped.file, NULL, PAGE_READONLY, 0, 0, NULL);
+    }
+    if (mapped.mapping == NULL) {
+        CloseHandle(mapped.file);
+        return false;
+    }
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    mapped.size = (uint64_t)size.QuadPart;
+    mapped.granularity = info.dwAllocationGranularity;
+#else
+    mapped.fd = open(path.c_str(), O_RDONLY);
+    if (mapped.fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(mapped.fd, &st) != 0 || st.st_size == 0) {
+        close(mapped.fd);
+        return false;
+    }
+    mapped.size = (uint64_t)st.st_size;
+    mapped.granularity = (uint64_t)sysconf(_SC_PAGESIZE);
+#endif // _WIN32
+    return true;
+}
+
+// Maps [offset, size), offset must be a multiple of the granularity
+static const char* MapFrom(const MappedFile& mapped, uint64_t offset)
+{
+    size_t length = (size_t)(mapped.size - offset);
+#ifdef _WIN32
+    return (const char*)MapViewOfFile(mapped.mapping, FILE_MAP_READ, (DWORD)(offset >> 32), (DWORD)offset, length);
+#else
+    void* data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, mapped.fd, (off_t)offset);
+    return data != MAP_FAILED ? (const char*)data : NULL;
+#endif // _WIN32
+}
+
+static void Unmap(const MappedFile& mapped, const char* data, uint64_t offset)
+{
+#ifdef _WIN32
+    (void)mapped;
+    (void)offset;
+    UnmapViewOfFile(data);
+#else
+    munmap((void*)data, (size_t)(mapped.size - offset));
+#endif // _WIN32
+}
+
+static void CloseMapped(const MappedFile& mapped)
+{
+#ifdef _WIN32
+    CloseHandle(mapped.mapping);
+    CloseHandle(mapped.file);
+#else
+    close(mapped.fd);
+#endif // _WIN32
+}
+
+bool ScanLinesBackward(const std::filesystem::path& path, const LineVisitor& visit)
+{
+    MappedFile mapped;
+    if (!OpenMapped(path, mapped)) {
+        return false;
+    }
+    // Lines starting at or after done have been visited
+    uint64_t done = mapped.size;
+    bool more = true;
+    for (uint64_t window = TAIL_WINDOW; more; window *= 2) {
+        uint64_t offset = mapped.size > window ? (mapped.size - window) / mapped.granularity * mapped.granularity : 0;
+        const char* data = MapFrom(mapped, offset);
+        if (data == NULL) {
+            CloseMapped(mapped);
+            return false;
+        }
+        const char* end = data + (done - offset);
+        while (more && end > data) {
+            const char* eol = end;
+            if (eol[-1] == '\n') {
+                eol--;
+            }
+            const char* start = eol;
+            while (start > data && start[-1] != '\n') {
+                start--;
+            }
+            if (start == data && offset > 0) {
+                break; // May continue before the window
+            }
+            if (eol > start) {
+                more = visit(start, eol - start, offset + (start - data));
+            }
+            end = start;
+            done = offset + (start - data);
+        }
+        Unmap(mapped, data, offset);
+        more = more && offset > 0;
+    }
+    CloseMapped(mapped);
+    return true;
+}
+
+ImportStats ImportLogTail(const std::filesystem::path& path, ULONGLONG fromKey, std::vector<AppLogger>& out)
+{
+    ImportStats stats = {0, 0, 0, 0};
+    size_t first = out.size();
+    AppLogger log;
+    ScanLinesBackward(path, [&](const char* line, size_t len, uint64_t) {
+        if (len == 1 && *line == '\r') {
+            return true;
+        }
+        stats.lines++;
+        stats.bytes += len + 1;
+        if (!ParseLogLine(line, len, log)) {
+            stats.malformed++;
+            return true;
+        }
+        if (TimeKey(log.start) < fromKey) {
+            return false;
+        }
+        out.push_back(std::move(log));
+        stats.imported++;
+        return true;
+    });
+    std::reverse(out.begin() + first, out.end());
+    return stats;
+}
+
+bool ReadLastLogRecord(const std::filesystem::path& path, AppLogger& log, uint64_t& offset)
+{
+    bool found = false;
+    ScanLinesBackward(path, [&](const char* line, size_t len, uint64_t at) {
+        found = ParseLogLine(line, len, log);
+        offset = at;
+        return !found;
+    });
+    return found;
+}
@@ -0,0 +1,609 @@
+#include "trackerIndex.h"
+#include "trackerArchive.h"
+#include "trackerImport.h"
+#include "trackerTime.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <set>
+
+#define INDEX_MAGIC "CSX1"
+#define EXE_TERM '\x01' // Executables share the dictionary under this prefix
+
+
+static void PutVarint(std::string& out, uint64_t value)
+{
+    while (value >= 0x80) {
+        out += (char)(value | 0x80);
+        value >>= 7;
+    }
+    out += (char)value;
+}
+
+static bool GetVarint(const char*& p, const char* end, uint64_t& value)
+{
+    value = 0;
+    for (unsigned shift = 0; p < end && shift < 64; shift += 7) {
+        uint8_t byte = (uint8_t)*p++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void PutString(std::string& out, const std::string& value)
+{
+    PutVarint(out, value.size());
+    out += value;
+}
+
+static bool GetString(const char*& p, const char* end, std::string& value)
+{
+    uint64_t len;
+    if (!GetVarint(p, end, len) || (uint64_t)(end - p) < len) {
+        return false;
+    }
+    value.assign(p, (size_t)len);
+    p += len;
+    return true;
+}
+
+static inline bool IsTokenChar(unsigned char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c >= 0x80;
+}
+
+static inline bool StartsWith(const std::string& value, const std::string& prefix)
+{
+    return value.size() >= prefix.size() && memcmp(value.data(), prefix.data(), prefix.size()) == 0;
+}
+
+static std::string Lower(const std::string& value)
+{
+    std::string out(value);
+    for (char& c : out) {
+        if (c >= 'A' && c <= 'Z') {
+            c = (char)(c - 'A' + 'a');
+        }
+    }
+    return out;
+}
+
+static long long KeySeconds(ULONGLONG key)
+{
+    return TimeSeconds(TimeFromKey(key));
+}
+
+
+void TokenizeTitle(const std::string& title, std::vector<std::string>& out)
+{
+    out.clear();
+    size_t i = 0;
+    while (i < title.size()) {
+        while (i < title.size() && !IsTokenChar((unsigned char)title[i])) {
+            i++;
+        }
+        size_t start = i;
+        while (i < title.size() && IsTokenChar((unsigned char)title[i])) {
+            i++;
+        }
+        if (i > start) {
+            out.push_back(Lower(title.substr(start, std::min<size_t>(i - start, INDEX_MAX_TOKEN))));
+        }
+    }
+}
+
+bool ParseIndexQuery(const std::string& text, IndexQuery& query)
+{
+    query.clauses.clear();
+    query.exe.clear();
+    query.exePrefix = false;
+
+    size_t i = 0;
+    while (i < text.size()) {
+        if (text[i] == ' ' || text[i] == '\t') {
+            i++;
+            continue;
+        }
+        std::string word;
+        bool quoted = text[i] == '"';
+        if (quoted) {
+            size_t close = text.find('"', i + 1);
+            if (close == std::string::npos) {
+                return false;
+            }
+            word = text.substr(i + 1, close - i - 1);
+            i = close + 1;
+        } else {
+            size_t end = text.find_first_of(" \t", i);
+            end = end == std::string::npos ? text.size() : end;
+            word = text.substr(i, end - i);
+            i = end;
+        }
+
+        bool prefix = !word.empty() && word.back() == '*';
+        if (prefix) {
+            word.pop_back();
+        }
+        if (!quoted && StartsWith(word, "exe:")) {
+            query.exe = Lower(word.substr(4));
+            query.exePrefix = prefix;
+            continue;
+        }
+
+        IndexClause clause;
+        TokenizeTitle(word, clause.tokens);
+        // "report.*" is a prefix on "report", not on an empty token
+        clause.prefix = prefix && !word.empty() && IsTokenChar((unsigned char)word.back());
+        if (!clause.tokens.empty()) {
+            query.clauses.push_back(std::move(clause));
+        }
+    }
+    return true;
+}
+
+
+IndexSegment::IndexSegment(unsigned month)
+    : _month(month), _ordered(true)
+{
+}
+
+void IndexSegment::AddTerm(const std::string& term, uint32_t session)
+{
+    auto it = _terms.find(term);
+    if (it == _terms.end()) {
+        it = _terms.emplace(term, Postings{std::string(), 0, 0}).first;
+        PutVarint(it->second.data, session);
+    } else {
+        PutVarint(it->second.data, session - it->second.last);
+    }
+    it->second.last = session;
+    it->second.count++;
+}
+
+bool IndexSegment::Add(const AppLogger& log)
+{
+    IndexedSession session;
+    session.start = TimeSeconds(log.start);
+    session.end = TimeSeconds(log.end);
+
+    auto knownExe = _exe_ids.find(log.executable);
+    auto knownTitle = _title_ids.find(log.title);
+    if (knownExe != _exe_ids.end() && knownTitle != _title_ids.end()) {
+        auto range = _starts.equal_range(session.start);
+        for (auto it = range.first; it != range.second; ++it) {
+            IndexedSession& known = _sessions[it->second];
+            if (known.exe == knownExe->second && known.title == knownTitle->second) {
+                if (session.end <= known.end) {
+                    return false;
+                }
+                known.end = session.end;
+                return true;
+            }
+        }
+    }
+
+    auto exe = _exe_ids.emplace(log.executable, (uint32_t)_exes.size());
+    if (exe.second) {
+        _exes.push_back(log.executable);
+    }
+    session.exe = exe.first->second;
+    auto title = _title_ids.emplace(log.title, (uint32_t)_titles.size());
+    if (title.second) {
+        _titles.push_back(log.title);
+    }
+    session.title = title.first->second;
+
+    uint32_t id = (uint32_t)_sessions.size();
+    _ordered = _ordered && (_sessions.empty() || session.start >= _sessions.back().start);
+    _sessions.push_back(session);
+    _starts.emplace(session.start, id);
+
+    std::vector<std::string> tokens;
+    TokenizeTitle(log.title, tokens);
+    std::sort(tokens.begin(), tokens.end());
+    tokens.erase(std::unique(tokens.begin(), tokens.end()), tokens.end());
+    for (const auto& token : tokens) {
+        AddTerm(token, id);
+    }
+    AddTerm(EXE_TERM + Lower(log.executable), id);
+    return true;
+}
+
+void IndexSegment::Lookup(const std::string& term, bool prefix, std::vector<uint32_t>& out) const
+{
+    out.clear();
+    auto it = prefix ? _terms.lower_bound(term) : _terms.find(term);
+    for (; it != _terms.end() && (prefix ? StartsWith(it->first, term) : it->first == term); ++it) {
+        const char* p = it->second.data.data();
+        const char* end = p + it->second.data.size();
+        uint64_t delta;
+        uint32_t id = 0;
+        for (bool first = true; GetVarint(p, end, delta); first = false) {
+            id = first ? (uint32_t)delta : id + (uint32_t)delta;
+            out.push_back(id);
+        }
+        if (!prefix) {
+            break;
+        }
+    }
+    if (prefix) {
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+    }
+}
+
+AppLogger IndexSegment::Session(uint32_t id) const
+{
+    const IndexedSession& session = _sessions[id];
+    AppLogger log;
+    log.start = TimeFromSeconds(session.start);
+    log.end = TimeFromSeconds(session.end);
+    log.executable = _exes[session.exe];
+    log.title = _titles[session.title];
+    return log;
+}
+
+static bool MatchPhrase(const std::vector<std::string>& tokens, const IndexClause& clause)
+{
+    size_t n = clause.tokens.size();
+    for (size_t i = 0; i + n <= tokens.size(); i++) {
+        size_t j = 0;
+        while (j < n && (clause.prefix && j == n - 1 ? StartsWith(tokens[i + j], clause.tokens[j])
+                                                     : tokens[i + j] == clause.tokens[j])) {
+            j++;
+        }
+        if (j == n) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void IndexSegment::Search(const IndexQuery& query, long long from, long long to, size_t limit,
+                          std::vector<AppLogger>& out) const
+{
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> list;
+    bool all = true;
+    auto intersect = [&]() {
+        if (all) {
+            candidates.swap(list);
+            all = false;
+            return;
+        }
+        std::vector<uint32_t> both;
+        std::set_intersection(candidates.begin(), candidates.end(), list.begin(), list.end(), std::back_inserter(both));
+        candidates.swap(both);
+    };
+
+    for (const auto& clause : query.clauses) {
+        for (size_t i = 0; i < clause.tokens.size() && (all || !candidates.empty()); i++) {
+            Lookup(clause.tokens[i], clause.prefix && i + 1 == clause.tokens.size(), list);
+            intersect();
+        }
+    }
+    if (!query.exe.empty() && (all || !candidates.empty())) {
+        Lookup(EXE_TERM + query.exe, query.exePrefix, list);
+        intersect();
+    }
+
+    if (all) {
+        candidates.resize(_sessions.size());
+        for (uint32_t id = 0; id < candidates.size(); id++) {
+            candidates[id] = id;
+        }
+    }
+    if (!_ordered) {
+        std::stable_sort(candidates.begin(), candidates.end(),
+                         [&](uint32_t a, uint32_t b) { return _sessions[a].start < _sessions[b].start; });
+    }
+
+    std::vector<std::string> tokens;
+    for (size_t k = candidates.size(); k-- > 0 && out.size() < limit;) {
+        uint32_t id = candidates[k];
+        const IndexedSession& session = _sessions[id];
+        if (session.end < from || session.start > to) {
+            continue;
+        }
+        bool match = true;
+        for (const auto& clause : query.clauses) {
+            if (clause.tokens.size() > 1) {
+                if (tokens.empty()) {
+                    TokenizeTitle(_titles[session.title], tokens);
+                }
+                match = match && MatchPhrase(tokens, clause);
+            }
+        }
+        tokens.clear();
+        if (match) {
+            out.push_back(Session(id));
+        }
+    }
+}
+
+bool IndexSegment::Save(const std::filesystem::path& path) const
+{
+    std::string data = INDEX_MAGIC;
+    PutVarint(data, _month);
+
+    PutVarint(data, _exes.size());
+    for (const auto& exe : _exes) {
+        PutString(data, exe);
+    }
+    PutVarint(data, _titles.size());
+    for (const auto& title : _titles) {
+        PutString(data, title);
+    }
+
+    PutVarint(data, _sessions.size());
+    long long previous = 0;
+    for (const auto& session : _sessions) {
+        long long delta = session.start - previous;
+        PutVarint(data, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+        PutVarint(data, (uint64_t)std::max(0LL, session.end - session.start));
+        PutVarint(data, session.exe);
+        PutVarint(data, session.title);
+        previous = session.start;
+    }
+
+    // Front-coded dictionary, each term followed by its postings
+    PutVarint(data, _terms.size());
+    const std::string* last = NULL;
+    for (const auto& term : _terms) {
+        size_t shared = 0;
+        if (last != NULL) {
+            size_t max = std::min(last->size(), term.first.size());
+            while (shared < max && (*last)[shared] == term.first[shared]) {
+                shared++;
+            }
+        }
+        PutVarint(data, shared);
+        PutString(data, term.first.substr(shared));
+        PutVarint(data, term.second.count);
+        PutVarint(data, term.second.last);
+        PutString(data, term.second.data);
+        last = &term.first;
+    }
+
+    std::filesystem::path tmpPath = path;
+    tmpPath += ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!file.write(data.data(), data.size())) {
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, path, ec);
+    return !ec;
+}
+
+bool IndexSegment::Load(const std::filesystem::path& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (data.size() < 4 || memcmp(data.data(), INDEX_MAGIC, 4) != 0) {
+        return false;
+    }
+    const char* p = data.data() + 4;
+    const char* end = data.data() + data.size();
+    uint64_t month, count, a, b, c, d;
+    IndexSegment segment;
+    if (!GetVarint(p, end, month)) {
+        return false;
+    }
+    segment._month = (unsigned)month;
+
+    std::string value;
+    if (!GetVarint(p, end, count)) {
+        return false;
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        if (!GetString(p, end, value)) {
+            return false;
+        }
+        segment._exe_ids.emplace(value, (uint32_t)segment._exes.size());
+        segment._exes.push_back(value);
+    }
+    if (!GetVarint(p, end, count)) {
+        return false;
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        if (!GetString(p, end, value)) {
+            return false;
+        }
+        segment._title_ids.emplace(value, (uint32_t)segment._titles.size());
+        segment._titles.push_back(value);
+    }
+
+    if (!GetVarint(p, end, count)) {
+        return false;
+    }
+    long long previous = 0;
+    segment._sessions.reserve((size_t)count);
+    segment._starts.reserve((size_t)count);
+    for (uint64_t i = 0; i < count; i++) {
+        if (!GetVarint(p, end, a) || !GetVarint(p, end, b) || !GetVarint(p, end, c) || !GetVarint(p, end, d) ||
+            c >= segment._exes.size() || d >= segment._titles.size()) {
+            return false;
+        }
+        IndexedSession session;
+        session.start = previous + (long long)((a >> 1) ^ (~(a & 1) + 1));
+        session.end = session.start + (long long)b;
+        session.exe = (uint32_t)c;
+        session.title = (uint32_t)d;
+        segment._starts.emplace(session.start, (uint32_t)segment._sessions.size());
+        segment._ordered = segment._ordered && (segment._sessions.empty() || session.start >= previous);
+        segment._sessions.push_back(session);
+        previous = session.start;
+    }
+
+    if (!GetVarint(p, end, count)) {
+        return false;
+    }
+    std::string term;
+    for (uint64_t i = 0; i < count; i++) {
+        Postings postings;
+        if (!GetVarint(p, end, a) || a > term.size() || !GetString(p, end, value) || !GetVarint(p, end, b) ||
+            !GetVarint(p, end, c) || !GetString(p, end, postings.data)) {
+            return false;
+        }
+        term.resize((size_t)a);
+        term += value;
+        postings.count = (uint32_t)b;
+        postings.last = (uint32_t)c;
+        segment._terms.emplace_hint(segment._terms.end(), term, std::move(postings));
+    }
+
+    *this = std::move(segment);
+    return true;
+}
+
+
+std::mutex _index_mutex;
+std::map<unsigned, IndexSegment> _segments;
+std::set<unsigned> _dirty_segments;
+// Segments saved on disk and not loaded yet, read on first use
+std::set<unsigned> _stored_segments;
+
+static inline unsigned MonthOf(const SYSTEMTIME& st)
+{
+    return st.wYear * 100u + st.wMonth;
+}
+
+static std::filesystem::path IndexDir()
+{
+    return GetLogFilePath().parent_path() / "Index";
+}
+
+static std::filesystem::path SegmentPath(unsigned month)
+{
+    char name[16];
+    snprintf(name, sizeof(name), "%04u-%02u.idx", month / 100, month % 100);
+    return IndexDir() / name;
+}
+
+// Caller holds _index_mutex
+static IndexSegment& Segment(unsigned month)
+{
+    auto it = _segments.find(month);
+    if (it != _segments.end()) {
+        return it->second;
+    }
+    IndexSegment& segment = _segments.try_emplace(month, month).first->second;
+    if (_stored_segments.erase(month) && !segment.Load(SegmentPath(month))) {
+        segment = IndexSegment(month);
+    }
+    return segment;
+}
+
+// Caller holds _index_mutex. The catch-up on start and a resumed session
+// hand over sessions the segment already has, Add skips them.
+static void IndexSession(const AppLogger& log)
+{
+    unsigned month = MonthOf(log.start);
+    if (Segment(month).Add(log)) {
+        _dirty_segments.insert(month);
+    }
+}
+
+static void OnSessionClosed(const AppLogger& log)
+{
+    std::lock_guard<std::mutex> lock(_index_mutex);
+    IndexSession(log);
+}
+
+void StartTitleIndex()
+{
+    std::filesystem::path logPath = GetLogFilePath();
+    std::error_code ec;
+    {
+        std::lock_guard<std::mutex> lock(_index_mutex);
+        // Only the names: segments load when first searched or appended to
+        unsigned year, month;
+        for (const auto& entry : std::filesystem::directory_iterator(IndexDir(), ec)) {
+            if (entry.path().extension() == ".idx" &&
+                sscanf(entry.path().stem().string().c_str(), "%u-%u", &year, &month) == 2) {
+                _stored_segments.insert(year * 100 + month);
+            }
+        }
+
+        // Months archived before the index existed
+        for (const auto& entry : std::filesystem::directory_iterator(logPath.parent_path() / "Archive", ec)) {
+            ArchiveReader reader;
+            if (entry.path().extension() != ".csa" ||
+                sscanf(entry.path().stem().string().c_str(), "%u-%u", &year, &month) != 2 ||
+                _stored_segments.count(year * 100 + month) || _segments.count(year * 100 + month) ||
+                !OpenArchive(entry.path(), reader)) {
+                continue;
+            }
+            std::vector<AppLogger> logs;
+            for (size_t i = 0; i < reader.blocks.size(); i++) {
+                ReadArchiveBlock(reader, i, logs);
+            }
+            for (const auto& log : logs) {
+                IndexSession(log);
+            }
+        }
+
+        // Catch up with whatever the text log gained since the newest indexed session
+        ULONGLONG fromKey = 0;
+        unsigned newest = std::max(_stored_segments.empty() ? 0 : *_stored_segments.rbegin(),
+                                   _segments.empty() ? 0 : _segments.rbegin()->first);
+        if (newest != 0 && Segment(newest).LastStart() >= 0) {
+            fromKey = TimeKey(TimeFromSeconds(Segment(newest).LastStart()));
+        }
+        std::vector<AppLogger> logs;
+        ImportLogTail(logPath, fromKey, logs);
+        for (const auto& log : logs) {
+            IndexSession(log);
+        }
+    }
+    AddSessionListener(OnSessionClosed);
+}
+
+void SaveTitleIndex()
+{
+    std::lock_guard<std::mutex> lock(_index_mutex);
+    std::error_code ec;
+    std::filesystem::create_directories(IndexDir(), ec);
+    for (unsigned month : _dirty_segments) {
+        _segments[month].Save(SegmentPath(month));
+    }
+    _dirty_segments.clear();
+}
+
+std::vector<AppLogger> SearchTitles(const std::string& text, ULONGLONG from, ULONGLONG to, size_t limit)
+{
+    std::vector<AppLogger> out;
+    IndexQuery query;
+    if (!ParseIndexQuery(text, query)) {
+        return out;
+    }
+    long long fromSeconds = from == 0 ? 0 : KeySeconds(from);
+    long long toSeconds = to == 0 ? (1LL << 62) : KeySeconds(to);
+    unsigned fromMonth = from == 0 ? 0 : (unsigned)(from / 100000000ULL);
+    unsigned toMonth = to == 0 ? ~0u : (unsigned)(to / 100000000ULL);
+    // A session that started the month before can still overlap the range
+    if (fromMonth > 0) {
+        fromMonth = fromMonth % 100 == 1 ? fromMonth - 89 : fromMonth - 1;
+    }
+
+    std::lock_guard<std::mutex> lock(_index_mutex);
+    std::set<unsigned> months(_stored_segments);
+    for (const auto& item : _segments) {
+        months.insert(item.first);
+    }
+    for (auto it = months.rbegin(); it != months.rend() && out.size() < limit; ++it) {
+        if (*it > toMonth || *it < fromMonth) {
+            continue;
+        }
+        Segment(*it).Search(query, fromSeconds, toSeconds, limit, out);
+    }
+    return out;
+}
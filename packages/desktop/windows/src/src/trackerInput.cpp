@@ -0,0 +1,340 @@
+#include "trackerInput.h"
+#include "trackerTime.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <string>
+
+#ifdef _DEBUG
+#include <iostream>
+#endif // _DEBUG
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/input.h>
+#include <poll.h>
+#include <unistd.h>
+#include <thread>
+#include <vector>
+#endif // _WIN32
+
+
+// Written by the input thread only, on a line of their own so the reducer
+// reading them never shares one with anything the hooks do not touch
+alignas(64) std::atomic<uint32_t> _input_counts[INPUT_KINDS];
+std::atomic<bool> _input_active(false);
+// Begin and End come from the tray and the shutdown path
+std::mutex _input_thread_mutex;
+
+// Reducer state, the tracker thread folds, the logger takes and the save thread drains
+std::mutex _input_mutex;
+uint32_t _input_seen[INPUT_KINDS] = {};
+long long _input_minute = -1;
+uint32_t _input_minute_counts[INPUT_KINDS] = {};
+InputSummary _input_session = {};
+std::string _input_lines;
+// Only the save thread writes from it, swapped with _input_lines so both keep their capacity
+std::string _input_writing;
+
+
+void RecordInput(InputKind kind)
+{
+    _input_counts[kind].store(_input_counts[kind].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+#ifdef _WIN32
+HANDLE _input_thread = NULL;
+DWORD _input_thread_id = 0;
+bool _input_hooked = false;
+// Keys held down, so auto-repeat is not counted; hook thread only
+uint64_t _input_keys_down[4] = {};
+
+static LRESULT CALLBACK KeyboardHook(int code, WPARAM wParam, LPARAM lParam)
+{
+    if (code == HC_ACTION) {
+        const KBDLLHOOKSTRUCT* key = reinterpret_cast<const KBDLLHOOKSTRUCT*>(lParam);
+        uint64_t& word = _input_keys_down[(key->vkCode >> 6) & 3];
+        uint64_t bit = 1ULL << (key->vkCode & 63);
+        if (wParam == WM_KEYUP || wParam == WM_SYSKEYUP) {
+            word &= ~bit;
+        } else if (!(word & bit) && !(key->flags & LLKHF_INJECTED)) {
+            word |= bit;
+            RecordInput(INPUT_KEY);
+        }
+    }
+    return CallNextHookEx(NULL, code, wParam, lParam);
+}
+
+// Moves are by far the most frequent and fall straight through
+static LRESULT CALLBACK MouseHook(int code, WPARAM wParam, LPARAM lParam)
+{
+    if (code == HC_ACTION) {
+        bool injected = reinterpret_cast<const MSLLHOOKSTRUCT*>(lParam)->flags & LLMHF_INJECTED;
+        switch (wParam) {
+        case WM_LBUTTONDOWN:
+        case WM_RBUTTONDOWN:
+        case WM_MBUTTONDOWN:
+        case WM_XBUTTONDOWN:
+            if (!injected) {
+                RecordInput(INPUT_CLICK);
+            }
+            break;
+        case WM_MOUSEWHEEL:
+        case WM_MOUSEHWHEEL:
+            if (!injected) {
+                RecordInput(INPUT_SCROLL);
+            }
+            break;
+        }
+    }
+    return CallNextHookEx(NULL, code, wParam, lParam);
+}
+
+// Low-level hooks are called on the thread that set them, through its message loop
+static DWORD WINAPI InputHookLoop(LPVOID ready)
+{
+    MSG msg;
+    // Creates the queue EndInputCounting posts WM_QUIT to
+    PeekMessageA(&msg, NULL, WM_USER, WM_USER, PM_NOREMOVE);
+    HINSTANCE instance = GetModuleHandleA(NULL);
+    HHOOK keyboard = SetWindowsHookExA(WH_KEYBOARD_LL, KeyboardHook, instance, 0);
+    HHOOK mouse = SetWindowsHookExA(WH_MOUSE_LL, MouseHook, instance, 0);
+    _input_hooked = keyboard != NULL || mouse != NULL;
+    SetEvent((HANDLE)ready);
+
+    while (_input_hooked && GetMessageA(&msg, NULL, 0, 0) > 0) {
+        DispatchMessageA(&msg);
+    }
+    if (keyboard != NULL) {
+        UnhookWindowsHookEx(keyboard);
+    }
+    if (mouse != NULL) {
+        UnhookWindowsHookEx(mouse);
+    }
+    return 0;
+}
+
+static bool StartInputThread()
+{
+    HANDLE ready = CreateEventA(NULL, TRUE, FALSE, NULL);
+    _input_thread = CreateThread(NULL, 0, InputHookLoop, ready, 0, &_input_thread_id);
+    if (_input_thread != NULL) {
+        WaitForSingleObject(ready, INFINITE);
+    }
+    CloseHandle(ready);
+    if (_input_thread != NULL && !_input_hooked) {
+        WaitForSingleObject(_input_thread, INFINITE);
+        CloseHandle(_input_thread);
+        _input_thread = NULL;
+    }
+    return _input_thread != NULL;
+}
+
+static void StopInputThread()
+{
+    PostThreadMessageA(_input_thread_id, WM_QUIT, 0, 0);
+    WaitForSingleObject(_input_thread, INFINITE);
+    CloseHandle(_input_thread);
+    _input_thread = NULL;
+}
+#else
+std::thread _input_reader;
+int _input_stop[2] = {-1, -1};
+
+// Auto-repeat comes as value 2, only presses are counted
+static void ReadEvents(int fd)
+{
+    struct input_event events[64];
+    ssize_t size;
+    while ((size = read(fd, events, sizeof(events))) > 0) {
+        for (size_t i = 0; i < size / sizeof(events[0]); i++) {
+            const struct input_event& event = events[i];
+            if (event.type == EV_KEY && event.value == 1) {
+                if (event.code >= BTN_MOUSE && event.code < BTN_JOYSTICK) {
+                    RecordInput(INPUT_CLICK);
+                } else if (event.code < BTN_MISC) {
+                    RecordInput(INPUT_KEY);
+                }
+            } else if (event.type == EV_REL && (event.code == REL_WHEEL || event.code == REL_HWHEEL)) {
+                RecordInput(INPUT_SCROLL);
+            }
+        }
+    }
+}
+
+// fds[0] is the stop pipe, unplugged devices are dropped from the poll
+static void EvdevLoop(std::vector<struct pollfd> fds)
+{
+    while (poll(fds.data(), fds.size(), -1) > 0 && !(fds[0].revents & POLLIN)) {
+        for (size_t i = 1; i < fds.size(); i++) {
+            if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+                close(fds[i].fd);
+                fds[i].fd = -1;
+            } else if (fds[i].revents & POLLIN) {
+                ReadEvents(fds[i].fd);
+            }
+        }
+    }
+    for (size_t i = 1; i < fds.size(); i++) {
+        if (fds[i].fd >= 0) {
+            close(fds[i].fd);
+        }
+    }
+}
+
+// Devices are opened once, readable only by root or the input group
+static bool StartInputThread(const char* deviceDir)
+{
+    std::vector<struct pollfd> fds(1);
+    if (DIR* dir = opendir(deviceDir)) {
+        while (struct dirent* entry = readdir(dir)) {
+            if (strncmp(entry->d_name, "event", 5) != 0) {
+                continue;
+            }
+            std::string path = std::string(deviceDir) + "/" + entry->d_name;
+            int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+            if (fd >= 0) {
+                fds.push_back({fd, POLLIN, 0});
+            }
+        }
+        closedir(dir);
+    }
+    if (fds.size() == 1 || pipe(_input_stop) != 0) {
+        for (size_t i = 1; i < fds.size(); i++) {
+            close(fds[i].fd);
+        }
+        return false;
+    }
+    fds[0] = {_input_stop[0], POLLIN, 0};
+    _input_reader = std::thread(EvdevLoop, std::move(fds));
+    return true;
+}
+
+static void StopInputThread()
+{
+    char stop = 0;
+    if (write(_input_stop[1], &stop, 1) == 1) {
+        _input_reader.join();
+    } else {
+        _input_reader.detach();
+    }
+    close(_input_stop[0]);
+    close(_input_stop[1]);
+    _input_stop[0] = _input_stop[1] = -1;
+}
+#endif // _WIN32
+
+
+// _input_mutex must be held
+static void FinishMinute()
+{
+    if (_input_minute >= 0 && (_input_minute_counts[INPUT_KEY] | _input_minute_counts[INPUT_CLICK] | _input_minute_counts[INPUT_SCROLL])) {
+        SYSTEMTIME st = TimeFromSeconds(_input_minute * 60);
+        char line[80];
+        snprintf(line, sizeof(line), "%04u-%02u-%02u %02u:%02u ; %u ; %u ; %u\n",
+                 st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute,
+                 _input_minute_counts[INPUT_KEY], _input_minute_counts[INPUT_CLICK], _input_minute_counts[INPUT_SCROLL]);
+        _input_lines += line;
+    }
+    memset(_input_minute_counts, 0, sizeof(_input_minute_counts));
+}
+
+#ifdef _WIN32
+bool BeginInputCounting()
+#else
+bool BeginInputCounting(const char* deviceDir)
+#endif // _WIN32
+{
+    std::lock_guard<std::mutex> lock(_input_thread_mutex);
+    if (_input_active) {
+        return true;
+    }
+#ifdef _WIN32
+    _input_active = StartInputThread();
+#else
+    _input_active = StartInputThread(deviceDir);
+#endif // _WIN32
+#ifdef _DEBUG
+    std::cout << "Input counting " << (_input_active ? "started" : "unavailable") << '\n';
+#endif // _DEBUG
+    return _input_active;
+}
+
+// The open minute is written as it stands, nothing more will be counted in it
+void EndInputCounting()
+{
+    std::lock_guard<std::mutex> lock(_input_thread_mutex);
+    if (!_input_active) {
+        return;
+    }
+    StopInputThread();
+    _input_active = false;
+    ReduceInput();
+    std::lock_guard<std::mutex> reducerLock(_input_mutex);
+    FinishMinute();
+    _input_minute = -1;
+}
+
+bool IsInputCountingActive()
+{
+    return _input_active;
+}
+
+void ReduceInput()
+{
+    long long minute = TimeSeconds(GetTime()) / 60;
+    std::lock_guard<std::mutex> lock(_input_mutex);
+    if (minute != _input_minute) {
+        FinishMinute();
+        _input_minute = minute;
+    }
+    bool first = !(_input_minute_counts[INPUT_KEY] | _input_minute_counts[INPUT_CLICK] | _input_minute_counts[INPUT_SCROLL]);
+    uint32_t delta[INPUT_KINDS];
+    for (int kind = 0; kind < INPUT_KINDS; kind++) {
+        // Wraps along with the counter
+        uint32_t count = _input_counts[kind].load(std::memory_order_relaxed);
+        delta[kind] = count - _input_seen[kind];
+        _input_seen[kind] = count;
+        _input_minute_counts[kind] += delta[kind];
+    }
+    if (!(delta[INPUT_KEY] | delta[INPUT_CLICK] | delta[INPUT_SCROLL])) {
+        return;
+    }
+    _input_session.keys += delta[INPUT_KEY];
+    _input_session.clicks += delta[INPUT_CLICK];
+    _input_session.scrolls += delta[INPUT_SCROLL];
+    if (first) {
+        _input_session.activeMinutes++;
+    }
+}
+
+void TakeSessionInput(InputSummary& out)
+{
+    std::lock_guard<std::mutex> lock(_input_mutex);
+    out = _input_session;
+    _input_session = {};
+}
+
+void SaveInput()
+{
+    {
+        std::lock_guard<std::mutex> lock(_input_mutex);
+        _input_writing.swap(_input_lines);
+    }
+    if (_input_writing.empty()) {
+        return;
+    }
+    std::ofstream file(GetLogFilePath().parent_path() / INPUT_FILE, std::ios::app);
+    file << _input_writing;
+#ifdef _DEBUG
+    std::cout << "Input: " << std::count(_input_writing.begin(), _input_writing.end(), '\n') << " minutes saved\n";
+#endif // _DEBUG
+    _input_writing.clear();
+}
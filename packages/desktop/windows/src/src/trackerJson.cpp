@@ -0,0 +1,313 @@
+#include "trackerJson.h"
+#include "trackerArchive.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif // __SSE2__
+
+
+// 0 for bytes copied as they are, otherwise the letter after the backslash
+static constexpr std::array<char, 256> MakeEscapes()
+{
+    std::array<char, 256> escapes = {};
+    for (int c = 0; c < 0x20; c++) {
+        escapes[c] = 'u';
+    }
+    escapes['\b'] = 'b';
+    escapes['\f'] = 'f';
+    escapes['\n'] = 'n';
+    escapes['\r'] = 'r';
+    escapes['\t'] = 't';
+    escapes['"'] = '"';
+    escapes['\\'] = '\\';
+    return escapes;
+}
+
+static constexpr std::array<char, 256> _json_escapes = MakeEscapes();
+
+
+// Length of the run at p that needs no escape
+static inline size_t CleanRun(const char* p, size_t size)
+{
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1F);
+    for (; i + 16 <= size; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+        // Unsigned v <= 0x1F, bytes of multi-byte UTF-8 sequences stay clean
+        __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+                                       _mm_cmpeq_epi8(_mm_max_epu8(v, control), control));
+        int mask = _mm_movemask_epi8(special);
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif // __SSE2__
+    while (i < size && _json_escapes[(unsigned char)p[i]] == 0) {
+        i++;
+    }
+    return i;
+}
+
+
+JsonWriter::JsonWriter() : JsonWriter(nullptr)
+{
+}
+
+JsonWriter::JsonWriter(JsonSink sink) : _sink(std::move(sink))
+{
+    _chunks.push_back(std::make_unique<char[]>(JSON_CHUNK_SIZE));
+    _sizes.push_back(0);
+    Clear();
+}
+
+void JsonWriter::Clear()
+{
+    _chunk = 0;
+    _at = _chunks[0].get();
+    _end = _at + JSON_CHUNK_SIZE;
+    _flushed = 0;
+    _ok = true;
+    _depth = 0;
+    _first[0] = true;
+    _afterKey = false;
+}
+
+void JsonWriter::NextChunk()
+{
+    size_t used = _at - _chunks[_chunk].get();
+    if (_sink) {
+        _ok = _ok && _sink(_chunks[_chunk].get(), used);
+        _flushed += used;
+    } else {
+        _sizes[_chunk] = used;
+        if (++_chunk == _chunks.size()) {
+            _chunks.push_back(std::make_unique<char[]>(JSON_CHUNK_SIZE));
+            _sizes.push_back(0);
+        }
+    }
+    _at = _chunks[_chunk].get();
+    _end = _at + JSON_CHUNK_SIZE;
+}
+
+bool JsonWriter::Flush()
+{
+    if (_sink && _at != _chunks[_chunk].get()) {
+        NextChunk();
+    }
+    return _ok;
+}
+
+size_t JsonWriter::Size() const
+{
+    size_t size = _flushed + (_at - _chunks[_chunk].get());
+    for (size_t i = 0; i < _chunk; i++) {
+        size += _sizes[i];
+    }
+    return size;
+}
+
+void JsonWriter::ForEachChunk(const std::function<void(const char* data, size_t size)>& visit) const
+{
+    for (size_t i = 0; i < _chunk; i++) {
+        visit(_chunks[i].get(), _sizes[i]);
+    }
+    visit(_chunks[_chunk].get(), _at - _chunks[_chunk].get());
+}
+
+void JsonWriter::Raw(const char* data, size_t size)
+{
+    while (size > 0) {
+        if (_at == _end) {
+            NextChunk();
+        }
+        size_t room = std::min<size_t>(size, _end - _at);
+        memcpy(_at, data, room);
+        _at += room;
+        data += room;
+        size -= room;
+    }
+}
+
+// A comma before every member or element but the first, none right after a key.
+// Past JSON_MAX_DEPTH the commas could not be placed, so the payload is refused.
+void JsonWriter::Separate()
+{
+    if (_afterKey) {
+        _afterKey = false;
+    } else if (_depth >= JSON_MAX_DEPTH) {
+        _ok = false;
+    } else if (_depth > 0) {
+        if (!_first[_depth]) {
+            Put(',');
+        }
+        _first[_depth] = false;
+    }
+}
+
+void JsonWriter::Open(char bracket)
+{
+    Separate();
+    Put(bracket);
+    if (++_depth < JSON_MAX_DEPTH) {
+        _first[_depth] = true;
+    } else {
+        _ok = false;
+    }
+}
+
+void JsonWriter::Close(char bracket)
+{
+    if (--_depth < 0) {
+        _ok = false;
+    }
+    Put(bracket);
+}
+
+void JsonWriter::BeginObject()
+{
+    Open('{');
+}
+
+void JsonWriter::EndObject()
+{
+    Close('}');
+}
+
+void JsonWriter::BeginArray()
+{
+    Open('[');
+}
+
+void JsonWriter::EndArray()
+{
+    Close(']');
+}
+
+void JsonWriter::Key(const char* key)
+{
+    Separate();
+    Put('"');
+    Raw(key, strlen(key));
+    Put('"');
+    Put(':');
+    _afterKey = true;
+}
+
+void JsonWriter::Escape(unsigned char c)
+{
+    static const char hex[] = "0123456789abcdef";
+    char escape = _json_escapes[c];
+    Put('\\');
+    Put(escape);
+    if (escape == 'u') {
+        char digits[4] = {'0', '0', hex[c >> 4], hex[c & 15]};
+        Raw(digits, sizeof(digits));
+    }
+}
+
+void JsonWriter::String(const char* text, size_t size)
+{
+    Separate();
+    Put('"');
+    const char* end = text + size;
+    while (text < end) {
+        size_t run = CleanRun(text, end - text);
+        Raw(text, run);
+        text += run;
+        if (text < end) {
+            Escape((unsigned char)*text++);
+        }
+    }
+    Put('"');
+}
+
+void JsonWriter::Int(long long value)
+{
+    Separate();
+    char digits[24];
+    char* p = digits + sizeof(digits);
+    unsigned long long magnitude = value < 0 ? 0ULL - value : value;
+    do {
+        *--p = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+    if (value < 0) {
+        *--p = '-';
+    }
+    Raw(p, digits + sizeof(digits) - p);
+}
+
+void JsonWriter::Time(const SYSTEMTIME& st)
+{
+    Separate();
+    char text[21] = {'"', 0, 0, 0, 0, '-', 0, 0, '-', 0, 0, 'T', 0, 0, ':', 0, 0, ':', 0, 0, '"'};
+    auto two = [&text](int at, unsigned value) {
+        text[at] = (char)('0' + value / 10 % 10);
+        text[at + 1] = (char)('0' + value % 10);
+    };
+    two(1, st.wYear / 100);
+    two(3, st.wYear);
+    two(6, st.wMonth);
+    two(9, st.wDay);
+    two(12, st.wHour);
+    two(15, st.wMinute);
+    two(18, st.wSecond);
+    Raw(text, sizeof(text));
+}
+
+
+void WriteSessionJson(JsonWriter& json, const AppLogger& log)
+{
+    json.BeginObject();
+    json.Key("start");
+    json.Time(log.start);
+    json.Key("end");
+    json.Time(log.end);
+    json.Key("executable");
+    json.String(log.executable);
+    json.Key("title");
+    json.String(log.title);
+    json.EndObject();
+}
+
+JsonExportStats ExportJson(ULONGLONG from, ULONGLONG to, long long deviceId, const JsonSink& sink, size_t batchSessions)
+{
+    JsonWriter json(sink);
+    JsonExportStats stats = {0, 0, 0};
+    size_t batched = 0;
+    auto finish = [&]() {
+        json.EndArray();
+        json.EndObject();
+        json.Raw("\n", 1);
+        stats.payloads++;
+        batched = 0;
+    };
+    ForEachStoredSession(from, to, [&](const AppLogger& log) {
+        if (batched == 0) {
+            json.BeginObject();
+            json.Key("deviceId");
+            json.Int(deviceId);
+            json.Key("sessions");
+            json.BeginArray();
+        }
+        WriteSessionJson(json, log);
+        stats.sessions++;
+        if (++batched == batchSessions) {
+            finish();
+        }
+        return json.Ok();
+    });
+    if (batched > 0) {
+        finish();
+    }
+    json.Flush();
+    stats.bytes = json.Size();
+    return stats;
+}
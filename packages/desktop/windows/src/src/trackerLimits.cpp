@@ -0,0 +1,216 @@
+#include "trackerLimits.h"
+#include "trackerImport.h"
+#include "trackerTime.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#ifdef _DEBUG
+#include <iostream>
+#endif // _DEBUG
+
+
+LimitEngine _limits;
+long long _limits_last_sample = -1;
+
+
+static std::string Trim(const std::string& text)
+{
+    size_t first = text.find_first_not_of(' ');
+    size_t last = text.find_last_not_of(' ');
+    return first == std::string::npos ? std::string() : text.substr(first, last - first + 1);
+}
+
+// Executables are matched ASCII case-insensitively, as Windows names files
+static void Lower(const std::string& value, std::string& out)
+{
+    out.assign(value);
+    for (char& c : out) {
+        if (c >= 'A' && c <= 'Z') {
+            c = (char)(c - 'A' + 'a');
+        }
+    }
+}
+
+bool LimitEngine::AddRule(const std::string& line)
+{
+    char kind[16];
+    unsigned seconds = 0;
+    unsigned window = 0;
+    int fields = sscanf(line.c_str(), "%15s %u %u", kind, &seconds, &window);
+    size_t nameAt = line.find(" ; ");
+    size_t executablesAt = nameAt == std::string::npos ? std::string::npos : line.find(" ; ", nameAt + 3);
+    if (fields < 2 || seconds == 0 || executablesAt == std::string::npos) {
+        return false;
+    }
+
+    State state = {};
+    if (strcmp(kind, "daily") == 0) {
+        state.rule.kind = LIMIT_DAILY;
+    } else if (strcmp(kind, "streak") == 0) {
+        state.rule.kind = LIMIT_STREAK;
+    } else if (strcmp(kind, "window") == 0 && fields == 3 && window >= 60 && window <= LIMIT_MAX_WINDOW) {
+        state.rule.kind = LIMIT_WINDOW;
+        state.rule.window = window;
+        state.buckets.assign((window + 59) / 60, 0);
+        state.headMinute = -1;
+    } else {
+        return false;
+    }
+    state.rule.seconds = seconds;
+    state.rule.name = Trim(line.substr(nameAt + 3, executablesAt - nameAt - 3));
+    state.period = -1;
+
+    uint32_t index = (uint32_t)_rules.size();
+    std::string executables = line.substr(executablesAt + 3);
+    if (!executables.empty() && executables.back() == '\r') {
+        executables.pop_back();
+    }
+    size_t from = 0;
+    while (from <= executables.size()) {
+        size_t comma = std::min(executables.find(',', from), executables.size());
+        std::string executable = Trim(executables.substr(from, comma - from));
+        if (executable == "*") {
+            _everyExecutable.push_back(index);
+        } else if (!executable.empty()) {
+            Lower(executable, executable);
+            _byExecutable[executable].push_back(index);
+        }
+        from = comma + 1;
+    }
+    _rules.push_back(std::move(state));
+    return true;
+}
+
+size_t LimitEngine::Load(const std::filesystem::path& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::string line;
+    size_t count = 0;
+    while (std::getline(file, line)) {
+        if (AddRule(line)) {
+            count++;
+        }
+    }
+    return count;
+}
+
+// Moves a sliding window's head to minute, emptying the buckets it passes
+void LimitEngine::Advance(State& state, long long minute)
+{
+    if (state.headMinute < 0) {
+        state.headMinute = minute;
+    }
+    long long steps = minute - state.headMinute;
+    if (steps <= 0) {
+        return;
+    }
+    if (steps >= (long long)state.buckets.size()) {
+        std::fill(state.buckets.begin(), state.buckets.end(), 0);
+        state.used = 0;
+    } else {
+        for (long long i = 0; i < steps; i++) {
+            state.head = (state.head + 1) % state.buckets.size();
+            state.used -= state.buckets[state.head];
+            state.buckets[state.head] = 0;
+        }
+    }
+    state.headMinute = minute;
+}
+
+void LimitEngine::Update(State& state, long long start, long long end, bool notify)
+{
+    while (start < end) {
+        long long stop = end;
+        switch (state.rule.kind) {
+        case LIMIT_DAILY:
+            stop = std::min(end, (start / 86400 + 1) * 86400);
+            if (start / 86400 != state.period) {
+                state.period = start / 86400;
+                state.used = 0;
+                state.fired = false;
+            }
+            break;
+        case LIMIT_STREAK:
+            if (start - state.period > LIMIT_STREAK_GAP) {
+                state.used = 0;
+                state.fired = false;
+            }
+            state.period = end;
+            break;
+        case LIMIT_WINDOW:
+            stop = std::min(end, (start / 60 + 1) * 60);
+            Advance(state, start / 60);
+            state.buckets[state.head] += (uint32_t)(stop - start);
+            // Re-armed once the window slid back under the limit
+            if (state.used < state.rule.seconds) {
+                state.fired = false;
+            }
+            break;
+        }
+        state.used += stop - start;
+        start = stop;
+        if (!state.fired && state.used >= state.rule.seconds) {
+            state.fired = true;
+            if (notify && _callback != nullptr) {
+                _callback(state.rule, state.used);
+            }
+        }
+    }
+}
+
+void LimitEngine::Add(const std::string& executable, long long start, long long end, bool notify)
+{
+    Lower(executable, _lowered);
+    auto it = _byExecutable.find(_lowered);
+    if (it != _byExecutable.end()) {
+        for (uint32_t index : it->second) {
+            Update(_rules[index], start, end, notify);
+        }
+    }
+    for (uint32_t index : _everyExecutable) {
+        Update(_rules[index], start, end, notify);
+    }
+}
+
+long long LimitEngine::Used(size_t i) const
+{
+    return _rules[i].used;
+}
+
+
+void StartLimits(LimitCallback callback)
+{
+    std::filesystem::path logPath = GetLogFilePath();
+    _limits.SetCallback(callback);
+    if (_limits.Load(logPath.parent_path() / LIMITS_FILE) == 0) {
+        return;
+    }
+    long long now = TimeSeconds(GetTime());
+    long long from = now / 86400 * 86400;
+    for (size_t i = 0; i < _limits.Rules(); i++) {
+        from = std::min(from, now - (long long)_limits.Rule(i).window);
+    }
+    std::vector<AppLogger> logs;
+    ImportLogTail(logPath, TimeKey(TimeFromSeconds(from)), logs);
+    for (const auto& log : logs) {
+        if (log.executable != "AFK") {
+            _limits.Add(log.executable, TimeSeconds(log.start), TimeSeconds(log.end), false);
+        }
+    }
+#ifdef _DEBUG
+    std::cout << "Limits: " << _limits.Rules() << " rules, " << logs.size() << " sessions replayed\n";
+#endif // _DEBUG
+}
+
+void SampleLimits(const AppLogger& current, const SYSTEMTIME& now)
+{
+    long long seconds = TimeSeconds(now);
+    long long step = seconds - _limits_last_sample;
+    if (_limits_last_sample >= 0 && step > 0 && step <= LIMIT_MAX_STEP && current.executable != "AFK") {
+        _limits.Add(current.executable, _limits_last_sample, seconds);
+    }
+    _limits_last_sample = seconds;
+}
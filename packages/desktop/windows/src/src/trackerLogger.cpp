@@ -1,12 +1,56 @@
 #include "trackerLogger.h"
+#include "trackerImport.h"
+#include "trackerInput.h"
+#include "trackerResources.h"
+#include "trackerTime.h"
+#include "trackerPipeline.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <system_error>
 #include <vector>
 
+#ifndef _WIN32
+#include <ctime>
+#endif // _WIN32
 
+#ifdef _DEBUG
+#include <iostream>
+#endif // _DEBUG
 
-bool ShouldSave = false;
+
+std::atomic<bool> ShouldSave(false);
+bool LoggerClosed = false;
 std::filesystem::path filePath;
 std::vector<AppLogger> Logger;
+// Flushed records, reused by the next sessions so their strings keep their capacity
+std::vector<AppLogger> LoggerSpare;
+// Lines of one flush, built in place
+std::string LoggerLines;
+// The log file stream's buffer, so opening it on each flush does not allocate
+char LoggerFileBuffer[4096];
+std::vector<void (*)(const AppLogger&)> SessionListeners;
+// Where the resumed session's line starts, the next flush replaces it
+uint64_t ResumedOffset = 0;
+bool ResumePending = false;
+// Logger is appended by the tracker thread and flushed from the tray thread.
+// Timed so that shutdown can give up on a thread that holds it too long.
+std::timed_mutex LoggerMutex;
+
+static void WriteLogger();
+
+// Every record reaches the listeners once: when it closes, or when a flush cuts it.
+// The resources sampled and the input counted since the last record closed are attached first.
+static void NotifySessionListeners(AppLogger& log)
+{
+    TakeSessionResources(log.resources);
+    TakeSessionInput(log.input);
+    for (auto listener : SessionListeners) {
+        listener(log);
+    }
+}
 
 void ProgSave()
 {
@@ -16,56 +60,134 @@ void ProgSave()
 SYSTEMTIME GetTime()
 {
     SYSTEMTIME st;
+#ifdef _WIN32
     GetLocalTime(&st);
+#else
+    struct timespec now;
+    struct tm local;
+    clock_gettime(CLOCK_REALTIME, &now);
+    localtime_r(&now.tv_sec, &local);
+    st.wYear = (WORD)(local.tm_year + 1900);
+    st.wMonth = (WORD)(local.tm_mon + 1);
+    st.wDayOfWeek = (WORD)local.tm_wday;
+    st.wDay = (WORD)local.tm_mday;
+    st.wHour = (WORD)local.tm_hour;
+    st.wMinute = (WORD)local.tm_min;
+    st.wSecond = (WORD)local.tm_sec;
+    st.wMilliseconds = (WORD)(now.tv_nsec / 1000000);
+#endif // _WIN32
     return st;
 }
 
-void ClearLogger() 
+// Moves the buffered records to LoggerSpare; LoggerMutex must be held
+static void RecycleLogger()
 {
+    for (auto& log : Logger) {
+        LoggerSpare.push_back(std::move(log));
+    }
     Logger.clear();
 }
 
-void AddEntry(std::string executable, std::string title) 
+void ClearLogger() 
 {
-    if (!Logger.empty()) {
-        Logger.back().end = GetTime();
+    std::lock_guard<std::timed_mutex> lock(LoggerMutex);
+    // A dropped resumed session keeps its line as it was
+    ResumePending = false;
+    RecycleLogger();
+}
+
+void AddEntry(const char* executable, const char* title) 
+{
+    static Sessionizer<LocalClock> sessionizer(Logger, LoggerSpare);
+    std::lock_guard<std::timed_mutex> lock(LoggerMutex);
+    if (LoggerClosed) {
+        return;
+    }
+    sessionizer.Add(executable, title, []() {
+        if (!ShouldSave) {
+            NotifySessionListeners(Logger.back());
+        } else {
+            WriteLogger();
+        }
+    });
+}
+
+bool ExtendEntry()
+{
+    std::lock_guard<std::timed_mutex> lock(LoggerMutex);
+    if (LoggerClosed) {
+        return true;
+    }
+    if (Logger.empty()) {
+        return false;
+    }
+    Logger.back().end = GetTime();
+    return true;
+}
+
+bool ResumeSession(const char* executable, const char* title)
+{
+    std::lock_guard<std::timed_mutex> lock(LoggerMutex);
+    AppLogger last;
+    uint64_t offset;
+    if (!Logger.empty() || LoggerClosed || !ReadLastLogRecord(filePath, last, offset)) {
+        return false;
+    }
+    long long gap = TimeSeconds(GetTime()) - TimeSeconds(last.end);
+    if (gap < 0 || gap > RESUME_GRACE || last.executable != executable || last.title != title) {
+        return false;
     }
-    if (Logger.empty() || Logger.back().title != title) {
-        if (!Logger.empty() && ShouldSave) {
 #ifdef _DEBUG
-            PrintToConsole();
+    std::cout << "Resumed: " << GetLineStr(last);
 #endif // _DEBUG
-            PrintToFile();
-        }
-        Logger.push_back({GetTime(), GetTime(), executable, title});
+    last.resumed = true;
+    last.resumedEnd = last.end;
+    Logger.push_back(std::move(last));
+    ResumedOffset = offset;
+    ResumePending = true;
+    return true;
+}
+
+bool GetCurrentSession(AppLogger& log)
+{
+    std::lock_guard<std::timed_mutex> lock(LoggerMutex);
+    if (Logger.empty()) {
+        return false;
     }
+    log = Logger.back();
+    return true;
+}
+
+void ForEachBufferedSession(const std::function<void(const AppLogger&)>& visit)
+{
+    std::lock_guard<std::timed_mutex> lock(LoggerMutex);
+    for (const auto& log : Logger) {
+        visit(log);
+    }
+}
+
+void AddSessionListener(void (*listener)(const AppLogger&))
+{
+    std::lock_guard<std::timed_mutex> lock(LoggerMutex);
+    SessionListeners.push_back(listener);
 }
 
+long long UnseenSeconds(const AppLogger& log)
+{
+    return std::max(0LL, TimeSeconds(log.end) - TimeSeconds(log.resumed ? log.resumedEnd : log.start));
+}
 
-std::string GetLineStr(AppLogger log)
+std::string GetLineStr(const AppLogger& log)
 {
-    std::stringstream ss;
-    ss  << std::setfill('0') << std::setw(4) << log.start.wYear << "-" 
-        << std::setfill('0') << std::setw(2) << log.start.wMonth << "-"
-        << std::setfill('0') << std::setw(2) << log.start.wDay << " " 
-        << std::setfill('0') << std::setw(2) << log.start.wHour << ":" 
-        << std::setfill('0') << std::setw(2) << log.start.wMinute << ":" 
-        << std::setfill('0') << std::setw(2) << log.start.wSecond << " ; "
-        << std::setfill('0') << std::setw(4) << log.end.wYear << "-" 
-        << std::setfill('0') << std::setw(2) << log.end.wMonth << "-"
-        << std::setfill('0') << std::setw(2) << log.end.wDay << " " 
-        << std::setfill('0') << std::setw(2) << log.end.wHour << ":" 
-        << std::setfill('0') << std::setw(2) << log.end.wMinute << ":" 
-        << std::setfill('0') << std::setw(2) << log.end.wSecond << " ; "
-        << log.executable << " ; " 
-        << log.title << '\n';
-    return ss.str();
+    std::string line;
+    AppendLogLine(line, log);
+    return line;
 }
 
 #ifdef _DEBUG
-#include <iostream>
 void PrintToConsole() 
 {
+    std::lock_guard<std::timed_mutex> lock(LoggerMutex);
     for (const auto& log : Logger) {
         std::cout << GetLineStr(log);
     }
@@ -94,18 +216,115 @@ int CreateLogFile()
     return 0;
 }
 
-void PrintToFile() 
+std::filesystem::path GetLogFilePath()
 {
-    std::ofstream outFile(filePath, std::ios::app);
-    if (!outFile) {
-        return;
+    return filePath;
+}
+
+uint64_t GetLogFileSize()
+{
+    std::lock_guard<std::timed_mutex> lock(LoggerMutex);
+    std::error_code ec;
+    uintmax_t size = std::filesystem::file_size(filePath, ec);
+    return ec ? 0 : size;
+}
+
+bool ReplaceLogFile(const std::filesystem::path& path, uint64_t from)
+{
+    std::lock_guard<std::timed_mutex> lock(LoggerMutex);
+    std::ifstream log(filePath, std::ios::binary);
+    std::ofstream out(path, std::ios::binary | std::ios::app);
+    log.seekg(from);
+    char buffer[4096];
+    while (log && out) {
+        log.read(buffer, sizeof(buffer));
+        out.write(buffer, log.gcount());
+    }
+    out.close();
+    std::error_code ec;
+    if (!out || !log.eof()) {
+        return false;
+    }
+    std::filesystem::rename(path, filePath, ec);
+    if (ec) {
+        return false;
+    }
+    // The resumed session's line is still the last one, at a new offset
+    AppLogger last;
+    if (ResumePending && !ReadLastLogRecord(filePath, last, ResumedOffset)) {
+        ResumePending = false;
     }
+    return true;
+}
 
+// Writes the new lines over the resumed session's line, which is the last
+// one, and cuts whatever is left past them. Only the tail is touched: an
+// interrupted write leaves the old line or a mix of the old and the longer
+// one, never less of the log. LoggerMutex must be held.
+static bool ReplaceResumedLine()
+{
+    std::fstream file(filePath, std::ios::in | std::ios::out | std::ios::binary);
+    if (!file.seekp(ResumedOffset)) {
+        return false;
+    }
+    file.write(LoggerLines.data(), LoggerLines.size());
+    file.close();
+    if (!file) {
+        return false;
+    }
+    std::error_code ec;
+    uint64_t end = ResumedOffset + LoggerLines.size();
+    if (std::filesystem::file_size(filePath, ec) > end && !ec) {
+        std::filesystem::resize_file(filePath, end, ec);
+    }
+    return !ec;
+}
+
+// Append every buffered session, including the open one; LoggerMutex must be held
+static void WriteLogger()
+{
+    LoggerLines.clear();
     for (const auto& log : Logger) {
-        outFile << GetLineStr(log);
+        AppendLogLine(LoggerLines, log);
+    }
+    // Failing that, the longer line is appended: a duplicate is better than a loss
+    bool replaced = ResumePending && !Logger.empty() && ReplaceResumedLine();
+    ResumePending = false;
+    if (!replaced) {
+        std::ofstream outFile;
+        outFile.rdbuf()->pubsetbuf(LoggerFileBuffer, sizeof(LoggerFileBuffer));
+        outFile.open(filePath, std::ios::app);
+        if (!outFile) {
+            return;
+        }
+        outFile.write(LoggerLines.data(), LoggerLines.size());
+        outFile.close();
     }
-    outFile.close();
+#ifdef _DEBUG
+    std::cout << LoggerLines;
+#endif // _DEBUG
 
-    Logger.clear();
+    if (!Logger.empty()) {
+        NotifySessionListeners(Logger.back());
+    }
+
+    RecycleLogger();
     ShouldSave = false;
+}
+
+void PrintToFile() 
+{
+    std::lock_guard<std::timed_mutex> lock(LoggerMutex);
+    WriteLogger();
+}
+
+bool CloseLogger(DWORD timeout)
+{
+    std::unique_lock<std::timed_mutex> lock(LoggerMutex, std::chrono::milliseconds(timeout));
+    if (!lock.owns_lock()) {
+        return false;
+    }
+    WriteLogger();
+    LoggerClosed = true;
+    return true;
 }
\ No newline at end of file
@@ -0,0 +1,293 @@
+#include "trackerResources.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+#ifdef _DEBUG
+#include <iostream>
+#endif // _DEBUG
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif // _WIN32
+
+
+std::mutex _resource_mutex;
+ResourceSampler _resource_sampler;
+// Lines for RESOURCE_FILE, appended by the listener and written by SaveResources
+std::string _resource_lines;
+
+
+ResourceSampler::~ResourceSampler()
+{
+    Clear();
+}
+
+void ResourceSampler::Clear()
+{
+    for (auto& process : _processes) {
+        Close(process);
+    }
+    _processes.clear();
+    _cursor = 0;
+}
+
+#ifdef _WIN32
+bool ResourceSampler::Open(Process& process)
+{
+    // VM_READ is refused for protected processes, times and I/O still work without it
+    process.handle = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION | PROCESS_VM_READ, FALSE, process.pid);
+    if (process.handle == NULL) {
+        process.handle = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, process.pid);
+    }
+    return process.handle != NULL;
+}
+
+void ResourceSampler::Close(Process& process)
+{
+    if (process.handle != NULL) {
+        CloseHandle(process.handle);
+    }
+}
+
+// The handle pins the process object, so its id cannot be reused under us
+bool ResourceSampler::Read(Process& process, ProcessCounters& counters)
+{
+    FILETIME creation, exit, kernel, user;
+    DWORD code;
+    if (!GetExitCodeProcess(process.handle, &code) || code != STILL_ACTIVE ||
+        !GetProcessTimes(process.handle, &creation, &exit, &kernel, &user)) {
+        return false;
+    }
+    ULARGE_INTEGER k = {{kernel.dwLowDateTime, kernel.dwHighDateTime}};
+    ULARGE_INTEGER u = {{user.dwLowDateTime, user.dwHighDateTime}};
+    counters.cpuSeconds = (k.QuadPart + u.QuadPart) / 1e7;
+    PROCESS_MEMORY_COUNTERS memory;
+    counters.rssBytes = GetProcessMemoryInfo(process.handle, &memory, sizeof(memory)) ? memory.WorkingSetSize : 0;
+    IO_COUNTERS io;
+    counters.ioBytes = GetProcessIoCounters(process.handle, &io) ? io.ReadTransferCount + io.WriteTransferCount : 0;
+    return true;
+}
+#else
+bool ResourceSampler::Open(Process& process)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%u/stat", (unsigned)process.pid);
+    process.stat = open(path, O_RDONLY | O_CLOEXEC);
+    // Other users' processes refuse io, times and memory still count
+    snprintf(path, sizeof(path), "/proc/%u/io", (unsigned)process.pid);
+    process.io = open(path, O_RDONLY | O_CLOEXEC);
+    if (process.stat < 0) {
+        Close(process);
+        return false;
+    }
+    return true;
+}
+
+void ResourceSampler::Close(Process& process)
+{
+    for (int fd : {process.stat, process.io}) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    process.stat = process.io = -1;
+}
+
+// Moves p to the space before the field count fields on. Plain walking,
+// sscanf costs more than the read itself.
+static const char* SkipFields(const char* p, int count)
+{
+    for (int i = 0; i < count && p != nullptr; i++) {
+        p = strchr(p + 1, ' ');
+    }
+    return p;
+}
+
+// The descriptors stay bound to the process they were opened for: once it
+// exits they fail with ESRCH, even if its id is reused
+bool ResourceSampler::Read(Process& process, ProcessCounters& counters)
+{
+    static const long tick = sysconf(_SC_CLK_TCK);
+    static const long page = sysconf(_SC_PAGESIZE);
+    char buffer[512];
+    ssize_t size = pread(process.stat, buffer, sizeof(buffer) - 1, 0);
+    if (size <= 0) {
+        return false;
+    }
+    buffer[size] = '\0';
+    // The command name may hold spaces and parentheses, fields resume after the last ')'
+    // ')' ends field 2: utime is field 14, stime 15 and rss, in pages, 24
+    const char* utime = SkipFields(strrchr(buffer, ')'), 12);
+    const char* stime = SkipFields(utime, 1);
+    const char* rss = SkipFields(stime, 9);
+    if (rss == nullptr) {
+        return false;
+    }
+    counters.cpuSeconds = (double)(strtoull(utime, nullptr, 10) + strtoull(stime, nullptr, 10)) / tick;
+    counters.rssBytes = strtoull(rss, nullptr, 10) * page;
+
+    counters.ioBytes = 0;
+    size = process.io >= 0 ? pread(process.io, buffer, sizeof(buffer) - 1, 0) : -1;
+    if (size > 0) {
+        buffer[size] = '\0';
+        unsigned long long rchar, wchar;
+        if (sscanf(buffer, "rchar: %llu wchar: %llu", &rchar, &wchar) == 2) {
+            counters.ioBytes = rchar + wchar;
+        }
+    }
+    return true;
+}
+#endif // _WIN32
+
+bool ResourceSampler::Account(Process& process, bool foreground)
+{
+    ProcessCounters counters;
+    if (!Read(process, counters)) {
+        return false;
+    }
+    double cpu = std::max(0.0, counters.cpuSeconds - process.last.cpuSeconds);
+    if (foreground) {
+        _cpu += cpu;
+        _io += counters.ioBytes >= process.last.ioBytes ? counters.ioBytes - process.last.ioBytes : 0;
+        _peakRss = std::max(_peakRss, counters.rssBytes);
+    } else {
+        _backgroundCpu += cpu;
+    }
+    process.last = counters;
+    return true;
+}
+
+void ResourceSampler::Sample(DWORD foregroundPid)
+{
+    _samples++;
+    size_t current = _processes.size();
+    if (foregroundPid != 0) {
+        auto it = std::find_if(_processes.begin(), _processes.end(), [&](const Process& process) {
+            return process.pid == foregroundPid;
+        });
+        if (it != _processes.end()) {
+            current = it - _processes.begin();
+        } else {
+            Process process = {};
+            process.pid = foregroundPid;
+            if (Open(process) && Read(process, process.last)) {
+                // Primed only: what it used before it was tracked is nobody's session
+                if (_processes.size() >= RESOURCE_MAX_PROCESSES) {
+                    auto oldest = std::min_element(_processes.begin(), _processes.end(), [](const Process& a, const Process& b) {
+                        return a.focused < b.focused;
+                    });
+                    Close(*oldest);
+                    *oldest = process;
+                    current = oldest - _processes.begin();
+                } else {
+                    _processes.push_back(process);
+                    current = _processes.size() - 1;
+                }
+                _processes[current].focused = _samples;
+                _peakRss = std::max(_peakRss, process.last.rssBytes);
+            } else {
+                Close(process);
+            }
+            foregroundPid = 0;
+        }
+    }
+
+    size_t gone[RESOURCE_BATCH + 1];
+    size_t goneCount = 0;
+    if (foregroundPid != 0) {
+        _processes[current].focused = _samples;
+        if (!Account(_processes[current], true)) {
+            gone[goneCount++] = current;
+        }
+    }
+    size_t batch = std::min<size_t>(RESOURCE_BATCH, _processes.size());
+    for (size_t n = 0; n < batch; n++) {
+        _cursor = (_cursor + 1) % _processes.size();
+        if (_cursor != current && !Account(_processes[_cursor], false)) {
+            gone[goneCount++] = _cursor;
+        }
+    }
+
+    // Highest index first so the others stay valid
+    std::sort(gone, gone + goneCount, std::greater<size_t>());
+    for (size_t i = 0; i < goneCount; i++) {
+        Close(_processes[gone[i]]);
+        _processes[gone[i]] = _processes.back();
+        _processes.pop_back();
+    }
+}
+
+static inline uint32_t Saturate(double value)
+{
+    return value >= 4294967295.0 ? 0xFFFFFFFFu : (uint32_t)value;
+}
+
+void ResourceSampler::Take(ResourceSummary& out)
+{
+    out.cpuMs = Saturate(_cpu * 1000.0);
+    out.backgroundCpuMs = Saturate(_backgroundCpu * 1000.0);
+    out.peakRssKb = Saturate(_peakRss / 1024.0);
+    out.ioKb = Saturate(_io / 1024.0);
+    _cpu = 0.0;
+    _backgroundCpu = 0.0;
+    _peakRss = 0;
+    _io = 0;
+}
+
+
+void SampleResources(DWORD foregroundPid)
+{
+    std::lock_guard<std::mutex> lock(_resource_mutex);
+    _resource_sampler.Sample(foregroundPid);
+}
+
+void TakeSessionResources(ResourceSummary& out)
+{
+    std::lock_guard<std::mutex> lock(_resource_mutex);
+    _resource_sampler.Take(out);
+}
+
+// Runs under the logger lock, which is always taken before _resource_mutex
+static void OnSessionClosed(const AppLogger& log)
+{
+    char line[96];
+    snprintf(line, sizeof(line), "%04u-%02u-%02u %02u:%02u:%02u ; ",
+             log.start.wYear, log.start.wMonth, log.start.wDay, log.start.wHour, log.start.wMinute, log.start.wSecond);
+    std::string entry = line;
+    entry += log.executable;
+    snprintf(line, sizeof(line), " ; %u ; %u ; %u ; %u\n",
+             log.resources.cpuMs, log.resources.backgroundCpuMs, log.resources.peakRssKb, log.resources.ioKb);
+    entry += line;
+    std::lock_guard<std::mutex> lock(_resource_mutex);
+    _resource_lines += entry;
+}
+
+void StartResources()
+{
+    AddSessionListener(OnSessionClosed);
+}
+
+void SaveResources()
+{
+    std::string lines;
+    {
+        std::lock_guard<std::mutex> lock(_resource_mutex);
+        lines.swap(_resource_lines);
+    }
+    if (lines.empty()) {
+        return;
+    }
+    std::ofstream file(GetLogFilePath().parent_path() / RESOURCE_FILE, std::ios::app | std::ios::binary);
+    file << lines;
+#ifdef _DEBUG
+    std::cout << "Resources: " << std::count(lines.begin(), lines.end(), '\n') << " sessions saved\n";
+#endif // _DEBUG
+}
@@ -0,0 +1,208 @@
+#include "trackerRollup.h"
+#include "trackerImport.h"
+#include "trackerTime.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#ifdef _DEBUG
+#include <iostream>
+#endif // _DEBUG
+
+typedef std::map<std::string, DailyRollup> DayRollups;
+
+std::mutex _rollup_mutex;
+std::map<long, DayRollups> _rollups;
+std::set<long> _sealed_days;
+
+
+static std::filesystem::path RollupPath()
+{
+    return GetLogFilePath().parent_path() / ROLLUP_FILE;
+}
+
+static std::string RollupLine(long day, const std::string& executable, const DailyRollup& rollup)
+{
+    SYSTEMTIME st = TimeFromSeconds((long long)day * 86400);
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%04u-%02u-%02u ; ", st.wYear, st.wMonth, st.wDay);
+    std::string line = buffer;
+    line += executable;
+    snprintf(buffer, sizeof(buffer), " ; %lld ; %u ; %u\n", rollup.seconds, rollup.sessions, rollup.revision);
+    line += buffer;
+    return line;
+}
+
+static bool ParseRollupLine(const std::string& line, long& day, std::string& executable, DailyRollup& rollup)
+{
+    SYSTEMTIME st = {};
+    unsigned year, month, date;
+    if (line.size() < 13 || sscanf(line.c_str(), "%4u-%2u-%2u ; ", &year, &month, &date) != 3) {
+        return false;
+    }
+    // The executable may contain " ; ", the three numbers never do
+    size_t end = line.size();
+    for (int i = 0; i < 3; i++) {
+        end = line.rfind(" ; ", end - 1);
+        if (end == std::string::npos || end < 13) {
+            return false;
+        }
+    }
+    if (sscanf(line.c_str() + end, " ; %lld ; %u ; %u", &rollup.seconds, &rollup.sessions, &rollup.revision) != 3) {
+        return false;
+    }
+    st.wYear = (WORD)year;
+    st.wMonth = (WORD)month;
+    st.wDay = (WORD)date;
+    day = DayNumber(st);
+    executable = line.substr(13, end - 13);
+    return true;
+}
+
+static void AppendRollups(const std::string& lines)
+{
+    std::ofstream file(RollupPath(), std::ios::app | std::ios::binary);
+    file << lines;
+}
+
+long long RollupSeconds(const AppLogger& log, long first, long last)
+{
+    long long end = TimeSeconds(log.end);
+    long long start = std::min(end, TimeSeconds(log.resumed ? log.resumedEnd : log.start));
+    return std::max(0LL, std::min(end, (long long)(last + 1) * 86400) - std::max(start, (long long)first * 86400));
+}
+
+// Credits each day the session spans with its seconds on that day, and the day
+// it started with the session. Days older than ROLLUP_KEEP_DAYS, and sealed
+// ones unless sealedToo, are skipped; the days credited are appended to days.
+static void AddSession(const AppLogger& log, bool sealedToo, std::vector<long>& days)
+{
+    long first = DayNumber(log.start);
+    long last = DayNumber(log.end);
+    long oldest = DayNumber(GetTime()) - ROLLUP_KEEP_DAYS;
+    for (long day = std::max(first, oldest); day <= last; day++) {
+        long long seconds = RollupSeconds(log, day, day);
+        if ((seconds == 0 && (day != first || log.resumed)) || (!sealedToo && _sealed_days.count(day))) {
+            continue;
+        }
+        DailyRollup& rollup = _rollups[day][log.executable];
+        rollup.seconds += seconds;
+        rollup.sessions += !log.resumed && day == first;
+        days.push_back(day);
+    }
+}
+
+// Caller holds _rollup_mutex
+static void SealBefore(long today)
+{
+    std::string lines;
+    for (auto& day : _rollups) {
+        if (day.first >= today || _sealed_days.count(day.first)) {
+            continue;
+        }
+        for (auto& item : day.second) {
+            item.second.revision = 1;
+            lines += RollupLine(day.first, item.first, item.second);
+        }
+        _sealed_days.insert(day.first);
+    }
+    while (!_rollups.empty() && _rollups.begin()->first < today - ROLLUP_KEEP_DAYS) {
+        _sealed_days.erase(_rollups.begin()->first);
+        _rollups.erase(_rollups.begin());
+    }
+    if (!lines.empty()) {
+        AppendRollups(lines);
+    }
+}
+
+static void OnSessionClosed(const AppLogger& log)
+{
+    std::lock_guard<std::mutex> lock(_rollup_mutex);
+    std::vector<long> days;
+    AddSession(log, true, days);
+
+    for (long day : days) {
+        if (_sealed_days.count(day)) {
+            // Late session: re-issue the whole total under the next revision
+            DailyRollup& rollup = _rollups[day][log.executable];
+            rollup.revision++;
+            AppendRollups(RollupLine(day, log.executable, rollup));
+#ifdef _DEBUG
+            std::cout << "Rollup correction: " << log.executable << " revision " << rollup.revision << "\n";
+#endif // _DEBUG
+        }
+    }
+    SealBefore(DayNumber(log.start));
+}
+
+
+void StartRollups()
+{
+    long today = DayNumber(GetTime());
+    {
+        std::lock_guard<std::mutex> lock(_rollup_mutex);
+
+        // Sealed totals, newest lines first so the first revision seen of a key
+        // wins ties. A line is only ever written for a day at most
+        // ROLLUP_KEEP_DAYS old, so once lines fall twice that far back nothing
+        // earlier in the file can still be kept.
+        std::string line, executable;
+        long day;
+        long lastSealed = today - ROLLUP_KEEP_DAYS - 1;
+        DailyRollup rollup;
+        ScanLinesBackward(RollupPath(), [&](const char* text, size_t len, uint64_t) {
+            line.assign(text, len);
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (!ParseRollupLine(line, day, executable, rollup)) {
+                return true;
+            }
+            if (day < today - 2 * ROLLUP_KEEP_DAYS) {
+                return false;
+            }
+            if (day >= today - ROLLUP_KEEP_DAYS) {
+                auto inserted = _rollups[day].try_emplace(executable, rollup);
+                if (!inserted.second && rollup.revision > inserted.first->second.revision) {
+                    inserted.first->second = rollup;
+                }
+                _sealed_days.insert(day);
+                lastSealed = std::max(lastSealed, day);
+            }
+            return true;
+        });
+
+        // Days still open in the log file, e.g. the app was closed before
+        // midnight. Every day before the last sealed one was sealed with it,
+        // sessions from that day may still run into the open ones.
+        std::vector<AppLogger> logs;
+        std::vector<long> days;
+        ImportLogTail(GetLogFilePath(), TimeKey(TimeFromSeconds((long long)lastSealed * 86400)), logs);
+        for (const auto& log : logs) {
+            AddSession(log, false, days);
+        }
+        SealBefore(today);
+    }
+    AddSessionListener(OnSessionClosed);
+}
+
+void SealRollups()
+{
+    std::lock_guard<std::mutex> lock(_rollup_mutex);
+    SealBefore(DayNumber(GetTime()));
+}
+
+bool GetDailyRollup(long day, std::map<std::string, DailyRollup>& out)
+{
+    std::lock_guard<std::mutex> lock(_rollup_mutex);
+    auto it = _rollups.find(day);
+    if (it == _rollups.end()) {
+        return false;
+    }
+    out = it->second;
+    return true;
+}
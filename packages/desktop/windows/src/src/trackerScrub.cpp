@@ -0,0 +1,63 @@
+#include "trackerScrub.h"
+#include "trackerArchive.h"
+
+#include <algorithm>
+#include <vector>
+
+#ifdef _DEBUG
+#include <iostream>
+#endif // _DEBUG
+
+
+bool ScrubArchive(const std::filesystem::path& path, ScrubStats& stats, ScrubPace pace)
+{
+    stats.archives++;
+    ArchiveReader reader;
+    bool damaged = !OpenArchive(path, reader);
+    for (size_t i = 0; !damaged && i < reader.blocks.size(); i++) {
+        bool intact;
+        size_t bytes = VerifyArchiveBlock(reader, i, intact);
+        stats.blocks++;
+        stats.bytes += bytes;
+        damaged = !intact;
+        if (pace != nullptr && pace(bytes)) {
+            return false;
+        }
+    }
+    if (!damaged && reader.checksums) {
+        return true;
+    }
+
+    ArchiveRepair repair = RepairArchive(path);
+    stats.damaged += repair.damaged;
+    stats.recovered += repair.recovered;
+    stats.lost += repair.lost;
+    if (repair.damaged == 0 && !damaged) {
+        stats.upgraded++;
+    }
+    return true;
+}
+
+// Month names sort in time order
+bool ScrubArchives(ScrubStats& stats, ScrubPace pace)
+{
+    std::error_code ec;
+    std::vector<std::filesystem::path> archives;
+    for (const auto& entry : std::filesystem::directory_iterator(GetLogFilePath().parent_path() / "Archive", ec)) {
+        if (entry.path().extension() == ".csa") {
+            archives.push_back(entry.path());
+        }
+    }
+    std::sort(archives.begin(), archives.end());
+    for (const auto& path : archives) {
+        if (!ScrubArchive(path, stats, pace)) {
+            return false;
+        }
+    }
+#ifdef _DEBUG
+    std::cout << "Scrub: " << stats.archives << " archives, " << stats.blocks << " blocks, " << stats.bytes
+              << " bytes, " << stats.damaged << " damaged, " << stats.recovered << " sessions recovered, "
+              << stats.lost << " lost, " << stats.upgraded << " upgraded\n";
+#endif // _DEBUG
+    return true;
+}
@@ -0,0 +1,126 @@
+#include "trackerSettings.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <vector>
+
+
+static std::filesystem::path SettingsPath()
+{
+    return GetLogFilePath().parent_path() / SETTINGS_FILE;
+}
+
+// Settings are read and written from the tray and from background threads
+std::mutex _settings_mutex;
+
+// Splits "name ; value", false for anything else. A file edited by hand may
+// end its lines with CRLF.
+static bool ParseSetting(const std::string& line, std::string& name, std::string& value)
+{
+    size_t size = line.size() - (!line.empty() && line.back() == '\r');
+    size_t separator = line.find(" ; ");
+    if (separator == std::string::npos || separator + 3 >= size) {
+        return false;
+    }
+    name = line.substr(0, separator);
+    value = line.substr(separator + 3, size - separator - 3);
+    return true;
+}
+
+// Name and value of every line, a name set twice keeps its place and the later value
+static std::vector<std::pair<std::string, std::string>> ReadSettings(const std::filesystem::path& path)
+{
+    std::vector<std::pair<std::string, std::string>> settings;
+    std::ifstream file(path, std::ios::binary);
+    std::string line;
+    std::string name;
+    std::string value;
+    while (std::getline(file, line)) {
+        if (!ParseSetting(line, name, value)) {
+            continue;
+        }
+        auto it = std::find_if(settings.begin(), settings.end(), [&](const auto& s) { return s.first == name; });
+        if (it == settings.end()) {
+            settings.push_back({name, value});
+        } else {
+            it->second = value;
+        }
+    }
+    return settings;
+}
+
+// False when the name is missing
+static bool ReadSetting(const char* name, std::string& value)
+{
+    std::lock_guard<std::mutex> lock(_settings_mutex);
+    for (const auto& setting : ReadSettings(SettingsPath())) {
+        if (setting.first == name) {
+            value = setting.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool WriteSetting(const char* name, const std::string& value)
+{
+    std::lock_guard<std::mutex> lock(_settings_mutex);
+    std::filesystem::path path = SettingsPath();
+    std::vector<std::pair<std::string, std::string>> settings = ReadSettings(path);
+    auto it = std::find_if(settings.begin(), settings.end(), [&](const auto& s) { return s.first == name; });
+    if (it == settings.end()) {
+        settings.push_back({name, value});
+    } else {
+        it->second = value;
+    }
+
+    std::filesystem::path tmpPath = path;
+    tmpPath += ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        for (const auto& setting : settings) {
+            file << setting.first << " ; " << setting.second << '\n';
+        }
+        if (!file.flush()) {
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, path, ec);
+    if (ec) {
+        std::filesystem::remove(tmpPath, ec);
+        return false;
+    }
+    return true;
+}
+
+bool GetSetting(const char* name)
+{
+    std::string value;
+    return ReadSetting(name, value) && value == "1";
+}
+
+bool SetSetting(const char* name, bool on)
+{
+    return WriteSetting(name, on ? "1" : "0");
+}
+
+long long GetSettingNumber(const char* name, long long missing)
+{
+    std::string value;
+    if (!ReadSetting(name, value)) {
+        return missing;
+    }
+    char* end = nullptr;
+    long long number = strtoll(value.c_str(), &end, 10);
+    return end != value.c_str() && *end == '\0' ? number : missing;
+}
+
+bool SetSettingNumber(const char* name, long long value)
+{
+    return WriteSetting(name, std::to_string(value));
+}
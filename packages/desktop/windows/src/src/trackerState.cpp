@@ -0,0 +1,130 @@
+#include "trackerState.h"
+
+#include <atomic>
+#include <vector>
+
+#ifdef _DEBUG
+#include <iostream>
+#endif // _DEBUG
+
+#define RECLAIM_THRESHOLD 8
+#define INACTIVE_EPOCH 0
+
+
+struct alignas(64) StateReaderSlot {
+    std::atomic<unsigned long long> epoch{INACTIVE_EPOCH};
+    std::atomic<bool> used{false};
+    unsigned depth = 0; // nested views on the owning thread
+    StateReaderSlot* next = nullptr;
+};
+
+typedef struct {
+    TrackerState* state;
+    unsigned long long epoch;
+} RetiredState;
+
+std::atomic<TrackerState*> _published(nullptr);
+std::atomic<unsigned long long> _global_epoch(1);
+std::atomic<StateReaderSlot*> _reader_slots(nullptr);
+// Writer-only bookkeeping
+std::vector<RetiredState> _retired;
+std::vector<TrackerState*> _free_states;
+
+
+// Slots are never freed, a thread returns its slot on exit for reuse
+static StateReaderSlot* AcquireSlot()
+{
+    for (StateReaderSlot* slot = _reader_slots.load(); slot != nullptr; slot = slot->next) {
+        bool expected = false;
+        if (!slot->used.load(std::memory_order_relaxed) && slot->used.compare_exchange_strong(expected, true)) {
+            return slot;
+        }
+    }
+    StateReaderSlot* slot = new StateReaderSlot();
+    slot->used = true;
+    slot->next = _reader_slots.load();
+    while (!_reader_slots.compare_exchange_weak(slot->next, slot)) {
+    }
+    return slot;
+}
+
+struct ThreadSlot {
+    StateReaderSlot* slot = AcquireSlot();
+    ~ThreadSlot() { slot->used.store(false, std::memory_order_release); }
+};
+
+TrackerStateView::TrackerStateView()
+{
+    static thread_local ThreadSlot thread_slot;
+    _slot = thread_slot.slot;
+    if (_slot->depth++ == 0) {
+        _slot->epoch.store(_global_epoch.load());
+    }
+    _state = _published.load();
+}
+
+TrackerStateView::~TrackerStateView()
+{
+    if (--_slot->depth == 0) {
+        _slot->epoch.store(INACTIVE_EPOCH, std::memory_order_release);
+    }
+}
+
+
+static void Reclaim()
+{
+    unsigned long long oldest = ~0ULL;
+    for (StateReaderSlot* slot = _reader_slots.load(); slot != nullptr; slot = slot->next) {
+        unsigned long long epoch = slot->epoch.load();
+        if (epoch != INACTIVE_EPOCH && epoch < oldest) {
+            oldest = epoch;
+        }
+    }
+    // A reader pinned at epoch e may hold any state retired at e or later
+    size_t kept = 0;
+    for (const auto& retired : _retired) {
+        if (retired.epoch < oldest) {
+            _free_states.push_back(retired.state);
+        } else {
+            _retired[kept++] = retired;
+        }
+    }
+    _retired.resize(kept);
+}
+
+void PublishTrackerState(const TrackerState& state)
+{
+    TrackerState* next;
+    if (!_free_states.empty()) {
+        next = _free_states.back();
+        _free_states.pop_back();
+        *next = state;
+    } else {
+        next = new TrackerState(state);
+    }
+
+    TrackerState* old = _published.exchange(next);
+    if (old == nullptr) {
+        return;
+    }
+    _retired.push_back({old, _global_epoch.fetch_add(1)});
+    if (_retired.size() >= RECLAIM_THRESHOLD) {
+        Reclaim();
+    }
+}
+
+#ifdef _DEBUG
+void PrintTrackerState()
+{
+    TrackerStateView view;
+    if (view.get() == nullptr) {
+        return;
+    }
+    if (view->hasSession) {
+        std::cout << GetLineStr(view->current);
+    }
+    std::cout << "ticks: " << view->ticks << " sessions: " << view->sessions
+              << (view->afk ? " AFK" : "") << (view->locked ? " Locked" : "")
+              << (view->caffeine ? " Caffeine" : "") << " governor: " << GovernorModeName(view->governor) << '\n';
+}
+#endif // _DEBUG
@@ -0,0 +1,232 @@
+#include "trackerTasks.h"
+#include "trackerArchive.h"
+#include "trackerImport.h"
+#include "trackerTime.h"
+
+#include <algorithm>
+#include <climits>
+#include <fstream>
+
+#ifdef _DEBUG
+#include <iostream>
+#endif // _DEBUG
+
+
+void TaskIntervalTree::Build(std::vector<TaskBlock> blocks)
+{
+    std::sort(blocks.begin(), blocks.end(), [](const TaskBlock& a, const TaskBlock& b) { return a.start < b.start; });
+    _blocks = std::move(blocks);
+    _maxEnd.resize(_blocks.size());
+    // Bottom up over the same midpoints Visit walks
+    std::function<long long(size_t, size_t)> fill = [&](size_t lo, size_t hi) -> long long {
+        if (lo >= hi) {
+            return LLONG_MIN;
+        }
+        size_t mid = lo + (hi - lo) / 2;
+        _maxEnd[mid] = std::max({_blocks[mid].end, fill(lo, mid), fill(mid + 1, hi)});
+        return _maxEnd[mid];
+    };
+    fill(0, _blocks.size());
+}
+
+void TaskIntervalTree::Visit(size_t lo, size_t hi, long long start, long long end, const std::function<void(const TaskBlock&)>& visit) const
+{
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (_maxEnd[mid] <= start) {
+            return;
+        }
+        Visit(lo, mid, start, end, visit);
+        // Everything right of mid starts later still
+        if (_blocks[mid].start >= end) {
+            return;
+        }
+        if (_blocks[mid].end > start) {
+            visit(_blocks[mid]);
+        }
+        lo = mid + 1;
+    }
+}
+
+void TaskIntervalTree::Overlapping(long long start, long long end, const std::function<void(const TaskBlock&)>& visit) const
+{
+    Visit(0, _blocks.size(), start, end, visit);
+}
+
+
+uint32_t TaskAttribution::TaskId(const std::string& task)
+{
+    auto inserted = _taskIds.try_emplace(task, (uint32_t)_tasks.size());
+    if (inserted.second) {
+        _tasks.push_back(task);
+        _seconds.push_back(0.0);
+        _planned.push_back(0);
+        _sessions.push_back(0);
+        _lastSession.push_back(0);
+    }
+    return inserted.first->second;
+}
+
+uint32_t TaskAttribution::TypeId(const std::string& type)
+{
+    auto inserted = _typeIds.try_emplace(type, (uint32_t)_rules.size());
+    if (inserted.second) {
+        _rules.emplace_back();
+    }
+    return inserted.first->second;
+}
+
+void TaskAttribution::AddBlock(const std::string& task, const std::string& type, long long start, long long end)
+{
+    if (end <= start) {
+        return;
+    }
+    uint32_t id = TaskId(task);
+    _blocks.push_back({start, end, id, TypeId(type)});
+    _planned[id] += end - start;
+    _built = false;
+}
+
+void TaskAttribution::AddRule(const std::string& type, const std::string& executable)
+{
+    _rules[TypeId(type)].insert(executable);
+}
+
+size_t TaskAttribution::LoadBlocks(const std::filesystem::path& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::string line;
+    AppLogger block;
+    size_t count = 0;
+    while (std::getline(file, line)) {
+        if (ParseLogLine(line.data(), line.size(), block)) {
+            AddBlock(block.executable, block.title, TimeSeconds(block.start), TimeSeconds(block.end));
+            count++;
+        }
+    }
+    return count;
+}
+
+size_t TaskAttribution::LoadRules(const std::filesystem::path& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::string line;
+    size_t count = 0;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        size_t delim = line.find(" ; ");
+        if (delim != std::string::npos && delim > 0 && delim + 3 < line.size()) {
+            AddRule(line.substr(0, delim), line.substr(delim + 3));
+            count++;
+        }
+    }
+    return count;
+}
+
+bool TaskAttribution::Allowed(uint32_t type, const std::string& executable) const
+{
+    return _rules[type].empty() || _rules[type].count(executable) > 0;
+}
+
+void TaskAttribution::Add(const AppLogger& log)
+{
+    if (log.executable == "AFK") {
+        return;
+    }
+    if (!_built) {
+        _tree.Build(_blocks);
+        _built = true;
+    }
+    long long start = TimeSeconds(log.start);
+    long long end = TimeSeconds(log.end);
+    if (end <= start) {
+        return;
+    }
+
+    // Overlaps clipped to the session
+    _matches.clear();
+    _tree.Overlapping(start, end, [&](const TaskBlock& block) {
+        if (Allowed(block.type, log.executable)) {
+            _matches.push_back({std::max(start, block.start), std::min(end, block.end), block.task, block.type});
+        }
+    });
+    if (_matches.empty()) {
+        return;
+    }
+    _sessionCount++;
+    auto credit = [&](uint32_t task, double seconds) {
+        _seconds[task] += seconds;
+        if (_lastSession[task] != _sessionCount) {
+            _lastSession[task] = _sessionCount;
+            _sessions[task]++;
+        }
+    };
+    if (_mode == ATTRIBUTE_EACH) {
+        for (const TaskBlock& match : _matches) {
+            credit(match.task, (double)(match.end - match.start));
+        }
+        return;
+    }
+
+    // Shared: sweeping the block edges integrates share(t) = 1 / blocks active
+    // at t, and each block is owed the integral over its own span. Sorting the
+    // 2k edges keeps a session with k overlaps at O(k log k).
+    _events.clear();
+    for (const TaskBlock& match : _matches) {
+        _events.push_back({match.start, 1});
+        _events.push_back({match.end, -1});
+    }
+    std::sort(_events.begin(), _events.end());
+    _shares.clear();
+    int active = 0;
+    double share = 0.0;
+    for (size_t i = 0; i < _events.size(); i++) {
+        if (i > 0 && active > 0) {
+            share += (double)(_events[i].first - _events[i - 1].first) / active;
+        }
+        active += _events[i].second;
+        if (_shares.empty() || _shares.back().first != _events[i].first) {
+            _shares.push_back({_events[i].first, share});
+        }
+    }
+    auto at = [&](long long t) {
+        return std::lower_bound(_shares.begin(), _shares.end(), std::make_pair(t, -1.0))->second;
+    };
+    for (const TaskBlock& match : _matches) {
+        credit(match.task, at(match.end) - at(match.start));
+    }
+}
+
+std::vector<TaskTime> TaskAttribution::Results() const
+{
+    std::vector<TaskTime> results;
+    results.reserve(_tasks.size());
+    for (size_t i = 0; i < _tasks.size(); i++) {
+        results.push_back({_tasks[i], _seconds[i], _planned[i], _sessions[i]});
+    }
+    std::stable_sort(results.begin(), results.end(), [](const TaskTime& a, const TaskTime& b) { return a.seconds > b.seconds; });
+    return results;
+}
+
+
+std::vector<TaskTime> AttributeTasks(ULONGLONG from, ULONGLONG to, AttributionMode mode)
+{
+    std::filesystem::path logPath = GetLogFilePath();
+    TaskAttribution attribution(mode);
+    attribution.LoadBlocks(logPath.parent_path() / TASK_BLOCKS_FILE);
+    attribution.LoadRules(logPath.parent_path() / TASK_RULES_FILE);
+    if (attribution.Blocks() == 0) {
+        return attribution.Results();
+    }
+    ForEachStoredSession(from, to, [&](const AppLogger& log) {
+        attribution.Add(log);
+        return true;
+    });
+
+#ifdef _DEBUG
+    std::cout << "Tasks: " << attribution.Blocks() << " blocks joined\n";
+#endif // _DEBUG
+    return attribution.Results();
+}
@@ -0,0 +1,63 @@
+#include "trackerTime.h"
+
+
+ULONGLONG TimeKey(const SYSTEMTIME& st)
+{
+    return (ULONGLONG)st.wYear * 10000000000ULL + (ULONGLONG)st.wMonth * 100000000ULL +
+           (ULONGLONG)st.wDay * 1000000ULL + (ULONGLONG)st.wHour * 10000ULL +
+           (ULONGLONG)st.wMinute * 100ULL + (ULONGLONG)st.wSecond;
+}
+
+SYSTEMTIME TimeFromKey(ULONGLONG key)
+{
+    SYSTEMTIME st = {};
+    st.wYear = (WORD)(key / 10000000000ULL);
+    st.wMonth = (WORD)(key / 100000000ULL % 100);
+    st.wDay = (WORD)(key / 1000000ULL % 100);
+    st.wHour = (WORD)(key / 10000ULL % 100);
+    st.wMinute = (WORD)(key / 100ULL % 100);
+    st.wSecond = (WORD)(key % 100);
+    return st;
+}
+
+long DayNumber(const SYSTEMTIME& st)
+{
+    // Civil date to day count (Howard Hinnant's algorithm)
+    long y = (long)st.wYear - (st.wMonth <= 2);
+    long era = (y >= 0 ? y : y - 399) / 400;
+    long yoe = y - era * 400;
+    long m = st.wMonth;
+    long doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + st.wDay - 1;
+    long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+long long TimeSeconds(const SYSTEMTIME& st)
+{
+    return (long long)DayNumber(st) * 86400 + st.wHour * 3600 + st.wMinute * 60 + st.wSecond;
+}
+
+SYSTEMTIME TimeFromSeconds(long long seconds)
+{
+    long long days = (seconds >= 0 ? seconds : seconds - 86399) / 86400;
+    long long rem = seconds - days * 86400;
+
+    long long z = days + 719468;
+    long long era = (z >= 0 ? z : z - 146096) / 146097;
+    long long doe = z - era * 146097;
+    long long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    long long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    long long mp = (5 * doy + 2) / 153;
+    long long m = mp < 10 ? mp + 3 : mp - 9;
+
+    SYSTEMTIME st;
+    st.wYear = (WORD)(yoe + era * 400 + (m <= 2));
+    st.wMonth = (WORD)m;
+    st.wDay = (WORD)(doy - (153 * mp + 2) / 5 + 1);
+    st.wDayOfWeek = (WORD)((days % 7 + 11) % 7); // 1970-01-01 was a Thursday
+    st.wHour = (WORD)(rem / 3600);
+    st.wMinute = (WORD)(rem / 60 % 60);
+    st.wSecond = (WORD)(rem % 60);
+    st.wMilliseconds = 0;
+    return st;
+}
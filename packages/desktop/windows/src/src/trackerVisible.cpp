@@ -0,0 +1,116 @@
+#include "trackerVisible.h"
+#include "trackerWindow.h"
+
+#include <atomic>
+#include <fstream>
+#include <mutex>
+
+#ifdef _DEBUG
+#include <iostream>
+#endif // _DEBUG
+
+#define DWMWA_CLOAKED_ATTRIBUTE 14
+
+
+struct WindowNames {
+    const char* Executable(HWND hwnd) { return GetWindowExecutableName(hwnd); }
+    const char* Title(HWND hwnd) { return GetWindowTitle(hwnd); }
+};
+
+std::atomic<bool> _visible_active(false);
+// The samples are only taken on the tracker thread, the lock is for the tray
+// toggling the mode and the save thread draining closed sessions
+std::mutex _visible_mutex;
+std::vector<VisibleSample> _visible_sample;
+std::vector<AppLogger> _visible_closed;
+VisibleSet<LocalClock, WindowNames> _visible_set(_visible_closed);
+
+
+typedef HRESULT(WINAPI *DwmGetWindowAttributeFunc)(HWND, DWORD, PVOID, DWORD);
+
+// Windows on other virtual desktops and suspended store apps are visible but
+// cloaked. dwmapi is resolved at run time, as ntdll is for the OS version.
+static bool IsCloaked(HWND hwnd)
+{
+    static DwmGetWindowAttributeFunc getAttribute = []() -> DwmGetWindowAttributeFunc {
+        HMODULE hMod = LoadLibraryA("dwmapi.dll");
+        if (!hMod) {
+            return nullptr;
+        }
+        return reinterpret_cast<DwmGetWindowAttributeFunc>(
+            reinterpret_cast<void*>(GetProcAddress(hMod, "DwmGetWindowAttribute"))
+        );
+    }();
+    DWORD cloaked = 0;
+    return getAttribute != nullptr &&
+           getAttribute(hwnd, DWMWA_CLOAKED_ATTRIBUTE, &cloaked, sizeof(cloaked)) == 0 && cloaked != 0;
+}
+
+static BOOL CALLBACK CollectVisible(HWND hwnd, LPARAM lParam)
+{
+    if (!IsWindowVisible(hwnd) || GetWindow(hwnd, GW_OWNER) != NULL ||
+        (GetWindowLongA(hwnd, GWL_EXSTYLE) & WS_EX_TOOLWINDOW) ||
+        GetWindowTextLengthW(hwnd) == 0 || IsCloaked(hwnd)) {
+        return TRUE;
+    }
+    reinterpret_cast<std::vector<VisibleSample>*>(lParam)->push_back({hwnd, IsIconic(hwnd) != FALSE});
+    return TRUE;
+}
+
+void EnumVisibleWindows(std::vector<VisibleSample>& out)
+{
+    EnumWindows(CollectVisible, reinterpret_cast<LPARAM>(&out));
+}
+
+
+void BeginVisibleTracking()
+{
+    std::lock_guard<std::mutex> lock(_visible_mutex);
+    _visible_active = true;
+}
+
+void EndVisibleTracking()
+{
+    std::lock_guard<std::mutex> lock(_visible_mutex);
+    if (!_visible_active) {
+        return;
+    }
+    _visible_active = false;
+    _visible_set.Clear();
+    _visible_sample.clear();
+}
+
+bool IsVisibleTrackingActive()
+{
+    return _visible_active;
+}
+
+size_t SampleVisibleWindows()
+{
+    std::lock_guard<std::mutex> lock(_visible_mutex);
+    if (!_visible_active) {
+        return 0;
+    }
+    _visible_sample.clear();
+    EnumVisibleWindows(_visible_sample);
+    return _visible_set.Update(_visible_sample);
+}
+
+void SaveVisibleWindows()
+{
+    std::vector<AppLogger> closed;
+    {
+        std::lock_guard<std::mutex> lock(_visible_mutex);
+        closed.swap(_visible_closed);
+    }
+    if (closed.empty()) {
+        return;
+    }
+    std::ofstream file(GetLogFilePath().parent_path() / VISIBLE_FILE, std::ios::app);
+    for (const auto& session : closed) {
+        file << GetLineStr(session);
+    }
+#ifdef _DEBUG
+    std::cout << "Visible windows: " << closed.size() << " sessions saved\n";
+#endif // _DEBUG
+}
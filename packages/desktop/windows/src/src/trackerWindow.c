@@ -1,11 +1,65 @@
 #include "trackerWindow.h"
+#include "utfConvert.h"
 
+#define TITLE_MIN_CAPACITY 256
 
 
+// Grows buffer to hold at least size elements, keeping it on failure
+static bool Reserve(void** buffer, size_t* capacity, size_t size, size_t element)
+{
+    if (size <= *capacity) {
+        return true;
+    }
+    size_t grown = *capacity * 2 > size ? *capacity * 2 : size;
+    if (grown < TITLE_MIN_CAPACITY) {
+        grown = TITLE_MIN_CAPACITY;
+    }
+    void* resized = realloc(*buffer, grown * element);
+    if (resized == NULL) {
+        return false;
+    }
+    *buffer = resized;
+    *capacity = grown;
+    return true;
+}
+
+// The UTF-16 title, in a buffer kept between calls. The title can grow
+// between the two calls, and a result that fills the buffer may be cut short,
+// so retry with room for at least one more unit.
+static const WCHAR* GetWindowTextWide(HWND hwnd, size_t* length)
+{
+    static WCHAR* wide = NULL;
+    static size_t wide_capacity = 0;
+
+    size_t needed = (size_t)GetWindowTextLengthW(hwnd) + 2;
+    for (;;) {
+        if (!Reserve((void**)&wide, &wide_capacity, needed, sizeof(WCHAR))) {
+            return NULL;
+        }
+        int read = GetWindowTextW(hwnd, wide, (int)wide_capacity);
+        if ((size_t)read + 1 < wide_capacity) {
+            *length = (size_t)read;
+            return wide;
+        }
+        needed = wide_capacity * 2;
+    }
+}
+
+// Returns the title as UTF-8, with no length cap. The buffers are kept
+// between calls, so a steady title allocates nothing.
 char* GetWindowTitle(HWND hwnd)
 {
-    static char wnd_title[MAX_PATH];
-    GetWindowTextA(hwnd, wnd_title, sizeof(wnd_title));
+    static char* wnd_title = NULL;
+    static size_t title_capacity = 0;
+    static char empty[] = "";
+
+    size_t length;
+    const WCHAR* wide = GetWindowTextWide(hwnd, &length);
+    if (wide == NULL || !Reserve((void**)&wnd_title, &title_capacity, UTF8_CAPACITY(length) + 1, sizeof(char))) {
+        return empty;
+    }
+    size_t size = Utf16ToUtf8((const uint16_t*)wide, length, wnd_title);
+    wnd_title[size] = '\0';
     return wnd_title;
 }
 
@@ -49,4 +103,45 @@ char* GetActiveWindowExecutableName()
 {
     HWND hwnd = GetForegroundWindow();
     return GetWindowExecutableName(hwnd);
+}
+
+DWORD GetActiveWindowProcessId()
+{
+    DWORD pid = 0;
+    HWND hwnd = GetForegroundWindow();
+    if (hwnd != NULL) {
+        GetWindowThreadProcessId(hwnd, &pid);
+    }
+    return pid;
+}
+
+WindowFingerprint GetActiveWindowFingerprint()
+{
+    WindowFingerprint print = {};
+    print.hwnd = GetForegroundWindow();
+    GetWindowThreadProcessId(print.hwnd, &print.pid);
+
+    // Hashed eight bytes at a time straight from the UTF-16 buffer, nothing is
+    // transcoded or copied
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    size_t length = 0;
+    const WCHAR* wide = GetWindowTextWide(print.hwnd, &length);
+    const char* p = wide != NULL ? (const char*)wide : "";
+    size_t size = wide != NULL ? length * sizeof(WCHAR) : 0;
+    uint64_t h = size * m;
+    for (; size >= 8; p += 8, size -= 8) {
+        uint64_t k;
+        memcpy(&k, p, 8);
+        h = (h ^ k) * m;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, p, size);
+    h = (h ^ tail) * m;
+    print.title = h ^ (h >> 47);
+    return print;
+}
+
+bool SameWindow(const WindowFingerprint* a, const WindowFingerprint* b)
+{
+    return a->hwnd == b->hwnd && a->pid == b->pid && a->title == b->title;
 }
\ No newline at end of file
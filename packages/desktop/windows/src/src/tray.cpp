@@ -6,6 +6,7 @@ std::vector<TrayMenu> Menu;
 NOTIFYICONDATAA nid;
 int (*TrayCommandCallback)(HWND, WPARAM) = nullptr;
 int (*TrayUserCallback)(HWND, LPARAM) = nullptr;
+void (*TrayEndSessionCallback)() = nullptr;
 
 
 void CreateTrayIcon(HWND hwnd) 
@@ -33,6 +34,17 @@ void CreateTrayIcon(HWND hwnd, const char* name, const char* icon)
     }
 }
 
+void ShowTrayNotification(const char* title, const char* text)
+{
+    // A copy, so the icon's own fields are never written from another thread
+    NOTIFYICONDATAA info = nid;
+    info.uFlags = NIF_INFO;
+    info.dwInfoFlags = NIIF_INFO;
+    strncpy_s(info.szInfoTitle, sizeof(info.szInfoTitle) - 1, title, _TRUNCATE);
+    strncpy_s(info.szInfo, sizeof(info.szInfo) - 1, text, _TRUNCATE);
+    Shell_NotifyIconA(NIM_MODIFY, &info);
+}
+
 void RemoveTrayIcon(HWND hwnd) 
 {
     nid.hWnd = hwnd;
@@ -53,6 +65,13 @@ void SetTrayUserCallback(int (*callback)(HWND, LPARAM)) {
     TrayUserCallback = callback;
 }
 
+void SetTrayEndSessionCallback(void (*callback)()) {
+    if (callback == nullptr) {
+        return;
+    }
+    TrayEndSessionCallback = callback;
+}
+
 LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
     // Handle window messages
     switch (uMsg) {
@@ -69,6 +88,14 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
                 return TrayCommandCallback(hwnd, wParam);
             }
             break;
+        case WM_QUERYENDSESSION:
+            return TRUE;
+        case WM_ENDSESSION:
+            // The process may be killed as soon as this message returns
+            if (wParam && TrayEndSessionCallback != nullptr) {
+                TrayEndSessionCallback();
+            }
+            return 0;
         
         default:
             return DefWindowProc(hwnd, uMsg, wParam, lParam);
@@ -112,9 +139,9 @@ HWND CreateTrayWindow(HINSTANCE hInstance, const char* name)
     return hwnd;
 }
 
-void _CreateMenu(HMENU hMenu, std::vector<TrayMenu> vMenu)
+void _CreateMenu(HMENU hMenu, const std::vector<TrayMenu>& vMenu)
 {
-    for (TrayMenu Item : vMenu) {
+    for (const TrayMenu& Item : vMenu) {
         if (!Item.show) {
             continue;
         }
@@ -146,12 +173,12 @@ void CreateTrayMenu(HWND hwnd)
 
 
 
-void AddMenuItem(TrayMenu item) 
+void AddMenuItem(const TrayMenu& item) 
 {
     Menu.push_back(item);
 }
 
 void InitTrayMenu(std::vector<TrayMenu> vMenu)
 {
-    Menu = vMenu;
+    Menu = std::move(vMenu);
 }
\ No newline at end of file
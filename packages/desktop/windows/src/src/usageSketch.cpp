@@ -0,0 +1,420 @@
+#include "usageSketch.h"
+#include "trackerTime.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+
+#define SKETCH_MAGIC 0x31534B53 // "SKS1"
+
+
+static uint64_t HashKey(const std::string& key)
+{
+    uint64_t h = 1469598103934665603ULL;
+    for (unsigned char c : key) {
+        h = (h ^ c) * 1099511628211ULL;
+    }
+    // Final avalanche so both halves are usable for double hashing
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+template<typename T>
+static void Put(std::string& out, T value)
+{
+    out.append((const char*)&value, sizeof(value));
+}
+
+template<typename T>
+static bool Get(const char*& p, const char* end, T& value)
+{
+    if ((size_t)(end - p) < sizeof(value)) {
+        return false;
+    }
+    memcpy(&value, p, sizeof(value));
+    p += sizeof(value);
+    return true;
+}
+
+
+CountMinSketch::CountMinSketch(double epsilon, double delta)
+    : _width((uint32_t)std::ceil(std::exp(1.0) / epsilon)),
+      _depth((uint32_t)std::ceil(std::log(1.0 / delta))),
+      _total(0),
+      _counters((size_t)_width * _depth, 0)
+{
+}
+
+void CountMinSketch::Add(const std::string& key, uint64_t weight)
+{
+    uint64_t h = HashKey(key);
+    uint32_t h1 = (uint32_t)h;
+    uint32_t h2 = (uint32_t)(h >> 32) | 1;
+
+    // Conservative update: only raise the cells that hold the current minimum
+    uint64_t estimate = UINT64_MAX;
+    for (uint32_t row = 0; row < _depth; row++) {
+        estimate = std::min(estimate, _counters[(size_t)row * _width + (h1 + row * h2) % _width]);
+    }
+    uint64_t target = estimate + weight;
+    for (uint32_t row = 0; row < _depth; row++) {
+        uint64_t& cell = _counters[(size_t)row * _width + (h1 + row * h2) % _width];
+        cell = std::max(cell, target);
+    }
+    _total += weight;
+}
+
+uint64_t CountMinSketch::Estimate(const std::string& key) const
+{
+    uint64_t h = HashKey(key);
+    uint32_t h1 = (uint32_t)h;
+    uint32_t h2 = (uint32_t)(h >> 32) | 1;
+    uint64_t estimate = UINT64_MAX;
+    for (uint32_t row = 0; row < _depth; row++) {
+        estimate = std::min(estimate, _counters[(size_t)row * _width + (h1 + row * h2) % _width]);
+    }
+    return estimate;
+}
+
+bool CountMinSketch::Merge(const CountMinSketch& other)
+{
+    if (other._width != _width || other._depth != _depth) {
+        return false;
+    }
+    for (size_t i = 0; i < _counters.size(); i++) {
+        _counters[i] += other._counters[i];
+    }
+    _total += other._total;
+    return true;
+}
+
+void CountMinSketch::Serialize(std::string& out) const
+{
+    Put(out, _width);
+    Put(out, _depth);
+    Put(out, _total);
+    out.append((const char*)_counters.data(), _counters.size() * sizeof(uint64_t));
+}
+
+bool CountMinSketch::Deserialize(const char*& p, const char* end)
+{
+    uint32_t width, depth;
+    uint64_t total;
+    if (!Get(p, end, width) || !Get(p, end, depth) || !Get(p, end, total)) {
+        return false;
+    }
+    size_t bytes = (size_t)width * depth * sizeof(uint64_t);
+    if ((size_t)(end - p) < bytes) {
+        return false;
+    }
+    _width = width;
+    _depth = depth;
+    _total = total;
+    _counters.resize((size_t)width * depth);
+    memcpy(_counters.data(), p, bytes);
+    p += bytes;
+    return true;
+}
+
+
+SpaceSaving::SpaceSaving(size_t capacity)
+    : _capacity(std::max<size_t>(1, capacity))
+{
+    _heap.reserve(_capacity);
+    _index.reserve(_capacity);
+}
+
+void SpaceSaving::Swap(size_t a, size_t b)
+{
+    std::swap(_heap[a], _heap[b]);
+    _index[_heap[a].key] = a;
+    _index[_heap[b].key] = b;
+}
+
+void SpaceSaving::SiftDown(size_t i)
+{
+    while (true) {
+        size_t smallest = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        if (left < _heap.size() && _heap[left].count < _heap[smallest].count) {
+            smallest = left;
+        }
+        if (right < _heap.size() && _heap[right].count < _heap[smallest].count) {
+            smallest = right;
+        }
+        if (smallest == i) {
+            return;
+        }
+        Swap(i, smallest);
+        i = smallest;
+    }
+}
+
+void SpaceSaving::SiftUp(size_t i)
+{
+    while (i > 0 && _heap[(i - 1) / 2].count > _heap[i].count) {
+        Swap(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+void SpaceSaving::Add(const std::string& key, uint64_t weight)
+{
+    auto it = _index.find(key);
+    if (it != _index.end()) {
+        _heap[it->second].count += weight;
+        SiftDown(it->second);
+        return;
+    }
+    if (_heap.size() < _capacity) {
+        _heap.push_back({key, weight, 0});
+        _index[key] = _heap.size() - 1;
+        SiftUp(_heap.size() - 1);
+        return;
+    }
+    // Evict the smallest counter, the newcomer inherits its count as error
+    Counter& min = _heap[0];
+    _index.erase(min.key);
+    min.error = min.count;
+    min.count += weight;
+    min.key = key;
+    _index[min.key] = 0;
+    SiftDown(0);
+}
+
+std::vector<SpaceSaving::Counter> SpaceSaving::Top(size_t n) const
+{
+    std::vector<Counter> top(_heap);
+    n = std::min(n, top.size());
+    std::partial_sort(top.begin(), top.begin() + n, top.end(), [](const Counter& a, const Counter& b) {
+        return a.count != b.count ? a.count > b.count : a.key < b.key;
+    });
+    top.resize(n);
+    return top;
+}
+
+bool SpaceSaving::Merge(const SpaceSaving& other)
+{
+    // A key missing from a full summary may still have up to its minimum count
+    uint64_t minThis = _heap.size() < _capacity || _heap.empty() ? 0 : _heap[0].count;
+    uint64_t minOther = other._heap.size() < other._capacity || other._heap.empty() ? 0 : other._heap[0].count;
+
+    std::unordered_map<std::string, Counter> merged;
+    merged.reserve(_heap.size() + other._heap.size());
+    for (const auto& c : _heap) {
+        merged[c.key] = {c.key, c.count + minOther, c.error + minOther};
+    }
+    for (const auto& c : other._heap) {
+        auto it = merged.find(c.key);
+        if (it != merged.end()) {
+            it->second.count += c.count - minOther;
+            it->second.error += c.error - minOther;
+        } else {
+            merged[c.key] = {c.key, c.count + minThis, c.error + minThis};
+        }
+    }
+
+    std::vector<Counter> all;
+    all.reserve(merged.size());
+    for (auto& item : merged) {
+        all.push_back(std::move(item.second));
+    }
+    size_t keep = std::min(_capacity, all.size());
+    std::partial_sort(all.begin(), all.begin() + keep, all.end(), [](const Counter& a, const Counter& b) {
+        return a.count != b.count ? a.count > b.count : a.key < b.key;
+    });
+    all.resize(keep);
+
+    _heap = std::move(all);
+    _index.clear();
+    for (size_t i = 0; i < _heap.size(); i++) {
+        _index[_heap[i].key] = i;
+    }
+    for (size_t i = _heap.size() / 2; i-- > 0;) {
+        SiftDown(i);
+    }
+    return true;
+}
+
+void SpaceSaving::Serialize(std::string& out) const
+{
+    Put(out, (uint32_t)_capacity);
+    Put(out, (uint32_t)_heap.size());
+    for (const auto& c : _heap) {
+        Put(out, c.count);
+        Put(out, c.error);
+        Put(out, (uint32_t)c.key.size());
+        out += c.key;
+    }
+}
+
+bool SpaceSaving::Deserialize(const char*& p, const char* end)
+{
+    uint32_t capacity, size;
+    if (!Get(p, end, capacity) || !Get(p, end, size) || capacity == 0 || size > capacity) {
+        return false;
+    }
+    std::vector<Counter> heap(size);
+    for (auto& c : heap) {
+        uint32_t len;
+        if (!Get(p, end, c.count) || !Get(p, end, c.error) || !Get(p, end, len) || (size_t)(end - p) < len) {
+            return false;
+        }
+        c.key.assign(p, len);
+        p += len;
+    }
+    _capacity = capacity;
+    _heap = std::move(heap);
+    _index.clear();
+    for (size_t i = 0; i < _heap.size(); i++) {
+        _index[_heap[i].key] = i;
+    }
+    for (size_t i = _heap.size() / 2; i-- > 0;) {
+        SiftDown(i);
+    }
+    return true;
+}
+
+
+void AddToUsageSketch(UsageSketch& sketch, const AppLogger& log)
+{
+    long long seconds = UnseenSeconds(log);
+    if (seconds <= 0) {
+        return;
+    }
+    sketch.apps.Add(log.executable, (uint64_t)seconds);
+    sketch.titles.Add(log.title, (uint64_t)seconds);
+    sketch.titleSeconds.Add(log.title, (uint64_t)seconds);
+}
+
+bool MergeUsageSketch(UsageSketch& into, const UsageSketch& other)
+{
+    return into.apps.Merge(other.apps) && into.titles.Merge(other.titles) &&
+           into.titleSeconds.Merge(other.titleSeconds);
+}
+
+void SerializeUsageSketch(const UsageSketch& sketch, std::string& out)
+{
+    Put(out, (uint32_t)SKETCH_MAGIC);
+    sketch.apps.Serialize(out);
+    sketch.titles.Serialize(out);
+    sketch.titleSeconds.Serialize(out);
+}
+
+bool DeserializeUsageSketch(UsageSketch& sketch, const std::string& data)
+{
+    const char* p = data.data();
+    const char* end = p + data.size();
+    uint32_t magic;
+    return Get(p, end, magic) && magic == SKETCH_MAGIC && sketch.apps.Deserialize(p, end) &&
+           sketch.titles.Deserialize(p, end) && sketch.titleSeconds.Deserialize(p, end);
+}
+
+
+std::mutex _sketch_mutex;
+std::map<long, UsageSketch> _daily_sketches;
+// Days whose file matches the sketch in memory
+std::set<long> _saved_days;
+
+static std::filesystem::path SketchPath(long day)
+{
+    SYSTEMTIME st = TimeFromSeconds((long long)day * 86400);
+    char name[32];
+    snprintf(name, sizeof(name), "%04u-%02u-%02u.sk", st.wYear, st.wMonth, st.wDay);
+    return GetLogFilePath().parent_path() / "Sketch" / name;
+}
+
+static void SaveSketch(long day, const UsageSketch& sketch)
+{
+    std::string data;
+    SerializeUsageSketch(sketch, data);
+    std::error_code ec;
+    std::filesystem::path path = SketchPath(day);
+    std::filesystem::create_directories(path.parent_path(), ec);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(data.data(), data.size());
+}
+
+static void OnSessionClosed(const AppLogger& log)
+{
+    long day = DayNumber(log.start);
+    std::lock_guard<std::mutex> lock(_sketch_mutex);
+    AddToUsageSketch(_daily_sketches[day], log);
+    _saved_days.erase(day);
+
+    // Seal days that fell out of today: persist each once and drop the oldest.
+    // The open day is left to SaveUsageSketches, this runs on the tracker thread.
+    while (_daily_sketches.size() > 1 && _daily_sketches.begin()->first <= day - SKETCH_DAYS) {
+        _saved_days.erase(_daily_sketches.begin()->first);
+        _daily_sketches.erase(_daily_sketches.begin());
+    }
+    for (auto it = _daily_sketches.begin(); it != _daily_sketches.end() && it->first < day; ++it) {
+        if (_saved_days.insert(it->first).second) {
+            SaveSketch(it->first, it->second);
+        }
+    }
+}
+
+void StartUsageSketches()
+{
+    long today = DayNumber(GetTime());
+    {
+        std::lock_guard<std::mutex> lock(_sketch_mutex);
+        for (long day = today - SKETCH_DAYS + 1; day <= today; day++) {
+            std::ifstream file(SketchPath(day), std::ios::binary);
+            if (!file) {
+                continue;
+            }
+            std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            UsageSketch sketch;
+            if (DeserializeUsageSketch(sketch, data)) {
+                _daily_sketches[day] = std::move(sketch);
+                _saved_days.insert(day);
+            }
+        }
+    }
+    AddSessionListener(OnSessionClosed);
+}
+
+void SaveUsageSketches()
+{
+    std::lock_guard<std::mutex> lock(_sketch_mutex);
+    for (const auto& item : _daily_sketches) {
+        if (_saved_days.insert(item.first).second) {
+            SaveSketch(item.first, item.second);
+        }
+    }
+}
+
+static UsageSketch MergeDays(int days)
+{
+    long first = DayNumber(GetTime()) - days + 1;
+    UsageSketch merged;
+    std::lock_guard<std::mutex> lock(_sketch_mutex);
+    for (auto it = _daily_sketches.lower_bound(first); it != _daily_sketches.end(); ++it) {
+        MergeUsageSketch(merged, it->second);
+    }
+    return merged;
+}
+
+std::vector<SpaceSaving::Counter> TopApps(size_t n, int days)
+{
+    return MergeDays(days).apps.Top(n);
+}
+
+std::vector<SpaceSaving::Counter> TopTitles(size_t n, int days)
+{
+    return MergeDays(days).titles.Top(n);
+}
+
+uint64_t EstimateTitleSeconds(const std::string& title, int days)
+{
+    return MergeDays(days).titleSeconds.Estimate(title);
+}
@@ -0,0 +1,148 @@
+#include "utfConvert.h"
+
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif // __SSE2__
+
+
+static inline bool IsHighSurrogate(uint16_t c) { return (c & 0xFC00) == 0xD800; }
+static inline bool IsLowSurrogate(uint16_t c) { return (c & 0xFC00) == 0xDC00; }
+
+// Encodes the code point at p, consuming one or two units
+static inline char* EncodeOne(const uint16_t*& p, const uint16_t* end, char* out)
+{
+    uint32_t c = *p++;
+    if (c < 0x80) {
+        *out++ = (char)c;
+        return out;
+    }
+    if (c < 0x800) {
+        *out++ = (char)(0xC0 | (c >> 6));
+        *out++ = (char)(0x80 | (c & 0x3F));
+        return out;
+    }
+    if ((c & 0xF800) == 0xD800) {
+        if (IsHighSurrogate((uint16_t)c) && p < end && IsLowSurrogate(*p)) {
+            c = 0x10000 + ((c - 0xD800) << 10) + (*p++ - 0xDC00);
+            *out++ = (char)(0xF0 | (c >> 18));
+            *out++ = (char)(0x80 | ((c >> 12) & 0x3F));
+            *out++ = (char)(0x80 | ((c >> 6) & 0x3F));
+            *out++ = (char)(0x80 | (c & 0x3F));
+            return out;
+        }
+        c = 0xFFFD;
+    }
+    *out++ = (char)(0xE0 | (c >> 12));
+    *out++ = (char)(0x80 | ((c >> 6) & 0x3F));
+    *out++ = (char)(0x80 | (c & 0x3F));
+    return out;
+}
+
+#ifdef __SSE2__
+// Eight surrogate-free units: every unit becomes a 32-bit word holding its
+// 1 to 3 encoded bytes, then each word is stored whole and the output only
+// advances by its length, so mixed scripts do not branch per character.
+// The caller keeps at least one unit after the block, which leaves room for
+// the last store's spare byte.
+static inline char* EncodeBlock(__m128i v, char* out)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i mask3f = _mm_set1_epi16(0x3F);
+    const __m128i cont = _mm_set1_epi16(0x80);
+    __m128i one = _mm_cmpeq_epi16(_mm_and_si128(v, _mm_set1_epi16((short)0xFF80)), zero);
+    __m128i two = _mm_cmpeq_epi16(_mm_and_si128(v, _mm_set1_epi16((short)0xF800)), zero);
+
+    __m128i low6 = _mm_or_si128(_mm_and_si128(v, mask3f), cont);
+    __m128i mid6 = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(v, 6), mask3f), cont);
+    // Two byte form: lead 110xxxxx, then the low six bits
+    __m128i word2 = _mm_or_si128(_mm_or_si128(_mm_srli_epi16(v, 6), _mm_set1_epi16(0xC0)), _mm_slli_epi16(low6, 8));
+    // Three byte form: lead 1110xxxx, the middle six bits, the low six bits in the high half
+    __m128i word3 = _mm_or_si128(_mm_or_si128(_mm_srli_epi16(v, 12), _mm_set1_epi16(0xE0)), _mm_slli_epi16(mid6, 8));
+
+    // One bit per unit for each mask
+    unsigned masks = (unsigned)_mm_movemask_epi8(_mm_packs_epi16(one, two));
+    if (masks == 0xFF00) {
+        // Only two byte forms, as in a run of Cyrillic or Greek: already in order
+        _mm_storeu_si128((__m128i*)out, word2);
+        return out + 16;
+    }
+
+    __m128i lo = _mm_or_si128(_mm_and_si128(two, word2), _mm_andnot_si128(two, word3));
+    lo = _mm_or_si128(_mm_and_si128(one, v), _mm_andnot_si128(one, lo));
+    __m128i hi = _mm_andnot_si128(two, low6);
+
+    alignas(16) uint32_t words[8];
+    _mm_store_si128((__m128i*)words, _mm_unpacklo_epi16(lo, hi));
+    _mm_store_si128((__m128i*)(words + 4), _mm_unpackhi_epi16(lo, hi));
+    // 3 bytes less one for each mask that holds
+    for (int i = 0; i < 8; i++) {
+        memcpy(out, &words[i], 4);
+        out += 3 - ((masks >> i) & 1) - ((masks >> (i + 8)) & 1);
+    }
+    return out;
+}
+#endif // __SSE2__
+
+size_t Utf16ToUtf8(const uint16_t* in, size_t len, char* out)
+{
+    const uint16_t* p = in;
+    const uint16_t* end = in + len;
+    char* start = out;
+#ifdef __SSE2__
+    const __m128i ascii = _mm_set1_epi16((short)0xFF80);
+    const __m128i surrogate = _mm_set1_epi16((short)0xF800);
+    const __m128i surrogateTag = _mm_set1_epi16((short)0xD800);
+    while (end - p > 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, ascii), _mm_setzero_si128())) == 0xFFFF) {
+            _mm_storel_epi64((__m128i*)out, _mm_packus_epi16(v, v));
+            out += 8;
+            p += 8;
+        } else if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, surrogate), surrogateTag)) == 0) {
+            out = EncodeBlock(v, out);
+            p += 8;
+        } else {
+            const uint16_t* blockEnd = p + 8;
+            while (p < blockEnd) {
+                out = EncodeOne(p, end, out);
+            }
+        }
+    }
+#endif // __SSE2__
+    while (p < end) {
+        out = EncodeOne(p, end, out);
+    }
+    return out - start;
+}
+
+bool IsValidUtf16(const uint16_t* in, size_t len)
+{
+    const uint16_t* p = in;
+    const uint16_t* end = in + len;
+#ifdef __SSE2__
+    const __m128i surrogate = _mm_set1_epi16((short)0xF800);
+    const __m128i surrogateTag = _mm_set1_epi16((short)0xD800);
+    while (end - p >= 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, surrogate), surrogateTag)) != 0) {
+            break;
+        }
+        p += 8;
+    }
+#endif // __SSE2__
+    while (p < end) {
+        uint16_t c = *p++;
+        if (IsLowSurrogate(c)) {
+            return false;
+        }
+        if (IsHighSurrogate(c)) {
+            if (p == end || !IsLowSurrogate(*p)) {
+                return false;
+            }
+            p++;
+        }
+    }
+    return true;
+}
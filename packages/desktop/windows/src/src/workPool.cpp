@@ -0,0 +1,106 @@
+#include "workPool.h"
+
+#include <algorithm>
+
+
+WorkStealingPool::WorkStealingPool(unsigned threads, std::function<void(size_t task)> run)
+    : _run(std::move(run)), _queued(0), _steals(0), _stopping(false)
+{
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned i = 0; i < threads; i++) {
+        _workers.push_back(std::make_unique<Worker>());
+    }
+    for (unsigned i = 0; i < threads; i++) {
+        _threads.emplace_back(&WorkStealingPool::WorkerLoop, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    Stop();
+}
+
+void WorkStealingPool::Submit(size_t task, unsigned hint)
+{
+    Worker& worker = *_workers[hint % _workers.size()];
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(task);
+    }
+    _queued.fetch_add(1);
+    {
+        // A worker between its check and its wait holds this lock, so the wakeup is not lost
+        std::lock_guard<std::mutex> lock(_idle_mutex);
+    }
+    _idle.notify_one();
+}
+
+void WorkStealingPool::Stop()
+{
+    if (_stopping.exchange(true)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(_idle_mutex);
+    }
+    _idle.notify_all();
+    for (auto& thread : _threads) {
+        thread.join();
+    }
+    _threads.clear();
+}
+
+bool WorkStealingPool::Pop(unsigned self, size_t& task)
+{
+    Worker& worker = *_workers[self];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.tasks.empty()) {
+        return false;
+    }
+    task = worker.tasks.front();
+    worker.tasks.pop_front();
+    return true;
+}
+
+bool WorkStealingPool::Steal(unsigned self, size_t& task)
+{
+    unsigned count = (unsigned)_workers.size();
+    for (unsigned i = 1; i < count; i++) {
+        Worker& victim = *_workers[(self + i) % count];
+        std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+        if (!lock.owns_lock() || victim.tasks.empty()) {
+            continue;
+        }
+        task = victim.tasks.back();
+        victim.tasks.pop_back();
+        _steals.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+void WorkStealingPool::WorkerLoop(unsigned self)
+{
+    size_t task;
+    while (true) {
+        if (Pop(self, task) || Steal(self, task)) {
+            _queued.fetch_sub(1);
+            _run(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(_idle_mutex);
+        if (_queued.load() > 0) {
+            // A victim was busy during the try_lock sweep, retry without sleeping
+            lock.unlock();
+            std::this_thread::yield();
+            continue;
+        }
+        if (_stopping) {
+            return;
+        }
+        _idle.wait(lock, [&]() { return _queued.load() > 0 || _stopping.load(); });
+    }
+}
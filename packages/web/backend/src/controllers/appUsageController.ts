@@ -189,4 +189,96 @@ export async function getCustomRangeAppUsage(req: AuthRequest, res: Response) {
     console.error('Error in getCustomRangeAppUsage controller:', error);
     return res.status(500).json({ error: 'Failed to retrieve custom range app usage data' });
   }
-} 
\ No newline at end of file
+} 
+
+const MAX_ROLLUPS_PER_REQUEST = 5000;
+
+/**
+ * Store daily rollups sealed by a desktop client
+ */
+export async function uploadDailyRollups(req: AuthRequest, res: Response) {
+  try {
+    const userId = req.user?.id;
+
+    if (!userId) {
+      return res.status(401).json({ error: 'User not authenticated' });
+    }
+
+    const { deviceId, rollups } = req.body ?? {};
+
+    if (!Number.isInteger(deviceId) || deviceId < 1) {
+      return res.status(400).json({ error: 'deviceId must be a positive integer' });
+    }
+    if (!Array.isArray(rollups) || rollups.length === 0 || rollups.length > MAX_ROLLUPS_PER_REQUEST) {
+      return res.status(400).json({ error: `rollups must be a non-empty array of at most ${MAX_ROLLUPS_PER_REQUEST} records` });
+    }
+
+    const valid = rollups.every((r: appUsageService.DailyRollup) =>
+      typeof r?.day === 'string' && /^\d{4}-\d{2}-\d{2}$/.test(r.day) &&
+      typeof r.executable === 'string' && r.executable.length > 0 &&
+      Number.isInteger(r.seconds) && r.seconds >= 0 &&
+      Number.isInteger(r.sessions) && r.sessions >= 0 &&
+      Number.isInteger(r.revision) && r.revision >= 1
+    );
+    if (!valid) {
+      return res.status(400).json({ error: 'Each rollup needs day (YYYY-MM-DD), executable, seconds, sessions and revision' });
+    }
+
+    const stored = await appUsageService.upsertDailyRollups(userId, deviceId, rollups);
+    return res.status(200).json({ received: rollups.length, stored });
+  } catch (error) {
+    console.error('Error in uploadDailyRollups controller:', error);
+    return res.status(500).json({ error: 'Failed to store daily rollups' });
+  }
+}
+
+/**
+ * Get app usage for a date range from the daily rollups
+ */
+export async function getRollupAppUsage(req: AuthRequest, res: Response) {
+  try {
+    const userId = req.user?.id;
+
+    if (!userId) {
+      return res.status(401).json({ error: 'User not authenticated' });
+    }
+
+    const { startDate, endDate } = req.query;
+
+    if (!startDate || !endDate) {
+      return res.status(400).json({ error: 'Both startDate and endDate are required' });
+    }
+
+    const page = parseInt(req.query.page as string) || 1;
+    const limit = parseInt(req.query.limit as string) || 10;
+
+    if (page < 1 || limit < 1 || limit > 100) {
+      return res.status(400).json({ 
+        error: 'Invalid pagination parameters. Page must be >= 1 and limit must be between 1 and 100' 
+      });
+    }
+
+    const parsedStartDate = parseISO(startDate as string);
+    const parsedEndDate = parseISO(endDate as string);
+
+    if (isNaN(parsedStartDate.getTime()) || isNaN(parsedEndDate.getTime())) {
+      return res.status(400).json({ error: 'Invalid date format. Use ISO format (e.g., 2023-01-01)' });
+    }
+    if (parsedStartDate > parsedEndDate) {
+      return res.status(400).json({ error: 'startDate must be before endDate' });
+    }
+
+    const { data, total } = await appUsageService.getRollupAppUsageForTimeRange(
+      userId,
+      parsedStartDate,
+      parsedEndDate,
+      page,
+      limit
+    );
+
+    return res.status(200).json({ data, total, page, limit });
+  } catch (error) {
+    console.error('Error in getRollupAppUsage controller:', error);
+    return res.status(500).json({ error: 'Failed to retrieve rollup app usage data' });
+  }
+}
@@ -134,6 +134,19 @@ CREATE TABLE IF NOT EXISTS app_usage_sessions (
     created_at TIMESTAMPTZ DEFAULT CURRENT_TIMESTAMP
 );
 
+-- Daily per-application rollups computed and sealed by the clients
+CREATE TABLE IF NOT EXISTS app_usage_daily_rollups (
+    user_id INTEGER REFERENCES users(id),
+    device_id BIGINT REFERENCES devices(device_id),
+    app_id BIGINT REFERENCES applications(app_id),
+    usage_date DATE NOT NULL,
+    total_duration INTEGER NOT NULL CHECK (total_duration >= 0),
+    session_count INTEGER NOT NULL CHECK (session_count >= 0),
+    revision INTEGER NOT NULL DEFAULT 1,
+    updated_at TIMESTAMPTZ DEFAULT CURRENT_TIMESTAMP,
+    PRIMARY KEY (user_id, device_id, app_id, usage_date)
+);
+
 -- App group members (junction table)
 CREATE TABLE IF NOT EXISTS app_group_members (
     group_id BIGINT REFERENCES app_groups(group_id),
@@ -167,6 +180,7 @@ CREATE INDEX IF NOT EXISTS idx_app_usage_start_time ON app_usage_sessions(start_
 CREATE INDEX IF NOT EXISTS idx_app_usage_device_id ON app_usage_sessions(device_id);
 CREATE INDEX IF NOT EXISTS idx_app_groups_user_id ON app_groups(user_id);
 CREATE INDEX IF NOT EXISTS idx_app_usage_user_time ON app_usage_sessions(user_id, start_time, end_time);
+CREATE INDEX IF NOT EXISTS idx_app_usage_rollups_user_date ON app_usage_daily_rollups(user_id, usage_date);
 CREATE INDEX IF NOT EXISTS idx_app_groups_parent ON app_groups(parent_group_id);
 CREATE INDEX IF NOT EXISTS idx_devices_user_id ON devices(user_id);
 CREATE INDEX IF NOT EXISTS idx_devices_os_name ON devices(os_name);
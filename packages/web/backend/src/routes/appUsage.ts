@@ -15,4 +15,8 @@ router.get('/monthly', appUsageController.getMonthlyAppUsage as RequestHandler);
 router.get('/yearly', appUsageController.getYearlyAppUsage as RequestHandler);
 router.get('/custom', appUsageController.getCustomRangeAppUsage as RequestHandler);
 
+// Daily rollups pre-aggregated by the desktop clients
+router.post('/rollups', appUsageController.uploadDailyRollups as RequestHandler);
+router.get('/rollups', appUsageController.getRollupAppUsage as RequestHandler);
+
 export default router; 
\ No newline at end of file
@@ -186,4 +186,154 @@ export async function getYearlyAppUsage(userId: number, page: number, limit: num
   endOfYear.setHours(23, 59, 59, 999);
 
   return getAppUsageForTimeRange(userId, startOfYear, endOfYear, page, limit);
-} 
\ No newline at end of file
+} 
+
+export interface DailyRollup {
+  day: string; // YYYY-MM-DD, client local date
+  executable: string;
+  seconds: number;
+  sessions: number;
+  revision: number;
+}
+
+/**
+ * Store rollups sealed by a client. A (device, app, day) row is only replaced by a
+ * higher revision, so re-sending the same records is a no-op
+ */
+export async function upsertDailyRollups(
+  userId: number,
+  deviceId: number,
+  rollups: DailyRollup[]
+): Promise<number> {
+  console.log(chalk.blue('📥 Upserting daily rollups for user:'), chalk.yellow(userId));
+  console.log(chalk.blue('💻 Device:'), chalk.cyan(deviceId), chalk.blue('Records:'), chalk.cyan(rollups.length));
+
+  const sql = `
+    WITH input AS (
+      SELECT DISTINCT ON (usage_date, package_name) *
+      FROM unnest($3::date[], $4::text[], $5::integer[], $6::integer[], $7::integer[])
+        AS t(usage_date, package_name, total_duration, session_count, revision)
+      ORDER BY usage_date, package_name, revision DESC
+    ),
+    new_apps AS (
+      INSERT INTO applications (app_name, package_name)
+      SELECT DISTINCT package_name, package_name FROM input
+      ON CONFLICT (package_name) DO NOTHING
+      RETURNING app_id, package_name
+    ),
+    apps AS (
+      SELECT app_id, package_name FROM new_apps
+      UNION
+      SELECT a.app_id, a.package_name
+      FROM applications a
+      JOIN input i ON i.package_name = a.package_name
+    )
+    INSERT INTO app_usage_daily_rollups
+      (user_id, device_id, app_id, usage_date, total_duration, session_count, revision)
+    SELECT $1, d.device_id, apps.app_id, i.usage_date, i.total_duration, i.session_count, i.revision
+    FROM input i
+    JOIN apps ON apps.package_name = i.package_name
+    JOIN devices d ON d.device_id = $2 AND d.user_id = $1
+    ON CONFLICT (user_id, device_id, app_id, usage_date) DO UPDATE SET
+      total_duration = EXCLUDED.total_duration,
+      session_count = EXCLUDED.session_count,
+      revision = EXCLUDED.revision,
+      updated_at = CURRENT_TIMESTAMP
+    WHERE app_usage_daily_rollups.revision < EXCLUDED.revision
+  `;
+
+  try {
+    const result = await query(sql, [
+      userId,
+      deviceId,
+      rollups.map(r => r.day),
+      rollups.map(r => r.executable),
+      rollups.map(r => r.seconds),
+      rollups.map(r => r.sessions),
+      rollups.map(r => r.revision),
+    ]);
+
+    console.log(chalk.green('✅ Rollups stored:'), chalk.cyan(`${result.rowCount} rows written`));
+    return result.rowCount ?? 0;
+  } catch (error) {
+    console.error(chalk.red('❌ Error storing daily rollups:'), error);
+    throw error;
+  }
+}
+
+/**
+ * Get app usage from the client rollups, summed over devices. Reads one row per
+ * app and day instead of every session, and counts the groups in the same pass
+ * unless the page is past the last one
+ */
+export async function getRollupAppUsageForTimeRange(
+  userId: number,
+  startDate: Date,
+  endDate: Date,
+  page: number = 1,
+  limit: number = 10
+): Promise<PaginatedAppUsage> {
+  console.log(chalk.blue('🔍 Getting rollup app usage for user:'), chalk.yellow(userId));
+  console.log(chalk.blue('📅 Time range:'), chalk.cyan(`${startDate} to ${endDate}`));
+
+  const offset = (page - 1) * limit;
+
+  const sql = `
+    SELECT 
+      a.app_id,
+      a.app_name,
+      a.package_name,
+      SUM(r.total_duration)::integer AS total_duration,
+      SUM(r.session_count)::integer AS session_count,
+      COUNT(*) OVER () AS total
+    FROM 
+      app_usage_daily_rollups r
+    JOIN 
+      applications a ON r.app_id = a.app_id
+    WHERE 
+      r.user_id = $1 AND
+      r.usage_date >= $2::date AND
+      r.usage_date <= $3::date
+    GROUP BY 
+      a.app_id, a.app_name, a.package_name
+    ORDER BY 
+      total_duration DESC
+    LIMIT $4 OFFSET $5
+  `;
+
+  try {
+    const result = await query(sql, [
+      userId,
+      formatISO(startDate, { representation: 'date' }),
+      formatISO(endDate, { representation: 'date' }),
+      limit,
+      offset
+    ]);
+
+    let total = parseInt(result.rows[0]?.total || '0', 10);
+    if (result.rows.length === 0 && offset > 0) {
+      // Past the last page no row carries the window count, count the groups on their own
+      const countResult = await query(
+        `SELECT COUNT(DISTINCT r.app_id) AS total
+         FROM app_usage_daily_rollups r
+         WHERE r.user_id = $1 AND r.usage_date >= $2::date AND r.usage_date <= $3::date`,
+        [
+          userId,
+          formatISO(startDate, { representation: 'date' }),
+          formatISO(endDate, { representation: 'date' })
+        ]
+      );
+      total = parseInt(countResult.rows[0]?.total || '0', 10);
+    }
+    console.log(chalk.green('✅ Query successful'));
+    console.log(chalk.blue('📊 Results:'), chalk.cyan(`${result.rows.length} rows returned, ${total} total`));
+
+    return {
+      data: result.rows.map(({ total: _total, ...row }) => row),
+      total
+    };
+  } catch (error) {
+    console.error(chalk.red('❌ Error fetching rollup app usage data:'), error);
+    throw error;
+  }
+}